@@ -0,0 +1,476 @@
+// file_sync_copy: copy strategy comparison.  Copies a set of files per size
+// bucket with every strategy and thread count and reports MB/s, CPU seconds
+// per GB and how much of the source and copy is left in the page cache.
+// Strategies are the CopyEngine ones plus two baselines that only live here:
+// fs::copy_file (what the daemon used before CopyEngine) and mmap + memcpy,
+// which the engine does not offer because a source truncated mid-copy
+// raises SIGBUS.  Ends with COPY_ENGINE / COPY_BUFFER_SIZE suggestions for
+// the destination next to what its device profile picks by default.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "copy_engine.hpp"
+#include "device_profiler.hpp"
+#include "photo_workload.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint64_t KiB = 1024;
+constexpr uint64_t MiB = 1024 * KiB;
+
+struct Options {
+    std::string sourceParent; // default: work dir
+    std::string destParent;   // default: work dir
+    std::string workDir;
+    std::vector<uint64_t> buckets = {4 * KiB, 64 * KiB, 1 * MiB, 16 * MiB, 256 * MiB};
+    std::vector<uint64_t> threads = {1, 4};
+    std::vector<uint64_t> buffers = {64 * KiB, 1 * MiB, 8 * MiB}; // read/write loop sizes
+    std::vector<std::string> strategies;                           // empty: all
+    uint64_t bytesPerBucket = 256 * MiB;
+    bool cold = false;  // evict the sources before every run
+    bool fsync = false; // fsync every copy
+    std::string csvPath;
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --work-dir DIR        scratch directory on the filesystem to test (default /var/tmp)\n"
+              << "  --source DIR          parent for the source files (default: work dir)\n"
+              << "  --dest DIR            parent for the copies (default: work dir)\n"
+              << "  --buckets S,S,...     file sizes, K/M/G suffixes (default 4K,64K,1M,16M,256M)\n"
+              << "  --bytes S             data per bucket (default 256M)\n"
+              << "  --threads N,N,...     concurrent copies (default 1,4)\n"
+              << "  --buffers S,S,...     read/write loop buffer sizes (default 64K,1M,8M)\n"
+              << "  --strategies A,B,...  subset of fs_copy, read_write, copy_file_range, sendfile,\n"
+              << "                        mmap, direct (default all)\n"
+              << "  --cold                evict the sources from the page cache before each run\n"
+              << "  --fsync               fsync each copy (count the device, not the page cache)\n"
+              << "  --csv FILE            write one row per run\n";
+}
+
+uint64_t parseSize(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    switch (end && *end ? std::toupper(*end) : 0) {
+        case 'K': value *= KiB; break;
+        case 'M': value *= MiB; break;
+        case 'G': value *= 1024.0 * MiB; break;
+        default: break;
+    }
+    return static_cast<uint64_t>(value);
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseSizes(const std::string& text, std::vector<uint64_t>& out) {
+    out.clear();
+    for (const auto& item : splitList(text)) {
+        uint64_t value = parseSize(item);
+        if (value == 0) {
+            return false;
+        }
+        out.push_back(value);
+    }
+    return !out.empty();
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--cold" || arg == "--fsync") {
+            (arg == "--cold" ? options.cold : options.fsync) = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--work-dir") options.workDir = value;
+        else if (arg == "--source") options.sourceParent = value;
+        else if (arg == "--dest") options.destParent = value;
+        else if (arg == "--buckets") { if (!parseSizes(value, options.buckets)) return false; }
+        else if (arg == "--bytes") options.bytesPerBucket = parseSize(value);
+        else if (arg == "--threads") { if (!parseSizes(value, options.threads)) return false; }
+        else if (arg == "--buffers") { if (!parseSizes(value, options.buffers)) return false; }
+        else if (arg == "--strategies") options.strategies = splitList(value);
+        else if (arg == "--csv") options.csvPath = value;
+        else return false;
+    }
+    return options.bytesPerBucket > 0;
+}
+
+std::string humanSize(uint64_t bytes) {
+    if (bytes >= MiB && bytes % MiB == 0) return std::to_string(bytes / MiB) + "M";
+    if (bytes >= KiB && bytes % KiB == 0) return std::to_string(bytes / KiB) + "K";
+    return std::to_string(bytes);
+}
+
+// One way of copying a file
+struct Strategy {
+    enum class Kind { FS_COPY, ENGINE, MMAP };
+
+    std::string name;
+    Kind kind;
+    CopyOptions options; // ENGINE only
+
+    // The COPY_ENGINE value that selects this strategy, if any
+    std::string configValue() const { return kind == Kind::ENGINE ? toString(options.strategy) : ""; }
+};
+
+void mmapCopy(const std::string& sourcePath, const std::string& destPath) {
+    sys::FileDescriptor source(sourcePath, O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fstat(source.fd(), &st) == -1) {
+        throw std::system_error(errno, std::system_category(), "Failed to stat " + sourcePath);
+    }
+    sys::FileDescriptor dest(destPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        return;
+    }
+    if (ftruncate(dest.fd(), st.st_size) == -1) {
+        throw std::system_error(errno, std::system_category(), "Failed to size " + destPath);
+    }
+    void* in = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, source.fd(), 0);
+    if (in == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(), "Failed to map " + sourcePath);
+    }
+    void* out = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, dest.fd(), 0);
+    if (out == MAP_FAILED) {
+        int error = errno;
+        ::munmap(in, size);
+        throw std::system_error(error, std::system_category(), "Failed to map " + destPath);
+    }
+    ::madvise(in, size, MADV_SEQUENTIAL);
+    std::memcpy(out, in, size);
+    ::munmap(out, size);
+    ::munmap(in, size);
+}
+
+// Pages of @p path resident in the page cache
+uint64_t residentBytes(const std::string& path) {
+    sys::FileDescriptor file(path, O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fstat(file.fd(), &st) == -1 || st.st_size == 0) {
+        return 0;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file.fd(), 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((size + page - 1) / page);
+    uint64_t resident = 0;
+    if (::mincore(map, size, pages.data()) == 0) {
+        for (unsigned char p : pages) {
+            resident += (p & 1) ? page : 0;
+        }
+    }
+    ::munmap(map, size);
+    return std::min<uint64_t>(resident, size);
+}
+
+void evict(const std::string& path) {
+    sys::FileDescriptor file(path, O_RDONLY | O_CLOEXEC);
+    ::fdatasync(file.fd());
+    ::posix_fadvise(file.fd(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+double cpuSeconds() {
+    struct rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval& tv) { return static_cast<double>(tv.tv_sec) + tv.tv_usec / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+struct RunResult {
+    std::string strategy;
+    uint64_t bucket = 0;
+    uint64_t threads = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    uint64_t sourceResident = 0;
+    uint64_t destResident = 0;
+    bool fellBack = false; // the filesystem refused the strategy for some files
+
+    double mbPerSecond() const { return static_cast<double>(bytes) / 1e6 / seconds; }
+    double cpuPerGb() const { return cpuSeconds / (static_cast<double>(bytes) / 1e9); }
+};
+
+RunResult runOnce(const Options& options, const Strategy& strategy, const std::vector<std::string>& sources,
+                  const fs::path& destDir, uint64_t bucket, uint64_t threadCount) {
+    RunResult result;
+    result.strategy = strategy.name;
+    result.bucket = bucket;
+    result.threads = threadCount;
+    result.files = sources.size();
+
+    std::error_code ec;
+    fs::remove_all(destDir, ec);
+    fs::create_directories(destDir);
+    if (options.cold) {
+        for (const auto& source : sources) {
+            evict(source);
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> bytes(0);
+    std::atomic<int> fallbacks(0);
+    std::vector<std::thread> workers;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    double cpuStart = cpuSeconds();
+    auto start = Clock::now();
+    for (uint64_t t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&] {
+            try {
+                for (size_t i = next++; i < sources.size(); i = next++) {
+                    std::string dest = (destDir / fs::path(sources[i]).filename()).string();
+                    switch (strategy.kind) {
+                        case Strategy::Kind::FS_COPY:
+                            fs::copy_file(sources[i], dest, fs::copy_options::overwrite_existing);
+                            break;
+                        case Strategy::Kind::MMAP:
+                            mmapCopy(sources[i], dest);
+                            break;
+                        case Strategy::Kind::ENGINE: {
+                            auto copied = CopyEngine::copyFile(sources[i], dest, strategy.options);
+                            if (copied.strategy != strategy.options.strategy) {
+                                fallbacks++;
+                            }
+                            break;
+                        }
+                    }
+                    if (options.fsync) {
+                        sys::FileDescriptor file(dest, O_RDONLY | O_CLOEXEC);
+                        ::fsync(file.fd());
+                    }
+                    bytes += fs::file_size(dest);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.cpuSeconds = cpuSeconds() - cpuStart;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    result.bytes = bytes;
+    result.fellBack = fallbacks > 0;
+
+    for (const auto& source : sources) {
+        result.sourceResident += residentBytes(source);
+        result.destResident += residentBytes((destDir / fs::path(source).filename()).string());
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.workDir.empty()) {
+        options.workDir = fs::is_directory("/var/tmp") ? "/var/tmp" : fs::temp_directory_path().string();
+    }
+    const std::string tag = "file_sync_copy." + std::to_string(getpid());
+    const fs::path work = fs::path(options.workDir) / tag;
+    const fs::path sourceRoot = options.sourceParent.empty() ? work / "source"
+                                                             : fs::path(options.sourceParent) / (tag + ".source");
+    const fs::path destRoot = options.destParent.empty() ? work / "dest"
+                                                         : fs::path(options.destParent) / (tag + ".dest");
+
+    // What the daemon would pick for this pair today
+    DeviceProfiler profiler;
+    fs::create_directories(sourceRoot);
+    fs::create_directories(destRoot);
+    IoProfile sourceProfile = profiler.profileFor(sourceRoot.string());
+    IoProfile destProfile = profiler.profileFor(destRoot.string());
+    CopyOptions defaults = copyOptionsFor(sourceProfile, destProfile);
+
+    std::vector<Strategy> strategies;
+    auto wanted = [&](const std::string& name) {
+        return options.strategies.empty() ||
+               std::find(options.strategies.begin(), options.strategies.end(), name) != options.strategies.end();
+    };
+    auto engine = [&](CopyStrategy strategy, size_t buffer) {
+        CopyOptions copyOptions = defaults;
+        copyOptions.strategy = strategy;
+        copyOptions.bufferSize = buffer;
+        return copyOptions;
+    };
+    if (wanted("fs_copy")) strategies.push_back({"fs_copy", Strategy::Kind::FS_COPY, {}});
+    if (wanted("read_write")) {
+        for (uint64_t buffer : options.buffers) {
+            strategies.push_back({"read_write:" + humanSize(buffer), Strategy::Kind::ENGINE,
+                                  engine(CopyStrategy::READ_WRITE, buffer)});
+        }
+    }
+    if (wanted("copy_file_range")) {
+        strategies.push_back({"copy_file_range", Strategy::Kind::ENGINE,
+                              engine(CopyStrategy::COPY_FILE_RANGE, defaults.bufferSize)});
+    }
+    if (wanted("sendfile")) {
+        strategies.push_back({"sendfile", Strategy::Kind::ENGINE, engine(CopyStrategy::SENDFILE, defaults.bufferSize)});
+    }
+    if (wanted("mmap")) strategies.push_back({"mmap", Strategy::Kind::MMAP, {}});
+    if (wanted("direct")) {
+        strategies.push_back({"direct", Strategy::Kind::ENGINE, engine(CopyStrategy::DIRECT_IO, defaults.bufferSize)});
+    }
+    if (strategies.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::ofstream csv;
+    if (!options.csvPath.empty()) {
+        csv.open(options.csvPath);
+        csv << "strategy,bucket_bytes,threads,files,bytes,seconds,mb_s,cpu_s_per_gb,source_cached_pct,"
+               "dest_cached_pct,fallback\n";
+    }
+
+    std::cout << "source " << sourceRoot.string() << " (" << (sourceProfile.device.empty() ? "?" : sourceProfile.device)
+              << "), dest " << destRoot.string() << " (" << (destProfile.device.empty() ? "?" : destProfile.device)
+              << ")" << (options.cold ? ", cold source" : ", warm source")
+              << (options.fsync ? ", fsync" : "") << std::endl;
+    std::cout << "profile default: COPY_ENGINE=" << toString(defaults.strategy)
+              << " COPY_BUFFER_SIZE=" << humanSize(defaults.bufferSize) << std::endl;
+    std::cout << std::left << std::setw(18) << "strategy" << std::right << std::setw(8) << "size" << std::setw(5)
+              << "thr" << std::setw(7) << "files" << std::setw(10) << "MB/s" << std::setw(10) << "cpu s/GB"
+              << std::setw(9) << "src$ %" << std::setw(9) << "dst$ %" << std::endl;
+
+    // Per strategy: MB/s per (bucket, threads), for the suggestions
+    std::map<std::string, std::vector<double>> rates;
+    std::set<std::string> refused;
+    int status = 0;
+    try {
+        for (uint64_t bucket : options.buckets) {
+            uint64_t count = std::clamp<uint64_t>(options.bytesPerBucket / bucket, 4, 4096);
+            std::error_code ec;
+            auto space = fs::space(work, ec);
+            if (!ec && space.available < 2 * count * bucket + 64 * MiB) {
+                std::cerr << "skipping " << humanSize(bucket) << " bucket: not enough space" << std::endl;
+                continue;
+            }
+
+            fs::path bucketDir = sourceRoot / humanSize(bucket);
+            fs::create_directories(bucketDir);
+            std::vector<std::string> sources;
+            for (uint64_t i = 0; i < count; ++i) {
+                WorkloadFile file{std::to_string(i) + ".bin", bucket, WorkloadFile::Kind::RAW, 0};
+                PhotoWorkload::write(bucketDir, file, bucket);
+                sources.push_back((bucketDir / file.path).string());
+            }
+
+            for (const auto& strategy : strategies) {
+                for (uint64_t threadCount : options.threads) {
+                    RunResult r = runOnce(options, strategy, sources, destRoot / humanSize(bucket), bucket,
+                                          threadCount);
+                    double total = static_cast<double>(count * bucket);
+                    double sourcePct = 100.0 * static_cast<double>(r.sourceResident) / total;
+                    double destPct = 100.0 * static_cast<double>(r.destResident) / total;
+                    rates[strategy.name].push_back(r.mbPerSecond());
+                    if (r.fellBack) {
+                        refused.insert(strategy.name);
+                    }
+
+                    std::cout << std::left << std::setw(18) << r.strategy << std::right << std::setw(8)
+                              << humanSize(bucket) << std::setw(5) << threadCount << std::setw(7) << count
+                              << std::fixed << std::setprecision(1) << std::setw(10) << r.mbPerSecond()
+                              << std::setprecision(2) << std::setw(10) << r.cpuPerGb() << std::setprecision(0)
+                              << std::setw(9) << sourcePct << std::setw(9) << destPct
+                              << (r.fellBack ? "  (fell back)" : "") << std::endl;
+                    if (csv) {
+                        csv << std::fixed << std::setprecision(3) << r.strategy << "," << bucket << ","
+                            << threadCount << "," << count << "," << r.bytes << "," << r.seconds << ","
+                            << r.mbPerSecond() << "," << r.cpuPerGb() << "," << sourcePct << "," << destPct << ","
+                            << (r.fellBack ? 1 : 0) << "\n";
+                    }
+                }
+            }
+            fs::remove_all(bucketDir, ec);
+            fs::remove_all(destRoot / humanSize(bucket), ec);
+        }
+
+        // Geometric mean across buckets and thread counts, so small files
+        // count as much as large ones; only strategies COPY_ENGINE can select
+        const Strategy* best = nullptr;
+        double bestScore = 0;
+        for (const auto& strategy : strategies) {
+            const auto& r = rates[strategy.name];
+            if (strategy.configValue().empty() || r.empty() || refused.count(strategy.name)) {
+                continue;
+            }
+            double logSum = 0;
+            for (double rate : r) {
+                logSum += std::log(std::max(rate, 1e-3));
+            }
+            double score = std::exp(logSum / static_cast<double>(r.size()));
+            if (score > bestScore) {
+                bestScore = score;
+                best = &strategy;
+            }
+        }
+        if (best) {
+            std::cout << "\nsuggested for " << (destProfile.device.empty() ? destRoot.string() : destProfile.device)
+                      << " (geometric mean " << std::setprecision(1) << bestScore << " MB/s):\n"
+                      << "COPY_ENGINE=" << best->configValue() << "\n"
+                      << "COPY_BUFFER_SIZE=" << humanSize(best->options.bufferSize) << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync_copy: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    std::error_code ec;
+    fs::remove_all(work, ec);
+    if (!options.sourceParent.empty()) fs::remove_all(sourceRoot, ec);
+    if (!options.destParent.empty()) fs::remove_all(destRoot, ec);
+    return status;
+}
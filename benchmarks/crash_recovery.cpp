@@ -0,0 +1,376 @@
+// file_sync_recovery: crash-recovery time against log size and in-flight
+// count.  For each configuration a transaction log is prepopulated, a child
+// process opens it and runs copy transactions until it is killed with
+// SIGKILL mid-batch, and a RobustSyncManager is then started on the same log.
+// Reported per run: time until the log is replayed and the in-flight backlog
+// is known (consistent), until the first new task is accepted, and until that
+// task is durable.  Needs nothing but a writable directory.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "robust_sync_manager.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string workDir;
+    std::vector<uint64_t> records = {10000, 100000, 1000000};
+    std::vector<double> inFlight = {0.01};
+    int batch = 1000;         // child transactions before it reports mid-batch
+    int killDelayMs = 5;      // then SIGKILL this much later
+    bool torn = false;        // append a partial record after the kill
+    bool dropCaches = false;  // replay from disk rather than the page cache
+    std::string csvPath;
+    bool keep = false;
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --work-dir DIR      scratch directory (default /dev/shm, else /tmp)\n"
+              << "  --records N,N,...   log sizes in records (default 10000,100000,1000000)\n"
+              << "  --in-flight F,F,... fraction of transactions left in flight (default 0.01)\n"
+              << "  --batch N           child transactions before the kill window (default 1000)\n"
+              << "  --kill-delay MS     SIGKILL this long after mid-batch (default 5)\n"
+              << "  --torn              leave a partial record at the end of the log\n"
+              << "  --drop-caches       drop the page cache before recovery (root)\n"
+              << "  --csv FILE          write one row per run\n"
+              << "  --keep              leave the logs in place\n";
+}
+
+template <typename T>
+bool parseList(const char* value, std::vector<T>& out) {
+    out.clear();
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        double parsed = std::atof(item.c_str());
+        if (parsed <= 0) {
+            return false;
+        }
+        out.push_back(static_cast<T>(parsed));
+    }
+    return !out.empty();
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--torn") { options.torn = true; continue; }
+        if (arg == "--drop-caches") { options.dropCaches = true; continue; }
+        if (arg == "--keep") { options.keep = true; continue; }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--work-dir") options.workDir = value;
+        else if (arg == "--records") { if (!parseList(value, options.records)) return false; }
+        else if (arg == "--in-flight") { if (!parseList(value, options.inFlight)) return false; }
+        else if (arg == "--batch") options.batch = std::max(1, std::atoi(value));
+        else if (arg == "--kill-delay") options.killDelayMs = std::max(0, std::atoi(value));
+        else if (arg == "--csv") options.csvPath = value;
+        else return false;
+    }
+    return std::all_of(options.inFlight.begin(), options.inFlight.end(), [](double f) { return f <= 1.0; });
+}
+
+double elapsedMs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Writes @p records log lines the way a long-running daemon would have:
+// PENDING, IN_PROGRESS, COMPLETED per transaction, except that every
+// 1/fraction-th transaction stops short.  Returns the in-flight count.
+uint64_t prepopulate(const fs::path& logDir, uint64_t records, double fraction) {
+    fs::create_directories(logDir);
+    std::ofstream out(logDir / "sync_log_20240101-000000.json", std::ios::binary);
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+    std::ostringstream line;
+
+    // Old enough that the recovery worker would retry them
+    auto base = std::chrono::system_clock::now() - std::chrono::hours(24);
+    const double stride = 1.0 / fraction;
+    double nextInFlight = stride / 2;
+    uint64_t written = 0;
+    uint64_t inFlight = 0;
+    for (uint64_t tx = 1; written < records; ++tx) {
+        TransactionLog::TransactionRecord record{
+            "tx-1700000000000-" + std::to_string(tx),
+            TransactionLog::OperationType::COPY,
+            "/photos/2024/" + std::to_string(tx % 365) + "/IMG_" + std::to_string(tx) + ".CR3",
+            "/backup/2024/" + std::to_string(tx % 365) + "/IMG_" + std::to_string(tx) + ".CR3",
+            TransactionLog::TransactionStatus::PENDING,
+            base + std::chrono::milliseconds(tx),
+            "",
+            std::nullopt};
+
+        bool stopsShort = static_cast<double>(tx) >= nextInFlight;
+        if (stopsShort) {
+            nextInFlight += stride;
+        }
+        // Half stop at PENDING, half at IN_PROGRESS; the record limit can
+        // also cut the last transaction short
+        int steps = stopsShort ? 1 + static_cast<int>(tx % 2) : 3;
+        int step = 0;
+        for (; step < steps && written < records; ++step, ++written) {
+            record.status = step == 0 ? TransactionLog::TransactionStatus::PENDING
+                          : step == 1 ? TransactionLog::TransactionStatus::IN_PROGRESS
+                                      : TransactionLog::TransactionStatus::COMPLETED;
+            line.str("");
+            writer->write(record.toJson(), &line);
+            out << line.str() << '\n';
+        }
+        if (step < 3) {
+            inFlight++;
+        }
+    }
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("failed to write the prepopulated log in " + logDir.string());
+    }
+    return inFlight;
+}
+
+// Runs copy transactions on the log in a child and kills it mid-batch.
+// Returns the child's replay time as reported over the pipe.
+double crashChild(const fs::path& logDir, const Options& options) {
+    int pipeFds[2];
+    if (::pipe(pipeFds) == -1) {
+        throw std::system_error(errno, std::system_category(), "pipe");
+    }
+    pid_t pid = ::fork();
+    if (pid == -1) {
+        throw std::system_error(errno, std::system_category(), "fork");
+    }
+    if (pid == 0) {
+        ::close(pipeFds[0]);
+        TransactionLog log(logDir.string());
+        log.open();
+        auto start = Clock::now();
+        log.recover();
+        double replayMs = elapsedMs(start, Clock::now());
+        if (::write(pipeFds[1], &replayMs, sizeof(replayMs)) != sizeof(replayMs)) {
+            ::_exit(1);
+        }
+        for (uint64_t n = 0;; ++n) {
+            std::string src = "/photos/new/IMG_" + std::to_string(n) + ".CR3";
+            std::string id = log.logTransaction(TransactionLog::OperationType::COPY, src, "/backup/new/" + src);
+            log.updateTransactionStatus(id, TransactionLog::TransactionStatus::IN_PROGRESS);
+            log.updateTransactionStatus(id, TransactionLog::TransactionStatus::COMPLETED);
+            if (n + 1 == static_cast<uint64_t>(options.batch)) {
+                char mid = 'm';
+                if (::write(pipeFds[1], &mid, 1) != 1) {
+                    ::_exit(1);
+                }
+            }
+        }
+    }
+
+    ::close(pipeFds[1]);
+    double replayMs = 0;
+    char mid = 0;
+    bool reported = ::read(pipeFds[0], &replayMs, sizeof(replayMs)) == sizeof(replayMs) &&
+                    ::read(pipeFds[0], &mid, 1) == 1;
+    if (reported) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.killDelayMs));
+    }
+    ::kill(pid, SIGKILL);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ::close(pipeFds[0]);
+    if (!reported) {
+        throw std::runtime_error("crash child exited before reaching mid-batch");
+    }
+    return replayMs;
+}
+
+void dropPageCache() {
+    ::sync();
+    std::ofstream out("/proc/sys/vm/drop_caches");
+    if (!(out << "1" << std::endl)) {
+        throw std::runtime_error("cannot write /proc/sys/vm/drop_caches (needs root)");
+    }
+}
+
+struct RunResult {
+    uint64_t records = 0;
+    double fraction = 0;
+    uint64_t expectedInFlight = 0;
+    uint64_t logBytes = 0;
+    double childReplayMs = 0;
+    TransactionLog::RecoveryStats recovered;
+    double consistentMs = 0; // manager constructed: log replayed, backlog known
+    double acceptedMs = 0;   // first new task enqueued
+    double durableMs = 0;    // first new task copied, verified and committed
+    bool synced = false;
+};
+
+RunResult runOnce(const Options& options, const fs::path& runDir, uint64_t records, double fraction) {
+    RunResult result;
+    result.records = records;
+    result.fraction = fraction;
+
+    const fs::path logDir = runDir / "txlog";
+    const fs::path source = runDir / "source";
+    const fs::path dest = runDir / "dest";
+    fs::create_directories(source);
+    fs::create_directories(dest);
+    result.expectedInFlight = prepopulate(logDir, records, fraction);
+    result.childReplayMs = crashChild(logDir, options);
+
+    fs::path logFile;
+    for (const auto& entry : fs::directory_iterator(logDir)) {
+        if (entry.path().filename().string().find("sync_log_") == 0) {
+            logFile = entry.path();
+        }
+    }
+    if (options.torn) {
+        std::ofstream(logFile, std::ios::app | std::ios::binary) << "{\"id\":\"tx-torn\",\"operation\":0,\"sourceP";
+    }
+    result.logBytes = fs::file_size(logFile);
+
+    // The new file exists before the clock starts; only recovery is timed
+    const std::string newFile = (source / "after_crash.jpg").string();
+    std::ofstream(newFile, std::ios::binary) << std::string(64 * 1024, 'x');
+    if (options.dropCaches) {
+        dropPageCache();
+    }
+
+    auto config = std::make_shared<Configuration>();
+    config->source_dir = source.string();
+    config->dest_dir = dest.string();
+    config->transaction_log_dir = logDir.string();
+    config->live_stats_path.clear();
+    config->num_threads = 2;
+    config->validate();
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::optional<Clock::time_point> durableAt;
+
+    auto start = Clock::now();
+    RobustSyncManager manager(config, std::make_unique<MetricsCollector>());
+    result.consistentMs = elapsedMs(start, Clock::now());
+    result.recovered = manager.getStartupRecovery();
+    manager.setCompletionCallback([&](const SyncTask& task, bool synced) {
+        if (task.getPath() != newFile) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        durableAt = Clock::now();
+        result.synced = synced;
+        done.notify_all();
+    });
+    manager.start();
+    while (!manager.syncFile(newFile)) {
+    }
+    result.acceptedMs = elapsedMs(start, Clock::now());
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait_for(lock, std::chrono::seconds(60), [&] { return durableAt.has_value(); });
+        if (durableAt) {
+            result.durableMs = elapsedMs(start, *durableAt);
+        }
+    }
+    manager.stop();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.workDir.empty()) {
+        options.workDir = fs::is_directory("/dev/shm") ? "/dev/shm" : fs::temp_directory_path().string();
+    }
+    const fs::path work = fs::path(options.workDir) / ("file_sync_recovery." + std::to_string(getpid()));
+
+    std::ofstream csv;
+    if (!options.csvPath.empty()) {
+        csv.open(options.csvPath);
+        csv << "records,in_flight_fraction,expected_in_flight,recovered_in_flight,log_bytes,torn_bytes,"
+               "child_replay_ms,consistent_ms,first_accepted_ms,first_durable_ms\n";
+    }
+
+    std::cout << std::setw(11) << "records" << std::setw(9) << "frac" << std::setw(10) << "in-flight"
+              << std::setw(10) << "log MiB" << std::setw(8) << "torn" << std::setw(14) << "consistent ms"
+              << std::setw(13) << "accepted ms" << std::setw(12) << "durable ms" << std::endl;
+
+    int status = 0;
+    try {
+        int run = 0;
+        for (uint64_t records : options.records) {
+            for (double fraction : options.inFlight) {
+                // About 250 bytes per record; the log lives alongside the trees
+                std::error_code ec;
+                fs::create_directories(work);
+                auto space = fs::space(work, ec);
+                if (!ec && space.available < records * 300) {
+                    throw std::runtime_error("not enough space in " + options.workDir + " for " +
+                                             std::to_string(records) + " records; use --work-dir");
+                }
+
+                fs::path runDir = work / ("run" + std::to_string(run++));
+                RunResult r = runOnce(options, runDir, records, fraction);
+                if (!options.keep) {
+                    fs::remove_all(runDir, ec);
+                }
+
+                std::cout << std::fixed << std::setw(11) << r.records << std::setprecision(3) << std::setw(9)
+                          << r.fraction << std::setw(10) << r.recovered.inFlight << std::setprecision(1)
+                          << std::setw(10) << static_cast<double>(r.logBytes) / (1024.0 * 1024.0) << std::setw(8)
+                          << r.recovered.tornBytes << std::setw(14) << r.consistentMs << std::setw(13)
+                          << r.acceptedMs << std::setw(12) << r.durableMs << std::endl;
+                if (csv) {
+                    csv << std::fixed << std::setprecision(3) << r.records << "," << r.fraction << ","
+                        << r.expectedInFlight << "," << r.recovered.inFlight << "," << r.logBytes << ","
+                        << r.recovered.tornBytes << "," << r.childReplayMs << "," << r.consistentMs << ","
+                        << r.acceptedMs << "," << r.durableMs << "\n";
+                }
+
+                // The crash child completes whatever it started, so everything
+                // prepopulated in flight must come back
+                if (r.recovered.inFlight < r.expectedInFlight || !r.synced) {
+                    std::cerr << "file_sync_recovery: expected " << r.expectedInFlight << " in flight, recovered "
+                              << r.recovered.inFlight << (r.synced ? "" : "; first new task did not sync")
+                              << std::endl;
+                    status = 1;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync_recovery: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    if (!options.keep) {
+        std::error_code ec;
+        fs::remove_all(work, ec);
+    }
+    return status;
+}
@@ -0,0 +1,348 @@
+// file_sync_e2e: end-to-end throughput harness.  Generates a synthetic photo
+// import into a watched source directory while a RobustSyncManager copies it
+// to a destination, then reports files/s, MB/s and event-to-durable latency
+// (file closed by the writer -> copy verified and transaction committed).
+// Needs nothing but a writable directory; tmpfs (/dev/shm) by default.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "file_system_monitor.hpp"
+#include "photo_workload.hpp"
+#include "robust_sync_manager.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    PhotoWorkloadSpec spec;
+    std::string workDir;
+    std::string sourceParent; // defaults to workDir
+    std::string destParent;   // defaults to workDir
+    int threads = 4;
+    std::string verifyMethod = "FAST_HASH";
+    int burstGapMs = 0;
+    int timeoutSeconds = 600;
+    bool keep = false;
+    bool preload = false; // write the tree first, then time the sync alone
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --work-dir DIR     scratch directory (default /dev/shm, else /tmp)\n"
+              << "  --source DIR       parent for the source tree (default: work dir)\n"
+              << "  --dest DIR         parent for the destination tree (default: work dir)\n"
+              << "  --scale X          multiply file sizes (default 0.05)\n"
+              << "  --bursts N         import sessions (default 4)\n"
+              << "  --pairs N          RAW+JPEG pairs per burst (default 25)\n"
+              << "  --thumbnails N     small preview files in total (default 3000)\n"
+              << "  --videos N         large videos in total (default 2)\n"
+              << "  --burst-gap MS     pause between bursts (default 0)\n"
+              << "  --threads N        sync worker threads (default 4)\n"
+              << "  --verify METHOD    VERIFY_METHOD for the copies (default FAST_HASH)\n"
+              << "  --seed N           workload seed (default 1)\n"
+              << "  --timeout S        give up after S seconds (default 600)\n"
+              << "  --preload          write the whole tree first, then time only the sync\n"
+              << "  --keep             leave the trees in place\n";
+}
+
+std::string humanBytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return ss.str();
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Tracks when each file was closed by the writer and when it became durable
+class LatencyTracker {
+public:
+    // The sync can finish before the writer gets here, so either side may arrive first
+    void written(const std::string& path, Clock::time_point closedAt) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto early = m_finishedEarly.find(path);
+        if (early != m_finishedEarly.end()) {
+            record(closedAt, early->second.first, early->second.second);
+            m_finishedEarly.erase(early);
+        } else {
+            m_writtenAt[path] = closedAt;
+        }
+    }
+
+    void finished(const std::string& path, bool synced) {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_writtenAt.find(path);
+        if (it != m_writtenAt.end()) {
+            record(it->second, now, synced);
+            m_writtenAt.erase(it);
+        } else {
+            m_finishedEarly[path] = {now, synced};
+        }
+    }
+
+    // Wait until @p expected files finished; false on timeout
+    bool waitFor(size_t expected, std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_changed.wait_for(lock, timeout, [&] { return m_finished >= expected; });
+    }
+
+    std::vector<double> latencies() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto sorted = m_latenciesMs;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
+    }
+
+    size_t failed() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failed;
+    }
+
+    size_t finished() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_finished;
+    }
+
+    Clock::time_point lastFinish() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lastFinish;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::unordered_map<std::string, Clock::time_point> m_writtenAt;
+    std::unordered_map<std::string, std::pair<Clock::time_point, bool>> m_finishedEarly;
+    std::vector<double> m_latenciesMs;
+    size_t m_finished = 0;
+    size_t m_failed = 0;
+    Clock::time_point m_lastFinish;
+
+    void record(Clock::time_point closedAt, Clock::time_point finishedAt, bool synced) {
+        if (synced) {
+            m_latenciesMs.push_back(std::chrono::duration<double, std::milli>(finishedAt - closedAt).count());
+        } else {
+            ++m_failed;
+        }
+        ++m_finished;
+        m_lastFinish = std::max(m_lastFinish, finishedAt);
+        m_changed.notify_all();
+    }
+};
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    options.spec.scale = 0.05;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* value = nullptr;
+        if (arg == "--keep" || arg == "--preload") {
+            (arg == "--keep" ? options.keep : options.preload) = true;
+            continue;
+        }
+        if (!(value = next())) {
+            return false;
+        }
+        if (arg == "--work-dir") options.workDir = value;
+        else if (arg == "--source") options.sourceParent = value;
+        else if (arg == "--dest") options.destParent = value;
+        else if (arg == "--scale") options.spec.scale = std::atof(value);
+        else if (arg == "--bursts") options.spec.bursts = std::atoi(value);
+        else if (arg == "--pairs") options.spec.pairsPerBurst = std::atoi(value);
+        else if (arg == "--thumbnails") options.spec.thumbnails = std::atoi(value);
+        else if (arg == "--videos") options.spec.videos = std::atoi(value);
+        else if (arg == "--burst-gap") options.burstGapMs = std::atoi(value);
+        else if (arg == "--threads") options.threads = std::max(1, std::atoi(value));
+        else if (arg == "--verify") options.verifyMethod = value;
+        else if (arg == "--seed") options.spec.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--timeout") options.timeoutSeconds = std::atoi(value);
+        else return false;
+    }
+    return options.spec.scale > 0 && options.spec.bursts > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.workDir.empty()) {
+        options.workDir = fs::is_directory("/dev/shm") ? "/dev/shm" : fs::temp_directory_path().string();
+    }
+    const std::string tag = "file_sync_e2e." + std::to_string(getpid());
+    const fs::path work = fs::path(options.workDir) / tag;
+    const fs::path source = fs::path(options.sourceParent.empty() ? work.string() : options.sourceParent) /
+                            (options.sourceParent.empty() ? "source" : tag + ".source");
+    const fs::path dest = fs::path(options.destParent.empty() ? work.string() : options.destParent) /
+                          (options.destParent.empty() ? "dest" : tag + ".dest");
+
+    auto files = PhotoWorkload::plan(options.spec);
+    const uint64_t totalBytes = PhotoWorkload::totalBytes(files);
+    std::cout << "workload: " << files.size() << " files, " << humanBytes(static_cast<double>(totalBytes));
+    for (auto kind : {WorkloadFile::Kind::RAW, WorkloadFile::Kind::JPEG, WorkloadFile::Kind::SIDECAR,
+                      WorkloadFile::Kind::THUMBNAIL, WorkloadFile::Kind::VIDEO}) {
+        auto count = std::count_if(files.begin(), files.end(), [&](const auto& f) { return f.kind == kind; });
+        std::cout << (kind == WorkloadFile::Kind::RAW ? " (" : ", ") << count << " " << toString(kind);
+    }
+    std::cout << ")" << std::endl;
+
+    int status = 0;
+    try {
+        fs::create_directories(work);
+        fs::create_directories(source);
+        fs::create_directories(dest);
+        std::error_code ec;
+        auto space = fs::space(work, ec);
+        if (!ec && space.available < totalBytes * 2 + (64ULL << 20)) {
+            throw std::runtime_error("not enough space in " + options.workDir + " (" +
+                                     humanBytes(static_cast<double>(space.available)) + " free, need " +
+                                     humanBytes(static_cast<double>(totalBytes * 2)) + "); lower --scale");
+        }
+
+        // The date hierarchy exists before the clock starts so every file
+        // lands in an already-watched directory
+        for (const auto& dir : PhotoWorkload::directories(files)) {
+            fs::create_directories(source / dir);
+        }
+        auto generateStart = Clock::now();
+        if (options.preload) {
+            for (const auto& file : files) {
+                PhotoWorkload::write(source, file, options.spec.seed);
+            }
+        }
+        double preloadSeconds = std::chrono::duration<double>(Clock::now() - generateStart).count();
+
+        FileSystemMonitor monitor;
+        monitor.addWatch(source.string());
+        for (const auto& dir : PhotoWorkload::directories(files)) {
+            monitor.addWatch((source / dir).string());
+        }
+
+        auto config = std::make_shared<Configuration>();
+        config->source_dir = source.string();
+        config->dest_dir = dest.string();
+        config->transaction_log_dir = (work / "txlog").string();
+        config->live_stats_path.clear();
+        config->num_threads = options.threads;
+        config->verify_method = options.verifyMethod;
+        config->retry_delay_seconds = 1;
+        config->validate();
+
+        LatencyTracker tracker;
+        RobustSyncManager manager(config, std::make_unique<MetricsCollector>());
+        manager.setCompletionCallback([&](const SyncTask& task, bool synced) {
+            tracker.finished(task.getPath(), synced);
+        });
+        manager.start();
+
+        // Daemon event loop: closed or renamed-in files are scheduled
+        std::atomic<bool> watching(true);
+        std::thread eventLoop([&] {
+            while (watching) {
+                bool idle = true;
+                while (auto event = monitor.getNextEvent()) {
+                    idle = false;
+                    if ((event->mask & IN_ISDIR) || !(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                        continue;
+                    }
+                    while (watching && !manager.syncFile(event->path)) {
+                        // Queue full: back-pressure, try again
+                    }
+                }
+                if (idle) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+
+        auto start = Clock::now();
+        if (options.preload) {
+            // Latency then runs from scheduling rather than from close()
+            for (const auto& file : files) {
+                std::string path = (source / file.path).string();
+                tracker.written(path, Clock::now());
+                while (!manager.syncFile(path)) {
+                }
+            }
+        } else {
+            int burst = 0;
+            for (const auto& file : files) {
+                if (file.burst != burst) {
+                    burst = file.burst;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(options.burstGapMs));
+                }
+                PhotoWorkload::write(source, file, options.spec.seed);
+                tracker.written((source / file.path).string(), Clock::now());
+            }
+        }
+        auto writeDone = Clock::now();
+
+        bool complete = tracker.waitFor(files.size(), std::chrono::seconds(options.timeoutSeconds));
+        auto end = complete ? tracker.lastFinish() : Clock::now();
+        watching = false;
+        eventLoop.join();
+        manager.stop();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double writeSeconds = options.preload ? preloadSeconds
+                                              : std::chrono::duration<double>(writeDone - start).count();
+        auto latencies = tracker.latencies();
+        size_t synced = latencies.size();
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "source: " << source.string() << "  dest: " << dest.string() << std::endl;
+        std::cout << "generated in " << writeSeconds << " s, synced " << synced << "/" << files.size()
+                  << " files in " << seconds << " s" << std::endl;
+        std::cout << "throughput: " << static_cast<double>(synced) / seconds << " files/s, "
+                  << static_cast<double>(totalBytes) / (1024.0 * 1024.0) / seconds << " MiB/s" << std::endl;
+        std::cout << std::setprecision(2) << (options.preload ? "schedule" : "event") << "-to-durable ms: p50 " << percentile(latencies, 0.50)
+                  << "  p90 " << percentile(latencies, 0.90) << "  p99 " << percentile(latencies, 0.99)
+                  << "  max " << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+        if (!complete || tracker.failed() > 0) {
+            std::cout << "failed: " << tracker.failed() << ", missing: " << files.size() - tracker.finished()
+                      << std::endl;
+            status = 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync_e2e: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    if (!options.keep) {
+        std::error_code ec;
+        fs::remove_all(work, ec);
+        if (!options.sourceParent.empty()) fs::remove_all(source, ec);
+        if (!options.destParent.empty()) fs::remove_all(dest, ec);
+    }
+    return status;
+}
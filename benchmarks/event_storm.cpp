@@ -0,0 +1,472 @@
+// file_sync_storm: event storm stress harness for FileSystemMonitor.  N writer
+// threads create, modify and rename files in a watched tree at a controlled
+// aggregate rate while one consumer drains the monitor the way the daemon
+// does.  Each step of the sweep reports achieved rate, op-to-dequeue latency,
+// the backlog between writers and consumer, IN_Q_OVERFLOW drops and how long
+// the consumer needs to recover; the sweep doubles the rate until the monitor
+// saturates.  --mock runs the same storm through MockFileSystemMonitor to
+// isolate the in-process queue from the kernel.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "file_system_monitor.hpp"
+#include "mock_file_system_monitor.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string workDir;
+    int writers = 4;
+    double rateMin = 1000;   // aggregate ops/s of the first step
+    double rateMax = 1024000;
+    double factor = 2.0;
+    double stepSeconds = 2.0;
+    int pollMicros = 100;    // consumer sleep when the monitor is empty
+    long maxQueuedEvents = 0; // overrides fs.inotify.max_queued_events for the run
+    size_t mockQueueLimit = 16384;
+    std::string csvPath;
+    bool mock = false;
+    bool full = false;       // keep sweeping past saturation
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --work-dir DIR          scratch directory (default /dev/shm, else /tmp)\n"
+              << "  --writers N             writer threads (default 4)\n"
+              << "  --rate-min OPS          first step, aggregate ops/s (default 1000)\n"
+              << "  --rate-max OPS          last step (default 1024000)\n"
+              << "  --factor X              rate multiplier per step (default 2)\n"
+              << "  --step S                seconds per step (default 2)\n"
+              << "  --poll-us N             consumer sleep when idle (default 100)\n"
+              << "  --max-queued-events N   set fs.inotify.max_queued_events for the run (root)\n"
+              << "  --mock                  drive MockFileSystemMonitor instead of inotify\n"
+              << "  --mock-queue-limit N    mock queue bound, 0 for none (default 16384)\n"
+              << "  --csv FILE              write the curve as CSV\n"
+              << "  --full                  do not stop at the first saturated step\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mock" || arg == "--full") {
+            (arg == "--mock" ? options.mock : options.full) = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--work-dir") options.workDir = value;
+        else if (arg == "--writers") options.writers = std::max(1, std::atoi(value));
+        else if (arg == "--rate-min") options.rateMin = std::atof(value);
+        else if (arg == "--rate-max") options.rateMax = std::atof(value);
+        else if (arg == "--factor") options.factor = std::atof(value);
+        else if (arg == "--step") options.stepSeconds = std::atof(value);
+        else if (arg == "--poll-us") options.pollMicros = std::max(0, std::atoi(value));
+        else if (arg == "--max-queued-events") options.maxQueuedEvents = std::atol(value);
+        else if (arg == "--mock-queue-limit") options.mockQueueLimit = std::strtoull(value, nullptr, 10);
+        else if (arg == "--csv") options.csvPath = value;
+        else return false;
+    }
+    return options.rateMin > 0 && options.rateMax >= options.rateMin && options.factor > 1.0 &&
+           options.stepSeconds > 0;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Temporarily replaces fs.inotify.max_queued_events; new monitors pick it up
+class QueuedEventsOverride {
+public:
+    explicit QueuedEventsOverride(long value) {
+        if (value <= 0) {
+            return;
+        }
+        std::ifstream(kPath) >> m_previous;
+        std::ofstream out(kPath);
+        if (!(out << value << std::endl)) {
+            throw std::runtime_error(std::string("cannot write ") + kPath + " (needs root)");
+        }
+    }
+    ~QueuedEventsOverride() {
+        if (m_previous > 0) {
+            std::ofstream(kPath) << m_previous << std::endl;
+        }
+    }
+
+private:
+    static constexpr const char* kPath = "/proc/sys/fs/inotify/max_queued_events";
+    long m_previous = 0;
+};
+
+// Every writer cycles through create(n), modify(n), rename(n): op 3n writes
+// and closes f<n>, op 3n+1 appends to it, op 3n+2 renames it to r<n>.  The
+// consumer maps the first CLOSE_WRITE of f<n> to op 3n, the second to 3n+1
+// and MOVED_TO r<n> to 3n+2, so every op has exactly one latency sample.
+class StormDriver {
+public:
+    virtual ~StormDriver() = default;
+    virtual void create(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) = 0;
+    virtual void modify(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) = 0;
+    virtual void rename(const std::string& dir, uint64_t n, const std::function<void()>& before) = 0;
+};
+
+class FileDriver : public StormDriver {
+public:
+    void create(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) override {
+        write(dir + "/f" + std::to_string(n), O_WRONLY | O_CREAT | O_TRUNC, beforeClose);
+    }
+    void modify(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) override {
+        write(dir + "/f" + std::to_string(n), O_WRONLY | O_APPEND, beforeClose);
+    }
+    void rename(const std::string& dir, uint64_t n, const std::function<void()>& before) override {
+        std::string from = dir + "/f" + std::to_string(n);
+        std::string to = dir + "/r" + std::to_string(n);
+        before();
+        if (::rename(from.c_str(), to.c_str()) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to rename " + from);
+        }
+    }
+
+private:
+    static void write(const std::string& path, int flags, const std::function<void()>& beforeClose) {
+        int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to open " + path);
+        }
+        static const char payload[64] = {};
+        if (::write(fd, payload, sizeof(payload)) != static_cast<ssize_t>(sizeof(payload))) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::system_category(), "Failed to write " + path);
+        }
+        beforeClose();
+        ::close(fd);
+    }
+};
+
+// Emits the events the kernel would for the same operations
+class MockDriver : public StormDriver {
+public:
+    explicit MockDriver(MockFileSystemMonitor& monitor) : m_monitor(monitor) {}
+
+    void create(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) override {
+        std::string path = dir + "/f" + std::to_string(n);
+        m_monitor.simulateEvent(path, "CREATE", IN_CREATE);
+        m_monitor.simulateEvent(path, "MODIFY", IN_MODIFY);
+        beforeClose();
+        m_monitor.simulateEvent(path, "CLOSE_WRITE", IN_CLOSE_WRITE);
+    }
+    void modify(const std::string& dir, uint64_t n, const std::function<void()>& beforeClose) override {
+        std::string path = dir + "/f" + std::to_string(n);
+        m_monitor.simulateEvent(path, "MODIFY", IN_MODIFY);
+        beforeClose();
+        m_monitor.simulateEvent(path, "CLOSE_WRITE", IN_CLOSE_WRITE);
+    }
+    void rename(const std::string& dir, uint64_t n, const std::function<void()>& before) override {
+        before();
+        m_monitor.simulateEvent(dir + "/r" + std::to_string(n), "MOVED_TO", IN_MOVED_TO);
+    }
+
+private:
+    MockFileSystemMonitor& m_monitor;
+};
+
+struct StepResult {
+    double targetRate = 0;
+    double achievedRate = 0;
+    uint64_t ops = 0;
+    uint64_t events = 0;   // events dequeued
+    uint64_t matched = 0;  // ops whose final event arrived
+    uint64_t overflows = 0;
+    uint64_t maxBacklog = 0; // ops completed but not yet seen by the consumer
+    double p50Us = 0, p99Us = 0, maxUs = 0;
+    double rescanMs = 0;   // walking the tree after an overflow
+    double drainMs = 0;    // writers stopped -> monitor empty
+
+    uint64_t lost() const { return ops - matched; }
+    bool saturated() const { return overflows > 0 || lost() > 0 || achievedRate < 0.9 * targetRate; }
+};
+
+// Per-writer op timestamps (ns since step start), filled before the final syscall
+struct WriterLog {
+    std::string dir;
+    std::vector<std::atomic<int64_t>> stampedAt;
+    std::vector<uint8_t> closesSeen; // consumer only: CLOSE_WRITEs seen for f<n>
+    std::atomic<uint64_t> completed{0};
+
+    WriterLog(std::string directory, size_t capacity)
+        : dir(std::move(directory)), stampedAt(capacity), closesSeen(capacity / 3 + 1, 0) {}
+};
+
+// Parses "<dir>/w<writer>/f<n>" or ".../r<n>"
+bool parseEventPath(const std::string& path, size_t& writer, char& kind, uint64_t& n) {
+    size_t slash = path.rfind('/');
+    size_t dirSlash = slash == std::string::npos ? std::string::npos : path.rfind('/', slash - 1);
+    if (dirSlash == std::string::npos || slash + 2 > path.size() || path[dirSlash + 1] != 'w') {
+        return false;
+    }
+    kind = path[slash + 1];
+    char* end = nullptr;
+    writer = std::strtoull(path.c_str() + dirSlash + 2, &end, 10);
+    n = std::strtoull(path.c_str() + slash + 2, &end, 10);
+    return (kind == 'f' || kind == 'r') && *end == '\0';
+}
+
+StepResult runStep(const Options& options, double rate, const fs::path& stepDir) {
+    StepResult result;
+    result.targetRate = rate;
+
+    std::unique_ptr<FileSystemMonitor> monitor;
+    std::unique_ptr<StormDriver> driver;
+    if (options.mock) {
+        auto mock = std::make_unique<MockFileSystemMonitor>();
+        mock->setQueueLimit(options.mockQueueLimit);
+        driver = std::make_unique<MockDriver>(*mock);
+        monitor = std::move(mock);
+    } else {
+        monitor = std::make_unique<FileSystemMonitor>();
+        driver = std::make_unique<FileDriver>();
+    }
+
+    // Room for a quarter more ops than scheduled so a late writer never overruns
+    const double perWriterRate = rate / options.writers;
+    const size_t capacity = static_cast<size_t>(perWriterRate * options.stepSeconds * 1.25) + 3;
+    std::vector<std::unique_ptr<WriterLog>> logs;
+    for (int w = 0; w < options.writers; ++w) {
+        fs::path dir = stepDir / ("w" + std::to_string(w));
+        if (!options.mock) {
+            fs::create_directories(dir);
+        }
+        monitor->addWatch(dir.string());
+        logs.push_back(std::make_unique<WriterLog>(dir.string(), capacity));
+    }
+
+    std::vector<double> latenciesUs;
+    latenciesUs.reserve(static_cast<size_t>(rate * options.stepSeconds));
+    std::atomic<bool> writing(true);
+    Clock::time_point stepStart = Clock::now();
+    Clock::time_point writersDone;
+    auto since = [&](Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - stepStart).count();
+    };
+
+    // Consumer: the daemon's event loop, minus the sync
+    std::thread consumer([&] {
+        uint64_t seenOverflows = 0;
+        Clock::time_point lastEvent = Clock::now();
+        auto sampleBacklog = [&] {
+            uint64_t completed = 0;
+            for (const auto& log : logs) {
+                completed += log->completed.load(std::memory_order_relaxed);
+            }
+            if (completed > result.matched) {
+                result.maxBacklog = std::max(result.maxBacklog, completed - result.matched);
+            }
+        };
+        while (true) {
+            bool idle = true;
+            while (auto event = monitor->getNextEvent()) {
+                idle = false;
+                int64_t now = since(Clock::now());
+                if (++result.events % 256 == 0) {
+                    sampleBacklog();
+                }
+                size_t w;
+                char kind;
+                uint64_t n;
+                if (!parseEventPath(event->path, w, kind, n) || w >= logs.size()) {
+                    continue;
+                }
+                auto& log = *logs[w];
+                uint64_t op;
+                if (kind == 'r' && (event->mask & IN_MOVED_TO)) {
+                    op = 3 * n + 2;
+                } else if (kind == 'f' && (event->mask & IN_CLOSE_WRITE) && n < log.closesSeen.size() &&
+                           log.closesSeen[n] < 2) {
+                    op = 3 * n + log.closesSeen[n]++;
+                } else {
+                    continue;
+                }
+                if (op >= log.stampedAt.size()) {
+                    continue;
+                }
+                int64_t stamped = log.stampedAt[op].load(std::memory_order_acquire);
+                if (stamped > 0) {
+                    latenciesUs.push_back(static_cast<double>(now - stamped) / 1000.0);
+                }
+                result.matched++;
+            }
+
+            sampleBacklog();
+
+            // Events were lost: rebuild from the tree as a real consumer must
+            uint64_t overflows = monitor->overflowCount();
+            if (overflows != seenOverflows) {
+                seenOverflows = overflows;
+                auto rescanStart = Clock::now();
+                if (!options.mock) {
+                    std::error_code ec;
+                    for (auto it = fs::recursive_directory_iterator(stepDir, ec);
+                         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                    }
+                }
+                result.rescanMs += std::chrono::duration<double, std::milli>(Clock::now() - rescanStart).count();
+            }
+
+            if (!idle) {
+                lastEvent = Clock::now();
+                continue;
+            }
+            // Drained once the writers are done and nothing arrived for 50ms
+            if (!writing && Clock::now() - lastEvent > std::chrono::milliseconds(50)) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(options.pollMicros));
+        }
+        result.drainMs = std::max(0.0, std::chrono::duration<double, std::milli>(lastEvent - writersDone).count());
+    });
+
+    // Open-loop writers: op k is due at k / perWriterRate; a late writer does not skip ops
+    std::vector<std::thread> writers;
+    std::mutex errorMutex;
+    std::exception_ptr writerError;
+    const auto stepLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.stepSeconds));
+    for (int w = 0; w < options.writers; ++w) {
+        writers.emplace_back([&, w] {
+            auto& log = *logs[w];
+            const auto interval = std::chrono::duration<double>(1.0 / perWriterRate);
+            for (uint64_t op = 0; op + 3 <= log.stampedAt.size(); ++op) {
+                auto due = stepStart + std::chrono::duration_cast<Clock::duration>(interval * static_cast<double>(op));
+                if (due - stepStart >= stepLength) {
+                    break;
+                }
+                std::this_thread::sleep_until(due);
+                auto stamp = [&] { log.stampedAt[op].store(std::max<int64_t>(1, since(Clock::now())), std::memory_order_release); };
+                uint64_t n = op / 3;
+                try {
+                    switch (op % 3) {
+                        case 0: driver->create(log.dir, n, stamp); break;
+                        case 1: driver->modify(log.dir, n, stamp); break;
+                        default: driver->rename(log.dir, n, stamp); break;
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    writerError = std::current_exception();
+                    return;
+                }
+                log.completed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    writersDone = Clock::now();
+    writing = false;
+    consumer.join();
+    if (writerError) {
+        std::rethrow_exception(writerError);
+    }
+
+    for (const auto& log : logs) {
+        result.ops += log->completed.load();
+    }
+    result.achievedRate = static_cast<double>(result.ops) / std::chrono::duration<double>(writersDone - stepStart).count();
+    result.overflows = monitor->overflowCount();
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    result.p50Us = percentile(latenciesUs, 0.50);
+    result.p99Us = percentile(latenciesUs, 0.99);
+    result.maxUs = latenciesUs.empty() ? 0.0 : latenciesUs.back();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.workDir.empty()) {
+        options.workDir = fs::is_directory("/dev/shm") ? "/dev/shm" : fs::temp_directory_path().string();
+    }
+    const fs::path work = fs::path(options.workDir) / ("file_sync_storm." + std::to_string(getpid()));
+
+    std::ofstream csv;
+    if (!options.csvPath.empty()) {
+        csv.open(options.csvPath);
+        csv << "target_ops_s,achieved_ops_s,ops,events,p50_us,p99_us,max_us,max_backlog,overflows,lost_ops,"
+               "rescan_ms,drain_ms\n";
+    }
+
+    std::cout << (options.mock ? "mock monitor" : "inotify") << ", " << options.writers << " writers, "
+              << options.stepSeconds << " s per step" << std::endl;
+    std::cout << std::setw(10) << "target/s" << std::setw(10) << "achieved" << std::setw(10) << "events"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us"
+              << std::setw(10) << "backlog" << std::setw(10) << "overflow" << std::setw(10) << "lost"
+              << std::setw(10) << "rescan ms" << std::setw(10) << "drain ms" << std::endl;
+
+    int status = 0;
+    try {
+        QueuedEventsOverride queuedEvents(options.mock ? 0 : options.maxQueuedEvents);
+        int step = 0;
+        for (double rate = options.rateMin; rate <= options.rateMax; rate *= options.factor, ++step) {
+            fs::path stepDir = work / ("step" + std::to_string(step));
+            StepResult r = runStep(options, rate, stepDir);
+            std::error_code ec;
+            fs::remove_all(stepDir, ec);
+
+            std::cout << std::fixed << std::setprecision(0) << std::setw(10) << r.targetRate << std::setw(10)
+                      << r.achievedRate << std::setw(10) << r.events << std::setprecision(1) << std::setw(10)
+                      << r.p50Us << std::setw(10) << r.p99Us << std::setw(10) << r.maxUs << std::setw(10)
+                      << r.maxBacklog << std::setw(10) << r.overflows << std::setw(10) << r.lost()
+                      << std::setw(10) << r.rescanMs << std::setw(10) << r.drainMs << std::endl;
+            if (csv) {
+                csv << std::fixed << std::setprecision(1) << r.targetRate << "," << r.achievedRate << "," << r.ops
+                    << "," << r.events << "," << r.p50Us << "," << r.p99Us << "," << r.maxUs << ","
+                    << r.maxBacklog << "," << r.overflows << "," << r.lost() << "," << r.rescanMs << ","
+                    << r.drainMs << "\n";
+            }
+            if (r.saturated() && !options.full) {
+                std::cout << "saturated at " << std::setprecision(0) << r.targetRate << " ops/s ("
+                          << (r.overflows > 0 ? "queue overflow" : r.lost() > 0 ? "lost events" : "writers fell behind")
+                          << ")" << std::endl;
+                break;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync_storm: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    std::error_code ec;
+    fs::remove_all(work, ec);
+    return status;
+}
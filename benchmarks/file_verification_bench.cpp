@@ -0,0 +1,77 @@
+//
+// FileVerification throughput per method and read size.  The sample files
+// stay in the page cache, so this measures hashing/compare CPU cost, not
+// the disk.
+//
+#include <benchmark/benchmark.h>
+#include "file_verification.hpp"
+
+#include <random>
+#include <unistd.h>
+
+namespace {
+
+using VerifyMethod = FileVerification::VerifyMethod;
+
+constexpr size_t kSampleSize = 8 * 1024 * 1024;
+
+// A random sample file and an identical copy, removed at exit
+struct SamplePair {
+    fs::path dir = fs::temp_directory_path() / ("file_sync_bench_verify_" + std::to_string(getpid()));
+    std::string source = (dir / "source.bin").string();
+    std::string copy = (dir / "copy.bin").string();
+
+    SamplePair() {
+        fs::create_directories(dir);
+        std::string data(kSampleSize, '\0');
+        std::mt19937_64 rng(7);
+        for (size_t i = 0; i + 8 <= data.size(); i += 8) {
+            uint64_t word = rng();
+            std::memcpy(&data[i], &word, sizeof(word));
+        }
+        std::ofstream(source, std::ios::binary) << data;
+        std::ofstream(copy, std::ios::binary) << data;
+    }
+    ~SamplePair() {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+};
+
+const SamplePair& samples() {
+    static SamplePair pair;
+    return pair;
+}
+
+} // namespace
+
+// range(0): VerifyMethod, range(1): read size.  Bytes count both files.
+static void BM_VerifyFile(benchmark::State& state) {
+    const auto& pair = samples();
+    auto method = static_cast<VerifyMethod>(state.range(0));
+    FileVerification verifier;
+    verifier.setReadSize(static_cast<size_t>(state.range(1)));
+
+    for (auto _ : state) {
+        auto result = verifier.verifyFile(pair.source, pair.copy, method);
+        if (!result.matches) {
+            state.SkipWithError(result.errorMessage.c_str());
+            break;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2 * kSampleSize));
+    switch (method) {
+        case VerifyMethod::FAST_HASH: state.SetLabel("md5"); break;
+        case VerifyMethod::SECURE_HASH: state.SetLabel("sha256"); break;
+        case VerifyMethod::FULL_COMPARE: state.SetLabel("compare"); break;
+        default: break;
+    }
+}
+BENCHMARK(BM_VerifyFile)
+    ->ArgsProduct({{static_cast<int64_t>(VerifyMethod::FAST_HASH),
+                    static_cast<int64_t>(VerifyMethod::SECURE_HASH),
+                    static_cast<int64_t>(VerifyMethod::FULL_COMPARE)},
+                   {64 * 1024, 1024 * 1024}})
+    ->ThreadRange(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
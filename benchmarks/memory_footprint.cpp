@@ -0,0 +1,351 @@
+// file_sync_memory: memory footprint per tracked file.  Each structure that
+// grows with the library (the monitor's watch table, the sync queue, the
+// transaction cache and the verification hash cache) is filled with synthetic
+// entries in a child process of its own, and the growth of the malloc heap
+// and of resident memory is reported per entry together with a projection to
+// a target library size.  A small calibration pass first estimates the cost,
+// so sizes that would not fit in this host's memory are skipped rather than
+// pushing it into the OOM killer.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "file_system_monitor.hpp"
+#include "file_verification.hpp"
+#include "priority_sync_queue.hpp"
+#include "transaction_log.hpp"
+
+namespace {
+
+struct Options {
+    std::string workDir;
+    std::vector<uint64_t> entries = {1000000};
+    uint64_t project = 100000000; // library size for the projection
+    uint64_t filesPerDirectory = 200;
+    std::vector<std::string> structures; // empty: all
+    std::string csvPath;
+};
+
+const char* kStructures[] = {"watch_table", "sync_queue", "transaction_cache", "hash_cache"};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --entries N,N,...     tracked files per run (default 1000000)\n"
+              << "  --project N           library size for the projection (default 100000000)\n"
+              << "  --files-per-dir N     files per watched directory (default 200)\n"
+              << "  --structures A,B,...  subset of watch_table, sync_queue, transaction_cache,\n"
+              << "                        hash_cache (default all)\n"
+              << "  --work-dir DIR        where the transaction log is written (default /var/tmp)\n"
+              << "  --csv FILE            write one row per run\n";
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--entries") {
+            options.entries.clear();
+            for (const auto& item : splitList(value)) {
+                options.entries.push_back(static_cast<uint64_t>(std::atof(item.c_str())));
+            }
+        }
+        else if (arg == "--project") options.project = static_cast<uint64_t>(std::atof(value.c_str()));
+        else if (arg == "--files-per-dir") options.filesPerDirectory = std::max<uint64_t>(1, std::atoll(value.c_str()));
+        else if (arg == "--structures") options.structures = splitList(value);
+        else if (arg == "--work-dir") options.workDir = value;
+        else if (arg == "--csv") options.csvPath = value;
+        else return false;
+    }
+    for (const auto& name : options.structures) {
+        if (std::find(std::begin(kStructures), std::end(kStructures), name) == std::end(kStructures)) {
+            return false;
+        }
+    }
+    return !options.entries.empty() &&
+           std::all_of(options.entries.begin(), options.entries.end(), [](uint64_t n) { return n > 0; });
+}
+
+// Photo-library-like names: /photos/YYYY/MM/DD/HHMM_camera/IMG_nnnnnnn.CR3
+std::string directoryFor(uint64_t file, uint64_t filesPerDirectory) {
+    static const char* cameras[] = {"EOS_R5", "Z8", "A7RV", "X-T5", "iPhone15Pro"};
+    uint64_t dir = file / filesPerDirectory;
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "/photos/%04u/%02u/%02u/%02u%02u_%s",
+                  static_cast<unsigned>(2000 + dir / 8064 % 100), static_cast<unsigned>(1 + dir / 672 % 12),
+                  static_cast<unsigned>(1 + dir / 24 % 28), static_cast<unsigned>(dir % 24),
+                  static_cast<unsigned>(dir * 7 % 60), cameras[dir % std::size(cameras)]);
+    return buffer;
+}
+
+std::string pathFor(uint64_t file, uint64_t filesPerDirectory) {
+    return directoryFor(file, filesPerDirectory) + "/IMG_" + std::to_string(1000000 + file) + ".CR3";
+}
+
+// Exposes the watch table so it can be filled without inotify_add_watch,
+// which the kernel caps far below these sizes (fs.inotify.max_user_watches)
+class SyntheticWatchTable : public FileSystemMonitor {
+public:
+    void add(int wd, std::string path) { m_watch_descriptors.emplace(wd, std::move(path)); }
+    size_t size() const { return m_watch_descriptors.size(); }
+};
+
+struct Usage {
+    uint64_t heapBytes = 0;     // malloc'd and in use
+    uint64_t residentBytes = 0; // RSS
+};
+
+Usage currentUsage() {
+    Usage usage;
+    struct mallinfo2 info = ::mallinfo2();
+    usage.heapBytes = info.uordblks + info.hblkhd;
+    long pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    usage.residentBytes = static_cast<uint64_t>(resident) * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    return usage;
+}
+
+uint64_t availableMemory() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    uint64_t value = 0;
+    std::string unit;
+    while (meminfo >> key >> value >> unit) {
+        if (key == "MemAvailable:") {
+            return value * 1024;
+        }
+    }
+    return 0;
+}
+
+struct RunResult {
+    std::string structure;
+    uint64_t files = 0;
+    uint64_t entries = 0; // watch table: directories, otherwise files
+    Usage growth;
+    bool ok = false;
+
+    double heapPerFile() const { return static_cast<double>(growth.heapBytes) / static_cast<double>(files); }
+    double residentPerFile() const { return static_cast<double>(growth.residentBytes) / static_cast<double>(files); }
+};
+
+// Fills one structure for @p files tracked files; runs in the child
+RunResult populate(const std::string& structure, uint64_t files, const Options& options, const fs::path& work) {
+    RunResult result;
+    result.structure = structure;
+    result.files = files;
+
+    // Everything that is not the structure itself is created first
+    std::unique_ptr<SyntheticWatchTable> watches;
+    std::unique_ptr<PrioritySyncQueue> queue;
+    std::unique_ptr<TransactionLog> log;
+    std::unique_ptr<FileVerification> verifier;
+    fs::path logDir = work / ("txlog." + std::to_string(::getpid()));
+    if (structure == "watch_table") watches = std::make_unique<SyntheticWatchTable>();
+    if (structure == "sync_queue") queue = std::make_unique<PrioritySyncQueue>(files);
+    if (structure == "transaction_cache") {
+        log = std::make_unique<TransactionLog>(logDir.string());
+        log->open();
+    }
+    if (structure == "hash_cache") verifier = std::make_unique<FileVerification>();
+
+    ::malloc_trim(0);
+    Usage before = currentUsage();
+
+    if (watches) {
+        // One watch per directory holding files
+        for (uint64_t dir = 0; dir * options.filesPerDirectory < files; ++dir) {
+            watches->add(static_cast<int>(dir + 1), directoryFor(dir * options.filesPerDirectory, options.filesPerDirectory));
+        }
+        result.entries = watches->size();
+    } else if (queue) {
+        for (uint64_t i = 0; i < files; ++i) {
+            SyncTask task(pathFor(i, options.filesPerDirectory), "SYNC",
+                          static_cast<SyncPriority>(i % kSyncPriorityLevels));
+            task.setSize(32ULL << 20);
+            queue->enqueue(std::move(task), std::chrono::milliseconds(0));
+        }
+        result.entries = queue->size();
+    } else if (log) {
+        // A long-running daemon's cache: every transaction it ever committed
+        for (uint64_t i = 0; i < files; ++i) {
+            std::string source = pathFor(i, options.filesPerDirectory);
+            std::string id = log->logTransaction(TransactionLog::OperationType::COPY, source, "/backup" + source);
+            log->updateTransactionStatus(id, TransactionLog::TransactionStatus::COMPLETED);
+        }
+        result.entries = files;
+    } else if (verifier) {
+        const std::string md5(32, 'f');
+        for (uint64_t i = 0; i < files; ++i) {
+            verifier->cacheHash(pathFor(i, options.filesPerDirectory), md5, 32ULL << 20);
+        }
+        result.entries = files;
+    }
+
+    Usage after = currentUsage();
+    result.growth.heapBytes = after.heapBytes > before.heapBytes ? after.heapBytes - before.heapBytes : 0;
+    result.growth.residentBytes = after.residentBytes > before.residentBytes ? after.residentBytes - before.residentBytes : 0;
+    result.ok = true;
+
+    if (log) {
+        log->close();
+        std::error_code ec;
+        fs::remove_all(logDir, ec);
+    }
+    return result;
+}
+
+// Runs populate() in a child so every structure starts from a fresh heap
+RunResult measure(const std::string& structure, uint64_t files, const Options& options, const fs::path& work) {
+    int pipeFds[2];
+    if (::pipe(pipeFds) == -1) {
+        throw std::system_error(errno, std::system_category(), "pipe");
+    }
+    pid_t pid = ::fork();
+    if (pid == -1) {
+        throw std::system_error(errno, std::system_category(), "fork");
+    }
+    if (pid == 0) {
+        ::close(pipeFds[0]);
+        RunResult r = populate(structure, files, options, work);
+        uint64_t fields[3] = {r.entries, r.growth.heapBytes, r.growth.residentBytes};
+        bool written = ::write(pipeFds[1], fields, sizeof(fields)) == static_cast<ssize_t>(sizeof(fields));
+        // Skip the destructors; freeing millions of entries only costs time
+        ::_exit(written ? 0 : 1);
+    }
+
+    ::close(pipeFds[1]);
+    uint64_t fields[3] = {};
+    bool read = ::read(pipeFds[0], fields, sizeof(fields)) == static_cast<ssize_t>(sizeof(fields));
+    ::close(pipeFds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+
+    RunResult result;
+    result.structure = structure;
+    result.files = files;
+    result.ok = read && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    result.entries = fields[0];
+    result.growth.heapBytes = fields[1];
+    result.growth.residentBytes = fields[2];
+    return result;
+}
+
+std::string humanBytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return ss.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.workDir.empty()) {
+        options.workDir = fs::is_directory("/var/tmp") ? "/var/tmp" : fs::temp_directory_path().string();
+    }
+    const fs::path work = fs::path(options.workDir);
+
+    std::vector<std::string> structures = options.structures;
+    if (structures.empty()) {
+        structures.assign(std::begin(kStructures), std::end(kStructures));
+    }
+
+    std::ofstream csv;
+    if (!options.csvPath.empty()) {
+        csv.open(options.csvPath);
+        csv << "structure,files,entries,heap_bytes,resident_bytes,heap_per_file,resident_per_file,projected_bytes\n";
+    }
+
+    std::cout << std::left << std::setw(19) << "structure" << std::right << std::setw(12) << "files"
+              << std::setw(12) << "entries" << std::setw(12) << "heap" << std::setw(12) << "resident"
+              << std::setw(11) << "heap B/f" << std::setw(11) << "RSS B/f" << std::setw(16)
+              << ("@ " + std::to_string(options.project / 1000000) + "M files") << std::endl;
+
+    int status = 0;
+    double projectedTotal = 0;
+    try {
+        for (const auto& structure : structures) {
+            // Calibrate on a small run so oversized requests are refused up front
+            RunResult calibration = measure(structure, 100000, options, work);
+            double perFile = calibration.ok ? std::max(calibration.residentPerFile(), calibration.heapPerFile()) : 0;
+
+            for (uint64_t files : options.entries) {
+                double needed = perFile * static_cast<double>(files) * 1.5; // container growth overshoot
+                uint64_t available = availableMemory();
+                if (available > 0 && needed > static_cast<double>(available) * 0.9) {
+                    std::cout << std::left << std::setw(19) << structure << std::right << std::setw(12) << files
+                              << "  skipped: needs ~" << humanBytes(needed) << ", "
+                              << humanBytes(static_cast<double>(available)) << " available" << std::endl;
+                    continue;
+                }
+
+                RunResult r = measure(structure, files, options, work);
+                if (!r.ok) {
+                    std::cerr << "file_sync_memory: " << structure << " run with " << files << " files failed"
+                              << std::endl;
+                    status = 1;
+                    continue;
+                }
+                double projected = r.residentPerFile() * static_cast<double>(options.project);
+                std::cout << std::left << std::setw(19) << r.structure << std::right << std::setw(12) << r.files
+                          << std::setw(12) << r.entries << std::setw(12)
+                          << humanBytes(static_cast<double>(r.growth.heapBytes)) << std::setw(12)
+                          << humanBytes(static_cast<double>(r.growth.residentBytes)) << std::fixed
+                          << std::setprecision(1) << std::setw(11) << r.heapPerFile() << std::setw(11)
+                          << r.residentPerFile() << std::setw(16) << humanBytes(projected) << std::endl;
+                if (csv) {
+                    csv << std::fixed << std::setprecision(2) << r.structure << "," << r.files << "," << r.entries
+                        << "," << r.growth.heapBytes << "," << r.growth.residentBytes << "," << r.heapPerFile()
+                        << "," << r.residentPerFile() << "," << static_cast<uint64_t>(projected) << "\n";
+                }
+                if (files == options.entries.back()) {
+                    projectedTotal += projected;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync_memory: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    if (projectedTotal > 0) {
+        std::cout << "\nall structures at " << options.project << " files: ~" << humanBytes(projectedTotal)
+                  << " resident" << std::endl;
+    }
+    return status;
+}
@@ -0,0 +1,32 @@
+//
+// MetricsCollector recording cost under contention.
+//
+#include <benchmark/benchmark.h>
+#include "metrics_collector.hpp"
+
+#include <string>
+
+// recordMetric() appends to an unbounded buffer until collect(), so the
+// iteration count is fixed to keep memory in check
+static void BM_RecordMetric(benchmark::State& state) {
+    static MetricsCollector metrics;
+    const std::string value = "tx-" + std::to_string(state.thread_index());
+
+    for (auto _ : state) {
+        metrics.recordMetric("tx_completed", value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RecordMetric)->ThreadRange(1, 8)->Iterations(1 << 16)->UseRealTime();
+
+static void BM_SetGauge(benchmark::State& state) {
+    static MetricsCollector metrics;
+    const std::string name = "sync_queue_pending{priority=\"" + std::to_string(state.thread_index()) + "\"}";
+    double value = 0;
+
+    for (auto _ : state) {
+        metrics.setGauge(name, value += 1.0);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetGauge)->ThreadRange(1, 8)->UseRealTime();
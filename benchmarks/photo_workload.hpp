@@ -0,0 +1,164 @@
+//
+// Synthetic photo library workload: burst imports of RAW+JPEG pairs with XMP
+// sidecars, thousands of small thumbnails, a few large videos, all under
+// deep YYYY/MM/DD/HHMM_camera hierarchies.  Deterministic for a given seed.
+//
+
+#ifndef PHOTO_WORKLOAD_HPP
+#define PHOTO_WORKLOAD_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+struct PhotoWorkloadSpec {
+    uint64_t seed = 1;
+    int bursts = 4;            // import sessions, one date directory each
+    int pairsPerBurst = 25;    // RAW + JPEG (+ XMP sidecar) per burst
+    int thumbnails = 3000;     // small preview files, spread over the bursts
+    int videos = 2;
+    double scale = 1.0;        // multiplies every file size
+
+    uint64_t rawMin = 20ULL << 20, rawMax = 60ULL << 20;
+    uint64_t jpegMin = 3ULL << 20, jpegMax = 12ULL << 20;
+    uint64_t sidecarMin = 2ULL << 10, sidecarMax = 8ULL << 10;
+    uint64_t thumbnailMin = 4ULL << 10, thumbnailMax = 48ULL << 10;
+    uint64_t videoMin = 500ULL << 20, videoMax = 2ULL << 30;
+};
+
+struct WorkloadFile {
+    enum class Kind { RAW, JPEG, SIDECAR, THUMBNAIL, VIDEO };
+
+    std::string path; // relative to the workload root
+    uint64_t size;
+    Kind kind;
+    int burst;
+};
+
+inline const char* toString(WorkloadFile::Kind kind) {
+    switch (kind) {
+        case WorkloadFile::Kind::RAW: return "raw";
+        case WorkloadFile::Kind::JPEG: return "jpeg";
+        case WorkloadFile::Kind::SIDECAR: return "sidecar";
+        case WorkloadFile::Kind::THUMBNAIL: return "thumbnail";
+        case WorkloadFile::Kind::VIDEO: return "video";
+    }
+    return "unknown";
+}
+
+class PhotoWorkload {
+public:
+    // Files in the order an import would write them, burst by burst
+    static std::vector<WorkloadFile> plan(const PhotoWorkloadSpec& spec) {
+        static const char* cameras[] = {"EOS_R5", "Z8", "A7RV", "X-T5", "iPhone15Pro"};
+        std::mt19937_64 rng(spec.seed);
+        auto sized = [&](uint64_t lo, uint64_t hi) {
+            uint64_t size = std::uniform_int_distribution<uint64_t>(lo, hi)(rng);
+            return std::max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(size) * spec.scale));
+        };
+
+        std::vector<WorkloadFile> files;
+        int day = 0;
+        int imageNumber = 1000;
+        for (int burst = 0; burst < spec.bursts; ++burst) {
+            day += 1 + static_cast<int>(rng() % 9);
+            const std::string camera = cameras[rng() % std::size(cameras)];
+            char dir[64];
+            std::snprintf(dir, sizeof(dir), "%04d/%02d/%02d/%02d%02d_%s", 2024 + day / 336,
+                          1 + (day / 28) % 12, 1 + day % 28, static_cast<int>(rng() % 24),
+                          static_cast<int>(rng() % 60), camera.c_str());
+
+            for (int pair = 0; pair < spec.pairsPerBurst; ++pair, ++imageNumber) {
+                std::string stem = std::string(dir) + "/IMG_" + std::to_string(imageNumber);
+                files.push_back({stem + ".CR3", sized(spec.rawMin, spec.rawMax), WorkloadFile::Kind::RAW, burst});
+                files.push_back({stem + ".JPG", sized(spec.jpegMin, spec.jpegMax), WorkloadFile::Kind::JPEG, burst});
+                files.push_back({stem + ".xmp", sized(spec.sidecarMin, spec.sidecarMax),
+                                 WorkloadFile::Kind::SIDECAR, burst});
+            }
+
+            int thumbnails = spec.thumbnails / std::max(spec.bursts, 1) +
+                             (burst < spec.thumbnails % std::max(spec.bursts, 1) ? 1 : 0);
+            for (int i = 0; i < thumbnails; ++i) {
+                files.push_back({std::string(dir) + "/.thumbnails/" + std::to_string(i / 256) + "/" +
+                                     std::to_string(i) + ".webp",
+                                 sized(spec.thumbnailMin, spec.thumbnailMax), WorkloadFile::Kind::THUMBNAIL, burst});
+            }
+
+            for (int video = burst; video < spec.videos; video += std::max(spec.bursts, 1)) {
+                files.push_back({std::string(dir) + "/MVI_" + std::to_string(imageNumber++) + ".MP4",
+                                 sized(spec.videoMin, spec.videoMax), WorkloadFile::Kind::VIDEO, burst});
+            }
+        }
+        return files;
+    }
+
+    static uint64_t totalBytes(const std::vector<WorkloadFile>& files) {
+        uint64_t total = 0;
+        for (const auto& file : files) {
+            total += file.size;
+        }
+        return total;
+    }
+
+    // Every directory the plan writes into, parents first
+    static std::vector<fs::path> directories(const std::vector<WorkloadFile>& files) {
+        std::set<fs::path> dirs;
+        for (const auto& file : files) {
+            for (fs::path dir = fs::path(file.path).parent_path(); !dir.empty(); dir = dir.parent_path()) {
+                dirs.insert(dir);
+            }
+        }
+        std::vector<fs::path> ordered(dirs.begin(), dirs.end());
+        std::stable_sort(ordered.begin(), ordered.end(), [](const fs::path& a, const fs::path& b) {
+            return std::distance(a.begin(), a.end()) < std::distance(b.begin(), b.end());
+        });
+        return ordered;
+    }
+
+    // Write one file with incompressible, per-file content.  Throws std::system_error.
+    static void write(const fs::path& root, const WorkloadFile& file, uint64_t seed) {
+        fs::path path = root / file.path;
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to create " + path.string());
+        }
+
+        constexpr size_t kChunk = 1 << 20;
+        std::vector<uint64_t> block((std::min<uint64_t>(kChunk, file.size) + 7) / sizeof(uint64_t));
+        std::mt19937_64 rng(seed ^ std::hash<std::string>{}(file.path));
+        for (auto& word : block) {
+            word = rng();
+        }
+
+        uint64_t written = 0;
+        while (written < file.size) {
+            block[0] = written; // no two chunks alike, so dedupe cannot shortcut the copy
+            size_t length = static_cast<size_t>(std::min<uint64_t>(block.size() * sizeof(uint64_t),
+                                                                   file.size - written));
+            ssize_t n = ::write(fd, block.data(), length);
+            if (n <= 0) {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::system_category(), "Failed to write " + path.string());
+            }
+            written += static_cast<uint64_t>(n);
+        }
+        if (::close(fd) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to close " + path.string());
+        }
+    }
+};
+
+#endif // PHOTO_WORKLOAD_HPP
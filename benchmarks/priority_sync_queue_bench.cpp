@@ -0,0 +1,64 @@
+//
+// PrioritySyncQueue enqueue/dequeue cost under contention.
+//
+#include <benchmark/benchmark.h>
+#include "priority_sync_queue.hpp"
+
+namespace {
+
+SyncTask makeTask(int i) {
+    SyncTask task("/photos/2024/IMG_" + std::to_string(i) + ".jpg", "SYNC",
+                  static_cast<SyncPriority>(i % kSyncPriorityLevels));
+    task.setSize(4 * 1024 * 1024);
+    return task;
+}
+
+} // namespace
+
+// Every thread enqueues and immediately dequeues: pure lock and heap cost
+static void BM_QueueEnqueueDequeue(benchmark::State& state) {
+    static PrioritySyncQueue queue(1 << 16);
+    SyncTask task = makeTask(state.thread_index());
+
+    for (auto _ : state) {
+        queue.enqueue(task);
+        benchmark::DoNotOptimize(queue.dequeue());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueEnqueueDequeue)->ThreadRange(1, 16)->UseRealTime();
+
+// Half the threads produce, half consume, through a bounded queue so
+// producers feel back-pressure the way file system events do
+static void BM_QueueProducerConsumer(benchmark::State& state) {
+    static PrioritySyncQueue queue(1024);
+    const bool producer = state.thread_index() % 2 == 0;
+    SyncTask task = makeTask(state.thread_index());
+
+    for (auto _ : state) {
+        if (producer) {
+            queue.enqueue(task, std::chrono::seconds(10));
+        } else {
+            benchmark::DoNotOptimize(queue.dequeue(std::chrono::seconds(10)));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueProducerConsumer)->Threads(2)->Threads(4)->Threads(8)->Threads(16)->UseRealTime();
+
+// Backlog gauge snapshot taken by the stats worker while the queue is busy
+static void BM_QueueBacklogStats(benchmark::State& state) {
+    static PrioritySyncQueue queue(1 << 16);
+    if (state.thread_index() == 0) {
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(queue.getBacklogStats());
+        }
+    } else {
+        SyncTask task = makeTask(state.thread_index());
+        for (auto _ : state) {
+            queue.enqueue(task);
+            benchmark::DoNotOptimize(queue.dequeue());
+        }
+    }
+}
+BENCHMARK(BM_QueueBacklogStats)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,56 @@
+//
+// ThreadPool dispatch latency and throughput.
+//
+#include <benchmark/benchmark.h>
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+// Time from enqueue() until a worker starts the task, for pools of
+// range(0) workers; the pool is otherwise idle
+static void BM_ThreadPoolDispatchLatency(benchmark::State& state) {
+    ThreadPool pool;
+    pool.start(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        std::atomic<int64_t> startedAt{0};
+        auto enqueuedAt = Clock::now();
+        pool.enqueue([&startedAt] {
+            startedAt.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+        });
+        int64_t started;
+        while ((started = startedAt.load(std::memory_order_acquire)) == 0) {
+        }
+        state.SetIterationTime(std::chrono::duration<double>(
+            Clock::time_point(Clock::duration(started)) - enqueuedAt).count());
+    }
+}
+BENCHMARK(BM_ThreadPoolDispatchLatency)->RangeMultiplier(2)->Range(1, 16)->UseManualTime();
+
+// Producer threads each submit batches of 64 empty tasks to a shared
+// 4-worker pool and wait for their batch to drain
+static void BM_ThreadPoolThroughput(benchmark::State& state) {
+    constexpr int kBatch = 64;
+    static ThreadPool pool;
+    static std::once_flag started;
+    std::call_once(started, [] { pool.start(4); });
+
+    auto done = std::make_shared<std::atomic<int>>(0);
+    for (auto _ : state) {
+        done->store(0, std::memory_order_relaxed);
+        for (int i = 0; i < kBatch; ++i) {
+            pool.enqueue([done] { done->fetch_add(1, std::memory_order_release); });
+        }
+        while (done->load(std::memory_order_acquire) < kBatch) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_ThreadPoolThroughput)->ThreadRange(1, 8)->UseRealTime();
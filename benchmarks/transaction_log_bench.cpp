@@ -0,0 +1,74 @@
+//
+// TransactionLog append and status-update throughput.
+//
+#include <benchmark/benchmark.h>
+#include "transaction_log.hpp"
+
+#include <unistd.h>
+
+namespace {
+
+// One log shared by every benchmark run, in a scratch directory removed at exit
+struct ScratchLog {
+    fs::path dir = fs::temp_directory_path() / ("file_sync_bench_txlog_" + std::to_string(getpid()));
+    TransactionLog log{dir.string()};
+
+    ScratchLog() { log.open(); }
+    ~ScratchLog() {
+        log.close();
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+};
+
+TransactionLog& scratchLog() {
+    static ScratchLog scratch;
+    return scratch.log;
+}
+
+} // namespace
+
+// New COPY records; every append is serialised, written and flushed
+static void BM_TransactionLogAppend(benchmark::State& state) {
+    TransactionLog& log = scratchLog();
+    const std::string source = "/photos/2024/IMG_" + std::to_string(state.thread_index()) + ".jpg";
+    const std::string dest = "/backup/2024/IMG_" + std::to_string(state.thread_index()) + ".jpg";
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(log.logTransaction(TransactionLog::OperationType::COPY, source, dest));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransactionLogAppend)->ThreadRange(1, 8)->UseRealTime();
+
+// Status transitions on an existing record (cache hit path)
+static void BM_TransactionLogUpdate(benchmark::State& state) {
+    TransactionLog& log = scratchLog();
+    std::string id = log.logTransaction(TransactionLog::OperationType::COPY,
+                                        "/photos/update_" + std::to_string(state.thread_index()) + ".jpg",
+                                        "/backup/update.jpg");
+    bool inProgress = false;
+
+    for (auto _ : state) {
+        inProgress = !inProgress;
+        log.updateTransactionStatus(id, inProgress ? TransactionLog::TransactionStatus::IN_PROGRESS
+                                                   : TransactionLog::TransactionStatus::PENDING);
+    }
+    log.updateTransactionStatus(id, TransactionLog::TransactionStatus::COMPLETED);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransactionLogUpdate)->ThreadRange(1, 8)->UseRealTime();
+
+// The full life of one sync: append, IN_PROGRESS, COMPLETED
+static void BM_TransactionLogLifecycle(benchmark::State& state) {
+    TransactionLog& log = scratchLog();
+    const std::string source = "/photos/cycle_" + std::to_string(state.thread_index()) + ".jpg";
+
+    for (auto _ : state) {
+        std::string id = log.logTransaction(TransactionLog::OperationType::COPY, source, "/backup/cycle.jpg");
+        log.updateTransactionStatus(id, TransactionLog::TransactionStatus::IN_PROGRESS);
+        log.updateTransactionStatus(id, TransactionLog::TransactionStatus::COMPLETED);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransactionLogLifecycle)->ThreadRange(1, 8)->UseRealTime();
@@ -4,26 +4,109 @@
 
 #ifndef CONFIGURATION_HPP
 #define CONFIGURATION_HPP
+#include <cstddef>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 
+/// @brief Daemon settings, read from the same shell-style file photo-sync.sh sources
+/// (/etc/photo-sync.conf).  Keys are KEY=value lines; quotes, comments and a
+/// leading "export" are accepted, unknown keys are ignored so one file can
+/// serve both the script and the daemon.
 class Configuration {
 public:
 
     Configuration();
 
-    int num_threads{1}; // number of threads to use for synchronization
+    /// @brief Parse and validate a config file; throws std::runtime_error naming the file and line
+    static Configuration loadFromFile(const std::string& path);
 
-private:
-};
+    /// @brief Parse config text without validating it; @p origin is used in error messages
+    static Configuration parse(const std::string& text, const std::string& origin = "<config>");
+
+    /// @brief Throws std::runtime_error listing every invalid setting
+    void validate() const;
+
+    /// @brief True if @p path (absolute, or relative to source_dir) matches an exclude pattern.
+    /// Patterns without a '/' match any path component, others the path relative to source_dir.
+    bool isExcluded(const std::string& path) const;
+
+    /// @brief Keys that differ from @p other and only take effect after a restart
+    std::vector<std::string> restartRequiredChanges(const Configuration& other) const;
+
+    std::string config_file; // file this configuration was loaded from, empty for defaults
 
-struct inotify_event {
-    int      wd;       /* Watch descriptor */
-    uint32_t mask;     /* Mask describing event */
-    uint32_t cookie;   /* Unique cookie associating related
-                          events (for rename(2)) */
-    uint32_t len;      /* Size of name field */
-    char     name[];   /* Optional null-terminated name */
+    // photo-sync.sh settings
+    std::string source_dir;                        // SOURCE_DIR
+    std::string dest_dir;                          // DEST_DIR
+    // Further array roots beside DEST_DIR; files without a policy destination are spread over all of them
+    struct ArrayMember {
+        std::string root;
+        uint64_t capacity{0}; // placement weight, 0 = the member's filesystem size
+        bool operator==(const ArrayMember&) const = default;
+    };
+    std::vector<ArrayMember> array_members;        // ARRAY_MEMBERS: "DIR[:SIZE] ..." (DEST_DIR may be listed to size it)
+    uint64_t rebalance_bandwidth_bytes{0};         // REBALANCE_BANDWIDTH: bytes/s for moves between members and resilvers, 0 = unlimited
+    std::string versions_dir;                      // VERSIONS_DIR
+    std::string log_file{"/var/log/photo-sync.log"};            // LOG_FILE
+    std::string pid_file{"/var/run/photo-sync/photo-sync.pid"}; // PID_FILE
+    std::vector<std::string> exclude_patterns;     // EXCLUDE_PATTERNS (space separated)
+    int max_retries{3};                            // MAX_RETRIES
+    int retry_delay_seconds{5};                    // RETRY_DELAY
+    int sync_delay_seconds{1};                     // SYNC_DELAY
+    int health_check_interval_seconds{3600};       // HEALTH_CHECK_INTERVAL
+    bool enable_health_checks{true};               // ENABLE_HEALTH_CHECKS
+    uint64_t min_disk_space_gb{10};                // MIN_DISK_SPACE
+    uint64_t max_log_size_bytes{10 * 1024 * 1024}; // MAX_LOG_SIZE
+    int debug_level{0};                            // DEBUG_LEVEL
+
+    // Daemon performance knobs
+    int num_threads{1}; // number of threads to use for synchronization (NUM_THREADS)
+    size_t queue_capacity{10000};          // QUEUE_CAPACITY: pending tasks before producers block
+    uint64_t bandwidth_limit_bytes{0};     // BANDWIDTH_LIMIT: copy and verify throughput cap in bytes/s, 0 = unlimited
+    uint64_t iops_limit{0};                // IOPS_LIMIT: copy and verify I/O operations per second, 0 = unlimited
+    // Bytes/s and operations/s for one device or priority class, 0 = unlimited
+    struct IoLimit {
+        std::string target;
+        uint64_t bytes_per_second{0};
+        uint64_t ops_per_second{0};
+        bool operator==(const IoLimit&) const = default;
+    };
+    std::vector<IoLimit> device_limits;    // DEVICE_LIMITS: "DIR:BYTES[:IOPS] ..." for the device holding DIR
+    std::vector<IoLimit> class_limits;     // CLASS_LIMITS: "PRIORITY:BYTES[:IOPS] ...", PRIORITY CRITICAL..BACKGROUND
+    std::string verify_method{"FAST_HASH"}; // VERIFY_METHOD: SIZE_ONLY, TIMESTAMP, FAST_HASH, SECURE_HASH, FULL_COMPARE
+    std::string transaction_log_dir{"/var/log/file_sync"}; // TRANSACTION_LOG_DIR
+    std::string policy_file;               // POLICY_FILE: per-subtree rules (priority, verify, dest, ...)
+    bool self_profiling{false}; // attribute perf_event_open counters to pipeline stages (SELF_PROFILING)
+    std::string live_stats_path{"/dev/shm/file_sync.stats"}; // shared-memory stats segment; empty disables (LIVE_STATS_PATH)
+    std::string copy_engine{"auto"};  // COPY_ENGINE: auto (per device profile), read_write, sendfile, copy_file_range, direct
+    size_t copy_buffer_size{0};       // COPY_BUFFER_SIZE: bytes per copy syscall, 0 = per device profile
+    bool device_calibration{false};   // time a short O_DIRECT read test per device at startup (DEVICE_CALIBRATION)
+
+    // Tiering: SOURCE_DIR is a cache tier over the DEST_DIR array
+    bool tiering{false};                   // TIERING: demote cold files to the array, promote hot ones back
+    uint64_t tier_cache_capacity{0};       // TIER_CACHE_CAPACITY: bytes the cache tier may hold, 0 = its filesystem size
+    int tier_high_watermark{90};           // TIER_HIGH_WATERMARK: % of capacity that starts demotion
+    int tier_low_watermark{75};            // TIER_LOW_WATERMARK: % of capacity demotion frees down to
+    std::string tier_demote_mode{"stub"};  // TIER_DEMOTE_MODE: stub (sparse placeholder) or remove (array only)
+    size_t tier_demote_batch{256};         // TIER_DEMOTE_BATCH: demotions queued per pass
+    double tier_promote_accesses{2.0};     // TIER_PROMOTE_ACCESSES: decayed accesses that promote an array file
+    int tier_half_life_seconds{86400};     // TIER_HALF_LIFE: access heat half-life
+    int tier_scan_interval_seconds{60};    // TIER_SCAN_INTERVAL: seconds between capacity checks
+    size_t tier_sketch_items{1 << 20};     // TIER_SKETCH_ITEMS: files the admission sketch is sized for (~3 bytes each)
+    // Erasure coding: array files left cold keep k data + m parity shards on distinct members instead of one copy
+    size_t erasure_data_shards{0};         // ERASURE_CODING: "K+M", e.g. 4+2; empty = off
+    size_t erasure_parity_shards{0};       //   the M of ERASURE_CODING
+    int erasure_cold_age_seconds{30 * 86400}; // ERASURE_COLD_AGE: seconds without access before an array file is encoded
+
+    // Write-back: changes are acknowledged once on SOURCE_DIR and flushed in batches
+    bool write_back{false};                        // WRITE_BACK
+    int write_back_max_age_seconds{30};            // WRITE_BACK_MAX_AGE: longest a change waits for a flush
+    uint64_t write_back_batch_bytes{1ULL << 30};   // WRITE_BACK_BATCH: dirty bytes that flush before the max age
+
+private:
+    void set(const std::string& key, const std::string& value);
 };
 
 #endif //CONFIGURATION_HPP
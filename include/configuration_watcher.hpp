@@ -0,0 +1,64 @@
+//
+// Hot reload of the configuration file.
+//
+
+#ifndef CONFIGURATION_WATCHER_HPP
+#define CONFIGURATION_WATCHER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/types.h>
+
+#include "configuration.hpp"
+#include "sys/inotify_handle.hpp"
+
+/// @brief Watches a configuration file with inotify and hands every valid new
+/// version to a callback.  The parent directory is watched rather than the file
+/// so editors that save by rename, and config management tools that replace
+/// the file, are picked up.  A file that fails to parse or validate is
+/// reported through the error callback and the previous configuration stays
+/// in effect.
+class ConfigurationWatcher {
+public:
+    using ReloadCallback = std::function<void(std::shared_ptr<Configuration>)>;
+    using ErrorCallback = std::function<void(const std::string&)>;
+
+    ConfigurationWatcher(std::string path, ReloadCallback onReload, ErrorCallback onError = nullptr);
+    ~ConfigurationWatcher();
+    ConfigurationWatcher(const ConfigurationWatcher&) = delete;
+    ConfigurationWatcher& operator=(const ConfigurationWatcher&) = delete;
+
+    /// @brief Re-read the file now if it changed since the last load
+    void checkNow();
+
+    /// @brief Number of configurations delivered to the reload callback
+    uint64_t reloadCount() const { return m_reloads; }
+
+private:
+    struct FileStamp {
+        ino_t inode = 0;
+        off_t size = -1;
+        std::chrono::nanoseconds mtime{0};
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    void watchLoop();
+    FileStamp stampOf() const;
+
+    std::string m_path;
+    ReloadCallback m_onReload;
+    ErrorCallback m_onError;
+    sys::InotifyHandle m_inotify;
+    std::mutex m_mutex; // serialises reloads between the watch thread and checkNow()
+    FileStamp m_lastStamp;
+    std::atomic<bool> m_running{true};
+    std::atomic<uint64_t> m_reloads{0};
+    std::thread m_thread;
+};
+
+#endif //CONFIGURATION_WATCHER_HPP
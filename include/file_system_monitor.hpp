@@ -6,6 +6,8 @@
 
 
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <queue>
 #include <mutex>
@@ -27,6 +29,7 @@ public:
     };
 
     FileSystemMonitor();
+    virtual ~FileSystemMonitor();
     FileSystemMonitor(const FileSystemMonitor&) = delete;
     FileSystemMonitor& operator=(const FileSystemMonitor&) = delete;
     FileSystemMonitor(FileSystemMonitor&&) = delete;
@@ -35,15 +38,15 @@ public:
 
     /// @brief  Add a watch to the file system monitor
     /// @param path  
-    void addWatch(const std::string& path);
+    virtual void addWatch(const std::string& path);
 
     /// @brief  Get the next file system event
     /// @return 
-    std::optional<FSEvent> getNextEvent();
+    virtual std::optional<FSEvent> getNextEvent();
 
     /// @brief Remove a watch from the file system monitor
     /// @param path
-    void removeWatch(const std::string& path);
+    virtual void removeWatch(const std::string& path);
 
     /// @brief Stop the file system monitor 
     void stop();
@@ -52,14 +55,22 @@ public:
     /// @param cb 
     void setCallback(std::function<void(const std::string&)> cb);
 
-    bool empty();
+    virtual bool empty();
+
+    /// @brief Number of IN_Q_OVERFLOW notifications seen; events were lost
+    /// each time and the watched tree should be rescanned
+    uint64_t overflowCount() const { return m_overflowCount.load(std::memory_order_relaxed); }
+
+protected:
+    /// @brief Drain pending inotify events (non-blocking) into the event queue
+    void readEvents();
 
-private:
     std::function<void(const std::string&)> m_callback;
     int m_inotifyFd;
     std::unordered_map<int, std::string> m_watch_descriptors;
     std::queue<FSEvent> m_event_queue;
     std::mutex m_queue_mutex;
+    std::atomic<uint64_t> m_overflowCount{0};
 
 };
 
@@ -7,8 +7,11 @@
 
 
 #include <chrono>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 
 class MetricsCollector {
@@ -20,6 +23,7 @@ private:
     };
 
     std::vector<Metric> m_metrics;
+    std::map<std::string, double> m_gauges;
     std::mutex m_metrics_mutex;
 
 
@@ -28,6 +32,11 @@ public:
 
     void recordMetric(const std::string& name, const std::string& value);
 
+    /// @brief Set a gauge; unlike recorded metrics, gauges keep their last value across collect()
+    void setGauge(const std::string& name, double value);
+
+    std::optional<double> getGauge(const std::string& name);
+
     void collect();
 
 };
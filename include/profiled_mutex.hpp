@@ -0,0 +1,118 @@
+//
+// Lock contention profiling for the daemon's internal mutexes.
+//
+
+#ifndef PROFILED_MUTEX_HPP
+#define PROFILED_MUTEX_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+class MetricsCollector;
+
+/// @brief Wait and hold statistics shared by every mutex registered under one name
+struct LockStats {
+    /// log2(nanoseconds) buckets: bucket i counts samples in [2^i, 2^(i+1)) ns
+    static constexpr size_t kBuckets = 40;
+
+    struct Site {
+        uint64_t contended = 0;
+        uint64_t waitNs = 0;
+    };
+
+    std::string name;
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> totalWaitNs{0};
+    std::array<std::atomic<uint64_t>, kBuckets> waitHistogram{};
+    std::array<std::atomic<uint64_t>, kBuckets> holdHistogram{};
+
+    // Contending call sites (first return address above lock() outside std::
+    // and ProfiledMutex, so -O0 builds name the caller rather than
+    // lock_guard), only touched on the slow path
+    std::mutex siteMutex;
+    std::unordered_map<const void*, Site> sites;
+
+    void recordWait(uint64_t ns, const void* site);
+    void recordHold(uint64_t ns);
+
+    /// @brief Upper bound (ns) of the bucket holding the given percentile
+    static uint64_t percentile(const std::array<std::atomic<uint64_t>, kBuckets>& histogram, double p);
+};
+
+#ifdef FILE_SYNC_LOCK_PROFILING
+
+/// Drop-in replacement for std::mutex that records how long callers wait to
+/// acquire it and how long it is held.  Only built with FILE_SYNC_LOCK_PROFILING;
+/// otherwise ProfiledMutex is a plain std::mutex (see below).
+class ProfiledMutex {
+public:
+    using UniqueLock = std::unique_lock<ProfiledMutex>;
+    using ConditionVariable = std::condition_variable_any;
+
+    explicit ProfiledMutex(const char* name);
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex m_mutex;
+    LockStats* m_stats;
+    std::chrono::steady_clock::time_point m_acquired;
+};
+
+#else
+
+/// Without FILE_SYNC_LOCK_PROFILING this is std::mutex; the name is discarded
+class ProfiledMutex : public std::mutex {
+public:
+    using UniqueLock = std::unique_lock<std::mutex>;
+    using ConditionVariable = std::condition_variable;
+
+    explicit ProfiledMutex(const char*) {}
+};
+
+#endif
+
+/// Registry of named lock statistics
+class LockProfiler {
+public:
+    static LockProfiler& instance();
+
+    /// @brief Stats for a lock name; the reference stays valid for the process lifetime
+    LockStats& statsFor(const std::string& name);
+
+    /// @brief Whether the build records lock statistics at all
+    static constexpr bool enabled() {
+#ifdef FILE_SYNC_LOCK_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// @brief Human readable summary: per lock percentiles and top contending sites
+    std::string getSummary(size_t topSites = 3);
+
+    /// @brief Export per lock gauges and the top contending sites
+    void recordMetrics(MetricsCollector& metrics, size_t topSites = 3);
+
+private:
+    LockProfiler() = default;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::unique_ptr<LockStats>> m_locks;
+};
+
+#endif //PROFILED_MUTEX_HPP
@@ -0,0 +1,143 @@
+#ifndef PERF_EVENT_COUNTERS_HPP
+#define PERF_EVENT_COUNTERS_HPP
+
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+namespace sys {
+
+// Per-thread hardware/software counters opened with perf_event_open(2).
+// Counts only the calling thread (pid = 0, cpu = -1).  Hardware counters are
+// user-space only so they open under perf_event_paranoid <= 2.  Counters the
+// kernel or PMU cannot provide (e.g. no PMU inside a VM) stay unavailable and
+// read as zero, except context switches, which fall back to getrusage().
+// The constructor throws only when no perf counter at all can be opened.
+class PerfEventCounters {
+public:
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        CONTEXT_SWITCHES,
+        COUNTER_COUNT
+    };
+
+    using Reading = std::array<uint64_t, COUNTER_COUNT>;
+
+    PerfEventCounters() {
+        m_fds.fill(-1);
+
+        int lastErrno = 0;
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            m_fds[i] = openCounter(static_cast<Counter>(i));
+            if (m_fds[i] == -1) {
+                lastErrno = errno;
+            }
+        }
+
+        if (!anyAvailable()) {
+            throw std::system_error(lastErrno, std::system_category(), "perf_event_open failed");
+        }
+    }
+
+    ~PerfEventCounters() {
+        for (int fd : m_fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+
+    // Prevent copying
+    PerfEventCounters(const PerfEventCounters&) = delete;
+    PerfEventCounters& operator=(const PerfEventCounters&) = delete;
+
+    bool isAvailable(Counter counter) const { return m_fds[counter] != -1; }
+
+    bool anyAvailable() const {
+        for (int fd : m_fds) {
+            if (fd != -1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Current counter values; unavailable counters read as zero
+    Reading read() const {
+        Reading values{};
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (m_fds[i] != -1) {
+                uint64_t value = 0;
+                if (::read(m_fds[i], &value, sizeof(value)) == sizeof(value)) {
+                    values[i] = value;
+                }
+            }
+        }
+
+        if (m_fds[CONTEXT_SWITCHES] == -1) {
+            rusage usage{};
+            if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+                values[CONTEXT_SWITCHES] = static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+            }
+        }
+        return values;
+    }
+
+    static const char* name(Counter counter) {
+        switch (counter) {
+            case CYCLES: return "cycles";
+            case INSTRUCTIONS: return "instructions";
+            case CACHE_MISSES: return "cache_misses";
+            case CONTEXT_SWITCHES: return "context_switches";
+            default: return "unknown";
+        }
+    }
+
+private:
+    std::array<int, COUNTER_COUNT> m_fds;
+
+    static int openCounter(Counter counter) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.exclude_hv = 1;
+
+        // Switches happen in the kernel, so that counter cannot exclude it
+        attr.exclude_kernel = counter == CONTEXT_SWITCHES ? 0 : 1;
+
+        switch (counter) {
+            case CYCLES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case CACHE_MISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            case CONTEXT_SWITCHES:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+                break;
+            default:
+                return -1;
+        }
+
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+};
+
+} // namespace sys
+
+#endif // PERF_EVENT_COUNTERS_HPP
@@ -0,0 +1,32 @@
+#ifndef PROBES_HPP
+#define PROBES_HPP
+
+// USDT (user statically defined tracing) probes for the sync hot paths.
+//
+// With <sys/sdt.h> available each SYNC_PROBE compiles to a single nop and an
+// ELF note describing its arguments; nothing runs until a tracer attaches, so
+// the probes stay in release builds.  Without the header (or with the
+// FILE_SYNC_USDT option off) they compile away entirely.
+//
+// Probes (provider "file_sync"):
+//   event_received (path, mask)                      FileSystemMonitor
+//   queue_enqueue  (path, priority, depth, created)  PrioritySyncQueue
+//   queue_dequeue  (path, priority, depth, created)  PrioritySyncQueue
+//   copy_start     (source, dest)                    RobustSyncManager
+//   copy_end       (source, dest, ok)                RobustSyncManager
+//   verify_result  (source, matches, duration_ms)    RobustSyncManager
+//   wal_commit     (tx_id, status)                   TransactionLog
+//
+// Example - copy latency histogram without restarting the daemon:
+//   bpftrace -e 'usdt:/usr/local/bin/file_sync:file_sync:copy_start { @s[tid] = nsecs; }
+//                usdt:/usr/local/bin/file_sync:file_sync:copy_end /@s[tid]/ {
+//                    @copy_us = hist((nsecs - @s[tid]) / 1000); delete(@s[tid]); }'
+
+#if defined(FILE_SYNC_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SYNC_PROBE(name, ...) STAP_PROBEV(file_sync, name, __VA_ARGS__)
+#else
+#define SYNC_PROBE(name, ...) do {} while (0)
+#endif
+
+#endif // PROBES_HPP
@@ -10,16 +10,19 @@
 #include <queue>
 #include <thread>
 
+#include "profiled_mutex.hpp"
+
 
 class ThreadPool {
 private:
     std::vector<std::thread> m_workers;
     std::queue<std::function<void()>> m_tasks;
-    std::mutex m_queue_mutex;
-    std::condition_variable m_condition;
+    ProfiledMutex m_queue_mutex{"thread_pool_queue"};
+    ProfiledMutex::ConditionVariable m_condition;
     bool m_stop;
 public:
     ThreadPool();
+    ~ThreadPool();
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool(ThreadPool&&) = delete;
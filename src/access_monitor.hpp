@@ -0,0 +1,97 @@
+//
+// Read-access events for the tiering engine, from a fanotify mount mark.
+//
+
+#ifndef ACCESS_MONITOR_HPP
+#define ACCESS_MONITOR_HPP
+
+#include "sys/fanotify_handle.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// Reports every open of a file under a root by another process: one event
+// per open, however much is read.  inotify has no mount-wide watch, and its
+// per-read IN_ACCESS would count a large file many times.  The daemon's own
+// copies and verification reads are filtered out by pid.
+class AccessMonitor {
+public:
+    using Callback = std::function<void(const std::string& path)>;
+
+    // Throws std::system_error if fanotify is unavailable; mount marks need
+    // CAP_SYS_ADMIN
+    AccessMonitor(const std::string& root, Callback callback)
+        : m_root(std::filesystem::weakly_canonical(root).string()),
+          m_callback(std::move(callback)),
+          m_fanotify(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE | O_CLOEXEC),
+          m_pid(::getpid()) {
+        while (m_root.size() > 1 && m_root.back() == '/') {
+            m_root.pop_back();
+        }
+        m_fanotify.addMountMark(m_root, FAN_OPEN);
+        m_thread = std::thread(&AccessMonitor::run, this);
+    }
+
+    ~AccessMonitor() {
+        m_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    AccessMonitor(const AccessMonitor&) = delete;
+    AccessMonitor& operator=(const AccessMonitor&) = delete;
+
+    // Opens reported to the callback
+    uint64_t eventCount() const { return m_events.load(std::memory_order_relaxed); }
+
+    // FAN_Q_OVERFLOW notifications; accesses were lost each time
+    uint64_t overflowCount() const { return m_overflows.load(std::memory_order_relaxed); }
+
+private:
+    std::string m_root;
+    Callback m_callback;
+    sys::FanotifyHandle m_fanotify;
+    const pid_t m_pid;
+    std::atomic<bool> m_running{true};
+    std::atomic<uint64_t> m_events{0};
+    std::atomic<uint64_t> m_overflows{0};
+    std::thread m_thread;
+
+    bool isUnderRoot(const std::string& path) const {
+        return path.size() > m_root.size() && path.compare(0, m_root.size(), m_root) == 0 &&
+               (m_root == "/" || path[m_root.size()] == '/');
+    }
+
+    void run() {
+        struct pollfd pfd{m_fanotify.fd(), POLLIN, 0};
+        while (m_running) {
+            if (::poll(&pfd, 1, 100) <= 0) {
+                continue;
+            }
+            try {
+                for (const auto& [metadata, path] : m_fanotify.readEvents()) {
+                    if (metadata.mask & FAN_Q_OVERFLOW) {
+                        m_overflows.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    if (metadata.pid == m_pid || !isUnderRoot(path)) {
+                        continue;
+                    }
+                    m_events.fetch_add(1, std::memory_order_relaxed);
+                    m_callback(path);
+                }
+            } catch (const std::system_error&) {
+                // EINTR and friends; the next poll retries
+            }
+        }
+    }
+};
+
+#endif // ACCESS_MONITOR_HPP
@@ -4,14 +4,459 @@
 
 #include "configuration.hpp"
 
-#include <iostream>
-#include <ostream>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fnmatch.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isKey(const std::string& key) {
+    if (key.empty() || std::isdigit(static_cast<unsigned char>(key[0]))) {
+        return false;
+    }
+    return std::all_of(key.begin(), key.end(), [](unsigned char c) {
+        return std::isupper(c) || std::isdigit(c) || c == '_';
+    });
+}
+
+std::string trim(const std::string& s) {
+    auto begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    auto end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+// Shell-style value: "double quoted" (with \ escapes), 'single quoted' or a bare word
+std::string parseValue(const std::string& raw) {
+    std::string value;
+    size_t i = 0;
+
+    if (!raw.empty() && (raw[0] == '"' || raw[0] == '\'')) {
+        char quote = raw[0];
+        for (i = 1; i < raw.size() && raw[i] != quote; ++i) {
+            if (quote == '"' && raw[i] == '\\' && i + 1 < raw.size()) {
+                ++i;
+            }
+            value += raw[i];
+        }
+        if (i == raw.size()) {
+            throw std::runtime_error("unterminated quote");
+        }
+        ++i;
+    } else {
+        while (i < raw.size() && raw[i] != '#' && !std::isspace(static_cast<unsigned char>(raw[i]))) {
+            value += raw[i++];
+        }
+    }
+
+    std::string rest = trim(raw.substr(i));
+    if (!rest.empty() && rest[0] != '#') {
+        throw std::runtime_error("unexpected text after value: " + rest);
+    }
+    return value;
+}
+
+template <typename T>
+T parseNumber(const std::string& key, const std::string& value) {
+    T result{};
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || end != value.data() + value.size()) {
+        throw std::runtime_error(key + " must be a number, got '" + value + "'");
+    }
+    return result;
+}
+
+// Byte count with an optional binary K/M/G/T suffix
+uint64_t parseSize(const std::string& key, const std::string& value) {
+    if (value.empty()) {
+        throw std::runtime_error(key + " must be a size, got ''");
+    }
+    uint64_t multiplier = 1;
+    std::string digits = value;
+    switch (std::toupper(static_cast<unsigned char>(value.back()))) {
+        case 'K': multiplier = 1ULL << 10; break;
+        case 'M': multiplier = 1ULL << 20; break;
+        case 'G': multiplier = 1ULL << 30; break;
+        case 'T': multiplier = 1ULL << 40; break;
+        default: break;
+    }
+    if (multiplier != 1) {
+        digits.pop_back();
+    }
+    return parseNumber<uint64_t>(key, digits) * multiplier;
+}
+
+bool parseBool(const std::string& key, const std::string& value) {
+    if (value == "true" || value == "1") {
+        return true;
+    }
+    if (value == "false" || value == "0") {
+        return false;
+    }
+    throw std::runtime_error(key + " must be true or false, got '" + value + "'");
+}
+
+// Lexically normalised directory without a trailing separator
+fs::path normalDirectory(const std::string& dir) {
+    fs::path path = fs::path(dir).lexically_normal();
+    if (!path.has_filename() && path.has_relative_path()) {
+        path = path.parent_path();
+    }
+    return path;
+}
+
+std::vector<std::string> splitWords(const std::string& value) {
+    std::vector<std::string> words;
+    std::istringstream in(value);
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// "DIR[:SIZE] ..."; a colon followed by a digit starts the size
+std::vector<Configuration::ArrayMember> parseArrayMembers(const std::string& key, const std::string& value) {
+    std::vector<Configuration::ArrayMember> members;
+    for (const auto& word : splitWords(value)) {
+        Configuration::ArrayMember member{word, 0};
+        auto colon = word.rfind(':');
+        if (colon != std::string::npos && colon + 1 < word.size() &&
+            std::isdigit(static_cast<unsigned char>(word[colon + 1]))) {
+            member.root = word.substr(0, colon);
+            member.capacity = parseSize(key, word.substr(colon + 1));
+        }
+        members.push_back(std::move(member));
+    }
+    return members;
+}
+
+// "TARGET:BYTES[:IOPS] ..."; BYTES takes a K/M/G/T suffix
+std::vector<Configuration::IoLimit> parseIoLimits(const std::string& key, const std::string& value) {
+    std::vector<Configuration::IoLimit> limits;
+    for (const auto& word : splitWords(value)) {
+        auto first = word.find(':');
+        if (first == std::string::npos) {
+            throw std::runtime_error(key + " entries must be TARGET:BYTES[:IOPS], got '" + word + "'");
+        }
+        Configuration::IoLimit limit;
+        limit.target = word.substr(0, first);
+        auto second = word.find(':', first + 1);
+        limit.bytes_per_second = parseSize(key, word.substr(first + 1, second - first - 1));
+        if (second != std::string::npos) {
+            limit.ops_per_second = parseNumber<uint64_t>(key, word.substr(second + 1));
+        }
+        limits.push_back(std::move(limit));
+    }
+    return limits;
+}
+
+// "K+M", or empty for none
+std::pair<size_t, size_t> parseErasureLayout(const std::string& key, const std::string& value) {
+    if (value.empty()) {
+        return {0, 0};
+    }
+    auto plus = value.find('+');
+    if (plus == std::string::npos) {
+        throw std::runtime_error(key + " must be K+M, e.g. 4+2, got '" + value + "'");
+    }
+    return {parseNumber<size_t>(key, value.substr(0, plus)), parseNumber<size_t>(key, value.substr(plus + 1))};
+}
+
+} // namespace
 
 Configuration::Configuration() {
     // constructor
 }
 
+Configuration Configuration::loadFromFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open configuration file: " + path);
+    }
+    std::stringstream text;
+    text << file.rdbuf();
 
+    Configuration config = parse(text.str(), path);
+    config.config_file = path;
+    try {
+        config.validate();
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+    return config;
+}
 
+Configuration Configuration::parse(const std::string& text, const std::string& origin) {
+    Configuration config;
+    std::istringstream in(text);
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.rfind("export ", 0) == 0) {
+            line = trim(line.substr(7));
+        }
+
+        try {
+            auto eq = line.find('=');
+            if (eq == std::string::npos || !isKey(line.substr(0, eq))) {
+                throw std::runtime_error("expected KEY=value");
+            }
+            config.set(line.substr(0, eq), parseValue(line.substr(eq + 1)));
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(origin + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+    return config;
+}
+
+void Configuration::set(const std::string& key, const std::string& value) {
+    if (key == "SOURCE_DIR") source_dir = value;
+    else if (key == "DEST_DIR") dest_dir = value;
+    else if (key == "ARRAY_MEMBERS") array_members = parseArrayMembers(key, value);
+    else if (key == "REBALANCE_BANDWIDTH") rebalance_bandwidth_bytes = parseSize(key, value);
+    else if (key == "VERSIONS_DIR") versions_dir = value;
+    else if (key == "LOG_FILE") log_file = value;
+    else if (key == "PID_FILE") pid_file = value;
+    else if (key == "EXCLUDE_PATTERNS") exclude_patterns = splitWords(value);
+    else if (key == "MAX_RETRIES") max_retries = parseNumber<int>(key, value);
+    else if (key == "RETRY_DELAY") retry_delay_seconds = parseNumber<int>(key, value);
+    else if (key == "SYNC_DELAY") sync_delay_seconds = parseNumber<int>(key, value);
+    else if (key == "HEALTH_CHECK_INTERVAL") health_check_interval_seconds = parseNumber<int>(key, value);
+    else if (key == "ENABLE_HEALTH_CHECKS") enable_health_checks = parseBool(key, value);
+    else if (key == "MIN_DISK_SPACE") min_disk_space_gb = parseNumber<uint64_t>(key, value);
+    else if (key == "MAX_LOG_SIZE") max_log_size_bytes = parseSize(key, value);
+    else if (key == "DEBUG_LEVEL") debug_level = parseNumber<int>(key, value);
+    else if (key == "NUM_THREADS") num_threads = parseNumber<int>(key, value);
+    else if (key == "QUEUE_CAPACITY") queue_capacity = parseNumber<size_t>(key, value);
+    else if (key == "BANDWIDTH_LIMIT") bandwidth_limit_bytes = parseSize(key, value);
+    else if (key == "IOPS_LIMIT") iops_limit = parseNumber<uint64_t>(key, value);
+    else if (key == "DEVICE_LIMITS") device_limits = parseIoLimits(key, value);
+    else if (key == "CLASS_LIMITS") class_limits = parseIoLimits(key, value);
+    else if (key == "VERIFY_METHOD") verify_method = value;
+    else if (key == "TRANSACTION_LOG_DIR") transaction_log_dir = value;
+    else if (key == "POLICY_FILE") policy_file = value;
+    else if (key == "SELF_PROFILING") self_profiling = parseBool(key, value);
+    else if (key == "LIVE_STATS_PATH") live_stats_path = value;
+    else if (key == "COPY_ENGINE") copy_engine = value;
+    else if (key == "COPY_BUFFER_SIZE") copy_buffer_size = parseSize(key, value);
+    else if (key == "DEVICE_CALIBRATION") device_calibration = parseBool(key, value);
+    else if (key == "TIERING") tiering = parseBool(key, value);
+    else if (key == "TIER_CACHE_CAPACITY") tier_cache_capacity = parseSize(key, value);
+    else if (key == "TIER_HIGH_WATERMARK") tier_high_watermark = parseNumber<int>(key, value);
+    else if (key == "TIER_LOW_WATERMARK") tier_low_watermark = parseNumber<int>(key, value);
+    else if (key == "TIER_DEMOTE_MODE") tier_demote_mode = value;
+    else if (key == "TIER_DEMOTE_BATCH") tier_demote_batch = parseNumber<size_t>(key, value);
+    else if (key == "TIER_PROMOTE_ACCESSES") tier_promote_accesses = parseNumber<double>(key, value);
+    else if (key == "TIER_HALF_LIFE") tier_half_life_seconds = parseNumber<int>(key, value);
+    else if (key == "TIER_SCAN_INTERVAL") tier_scan_interval_seconds = parseNumber<int>(key, value);
+    else if (key == "ERASURE_CODING") std::tie(erasure_data_shards, erasure_parity_shards) = parseErasureLayout(key, value);
+    else if (key == "ERASURE_COLD_AGE") erasure_cold_age_seconds = parseNumber<int>(key, value);
+    else if (key == "TIER_SKETCH_ITEMS") tier_sketch_items = parseNumber<size_t>(key, value);
+    else if (key == "WRITE_BACK") write_back = parseBool(key, value);
+    else if (key == "WRITE_BACK_MAX_AGE") write_back_max_age_seconds = parseNumber<int>(key, value);
+    else if (key == "WRITE_BACK_BATCH") write_back_batch_bytes = parseSize(key, value);
+    // Anything else belongs to photo-sync.sh (RSYNC_OPTS, LOCK_FILE, ...)
+}
 
-// Created by garrett on 2/23/25.
\ No newline at end of file
+void Configuration::validate() const {
+    std::vector<std::string> errors;
+
+    if (source_dir.empty() || dest_dir.empty()) {
+        errors.emplace_back("SOURCE_DIR and DEST_DIR must be set");
+    } else if (normalDirectory(source_dir) == normalDirectory(dest_dir)) {
+        errors.emplace_back("SOURCE_DIR and DEST_DIR must differ");
+    }
+    for (size_t i = 0; i < array_members.size(); ++i) {
+        const auto& member = array_members[i];
+        if (member.root.empty()) {
+            errors.emplace_back("ARRAY_MEMBERS entries must be DIR or DIR:SIZE");
+            continue;
+        }
+        if (!source_dir.empty() && normalDirectory(member.root) == normalDirectory(source_dir)) {
+            errors.emplace_back("ARRAY_MEMBERS must not include SOURCE_DIR");
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (normalDirectory(member.root) == normalDirectory(array_members[j].root)) {
+                errors.emplace_back("ARRAY_MEMBERS lists " + member.root + " twice");
+            }
+        }
+    }
+    if (num_threads < 1 || num_threads > 256) {
+        errors.emplace_back("NUM_THREADS must be between 1 and 256");
+    }
+    if (queue_capacity == 0) {
+        errors.emplace_back("QUEUE_CAPACITY must be positive");
+    }
+    if (max_retries < 0) {
+        errors.emplace_back("MAX_RETRIES must not be negative");
+    }
+    if (retry_delay_seconds < 0 || sync_delay_seconds < 0) {
+        errors.emplace_back("RETRY_DELAY and SYNC_DELAY must not be negative");
+    }
+    if (health_check_interval_seconds <= 0) {
+        errors.emplace_back("HEALTH_CHECK_INTERVAL must be positive");
+    }
+    static const char* methods[] = {"SIZE_ONLY", "TIMESTAMP", "FAST_HASH", "SECURE_HASH", "FULL_COMPARE"};
+    if (std::find(std::begin(methods), std::end(methods), verify_method) == std::end(methods)) {
+        errors.emplace_back("VERIFY_METHOD must be one of SIZE_ONLY, TIMESTAMP, FAST_HASH, SECURE_HASH, FULL_COMPARE");
+    }
+    static const char* engines[] = {"auto", "read_write", "sendfile", "copy_file_range", "direct"};
+    if (std::find(std::begin(engines), std::end(engines), copy_engine) == std::end(engines)) {
+        errors.emplace_back("COPY_ENGINE must be one of auto, read_write, sendfile, copy_file_range, direct");
+    }
+    if (copy_buffer_size != 0 && (copy_buffer_size < 4096 || copy_buffer_size > 64 * 1024 * 1024)) {
+        errors.emplace_back("COPY_BUFFER_SIZE must be 0 (auto) or between 4K and 64M");
+    }
+    for (size_t i = 0; i < device_limits.size(); ++i) {
+        if (device_limits[i].target.empty() || device_limits[i].target.front() != '/') {
+            errors.emplace_back("DEVICE_LIMITS entries must start with an absolute directory");
+            continue;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (normalDirectory(device_limits[i].target) == normalDirectory(device_limits[j].target)) {
+                errors.emplace_back("DEVICE_LIMITS lists " + device_limits[i].target + " twice");
+            }
+        }
+    }
+    static const char* priorities[] = {"CRITICAL", "HIGH", "NORMAL", "LOW", "BACKGROUND"};
+    for (size_t i = 0; i < class_limits.size(); ++i) {
+        if (std::find(std::begin(priorities), std::end(priorities), class_limits[i].target) == std::end(priorities)) {
+            errors.emplace_back("CLASS_LIMITS priorities must be CRITICAL, HIGH, NORMAL, LOW or BACKGROUND");
+            continue;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (class_limits[i].target == class_limits[j].target) {
+                errors.emplace_back("CLASS_LIMITS lists " + class_limits[i].target + " twice");
+            }
+        }
+    }
+    if (tier_low_watermark < 1 || tier_high_watermark > 100 || tier_low_watermark >= tier_high_watermark) {
+        errors.emplace_back("TIER_LOW_WATERMARK and TIER_HIGH_WATERMARK must satisfy 1 <= low < high <= 100");
+    }
+    if (tier_demote_mode != "stub" && tier_demote_mode != "remove") {
+        errors.emplace_back("TIER_DEMOTE_MODE must be stub or remove");
+    }
+    if (tier_demote_batch == 0) {
+        errors.emplace_back("TIER_DEMOTE_BATCH must be positive");
+    }
+    if (tier_promote_accesses < 1.0) {
+        errors.emplace_back("TIER_PROMOTE_ACCESSES must be at least 1");
+    }
+    if (tier_half_life_seconds <= 0 || tier_scan_interval_seconds <= 0) {
+        errors.emplace_back("TIER_HALF_LIFE and TIER_SCAN_INTERVAL must be positive");
+    }
+    if (tier_sketch_items == 0 || tier_sketch_items > (size_t{1} << 32)) {
+        errors.emplace_back("TIER_SKETCH_ITEMS must be between 1 and 4294967296");
+    }
+    if (erasure_data_shards > 0 || erasure_parity_shards > 0) {
+        // Shards go to distinct members; DEST_DIR may also be listed to size it
+        std::vector<fs::path> members;
+        if (!dest_dir.empty()) {
+            members.push_back(normalDirectory(dest_dir));
+        }
+        for (const auto& member : array_members) {
+            fs::path root = normalDirectory(member.root);
+            if (std::find(members.begin(), members.end(), root) == members.end()) {
+                members.push_back(root);
+            }
+        }
+        size_t shards = erasure_data_shards + erasure_parity_shards;
+        if (erasure_data_shards == 0 || erasure_parity_shards == 0 || shards > 256) {
+            errors.emplace_back("ERASURE_CODING must be K+M with K, M >= 1 and K + M <= 256");
+        } else if (shards > members.size()) {
+            errors.emplace_back("ERASURE_CODING needs K + M array members, DEST_DIR and ARRAY_MEMBERS have " +
+                                std::to_string(members.size()));
+        }
+        if (!tiering) {
+            errors.emplace_back("ERASURE_CODING encodes files TIERING has demoted; set TIERING=true");
+        }
+    }
+    if (erasure_cold_age_seconds <= 0) {
+        errors.emplace_back("ERASURE_COLD_AGE must be positive");
+    }
+    // Dirty records older than the recovery worker's 5 minutes would be replayed under the flusher
+    if (write_back_max_age_seconds < 1 || write_back_max_age_seconds > 240) {
+        errors.emplace_back("WRITE_BACK_MAX_AGE must be between 1 and 240 seconds");
+    }
+
+    if (!errors.empty()) {
+        std::string message = errors.front();
+        for (size_t i = 1; i < errors.size(); ++i) {
+            message += "; " + errors[i];
+        }
+        throw std::runtime_error(message);
+    }
+}
+
+bool Configuration::isExcluded(const std::string& path) const {
+    if (exclude_patterns.empty()) {
+        return false;
+    }
+
+    fs::path relative = fs::path(path);
+    if (relative.is_absolute() && !source_dir.empty()) {
+        fs::path inSource = relative.lexically_relative(source_dir);
+        if (!inSource.empty() && *inSource.begin() != "..") {
+            relative = inSource;
+        }
+    }
+
+    for (const auto& pattern : exclude_patterns) {
+        if (pattern.find('/') == std::string::npos) {
+            for (const auto& component : relative) {
+                if (fnmatch(pattern.c_str(), component.c_str(), 0) == 0) {
+                    return true;
+                }
+            }
+            continue;
+        }
+
+        // Anchored pattern: match the relative path or any of its parent directories
+        std::string anchored = pattern.front() == '/' ? pattern.substr(1) : pattern;
+        if (!anchored.empty() && anchored.back() == '/') {
+            anchored.pop_back();
+        }
+        fs::path prefix;
+        for (const auto& component : relative) {
+            prefix /= component;
+            if (fnmatch(anchored.c_str(), prefix.c_str(), FNM_PATHNAME) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> Configuration::restartRequiredChanges(const Configuration& other) const {
+    std::vector<std::string> changed;
+    if (source_dir != other.source_dir) changed.emplace_back("SOURCE_DIR");
+    if (dest_dir != other.dest_dir) changed.emplace_back("DEST_DIR");
+    if (array_members != other.array_members) changed.emplace_back("ARRAY_MEMBERS");
+    if (versions_dir != other.versions_dir) changed.emplace_back("VERSIONS_DIR");
+    if (log_file != other.log_file) changed.emplace_back("LOG_FILE");
+    if (pid_file != other.pid_file) changed.emplace_back("PID_FILE");
+    if (transaction_log_dir != other.transaction_log_dir) changed.emplace_back("TRANSACTION_LOG_DIR");
+    if (live_stats_path != other.live_stats_path) changed.emplace_back("LIVE_STATS_PATH");
+    if (device_calibration != other.device_calibration) changed.emplace_back("DEVICE_CALIBRATION");
+    if (tier_half_life_seconds != other.tier_half_life_seconds) changed.emplace_back("TIER_HALF_LIFE");
+    if (tier_sketch_items != other.tier_sketch_items) changed.emplace_back("TIER_SKETCH_ITEMS");
+    return changed;
+}
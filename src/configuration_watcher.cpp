@@ -0,0 +1,79 @@
+//
+// Hot reload of the configuration file.
+//
+
+#include "configuration_watcher.hpp"
+
+#include <filesystem>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+ConfigurationWatcher::ConfigurationWatcher(std::string path, ReloadCallback onReload, ErrorCallback onError)
+    : m_path(std::move(path)),
+      m_onReload(std::move(onReload)),
+      m_onError(std::move(onError)),
+      m_lastStamp(stampOf()) {
+    fs::path directory = fs::absolute(m_path).parent_path();
+    m_inotify.addWatch(directory.string(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB);
+    m_thread = std::thread(&ConfigurationWatcher::watchLoop, this);
+}
+
+ConfigurationWatcher::~ConfigurationWatcher() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ConfigurationWatcher::watchLoop() {
+    pollfd pfd{m_inotify.fd(), POLLIN, 0};
+    while (m_running) {
+        // Short timeout so the destructor never waits long
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        try {
+            // Events name other files in the directory too; the stamp check filters them
+            m_inotify.readEvents();
+        } catch (const std::system_error& e) {
+            if (m_onError) {
+                m_onError(e.what());
+            }
+            continue;
+        }
+        checkNow();
+    }
+}
+
+void ConfigurationWatcher::checkNow() {
+    std::lock_guard lock(m_mutex);
+    FileStamp stamp = stampOf();
+    if (stamp == m_lastStamp || stamp.size < 0) {
+        return; // unchanged, or mid-replace and not there yet
+    }
+    m_lastStamp = stamp;
+
+    try {
+        auto config = std::make_shared<Configuration>(Configuration::loadFromFile(m_path));
+        m_reloads++;
+        m_onReload(std::move(config));
+    } catch (const std::runtime_error& e) {
+        if (m_onError) {
+            m_onError(e.what());
+        }
+    }
+}
+
+ConfigurationWatcher::FileStamp ConfigurationWatcher::stampOf() const {
+    FileStamp stamp;
+    struct stat st;
+    if (::stat(m_path.c_str(), &st) == 0) {
+        stamp.inode = st.st_ino;
+        stamp.size = st.st_size;
+        stamp.mtime = std::chrono::seconds(st.st_mtim.tv_sec) + std::chrono::nanoseconds(st.st_mtim.tv_nsec);
+    }
+    return stamp;
+}
@@ -0,0 +1,387 @@
+//
+// File copy strategies: in-kernel copy_file_range/sendfile, buffered
+// read/write and O_DIRECT, each falling back when the filesystem refuses.
+//
+
+#ifndef COPY_ENGINE_HPP
+#define COPY_ENGINE_HPP
+
+#include "sys/file_descriptor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class CopyStrategy {
+    READ_WRITE,      // buffered read()/write() through a user-space buffer
+    SENDFILE,        // sendfile(2), no user-space copy
+    COPY_FILE_RANGE, // copy_file_range(2); reflinks or server-side copies where supported
+    DIRECT_IO        // O_DIRECT on both ends, bypassing the page cache
+};
+
+inline const char* toString(CopyStrategy strategy) {
+    switch (strategy) {
+        case CopyStrategy::READ_WRITE: return "read_write";
+        case CopyStrategy::SENDFILE: return "sendfile";
+        case CopyStrategy::COPY_FILE_RANGE: return "copy_file_range";
+        case CopyStrategy::DIRECT_IO: return "direct";
+    }
+    return "unknown";
+}
+
+// Strategy named by the COPY_ENGINE config key; nullopt for "auto" or unknown names
+inline std::optional<CopyStrategy> copyStrategyFromString(const std::string& name) {
+    if (name == "read_write") return CopyStrategy::READ_WRITE;
+    if (name == "sendfile") return CopyStrategy::SENDFILE;
+    if (name == "copy_file_range") return CopyStrategy::COPY_FILE_RANGE;
+    if (name == "direct") return CopyStrategy::DIRECT_IO;
+    return std::nullopt;
+}
+
+struct CopyOptions {
+    CopyStrategy strategy = CopyStrategy::COPY_FILE_RANGE;
+    size_t bufferSize = 128 * 1024; // chunk per syscall
+    size_t alignment = 4096;        // O_DIRECT buffer and length alignment
+    // Called with the length of each chunk moved, before the next one is
+    // started; a rate limiter sleeps in it
+    std::function<void(uint64_t bytes)> throttle;
+};
+
+struct CopyResult {
+    uint64_t bytes = 0;
+    CopyStrategy strategy = CopyStrategy::READ_WRITE; // strategy that actually moved the data
+};
+
+struct FanOutResult {
+    uint64_t bytes = 0;              // bytes read from the source
+    std::vector<std::string> errors; // per destination; empty if it was written and synced
+};
+
+// Copies one regular file, truncating the destination and preserving mode
+// and timestamps.  A strategy the kernel or filesystem does not support for
+// this pair degrades towards READ_WRITE.  Throws std::system_error.
+class CopyEngine {
+public:
+    static CopyResult copyFile(const std::string& sourcePath, const std::string& destPath,
+                               const CopyOptions& options = {}) {
+        sys::FileDescriptor source(sourcePath, O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        if (fstat(source.fd(), &st) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to stat " + sourcePath);
+        }
+        sys::FileDescriptor dest(destPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+        posix_fadvise(source.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        const uint64_t size = static_cast<uint64_t>(st.st_size);
+        const size_t chunk = std::max<size_t>(options.bufferSize, 4096);
+        CopyResult result;
+        result.strategy = options.strategy;
+
+        switch (options.strategy) {
+            case CopyStrategy::COPY_FILE_RANGE:
+                result.bytes = copyFileRange(source, dest, size, chunk, options.throttle);
+                if (result.bytes == size) break;
+                result.strategy = CopyStrategy::SENDFILE;
+                [[fallthrough]];
+            case CopyStrategy::SENDFILE:
+                result.bytes += sendFile(source, dest, size - result.bytes, chunk, options.throttle);
+                if (result.bytes == size) break;
+                result.strategy = CopyStrategy::READ_WRITE;
+                result.bytes += readWrite(source, dest, chunk, options.throttle);
+                break;
+            case CopyStrategy::DIRECT_IO:
+                if (auto copied = directCopy(sourcePath, destPath, size, chunk, options.alignment,
+                                             options.throttle)) {
+                    result.bytes = *copied;
+                    break;
+                }
+                result.strategy = CopyStrategy::READ_WRITE;
+                [[fallthrough]];
+            case CopyStrategy::READ_WRITE:
+                result.bytes = readWrite(source, dest, chunk, options.throttle);
+                break;
+        }
+
+        // The source may have grown or shrunk while we copied; keep what we read
+        if (ftruncate(dest.fd(), static_cast<off_t>(result.bytes)) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to truncate " + destPath);
+        }
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        if (futimens(dest.fd(), times) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to set times on " + destPath);
+        }
+        return result;
+    }
+
+    // Copies one source to every destination reading it once: the caller's
+    // thread reads into one of two shared buffers while one writer thread
+    // per destination writes out the other.  Each destination is truncated
+    // to the bytes read, given the source's mode and times and fdatasync'ed,
+    // then @p onDurable is called with its index from its writer thread.  A
+    // destination that fails is dropped and the rest carry on; its error is
+    // in the result.  @p throttle is called with each chunk read, as
+    // CopyOptions::throttle is.  Throws std::system_error if the source
+    // cannot be read.
+    static FanOutResult fanOutCopy(const std::string& sourcePath, const std::vector<std::string>& destPaths,
+                                   size_t bufferSize = 1024 * 1024,
+                                   const std::function<void(size_t)>& onDurable = {},
+                                   const std::function<void(uint64_t)>& throttle = {}) {
+        sys::FileDescriptor source(sourcePath, O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        if (fstat(source.fd(), &st) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to stat " + sourcePath);
+        }
+        posix_fadvise(source.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        const size_t chunk = std::max<size_t>(bufferSize, 4096);
+        const size_t count = destPaths.size();
+        FanOutResult result;
+        result.errors.resize(count);
+
+        // Chunk k is in buffer k % 2; it is refilled once every writer has
+        // consumed chunk k - 2
+        std::unique_ptr<char[]> buffers[2] = {std::unique_ptr<char[]>(new char[chunk]),
+                                              std::unique_ptr<char[]>(new char[chunk])};
+        size_t lengths[2] = {0, 0};
+        std::mutex mutex;
+        std::condition_variable changed;
+        uint64_t published = 0;
+        bool finished = false;
+        bool aborted = false;
+        std::vector<uint64_t> consumed(count, 0);
+
+        auto writer = [&](size_t index) {
+            std::optional<sys::FileDescriptor> dest;
+            try {
+                dest.emplace(destPaths[index], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+            } catch (const std::system_error& e) {
+                result.errors[index] = e.what();
+            }
+            for (uint64_t k = 0;; ++k) {
+                size_t length;
+                {
+                    std::unique_lock lock(mutex);
+                    changed.wait(lock, [&] { return published > k || finished; });
+                    if (published <= k) {
+                        break;
+                    }
+                    length = lengths[k % 2];
+                }
+                if (dest) {
+                    try {
+                        writeAll(dest->fd(), buffers[k % 2].get(), length);
+                    } catch (const std::system_error& e) {
+                        // Keep consuming so the reader is not held up
+                        result.errors[index] = e.what();
+                        dest.reset();
+                    }
+                }
+                {
+                    std::lock_guard lock(mutex);
+                    consumed[index] = k + 1;
+                }
+                changed.notify_all();
+            }
+            if (!dest || aborted) {
+                return;
+            }
+            struct timespec times[2] = {st.st_atim, st.st_mtim};
+            if (ftruncate(dest->fd(), static_cast<off_t>(result.bytes)) == -1 ||
+                futimens(dest->fd(), times) == -1 || fdatasync(dest->fd()) == -1) {
+                result.errors[index] = std::system_error(errno, std::system_category(),
+                                                         "Failed to finish " + destPaths[index]).what();
+                return;
+            }
+            if (onDurable) {
+                onDurable(index);
+            }
+        };
+
+        std::vector<std::thread> writers;
+        writers.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            writers.emplace_back(writer, i);
+        }
+
+        int readError = 0;
+        for (uint64_t k = 0;; ++k) {
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] {
+                    return k < 2 || std::all_of(consumed.begin(), consumed.end(),
+                                                [&](uint64_t done) { return done + 2 > k; });
+                });
+            }
+            ssize_t n;
+            do {
+                n = ::read(source.fd(), buffers[k % 2].get(), chunk);
+            } while (n == -1 && errno == EINTR);
+            {
+                std::lock_guard lock(mutex);
+                if (n <= 0) {
+                    readError = n == -1 ? errno : 0;
+                    aborted = n == -1;
+                    finished = true;
+                } else {
+                    lengths[k % 2] = static_cast<size_t>(n);
+                    result.bytes += static_cast<uint64_t>(n);
+                    published = k + 1;
+                }
+            }
+            changed.notify_all();
+            if (n <= 0) {
+                break;
+            }
+            if (throttle) {
+                throttle(static_cast<uint64_t>(n));
+            }
+        }
+
+        for (auto& thread : writers) {
+            thread.join();
+        }
+        if (readError != 0) {
+            throw std::system_error(readError, std::system_category(), "read failed: " + sourcePath);
+        }
+        return result;
+    }
+
+private:
+    // Errors meaning "not for this pair of files", as opposed to I/O failures
+    static bool isUnsupported(int error) {
+        return error == EXDEV || error == EINVAL || error == ENOSYS || error == EOPNOTSUPP ||
+               error == EBADF;
+    }
+
+    // Bytes copied; fewer than @p size if the kernel refused before copying anything further
+    static uint64_t copyFileRange(sys::FileDescriptor& source, sys::FileDescriptor& dest,
+                                  uint64_t size, size_t chunk, const std::function<void(uint64_t)>& throttle) {
+        uint64_t copied = 0;
+        while (copied < size) {
+            ssize_t n = ::copy_file_range(source.fd(), nullptr, dest.fd(), nullptr,
+                                          std::min<uint64_t>(chunk, size - copied), 0);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                if (copied == 0 && isUnsupported(errno)) return 0;
+                throw std::system_error(errno, std::system_category(), "copy_file_range failed");
+            }
+            if (n == 0) break; // source truncated under us
+            copied += static_cast<uint64_t>(n);
+            if (throttle) throttle(static_cast<uint64_t>(n));
+        }
+        return copied == size ? copied : copied + readWrite(source, dest, chunk, throttle);
+    }
+
+    static uint64_t sendFile(sys::FileDescriptor& source, sys::FileDescriptor& dest,
+                             uint64_t remaining, size_t chunk, const std::function<void(uint64_t)>& throttle) {
+        uint64_t copied = 0;
+        while (copied < remaining) {
+            ssize_t n = ::sendfile(dest.fd(), source.fd(), nullptr,
+                                   std::min<uint64_t>(chunk, remaining - copied));
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                if (copied == 0 && isUnsupported(errno)) return 0;
+                throw std::system_error(errno, std::system_category(), "sendfile failed");
+            }
+            if (n == 0) break;
+            copied += static_cast<uint64_t>(n);
+            if (throttle) throttle(static_cast<uint64_t>(n));
+        }
+        return copied == remaining ? copied : copied + readWrite(source, dest, chunk, throttle);
+    }
+
+    // Copies from the current offsets to end of file
+    static uint64_t readWrite(sys::FileDescriptor& source, sys::FileDescriptor& dest, size_t chunk,
+                              const std::function<void(uint64_t)>& throttle) {
+        std::unique_ptr<char[]> buffer(new char[chunk]);
+        uint64_t copied = 0;
+        for (;;) {
+            ssize_t n = ::read(source.fd(), buffer.get(), chunk);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "read failed");
+            }
+            if (n == 0) break;
+            writeAll(dest.fd(), buffer.get(), static_cast<size_t>(n));
+            copied += static_cast<uint64_t>(n);
+            if (throttle) throttle(static_cast<uint64_t>(n));
+        }
+        return copied;
+    }
+
+    // Whole-file copy with O_DIRECT on both ends; nullopt if either
+    // filesystem rejects O_DIRECT (tmpfs, some FUSE and network mounts)
+    static std::optional<uint64_t> directCopy(const std::string& sourcePath, const std::string& destPath,
+                                              uint64_t size, size_t chunk, size_t alignment,
+                                              const std::function<void(uint64_t)>& throttle) {
+        int in = ::open(sourcePath.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+        if (in == -1) {
+            if (errno == EINVAL) return std::nullopt;
+            throw std::system_error(errno, std::system_category(), "Failed to open file: " + sourcePath);
+        }
+        sys::FileDescriptor source(in);
+        int out = ::open(destPath.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+        if (out == -1) {
+            if (errno == EINVAL) return std::nullopt;
+            throw std::system_error(errno, std::system_category(), "Failed to open file: " + destPath);
+        }
+        sys::FileDescriptor dest(out);
+
+        alignment = std::max<size_t>(alignment, 512);
+        chunk = (chunk + alignment - 1) / alignment * alignment;
+        void* raw = std::aligned_alloc(alignment, chunk);
+        if (raw == nullptr) {
+            throw std::bad_alloc();
+        }
+        std::unique_ptr<char, decltype(&std::free)> buffer(static_cast<char*>(raw), &std::free);
+
+        uint64_t copied = 0;
+        for (;;) {
+            ssize_t n = ::read(source.fd(), buffer.get(), chunk);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                if (copied == 0 && errno == EINVAL) return std::nullopt;
+                throw std::system_error(errno, std::system_category(), "O_DIRECT read failed");
+            }
+            if (n == 0) break;
+            // O_DIRECT writes whole blocks; the tail is zero-padded and the
+            // caller truncates the file back to its real length
+            size_t length = static_cast<size_t>(n);
+            size_t padded = (length + alignment - 1) / alignment * alignment;
+            std::memset(buffer.get() + length, 0, padded - length);
+            writeAll(dest.fd(), buffer.get(), padded);
+            copied += length;
+            if (throttle) throttle(length);
+            if (length < chunk && copied >= size) break;
+        }
+        return copied;
+    }
+
+    static void writeAll(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = ::write(fd, data, length);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "write failed");
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+    }
+};
+
+#endif // COPY_ENGINE_HPP
@@ -0,0 +1,302 @@
+//
+// Cuckoo filter of destination files known to be in sync: a path hash,
+// size and mtime per file, answering "already there?" without a stat.
+//
+
+#ifndef CUCKOO_FILTER_HPP
+#define CUCKOO_FILTER_HPP
+
+#include "profiled_mutex.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Each key keeps a 16-bit fingerprint in one of two buckets of four slots,
+// the second bucket derived from the first and the fingerprint, so entries
+// can be moved and erased without the key.  About 2.1 bytes per file at the
+// 95% load the layout reaches, with a false-positive rate near 8 / 65536.
+// The key covers the file's size and mtime, so a file rewritten since it
+// was inserted misses; a miss only means the caller checks the disk.  Keys
+// alike in fingerprint and buckets share one slot, so erasing one can make
+// the other miss as well.  An insert that finds no room after kMaxKicks
+// evictions parks the last fingerprint in a single victim slot; with that
+// taken, inserts fail until rebuild(), but nothing inserted is ever lost.
+class CuckooFilter {
+public:
+    static constexpr size_t kBucketSlots = 4;
+    static constexpr size_t kMinCapacity = 1 << 16;
+
+    explicit CuckooFilter(size_t capacity = kMinCapacity) { reset(capacity); }
+
+    // Key of the file at @p relative below the destination directory @p root,
+    // with @p size bytes and mtime @p mtimeNs.  Slashes where the two meet
+    // are ignored, so "/dest/" and "a" make the same key as "/dest" and "/a".
+    static uint64_t key(std::string_view root, std::string_view relative, uint64_t size, int64_t mtimeNs) {
+        while (root.size() > 1 && root.back() == '/') {
+            root.remove_suffix(1);
+        }
+        while (!relative.empty() && relative.front() == '/') {
+            relative.remove_prefix(1);
+        }
+        // FNV-1a over root/relative, then the version mixed in
+        uint64_t h = 0xcbf29ce484222325ULL;
+        auto hash = [&h](std::string_view part) {
+            for (unsigned char c : part) {
+                h = (h ^ c) * 0x100000001b3ULL;
+            }
+        };
+        hash(root);
+        hash("/");
+        hash(relative);
+        h = mix(h ^ size);
+        return mix(h ^ static_cast<uint64_t>(mtimeNs));
+    }
+
+    // False only when the filter is full
+    bool insert(uint64_t key) {
+        std::lock_guard lock(m_mutex);
+        uint16_t fp = fingerprint(key);
+        size_t i1 = primary(key);
+        size_t i2 = alternate(i1, fp);
+        if (holds(i1, fp) || holds(i2, fp) || (m_hasVictim && m_victim == fp &&
+                                              (m_victimBucket == i1 || m_victimBucket == i2))) {
+            return true;
+        }
+        if (place(i1, fp) || place(i2, fp)) {
+            m_count++;
+            return true;
+        }
+        if (m_hasVictim) {
+            return false;
+        }
+        // Evict a random resident along the chain until one finds room
+        size_t bucket = (next() & 1) ? i1 : i2;
+        for (size_t kick = 0; kick < kMaxKicks; ++kick) {
+            uint16_t& slot = m_slots[bucket * kBucketSlots + next() % kBucketSlots];
+            std::swap(fp, slot);
+            bucket = alternate(bucket, fp);
+            if (place(bucket, fp)) {
+                m_count++;
+                return true;
+            }
+        }
+        m_hasVictim = true;
+        m_victim = fp;
+        m_victimBucket = bucket;
+        m_count++;
+        return true;
+    }
+
+    bool contains(uint64_t key) const {
+        std::lock_guard lock(m_mutex);
+        uint16_t fp = fingerprint(key);
+        size_t i1 = primary(key);
+        size_t i2 = alternate(i1, fp);
+        return holds(i1, fp) || holds(i2, fp) ||
+               (m_hasVictim && m_victim == fp && (m_victimBucket == i1 || m_victimBucket == i2));
+    }
+
+    // Remove one key inserted before; erasing a key never inserted may
+    // remove another key sharing its fingerprint and buckets
+    bool erase(uint64_t key) {
+        std::lock_guard lock(m_mutex);
+        uint16_t fp = fingerprint(key);
+        size_t i1 = primary(key);
+        size_t i2 = alternate(i1, fp);
+        if (m_hasVictim && m_victim == fp && (m_victimBucket == i1 || m_victimBucket == i2)) {
+            m_hasVictim = false;
+            m_count--;
+            return true;
+        }
+        for (size_t bucket : {i1, i2}) {
+            uint16_t* slots = &m_slots[bucket * kBucketSlots];
+            for (size_t s = 0; s < kBucketSlots; ++s) {
+                if (slots[s] == fp) {
+                    slots[s] = 0;
+                    m_count--;
+                    reinsertVictim();
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Replace the contents with @p keys, with room for as many again
+    void rebuild(const std::vector<uint64_t>& keys) {
+        CuckooFilter fresh(std::max(kMinCapacity, 2 * keys.size()));
+        for (uint64_t k : keys) {
+            fresh.insert(k);
+        }
+        std::lock_guard lock(m_mutex);
+        m_buckets = fresh.m_buckets;
+        m_slots = std::move(fresh.m_slots);
+        m_count = fresh.m_count;
+        m_hasVictim = fresh.m_hasVictim;
+        m_victim = fresh.m_victim;
+        m_victimBucket = fresh.m_victimBucket;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(m_mutex);
+        return m_count;
+    }
+
+    size_t capacity() const {
+        std::lock_guard lock(m_mutex);
+        return m_buckets * kBucketSlots;
+    }
+
+    // Write the filter to @p path atomically; false on an I/O error
+    bool save(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        std::string tmp = path + ".tmp";
+        bool written;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            FileHeader header{};
+            std::memcpy(header.magic, kMagic, sizeof(header.magic));
+            header.buckets = m_buckets;
+            header.count = m_count;
+            header.victimBucket = m_hasVictim ? m_victimBucket : 0;
+            header.victim = m_hasVictim ? m_victim : 0;
+            header.hasVictim = m_hasVictim ? 1 : 0;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(m_slots.data()),
+                      static_cast<std::streamsize>(m_slots.size() * sizeof(uint16_t)));
+            written = static_cast<bool>(out.flush());
+        }
+        if (!written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Replace the contents with the filter saved at @p path; false, leaving
+    // the filter as it was, if the file is missing or not a whole filter
+    bool load(const std::string& path) {
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(path, ec);
+        std::ifstream in(path, std::ios::binary);
+        FileHeader header{};
+        if (ec || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0 || header.buckets == 0 ||
+            (header.buckets & (header.buckets - 1)) != 0 || header.buckets > fileSize ||
+            fileSize != sizeof(header) + header.buckets * kBucketSlots * sizeof(uint16_t)) {
+            return false;
+        }
+        std::vector<uint16_t> slots(header.buckets * kBucketSlots);
+        if (!in.read(reinterpret_cast<char*>(slots.data()),
+                     static_cast<std::streamsize>(slots.size() * sizeof(uint16_t)))) {
+            return false;
+        }
+        std::lock_guard lock(m_mutex);
+        m_buckets = header.buckets;
+        m_slots = std::move(slots);
+        m_count = header.count;
+        m_hasVictim = header.hasVictim != 0;
+        m_victim = header.victim;
+        m_victimBucket = header.victimBucket & (m_buckets - 1);
+        return true;
+    }
+
+private:
+    static constexpr size_t kMaxKicks = 500;
+    static constexpr char kMagic[8] = {'C', 'A', 'S', 'C', 'K', 'O', 'O', '1'};
+
+    struct FileHeader {
+        char magic[8];
+        uint64_t buckets;
+        uint64_t count;
+        uint64_t victimBucket;
+        uint16_t victim;
+        uint16_t hasVictim;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 40, "filter file header layout");
+
+    mutable ProfiledMutex m_mutex{"cuckoo_filter"};
+    size_t m_buckets = 0; // a power of two
+    std::vector<uint16_t> m_slots; // 0 marks an empty slot
+    size_t m_count = 0;
+    bool m_hasVictim = false;
+    uint16_t m_victim = 0;
+    size_t m_victimBucket = 0;
+    uint64_t m_random = 0x9e3779b97f4a7c15ULL;
+
+    static uint64_t mix(uint64_t x) {
+        // splitmix64 finaliser
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Room for @p capacity keys at 95% load
+    void reset(size_t capacity) {
+        size_t buckets = 1;
+        while (buckets * kBucketSlots * 95 / 100 < capacity) {
+            buckets <<= 1;
+        }
+        m_buckets = buckets;
+        m_slots.assign(buckets * kBucketSlots, 0);
+        m_count = 0;
+        m_hasVictim = false;
+    }
+
+    // Top bits of the key, never 0
+    static uint16_t fingerprint(uint64_t key) {
+        auto fp = static_cast<uint16_t>(key >> 48);
+        return fp == 0 ? 1 : fp;
+    }
+
+    size_t primary(uint64_t key) const { return static_cast<size_t>(key) & (m_buckets - 1); }
+
+    // Its own inverse: the alternate of the alternate is the first bucket
+    size_t alternate(size_t bucket, uint16_t fp) const {
+        return (bucket ^ static_cast<size_t>(mix(fp))) & (m_buckets - 1);
+    }
+
+    bool holds(size_t bucket, uint16_t fp) const {
+        const uint16_t* slots = &m_slots[bucket * kBucketSlots];
+        return std::find(slots, slots + kBucketSlots, fp) != slots + kBucketSlots;
+    }
+
+    bool place(size_t bucket, uint16_t fp) {
+        uint16_t* slots = &m_slots[bucket * kBucketSlots];
+        uint16_t* empty = std::find(slots, slots + kBucketSlots, uint16_t{0});
+        if (empty == slots + kBucketSlots) {
+            return false;
+        }
+        *empty = fp;
+        return true;
+    }
+
+    // An erase made room: move the victim back into the table if it fits
+    void reinsertVictim() {
+        if (m_hasVictim && (place(m_victimBucket, m_victim) ||
+                            place(alternate(m_victimBucket, m_victim), m_victim))) {
+            m_hasVictim = false;
+        }
+    }
+
+    uint64_t next() {
+        // xorshift64
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 7;
+        m_random ^= m_random << 17;
+        return m_random;
+    }
+};
+
+#endif // CUCKOO_FILTER_HPP
@@ -0,0 +1,376 @@
+//
+// Per-device I/O profiles (rotational, queue depth, I/O size hints) read from
+// sysfs at startup and turned into copy, verify and scheduling parameters.
+//
+
+#ifndef DEVICE_PROFILER_HPP
+#define DEVICE_PROFILER_HPP
+
+#include "copy_engine.hpp"
+#include "metrics_collector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// What we know about the block device behind a mount, plus the tuning derived from it
+struct IoProfile {
+    dev_t deviceId = 0;          // st_dev of the profiled path
+    std::string device;          // kernel name ("sda", "nvme0n1"); empty for tmpfs, NFS, ...
+    bool rotational = false;     // queue/rotational
+    bool zoned = false;          // queue/zoned: SMR drives want strictly sequential writes
+    uint32_t queueDepth = 0;     // queue/nr_requests
+    uint32_t optimalIoSize = 0;  // queue/optimal_io_size, 0 when the device gives no hint
+    uint32_t logicalBlockSize = 512;
+    uint32_t maxTransferBytes = 0; // queue/max_sectors_kb
+
+    // Filled in by calibration, zero when it did not run
+    double sequentialBytesPerSecond = 0.0;
+    double randomReadsPerSecond = 0.0;
+
+    // Derived tuning
+    size_t bufferSize = 128 * 1024;  // copy and hash chunk size
+    unsigned concurrency = 4;        // concurrent copies/verifies on this device
+    CopyStrategy copyStrategy = CopyStrategy::COPY_FILE_RANGE;
+
+    bool isBlockDevice() const { return !device.empty(); }
+};
+
+// Copy options for a source/destination pair: a rotational disk on either end
+// gets large buffered chunks instead of the kernel's small splice-sized steps
+inline CopyOptions copyOptionsFor(const IoProfile& source, const IoProfile& dest) {
+    CopyOptions options;
+    options.strategy = source.rotational || dest.rotational ? CopyStrategy::READ_WRITE : dest.copyStrategy;
+    options.bufferSize = std::max(source.bufferSize, dest.bufferSize);
+    options.alignment = std::max<size_t>({4096, source.logicalBlockSize, dest.logicalBlockSize});
+    return options;
+}
+
+// Builds and caches one IoProfile per device.  sysfsRoot is a parameter so
+// tests can point it at a fake tree.
+class DeviceProfiler {
+public:
+    explicit DeviceProfiler(std::string sysfsRoot = "/sys", bool calibrate = false)
+        : m_sysfsRoot(std::move(sysfsRoot)), m_calibrate(calibrate) {}
+
+    // Profile of the device holding @p path (or its nearest existing ancestor).
+    // The first call per device reads sysfs and, if enabled, calibrates.
+    IoProfile profileFor(const std::string& path) {
+        struct stat st{};
+        fs::path existing = path;
+        while (::stat(existing.c_str(), &st) == -1) {
+            if (!existing.has_relative_path()) {
+                return IoProfile{};
+            }
+            existing = existing.parent_path();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_profiles.find(st.st_dev);
+        if (it != m_profiles.end()) {
+            return it->second;
+        }
+
+        IoProfile profile = profileForDevice(major(st.st_dev), minor(st.st_dev));
+        profile.deviceId = st.st_dev;
+        if (m_calibrate && profile.isBlockDevice()) {
+            fs::path dir = S_ISDIR(st.st_mode) ? existing : existing.parent_path();
+            calibrate(profile, dir.string());
+        }
+        return m_profiles.emplace(st.st_dev, profile).first->second;
+    }
+
+    // Profile from sysfs alone; devices without a block queue (tmpfs, NFS,
+    // overlay, btrfs anonymous devices) get the non-rotational defaults
+    IoProfile profileForDevice(unsigned int majorNumber, unsigned int minorNumber) const {
+        IoProfile profile;
+        std::error_code ec;
+        fs::path node = fs::canonical(fs::path(m_sysfsRoot) / "dev" / "block" /
+                                      (std::to_string(majorNumber) + ":" + std::to_string(minorNumber)), ec);
+        if (!ec) {
+            // Partitions share their disk's queue
+            if (fs::exists(node / "partition", ec)) {
+                node = node.parent_path();
+            }
+            fs::path queue = node / "queue";
+            if (fs::is_directory(queue, ec)) {
+                profile.device = node.filename().string();
+                profile.rotational = readNumber(queue / "rotational") != 0;
+                std::string zoned = readWord(queue / "zoned");
+                profile.zoned = !zoned.empty() && zoned != "none";
+                profile.queueDepth = static_cast<uint32_t>(readNumber(queue / "nr_requests"));
+                profile.optimalIoSize = static_cast<uint32_t>(readNumber(queue / "optimal_io_size"));
+                if (auto block = readNumber(queue / "logical_block_size")) {
+                    profile.logicalBlockSize = static_cast<uint32_t>(block);
+                }
+                profile.maxTransferBytes = static_cast<uint32_t>(readNumber(queue / "max_sectors_kb") * 1024);
+            }
+        }
+        tune(profile);
+        return profile;
+    }
+
+    // Derive buffer size, concurrency and copy strategy from the device facts
+    static void tune(IoProfile& profile) {
+        constexpr size_t KiB = 1024;
+        constexpr size_t MiB = 1024 * KiB;
+
+        if (!profile.isBlockDevice()) {
+            profile.bufferSize = 128 * KiB;
+            profile.concurrency = 4;
+            profile.copyStrategy = CopyStrategy::COPY_FILE_RANGE;
+            return;
+        }
+
+        if (profile.rotational) {
+            // Seeks dominate: few streams, big sequential chunks
+            profile.bufferSize = std::max<size_t>(profile.optimalIoSize, MiB);
+            profile.concurrency = profile.zoned ? 1 : 2;
+            profile.copyStrategy = CopyStrategy::READ_WRITE;
+        } else {
+            // Flash: keep the queue busy, let the kernel move the data
+            profile.bufferSize = std::max<size_t>(profile.optimalIoSize, 256 * KiB);
+            profile.concurrency = std::clamp<unsigned>(profile.queueDepth / 8, 2, 16);
+            profile.copyStrategy = CopyStrategy::COPY_FILE_RANGE;
+        }
+        if (profile.maxTransferBytes > 0 && !profile.rotational) {
+            // Larger requests are split by the block layer anyway
+            profile.bufferSize = std::min<size_t>(profile.bufferSize,
+                                                  std::max<size_t>(profile.maxTransferBytes, 128 * KiB));
+        }
+        profile.bufferSize = std::min<size_t>(profile.bufferSize, 8 * MiB);
+    }
+
+    // Short O_DIRECT read test on a scratch file in @p directory.  Virtual
+    // disks often report rotational=1 (or 0) regardless of what backs them,
+    // so measured random-read rate overrides the sysfs flag.  Leaves the
+    // profile untouched if the directory is not writable or rejects O_DIRECT.
+    static bool calibrate(IoProfile& profile, const std::string& directory,
+                          size_t fileSize = 16 * 1024 * 1024, int randomReads = 256) {
+        std::string scratch = (fs::path(directory) / ".file_sync-calibrate.XXXXXX").string();
+        int fd = ::mkstemp(scratch.data());
+        if (fd == -1) {
+            return false;
+        }
+        ::unlink(scratch.c_str());
+        sys::FileDescriptor file(fd);
+
+        const size_t block = std::max<size_t>(profile.logicalBlockSize, 4096);
+        const size_t chunk = 1024 * 1024;
+        std::unique_ptr<char, decltype(&std::free)> buffer(
+            static_cast<char*>(std::aligned_alloc(block, chunk)), &std::free);
+        if (!buffer) {
+            return false;
+        }
+        std::memset(buffer.get(), 0x5a, chunk);
+        for (size_t written = 0; written < fileSize; written += chunk) {
+            if (::write(file.fd(), buffer.get(), chunk) != static_cast<ssize_t>(chunk)) {
+                return false;
+            }
+        }
+        if (::fsync(file.fd()) == -1 || ::fcntl(file.fd(), F_SETFL, O_DIRECT) == -1) {
+            return false;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+        for (size_t offset = 0; offset < fileSize; offset += chunk) {
+            if (::pread(file.fd(), buffer.get(), chunk, static_cast<off_t>(offset)) <= 0) {
+                return false; // O_DIRECT unsupported here
+            }
+        }
+        double sequentialSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> pick(0, fileSize / block - 1);
+        start = Clock::now();
+        for (int i = 0; i < randomReads; ++i) {
+            if (::pread(file.fd(), buffer.get(), block, static_cast<off_t>(pick(rng) * block)) <= 0) {
+                return false;
+            }
+        }
+        double randomSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        profile.sequentialBytesPerSecond = static_cast<double>(fileSize) / std::max(sequentialSeconds, 1e-9);
+        profile.randomReadsPerSecond = randomReads / std::max(randomSeconds, 1e-9);
+        // A spinning disk manages a few hundred random reads a second at best
+        profile.rotational = profile.randomReadsPerSecond < 1000.0;
+        tune(profile);
+        return true;
+    }
+
+    // Summary of every profiled device
+    std::string getSummary() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::stringstream ss;
+        for (const auto& [id, profile] : m_profiles) {
+            ss << (profile.isBlockDevice() ? profile.device : "(no block device)")
+               << " [" << major(id) << ":" << minor(id) << "]: "
+               << (profile.rotational ? "rotational" : "non-rotational")
+               << (profile.zoned ? ", zoned" : "")
+               << ", queue depth " << profile.queueDepth
+               << ", buffer " << profile.bufferSize / 1024 << " KiB"
+               << ", concurrency " << profile.concurrency
+               << ", copy " << toString(profile.copyStrategy);
+            if (profile.randomReadsPerSecond > 0) {
+                ss << ", calibrated " << static_cast<uint64_t>(profile.sequentialBytesPerSecond / (1024 * 1024))
+                   << " MiB/s sequential, " << static_cast<uint64_t>(profile.randomReadsPerSecond)
+                   << " random reads/s";
+            }
+            ss << std::endl;
+        }
+        return ss.str();
+    }
+
+    void recordMetrics(MetricsCollector& metrics) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& [id, profile] : m_profiles) {
+            const std::string label = "{device=\"" + (profile.isBlockDevice() ? profile.device
+                : std::to_string(major(id)) + ":" + std::to_string(minor(id))) + "\"}";
+            metrics.setGauge("device_rotational" + label, profile.rotational ? 1.0 : 0.0);
+            metrics.setGauge("device_queue_depth" + label, profile.queueDepth);
+            metrics.setGauge("device_buffer_bytes" + label, static_cast<double>(profile.bufferSize));
+            metrics.setGauge("device_concurrency" + label, profile.concurrency);
+        }
+    }
+
+private:
+    std::string m_sysfsRoot;
+    bool m_calibrate;
+    mutable std::mutex m_mutex;
+    std::map<dev_t, IoProfile> m_profiles;
+
+    static std::string readWord(const fs::path& path) {
+        std::ifstream in(path);
+        std::string word;
+        in >> word;
+        return word;
+    }
+
+    static uint64_t readNumber(const fs::path& path) {
+        std::string word = readWord(path);
+        return word.empty() ? 0 : std::strtoull(word.c_str(), nullptr, 10);
+    }
+};
+
+// Caps concurrent operations per device at the profile's concurrency
+class DeviceGate {
+public:
+    class Slot {
+    public:
+        Slot(DeviceGate* gate, dev_t device, unsigned limit) : m_gate(gate), m_device(device), m_limit(limit) {}
+        Slot(Slot&& other) noexcept
+            : m_gate(std::exchange(other.m_gate, nullptr)), m_device(other.m_device), m_limit(other.m_limit),
+              m_held(other.m_held), m_pauses(other.m_pauses) {}
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+        Slot& operator=(Slot&&) = delete;
+        ~Slot() {
+            if (m_gate) {
+                m_gate->release(*this);
+            }
+        }
+
+        // Let others use the device during a wait that is not for it.  Any
+        // thread may pause; the slot is taken back, blocking until there is
+        // room, once every pause has been resumed.
+        void pause() {
+            if (m_gate) {
+                m_gate->pause(*this);
+            }
+        }
+        void resume() {
+            if (m_gate) {
+                m_gate->resume(*this);
+            }
+        }
+
+    private:
+        friend class DeviceGate;
+
+        DeviceGate* m_gate;
+        dev_t m_device;
+        unsigned m_limit;
+        // Guarded by the gate's mutex
+        bool m_held = true;
+        unsigned m_pauses = 0;
+    };
+
+    // Blocks while the device already has profile.concurrency operations running
+    Slot acquire(const IoProfile& profile) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        unsigned limit = std::max(profile.concurrency, 1u);
+        unsigned& active = m_active[profile.deviceId];
+        m_released.wait(lock, [&] { return active < limit; });
+        ++active;
+        return Slot(this, profile.deviceId, limit);
+    }
+
+    unsigned active(dev_t device) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_active.find(device);
+        return it == m_active.end() ? 0 : it->second;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::map<dev_t, unsigned> m_active;
+
+    void release(Slot& slot) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!slot.m_held) {
+                return;
+            }
+            slot.m_held = false;
+            --m_active[slot.m_device];
+        }
+        m_released.notify_all();
+    }
+
+    void pause(Slot& slot) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (slot.m_pauses++ > 0 || !slot.m_held) {
+                return;
+            }
+            slot.m_held = false;
+            --m_active[slot.m_device];
+        }
+        m_released.notify_all();
+    }
+
+    void resume(Slot& slot) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (--slot.m_pauses > 0) {
+            return;
+        }
+        unsigned& active = m_active[slot.m_device];
+        // Paused again meanwhile: that pause's resume takes it
+        m_released.wait(lock, [&] { return slot.m_pauses > 0 || slot.m_held || active < slot.m_limit; });
+        if (slot.m_pauses == 0 && !slot.m_held) {
+            slot.m_held = true;
+            ++active;
+        }
+    }
+};
+
+#endif // DEVICE_PROFILER_HPP
@@ -0,0 +1,218 @@
+//
+// Write-back bookkeeping: files written to the cache tier but not yet to the
+// array, and the order in which a flush writes them.
+//
+
+#ifndef DIRTY_SET_HPP
+#define DIRTY_SET_HPP
+
+#include "priority_sync_queue.hpp"
+#include "profiled_mutex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <functional>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Dirty files keyed by source path.  A file stays dirty from its first write
+// until a flush that started after its last write has reached the array, so
+// a write during a flush keeps it dirty for the next one.  Each dirty file
+// holds one PENDING transaction, opened when it became dirty, so a crash
+// loses no acknowledged write: recovery replays the transaction.  A file
+// whose flush fails is handed to recovery the same way.
+class DirtySet {
+public:
+    // One file in a flush batch
+    struct DirtyFile {
+        std::string path;
+        uint64_t size = 0;
+        SyncPriority priority = SyncPriority::NORMAL;
+        std::chrono::steady_clock::time_point since; // first write not yet flushed
+        std::string transactionId;
+        // Filled in by the flusher for ordering
+        std::string destRoot;
+        std::string destPath;
+        std::optional<uint64_t> destOffset; // physical offset of the existing array copy
+    };
+
+    struct Stats {
+        size_t files = 0;
+        uint64_t bytes = 0;
+        size_t flushing = 0;
+        std::chrono::milliseconds oldestAge{0};
+    };
+
+    // Mark @p path dirty.  @p openRecord is called (under the set's lock)
+    // only when the file was clean, and returns the transaction that records
+    // the dirty state.  Returns true if the file was clean.
+    bool markDirty(const std::string& path, uint64_t size, SyncPriority priority,
+                   const std::function<std::string()>& openRecord,
+                   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        std::lock_guard lock(m_mutex);
+        auto [it, inserted] = m_files.try_emplace(path);
+        Entry& entry = it->second;
+        if (!inserted) {
+            m_bytes -= entry.size;
+            entry.size = size;
+            m_bytes += size;
+            entry.priority = std::min(entry.priority, priority);
+            if (entry.flushing && !entry.rewritten) {
+                // The flush in progress may miss this write; dirty again from now
+                entry.rewritten = true;
+                entry.rewrittenSince = now;
+            }
+            return false;
+        }
+        entry.size = size;
+        entry.priority = priority;
+        entry.since = now;
+        entry.transactionId = openRecord();
+        m_bytes += size;
+        return true;
+    }
+
+    // True when the oldest dirty file is @p maxAge old or the dirty bytes
+    // not already being flushed reach @p batchBytes
+    bool flushDue(std::chrono::steady_clock::duration maxAge, uint64_t batchBytes,
+                  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const {
+        std::lock_guard lock(m_mutex);
+        uint64_t waiting = 0;
+        for (const auto& [path, entry] : m_files) {
+            if (entry.flushing) {
+                continue;
+            }
+            if (now - entry.since >= maxAge) {
+                return true;
+            }
+            waiting += entry.size;
+        }
+        return waiting > 0 && waiting >= batchBytes;
+    }
+
+    // Every dirty file not already being flushed, now marked as flushing
+    std::vector<DirtyFile> takeBatch() {
+        std::lock_guard lock(m_mutex);
+        std::vector<DirtyFile> batch;
+        for (auto& [path, entry] : m_files) {
+            if (entry.flushing) {
+                continue;
+            }
+            entry.flushing = true;
+            entry.rewritten = false;
+            batch.push_back({path, entry.size, entry.priority, entry.since, entry.transactionId, {}, {}, {}});
+        }
+        return batch;
+    }
+
+    // A flush of @p path ended.  Returns the dirty record's transaction id if
+    // the file is now clean (close it).  Returns nullopt if the file was
+    // written again meanwhile (it stays dirty) or the flush failed (it leaves
+    // the set and its transaction stays PENDING for recovery).
+    std::optional<std::string> flushed(const std::string& path, bool success) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_files.find(path);
+        if (it == m_files.end()) {
+            return std::nullopt;
+        }
+        Entry& entry = it->second;
+        if (success && entry.rewritten) {
+            entry.flushing = false;
+            entry.rewritten = false;
+            entry.since = entry.rewrittenSince;
+            return std::nullopt;
+        }
+        std::optional<std::string> transactionId;
+        if (success) {
+            transactionId = std::move(entry.transactionId);
+        }
+        m_bytes -= entry.size;
+        m_files.erase(it);
+        return transactionId;
+    }
+
+    bool isDirty(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        return m_files.count(path) > 0;
+    }
+
+    Stats getStats(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const {
+        std::lock_guard lock(m_mutex);
+        Stats stats;
+        stats.files = m_files.size();
+        stats.bytes = m_bytes;
+        for (const auto& [path, entry] : m_files) {
+            if (entry.flushing) {
+                stats.flushing++;
+            }
+            stats.oldestAge = std::max(stats.oldestAge,
+                                       std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.since));
+        }
+        return stats;
+    }
+
+    // Order a batch for the array: by destination root, then files that
+    // already have blocks there by physical offset (one sweep of the head),
+    // then new files by path, which most allocators place in directory order
+    static void orderForArray(std::vector<DirtyFile>& batch) {
+        std::sort(batch.begin(), batch.end(), [](const DirtyFile& a, const DirtyFile& b) {
+            if (a.destRoot != b.destRoot) {
+                return a.destRoot < b.destRoot;
+            }
+            if (a.destOffset.has_value() != b.destOffset.has_value()) {
+                return a.destOffset.has_value();
+            }
+            if (a.destOffset && *a.destOffset != *b.destOffset) {
+                return *a.destOffset < *b.destOffset;
+            }
+            return a.destPath < b.destPath;
+        });
+    }
+
+    // Physical byte offset of the first extent of @p path (FIEMAP); nullopt
+    // for missing or empty files and filesystems without FIEMAP (tmpfs, NFS)
+    static std::optional<uint64_t> physicalOffset(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return std::nullopt;
+        }
+        // struct fiemap followed by room for one extent
+        alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+        auto* map = reinterpret_cast<struct fiemap*>(buffer);
+        map->fm_start = 0;
+        map->fm_length = FIEMAP_MAX_OFFSET;
+        map->fm_extent_count = 1;
+        int rc = ::ioctl(fd, FS_IOC_FIEMAP, map);
+        ::close(fd);
+        if (rc == -1 || map->fm_mapped_extents == 0) {
+            return std::nullopt;
+        }
+        return map->fm_extents[0].fe_physical;
+    }
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        SyncPriority priority = SyncPriority::NORMAL;
+        std::chrono::steady_clock::time_point since;
+        std::string transactionId;
+        bool flushing = false;
+        bool rewritten = false; // written again while flushing
+        std::chrono::steady_clock::time_point rewrittenSince;
+    };
+
+    mutable ProfiledMutex m_mutex{"dirty_set"};
+    std::unordered_map<std::string, Entry> m_files;
+    uint64_t m_bytes = 0;
+};
+
+#endif // DIRTY_SET_HPP
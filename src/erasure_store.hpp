@@ -0,0 +1,582 @@
+//
+// Erasure-coded copies of cold files: k + m shard files on distinct array
+// members, any k of which give the file back.
+//
+
+#ifndef ERASURE_STORE_HPP
+#define ERASURE_STORE_HPP
+
+#include "reed_solomon.hpp"
+#include "sys/file_descriptor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The file is cut into stripes of k units; unit j of every stripe goes to
+// data shard j and the m parity shards hold the code of each stripe, so every
+// shard is one sequential file on its own member.  Each shard starts with a
+// header naming the layout and the file's size, mode and mtime, so shards are
+// found by looking on every member with no catalogue; a shard that is
+// missing, short or disagrees counts as an erasure.
+//
+// Reads and writes go a batch of stripes at a time with one thread per shard,
+// so the members' heads work in parallel.  A read uses the data shards when
+// they are all there and otherwise reads parity in their place and rebuilds
+// the missing units over several threads.  A lost shard is rebuilt the same
+// way onto a replacement member.
+class ErasureStore {
+public:
+    // Bytes of one shard in a stripe
+    static constexpr uint32_t kStripeUnit = 256 * 1024;
+    // Stripes per read or write round
+    static constexpr size_t kBatchStripes = 8;
+    // Data starts after a block-aligned header
+    static constexpr size_t kHeaderSize = 4096;
+
+    struct Header {
+        char magic[8];
+        uint8_t dataShards;
+        uint8_t parityShards;
+        uint8_t index;
+        uint8_t version;
+        uint32_t stripeUnit;
+        uint64_t size;
+        int64_t mtimeNs;
+        uint32_t mode;
+        uint32_t reserved;
+
+        // Same file and layout; the index differs between shards
+        bool sameFile(const Header& other) const {
+            return dataShards == other.dataShards && parityShards == other.parityShards &&
+                   stripeUnit == other.stripeUnit && size == other.size && mtimeNs == other.mtimeNs &&
+                   mode == other.mode;
+        }
+    };
+
+    // Shards of one file; a path is empty where the shard is missing
+    struct Shards {
+        Header header{};
+        std::vector<std::string> paths;
+
+        size_t present() const {
+            return static_cast<size_t>(std::count_if(paths.begin(), paths.end(),
+                                                     [](const std::string& p) { return !p.empty(); }));
+        }
+    };
+
+    // Shard @p index of @p relative (leading '/') on the member at @p root
+    static std::string shardPath(const std::string& root, const std::string& relative, size_t index) {
+        return root + "/.erasure" + relative + ".rs" + std::to_string(index);
+    }
+
+    // Write @p sourcePath as rs.totalShards() shards to @p shardPaths, each
+    // synced; parent directories are created.  Returns the bytes encoded.
+    // Throws std::system_error; shards written so far are removed.
+    static uint64_t encode(const ReedSolomon& rs, const std::string& sourcePath,
+                           const std::vector<std::string>& shardPaths) {
+        const size_t k = rs.dataShards();
+        const size_t n = rs.totalShards();
+        if (shardPaths.size() != n) {
+            throw std::invalid_argument("erasure encode needs one path per shard");
+        }
+        sys::FileDescriptor source(sourcePath, O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        if (fstat(source.fd(), &st) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to stat " + sourcePath);
+        }
+        posix_fadvise(source.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.dataShards = static_cast<uint8_t>(k);
+        header.parityShards = static_cast<uint8_t>(rs.parityShards());
+        header.version = 1;
+        header.stripeUnit = kStripeUnit;
+        header.size = static_cast<uint64_t>(st.st_size);
+        header.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        header.mode = st.st_mode & 07777;
+
+        try {
+            std::vector<sys::FileDescriptor> shards;
+            for (size_t i = 0; i < n; ++i) {
+                std::filesystem::create_directories(std::filesystem::path(shardPaths[i]).parent_path());
+                shards.emplace_back(shardPaths[i], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+                Header shardHeader = header;
+                shardHeader.index = static_cast<uint8_t>(i);
+                char block[kHeaderSize] = {};
+                std::memcpy(block, &shardHeader, sizeof(shardHeader));
+                writeAt(shards[i].fd(), block, kHeaderSize, 0);
+            }
+
+            Batch batch(n);
+            const uint64_t stripes = stripeCount(header);
+            for (uint64_t first = 0; first < stripes; first += kBatchStripes) {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(kBatchStripes, stripes - first));
+                size_t length = count * kStripeUnit;
+                // Unit j of stripe s is the file's (s * k + j)th unit
+                for (size_t s = 0; s < count; ++s) {
+                    for (size_t j = 0; j < k; ++j) {
+                        uint8_t* unit = batch.shard(j) + s * kStripeUnit;
+                        size_t got = readFull(source.fd(), unit, kStripeUnit, sourcePath);
+                        std::memset(unit + got, 0, kStripeUnit - got);
+                    }
+                }
+                rs.encode(batch.data(k), batch.parity(k), length);
+
+                uint64_t offset = kHeaderSize + first * kStripeUnit;
+                forEachShard(n, [&](size_t i) { writeAt(shards[i].fd(), batch.shard(i), length, offset); });
+            }
+            forEachShard(n, [&](size_t i) {
+                if (fdatasync(shards[i].fd()) == -1) {
+                    throw std::system_error(errno, std::system_category(), "Failed to sync " + shardPaths[i]);
+                }
+            });
+        } catch (...) {
+            for (const auto& path : shardPaths) {
+                ::unlink(path.c_str());
+            }
+            throw;
+        }
+        return header.size;
+    }
+
+    // The shards of @p relative found on @p roots; nullopt if none is found.
+    // Shards that disagree with the lowest-numbered readable one are left out.
+    static std::optional<Shards> locate(const std::vector<std::string>& roots, const std::string& relative) {
+        auto candidates = list(roots, relative);
+        std::sort(candidates.begin(), candidates.end());
+        std::optional<Shards> found;
+        for (const auto& [index, path] : candidates) {
+            auto header = readHeader(path);
+            if (!header || header->index != index) {
+                continue;
+            }
+            if (!found) {
+                size_t total = static_cast<size_t>(header->dataShards) + header->parityShards;
+                if (index >= total) {
+                    continue;
+                }
+                found.emplace();
+                found->header = *header;
+                found->paths.resize(total);
+            } else if (index >= found->paths.size() || !header->sameFile(found->header) ||
+                       !found->paths[index].empty()) {
+                continue;
+            }
+            found->paths[index] = path;
+        }
+        return found;
+    }
+
+    // Stream the file held by @p shards to @p sink in order.  Missing data
+    // units are rebuilt from parity over up to @p threads threads; a shard
+    // that fails to read is dropped and the batch read again.  Returns the
+    // shards that were missing or dropped.  Throws std::runtime_error with
+    // fewer than k usable shards.
+    static size_t decode(const Shards& shards, const std::function<void(const uint8_t*, size_t)>& sink,
+                         size_t threads = std::thread::hardware_concurrency()) {
+        const size_t k = shards.header.dataShards;
+        uint64_t remaining = shards.header.size;
+        return readBatches(shards, threads, true, [&](const Batch& batch, size_t count) {
+            for (size_t s = 0; s < count && remaining > 0; ++s) {
+                for (size_t j = 0; j < k && remaining > 0; ++j) {
+                    size_t bytes = static_cast<size_t>(std::min<uint64_t>(kStripeUnit, remaining));
+                    sink(batch.shard(j) + s * kStripeUnit, bytes);
+                    remaining -= bytes;
+                }
+            }
+        });
+    }
+
+    // Decode @p shards into @p destPath with the file's mode and mtime,
+    // synced.  Returns the shards that had to be rebuilt around.
+    static size_t restore(const Shards& shards, const std::string& destPath,
+                          size_t threads = std::thread::hardware_concurrency()) {
+        sys::FileDescriptor dest(destPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, shards.header.mode);
+        size_t degraded = decode(shards, [&](const uint8_t* data, size_t length) {
+            const char* p = reinterpret_cast<const char*>(data);
+            while (length > 0) {
+                ssize_t written = ::write(dest.fd(), p, length);
+                if (written == -1) {
+                    if (errno == EINTR) continue;
+                    throw std::system_error(errno, std::system_category(), "Failed to write " + destPath);
+                }
+                p += written;
+                length -= static_cast<size_t>(written);
+            }
+        }, threads);
+        struct timespec times[2];
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_sec = static_cast<time_t>(shards.header.mtimeNs / 1000000000);
+        times[1].tv_nsec = static_cast<long>(shards.header.mtimeNs % 1000000000);
+        if (fchmod(dest.fd(), shards.header.mode) == -1 || futimens(dest.fd(), times) == -1 ||
+            fdatasync(dest.fd()) == -1) {
+            throw std::system_error(errno, std::system_category(), "Failed to finish " + destPath);
+        }
+        return degraded;
+    }
+
+    // Write shard @p index of the file held by @p shards to @p destPath,
+    // rebuilt from the other shards and synced, in place of whatever is
+    // there; parent directories are created.  Returns the other shards that
+    // were missing or dropped.  Throws std::runtime_error with fewer than k
+    // usable shards and std::system_error if the shard cannot be written.
+    static size_t rebuild(const Shards& shards, size_t index, const std::string& destPath,
+                          size_t threads = std::thread::hardware_concurrency()) {
+        if (index >= shards.paths.size()) {
+            throw std::invalid_argument("erasure rebuild: no shard " + std::to_string(index));
+        }
+        // The shard being replaced is never read back
+        Shards others = shards;
+        others.paths[index].clear();
+
+        std::filesystem::create_directories(std::filesystem::path(destPath).parent_path());
+        const std::string tmp = destPath + ".rebuild";
+        size_t degraded;
+        try {
+            sys::FileDescriptor dest(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            Header header = shards.header;
+            header.index = static_cast<uint8_t>(index);
+            char block[kHeaderSize] = {};
+            std::memcpy(block, &header, sizeof(header));
+            writeAt(dest.fd(), block, kHeaderSize, 0);
+
+            uint64_t offset = kHeaderSize;
+            degraded = readBatches(others, threads, index < shards.header.dataShards,
+                                   [&](const Batch& batch, size_t count) {
+                                       size_t length = count * kStripeUnit;
+                                       writeAt(dest.fd(), batch.shard(index), length, offset);
+                                       offset += length;
+                                   });
+            if (fdatasync(dest.fd()) == -1) {
+                throw std::system_error(errno, std::system_category(), "Failed to sync " + tmp);
+            }
+            std::filesystem::rename(tmp, destPath);
+        } catch (...) {
+            ::unlink(tmp.c_str());
+            throw;
+        }
+        // The replaced shard is counted as unusable
+        return degraded - 1;
+    }
+
+    // True if the data shards decode to exactly @p originalPath's content and
+    // every parity shard matches the code recomputed from them
+    static bool verify(const Shards& shards, const std::string& originalPath) {
+        const Header& header = shards.header;
+        ReedSolomon rs(header.dataShards, header.parityShards);
+        const size_t k = rs.dataShards();
+        const size_t n = rs.totalShards();
+        if (shards.present() != n) {
+            return false;
+        }
+        try {
+            sys::FileDescriptor original(originalPath, O_RDONLY | O_CLOEXEC);
+            std::vector<sys::FileDescriptor> files;
+            for (const auto& path : shards.paths) {
+                files.emplace_back(path, O_RDONLY | O_CLOEXEC);
+            }
+            Batch batch(n);
+            std::vector<uint8_t> expected(k * kStripeUnit), parity(rs.parityShards() * kBatchStripes * kStripeUnit);
+            const uint64_t stripes = stripeCount(header);
+            for (uint64_t first = 0; first < stripes; first += kBatchStripes) {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(kBatchStripes, stripes - first));
+                size_t length = count * kStripeUnit;
+                std::vector<char> failed(n, 0);
+                forEachShard(n, [&](size_t i) {
+                    failed[i] = !readAt(files[i].fd(), batch.shard(i), length, kHeaderSize + first * kStripeUnit);
+                });
+                if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+                    return false;
+                }
+                for (size_t s = 0; s < count; ++s) {
+                    size_t got = readFull(original.fd(), expected.data(), expected.size(), originalPath);
+                    std::memset(expected.data() + got, 0, expected.size() - got);
+                    for (size_t j = 0; j < k; ++j) {
+                        if (std::memcmp(batch.shard(j) + s * kStripeUnit, expected.data() + j * kStripeUnit,
+                                        kStripeUnit) != 0) {
+                            return false;
+                        }
+                    }
+                }
+                std::vector<uint8_t*> parityOut;
+                for (size_t i = 0; i < rs.parityShards(); ++i) {
+                    parityOut.push_back(parity.data() + i * length);
+                }
+                rs.encode(batch.data(k), parityOut, length);
+                for (size_t i = 0; i < rs.parityShards(); ++i) {
+                    if (std::memcmp(parityOut[i], batch.shard(k + i), length) != 0) {
+                        return false;
+                    }
+                }
+            }
+            char extra;
+            return ::read(original.fd(), &extra, 1) == 0;
+        } catch (const std::system_error&) {
+            return false;
+        }
+    }
+
+    // Remove every shard of @p relative from @p roots; returns how many went
+    static size_t remove(const std::vector<std::string>& roots, const std::string& relative) {
+        size_t removed = 0;
+        for (const auto& [index, path] : list(roots, relative)) {
+            std::error_code ec;
+            removed += std::filesystem::remove(path, ec) ? 1 : 0;
+        }
+        return removed;
+    }
+
+    static std::optional<Header> readHeader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return std::nullopt;
+        }
+        Header header{};
+        ssize_t n = ::pread(fd, &header, sizeof(header), 0);
+        ::close(fd);
+        if (n != static_cast<ssize_t>(sizeof(header)) || std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0 ||
+            header.dataShards == 0 || header.parityShards == 0 || header.stripeUnit != kStripeUnit) {
+            return std::nullopt;
+        }
+        return header;
+    }
+
+private:
+    static constexpr char kMagic[8] = {'C', 'A', 'S', 'R', 'S', 'E', 'C', '1'};
+
+    // One batch of every shard, contiguous per shard
+    class Batch {
+    public:
+        explicit Batch(size_t shards) : m_buffer(new uint8_t[shards * kBatchStripes * kStripeUnit]), m_shards(shards) {}
+
+        uint8_t* shard(size_t i) const { return m_buffer.get() + i * kBatchStripes * kStripeUnit; }
+
+        std::vector<uint8_t*> all() const {
+            std::vector<uint8_t*> shards;
+            for (size_t i = 0; i < m_shards; ++i) {
+                shards.push_back(shard(i));
+            }
+            return shards;
+        }
+        std::vector<const uint8_t*> data(size_t k) const {
+            std::vector<const uint8_t*> shards;
+            for (size_t i = 0; i < k; ++i) {
+                shards.push_back(shard(i));
+            }
+            return shards;
+        }
+        std::vector<uint8_t*> parity(size_t k) const {
+            std::vector<uint8_t*> shards;
+            for (size_t i = k; i < m_shards; ++i) {
+                shards.push_back(shard(i));
+            }
+            return shards;
+        }
+
+    private:
+        std::unique_ptr<uint8_t[]> m_buffer;
+        size_t m_shards;
+    };
+
+    // Read @p shards a batch of stripes at a time from the first k usable
+    // ones, data before parity, and rebuild the data units not read (and the
+    // parity units too unless @p dataOnly) over up to @p threads threads; a
+    // shard that fails to read is dropped and the batch read again.
+    // @p onBatch gets each batch and its stripe count.  Returns the shards
+    // that were missing or dropped.
+    static size_t readBatches(const Shards& shards, size_t threads, bool dataOnly,
+                              const std::function<void(const Batch& batch, size_t count)>& onBatch) {
+        const Header& header = shards.header;
+        ReedSolomon rs(header.dataShards, header.parityShards);
+        const size_t k = rs.dataShards();
+        const size_t n = rs.totalShards();
+
+        std::vector<std::optional<sys::FileDescriptor>> files(n);
+        std::vector<bool> usable(n, false);
+        const uint64_t stripes = stripeCount(header);
+        const uint64_t expectedSize = kHeaderSize + stripes * kStripeUnit;
+        for (size_t i = 0; i < n; ++i) {
+            if (shards.paths[i].empty()) {
+                continue;
+            }
+            try {
+                files[i].emplace(shards.paths[i], O_RDONLY | O_CLOEXEC);
+                struct stat st{};
+                usable[i] = fstat(files[i]->fd(), &st) == 0 && static_cast<uint64_t>(st.st_size) == expectedSize;
+                posix_fadvise(files[i]->fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+            } catch (const std::system_error&) {
+                files[i].reset();
+            }
+        }
+
+        Batch batch(n);
+        for (uint64_t first = 0; first < stripes; first += kBatchStripes) {
+            size_t count = static_cast<size_t>(std::min<uint64_t>(kBatchStripes, stripes - first));
+            size_t length = count * kStripeUnit;
+            uint64_t offset = kHeaderSize + first * kStripeUnit;
+
+            // The first k usable shards, data before parity
+            std::vector<bool> read(n, false);
+            for (;;) {
+                std::fill(read.begin(), read.end(), false);
+                size_t chosen = 0;
+                for (size_t i = 0; i < n && chosen < k; ++i) {
+                    if (usable[i]) {
+                        read[i] = true;
+                        chosen++;
+                    }
+                }
+                if (chosen < k) {
+                    throw std::runtime_error("erasure decode: " + std::to_string(chosen) + " of " +
+                                             std::to_string(n) + " shards readable, need " + std::to_string(k));
+                }
+                std::vector<char> failed(n, 0);
+                forEachShard(n, [&](size_t i) {
+                    if (read[i] && !readAt(files[i]->fd(), batch.shard(i), length, offset)) {
+                        failed[i] = 1;
+                    }
+                });
+                if (std::find(failed.begin(), failed.end(), 1) == failed.end()) {
+                    break;
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    if (failed[i]) {
+                        usable[i] = false;
+                    }
+                }
+            }
+            auto wanted = read.begin() + static_cast<std::ptrdiff_t>(dataOnly ? k : n);
+            if (!std::all_of(read.begin(), wanted, [](bool r) { return r; })) {
+                rs.reconstruct(batch.all(), read, length, std::max<size_t>(1, threads), dataOnly);
+            }
+            onBatch(batch, count);
+        }
+        return static_cast<size_t>(std::count(usable.begin(), usable.end(), false));
+    }
+
+    // Every "<name>.rs<N>" beside where @p relative's shards go, with its N
+    static std::vector<std::pair<size_t, std::string>> list(const std::vector<std::string>& roots,
+                                                            const std::string& relative) {
+        std::vector<std::pair<size_t, std::string>> shards;
+        const std::string prefix = std::filesystem::path(relative).filename().string() + ".rs";
+        for (const auto& root : roots) {
+            std::filesystem::path dir = std::filesystem::path(shardPath(root, relative, 0)).parent_path();
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+                std::string name = it->path().filename().string();
+                if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                std::string digits = name.substr(prefix.size());
+                if (digits.size() > 3 || !std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                    continue;
+                }
+                shards.emplace_back(std::stoul(digits), it->path().string());
+            }
+        }
+        return shards;
+    }
+
+    static uint64_t stripeCount(const Header& header) {
+        uint64_t stripeBytes = static_cast<uint64_t>(header.dataShards) * header.stripeUnit;
+        return (header.size + stripeBytes - 1) / stripeBytes;
+    }
+
+    // Run @p work for every shard, one thread each; rethrows the first error
+    static void forEachShard(size_t n, const std::function<void(size_t)>& work) {
+        std::vector<std::exception_ptr> errors(n);
+        std::vector<std::thread> threads;
+        threads.reserve(n);
+        for (size_t i = 1; i < n; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    work(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        try {
+            work(0);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // Bytes read, fewer than @p length only at end of file
+    static size_t readFull(int fd, uint8_t* data, size_t length, const std::string& path) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = ::read(fd, data + done, length - done);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "Failed to read " + path);
+            }
+            if (n == 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+
+    // False on an error or a short read
+    static bool readAt(int fd, uint8_t* data, size_t length, uint64_t offset) {
+        while (length > 0) {
+            ssize_t n = ::pread(fd, data, length, static_cast<off_t>(offset));
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    static void writeAt(int fd, const void* data, size_t length, uint64_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t n = ::pwrite(fd, p, length, static_cast<off_t>(offset));
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "write failed");
+            }
+            p += n;
+            length -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+    }
+};
+
+static_assert(sizeof(ErasureStore::Header) == 40, "shard header layout");
+
+#endif // ERASURE_STORE_HPP
@@ -0,0 +1,270 @@
+//
+// Persistent index of which array member holds each file.
+//
+
+#ifndef FILE_INDEX_HPP
+#define FILE_INDEX_HPP
+
+#include "profiled_mutex.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <json/json.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Relative path (as placed, with a leading '/') -> array member root and
+// size, for files placed by the array members rather than a policy
+// destination.  Kept as a JSON-lines journal beside the transaction log: one
+// line per change, replayed at open and compacted once superseded lines
+// outnumber live ones.  A torn last line is ignored.  The rebalancer reads
+// the index instead of walking the members' trees.  A file kept as
+// erasure-coded shards has no root; the members its shards were written to
+// are kept instead, since encoded files stay put when members change.
+class FileIndex {
+public:
+    struct Entry {
+        std::string root; // empty for erasure-coded files
+        uint64_t size = 0;
+        bool erasure = false;
+        // Erasure-coded files: member holding shard i; empty for files
+        // encoded before shard roots were recorded
+        std::vector<std::string> shardRoots;
+    };
+
+    explicit FileIndex(std::string path) : m_path(std::move(path)) {}
+
+    // Replay the journal and open it for appending
+    bool open() {
+        std::lock_guard lock(m_mutex);
+        if (m_stream.is_open()) {
+            return true;
+        }
+        replay();
+        if (m_lines > 2 * m_files.size() + kCompactSlack) {
+            compact();
+        }
+        bool tornTail = endsMidLine();
+        m_stream.open(m_path, std::ios::app);
+        if (tornTail) {
+            // Keep the next line apart from the torn one
+            m_stream << '\n';
+        }
+        return static_cast<bool>(m_stream);
+    }
+
+    // Record @p relative on @p root.  Returns the root it was on before, if
+    // that was another member: the copy there is now stale.
+    std::optional<std::string> put(const std::string& relative, const std::string& root, uint64_t size) {
+        return store(relative, root, size, false);
+    }
+
+    // Record @p relative as erasure-coded shards, shard i on @p shardRoots[i];
+    // returns the root its whole copy was on, as put() does
+    std::optional<std::string> putErasure(const std::string& relative, uint64_t size,
+                                          const std::vector<std::string>& shardRoots = {}) {
+        return store(relative, "", size, true, shardRoots);
+    }
+
+    void remove(const std::string& relative) {
+        std::lock_guard lock(m_mutex);
+        if (m_files.erase(relative) == 0) {
+            return;
+        }
+        Json::Value line;
+        line["path"] = relative;
+        line["removed"] = true;
+        append(line);
+    }
+
+    std::optional<Entry> find(const std::string& relative) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_files.find(relative);
+        if (it == m_files.end()) {
+            return std::nullopt;
+        }
+        return toEntry(it->second);
+    }
+
+    // Visit every file; @p visit must not call back into the index
+    void forEach(const std::function<void(const std::string& relative, const Entry& entry)>& visit) const {
+        std::lock_guard lock(m_mutex);
+        for (const auto& [relative, stored] : m_files) {
+            visit(relative, toEntry(stored));
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard lock(m_mutex);
+        return m_files.size();
+    }
+
+private:
+    // Superseded lines tolerated on top of one per live file before compacting
+    static constexpr size_t kCompactSlack = 1024;
+
+    // Roots are few; files hold an index into m_roots
+    struct Stored {
+        uint16_t rootId;
+        uint64_t size;
+        bool erasure;
+        std::vector<uint16_t> shardRootIds;
+    };
+
+    std::string m_path;
+    mutable ProfiledMutex m_mutex{"file_index"};
+    std::unordered_map<std::string, Stored> m_files;
+    std::vector<std::string> m_roots;
+    std::ofstream m_stream;
+    size_t m_lines = 0; // journal lines since the last compaction
+
+    uint16_t intern(const std::string& root) {
+        for (size_t i = 0; i < m_roots.size(); ++i) {
+            if (m_roots[i] == root) {
+                return static_cast<uint16_t>(i);
+            }
+        }
+        if (m_roots.size() == UINT16_MAX) {
+            throw std::runtime_error("file index: too many array roots");
+        }
+        m_roots.push_back(root);
+        return static_cast<uint16_t>(m_roots.size() - 1);
+    }
+
+    std::optional<std::string> store(const std::string& relative, const std::string& root, uint64_t size,
+                                     bool erasure, const std::vector<std::string>& shardRoots = {}) {
+        std::lock_guard lock(m_mutex);
+        Stored stored{intern(root), size, erasure, {}};
+        for (const auto& shardRoot : shardRoots) {
+            stored.shardRootIds.push_back(intern(shardRoot));
+        }
+        std::optional<std::string> previous;
+        auto [it, inserted] = m_files.try_emplace(relative, stored);
+        if (!inserted) {
+            const Stored& old = it->second;
+            if (old.rootId == stored.rootId && old.size == size && old.erasure == erasure &&
+                old.shardRootIds == stored.shardRootIds) {
+                return std::nullopt;
+            }
+            if (old.rootId != stored.rootId && !old.erasure) {
+                previous = m_roots[old.rootId];
+            }
+            it->second = std::move(stored);
+        }
+        append(toJson(relative, it->second));
+        return previous;
+    }
+
+    // Caller holds m_mutex
+    Entry toEntry(const Stored& stored) const {
+        Entry entry{m_roots[stored.rootId], stored.size, stored.erasure, {}};
+        for (uint16_t id : stored.shardRootIds) {
+            entry.shardRoots.push_back(m_roots[id]);
+        }
+        return entry;
+    }
+
+    // Caller holds m_mutex
+    Json::Value toJson(const std::string& relative, const Stored& stored) const {
+        Json::Value line;
+        line["path"] = relative;
+        if (stored.erasure) {
+            line["erasure"] = true;
+            if (!stored.shardRootIds.empty()) {
+                Json::Value& shards = line["shards"];
+                for (uint16_t id : stored.shardRootIds) {
+                    shards.append(m_roots[id]);
+                }
+            }
+        } else {
+            line["root"] = m_roots[stored.rootId];
+        }
+        line["size"] = Json::UInt64(stored.size);
+        return line;
+    }
+
+    static std::string serialize(const Json::Value& line) {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return Json::writeString(builder, line) + "\n";
+    }
+
+    // Caller holds m_mutex
+    void append(const Json::Value& line) {
+        m_stream << serialize(line);
+        m_stream.flush();
+        if (++m_lines > 2 * m_files.size() + kCompactSlack) {
+            m_stream.close();
+            compact();
+            m_stream.open(m_path, std::ios::app);
+        }
+    }
+
+    bool endsMidLine() const {
+        std::ifstream in(m_path, std::ios::binary | std::ios::ate);
+        if (!in || in.tellg() <= 0) {
+            return false;
+        }
+        in.seekg(-1, std::ios::end);
+        return in.get() != '\n';
+    }
+
+    // Caller holds m_mutex
+    void replay() {
+        std::ifstream in(m_path);
+        std::string text;
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        Json::Value line;
+        JSONCPP_STRING errs;
+        while (std::getline(in, text)) {
+            if (text.empty() || !reader->parse(text.data(), text.data() + text.size(), &line, &errs)) {
+                continue;
+            }
+            m_lines++;
+            std::string relative = line["path"].asString();
+            if (line["removed"].asBool()) {
+                m_files.erase(relative);
+            } else {
+                bool erasure = line["erasure"].asBool();
+                Stored stored{intern(erasure ? "" : line["root"].asString()), line["size"].asUInt64(), erasure, {}};
+                for (const auto& shardRoot : line["shards"]) {
+                    stored.shardRootIds.push_back(intern(shardRoot.asString()));
+                }
+                m_files[relative] = std::move(stored);
+            }
+        }
+    }
+
+    // Rewrite the journal with one line per live file, atomically; caller
+    // holds m_mutex and has closed m_stream.  On failure the journal is kept
+    // and compaction is retried after another round of lines.
+    void compact() {
+        std::string tmp = m_path + ".compact";
+        bool written;
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            for (const auto& [relative, stored] : m_files) {
+                out << serialize(toJson(relative, stored));
+            }
+            written = static_cast<bool>(out.flush());
+        }
+        std::error_code ec;
+        if (written) {
+            std::filesystem::rename(tmp, m_path, ec);
+        }
+        if (!written || ec) {
+            std::filesystem::remove(tmp, ec);
+        }
+        m_lines = m_files.size();
+    }
+};
+
+#endif // FILE_INDEX_HPP
@@ -0,0 +1,149 @@
+// file_sync-top: live, top-like view of a running file_sync daemon.
+// Maps the daemon's shared-memory stats segment read-only, so watching it
+// adds no work (and no IPC) on the daemon side.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <string>
+
+#include "live_stats.hpp"
+
+namespace {
+
+std::atomic<bool> running(true);
+
+const char* kPriorityNames[LiveStatsSnapshot::kPriorities] = {
+    "CRITICAL", "HIGH", "NORMAL", "LOW", "BACKGROUND"
+};
+
+const char* deviceStateName(uint32_t state) {
+    switch (state) {
+        case LiveStatsSnapshot::DEVICE_ONLINE: return "online";
+        case LiveStatsSnapshot::DEVICE_MISSING: return "missing";
+        case LiveStatsSnapshot::DEVICE_DEGRADED: return "degraded";
+        default: return "unknown";
+    }
+}
+
+std::string humanBytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return ss.str();
+}
+
+// Upper bound of a latency bucket, e.g. "512us" or "16ms"
+std::string bucketLabel(size_t bucket) {
+    uint64_t us = uint64_t{1} << (bucket + 1);
+    if (us >= 1000000) return std::to_string(us / 1000000) + "s";
+    if (us >= 1000) return std::to_string(us / 1000) + "ms";
+    return std::to_string(us) + "us";
+}
+
+void render(const LiveStatsSnapshot& stats) {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    double age = std::chrono::duration<double>(now - std::chrono::nanoseconds(stats.publishedAtNs)).count();
+
+    std::ostringstream out;
+    out << "\033[H\033[2J";
+    out << "file_sync pid " << stats.pid << "  workers " << stats.workers
+        << "  updated " << std::fixed << std::setprecision(1) << age << "s ago"
+        << (age > 5.0 ? "  (stale)" : "") << "\n\n";
+
+    out << "Queue     " << stats.pending << " pending, " << humanBytes(static_cast<double>(stats.bytesPending))
+        << "  drain " << std::setprecision(1) << stats.drainTasksPerSecond << " tasks/s "
+        << humanBytes(stats.drainBytesPerSecond) << "/s  ETA "
+        << (stats.etaSeconds < 0 ? std::string("unknown") : std::to_string(stats.etaSeconds) + "s") << "\n";
+    for (size_t i = 0; i < LiveStatsSnapshot::kPriorities; ++i) {
+        out << "  " << std::left << std::setw(11) << kPriorityNames[i] << std::right
+            << std::setw(8) << stats.pendingByPriority[i]
+            << "  oldest " << std::setprecision(1) << stats.oldestAgeMs[i] / 1000.0 << "s\n";
+    }
+
+    out << "\nTasks     completed " << stats.tasksCompleted << "  failed " << stats.tasksFailed
+        << "  retried " << stats.tasksRetried << "  in-flight " << stats.inFlight
+        << " (oldest " << stats.oldestInFlightMs / 1000.0 << "s)\n";
+
+    out << "\nDevices\n";
+    for (uint32_t i = 0; i < stats.deviceCount && i < LiveStatsSnapshot::kMaxDevices; ++i) {
+        const auto& device = stats.devices[i];
+        out << "  " << std::left << std::setw(40) << std::string(device.path, strnlen(device.path, sizeof(device.path)))
+            << std::setw(10) << deviceStateName(device.state) << std::right;
+        if (device.capacityBytes > 0) {
+            out << humanBytes(static_cast<double>(device.freeBytes)) << " free of "
+                << humanBytes(static_cast<double>(device.capacityBytes));
+        }
+        out << "\n";
+    }
+
+    uint64_t peak = 0;
+    size_t last = 0;
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+        peak = std::max(peak, stats.latencyBuckets[i]);
+        if (stats.latencyBuckets[i] > 0) last = i;
+    }
+    out << "\nTask latency\n";
+    for (size_t i = 0; peak > 0 && i <= last; ++i) {
+        auto width = static_cast<int>(40 * stats.latencyBuckets[i] / peak);
+        out << "  <" << std::left << std::setw(7) << bucketLabel(i) << std::right
+            << std::setw(10) << stats.latencyBuckets[i] << " " << std::string(width, '#') << "\n";
+    }
+
+    std::cout << out.str() << std::flush;
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [-p segment_path] [-i interval_ms] [-n iterations]" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = kDefaultLiveStatsPath;
+    int intervalMs = 1000;
+    long iterations = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (arg == "-i" && i + 1 < argc) {
+            intervalMs = std::max(100, std::atoi(argv[++i]));
+        } else if (arg == "-n" && i + 1 < argc) {
+            iterations = std::atol(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::signal(SIGINT, [](int) { running = false; });
+    std::signal(SIGTERM, [](int) { running = false; });
+
+    try {
+        LiveStatsReader reader(path);
+        for (long n = 0; running && (iterations < 0 || n < iterations); ++n) {
+            if (auto stats = reader.read()) {
+                render(*stats);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "file_sync-top: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -4,9 +4,12 @@
 #include "file_system_monitor.hpp"
 
 #include <iostream>
+#include <vector>
 #include <linux/limits.h>
 #include <sys/inotify.h>
+#include <unistd.h>
 
+#include "sys/probes.hpp"
 #include "thread_pool.hpp"
 
 //// from Inotify API documentation
@@ -30,12 +33,25 @@
        create watches and cache entries for the objects to be monitored.)
 */
 ////
-FileSystemMonitor::FileSystemMonitor() : m_inotifyFd(inotify_init()) {
+FileSystemMonitor::FileSystemMonitor() : m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
     // constructor
 }
 
+FileSystemMonitor::~FileSystemMonitor() {
+    if (m_inotifyFd >= 0) {
+        close(m_inotifyFd);
+    }
+}
+
 void FileSystemMonitor::removeWatch(const std::string& path) {
-    std::cout << path << std::endl;
+    std::lock_guard lock(m_queue_mutex);
+    for (auto it = m_watch_descriptors.begin(); it != m_watch_descriptors.end(); ++it) {
+        if (it->second == path) {
+            inotify_rm_watch(m_inotifyFd, it->first);
+            m_watch_descriptors.erase(it);
+            return;
+        }
+    }
 }
 
 
@@ -48,25 +64,88 @@ void FileSystemMonitor::setCallback(std::function<void(const std::string&)> cb)
 
 void FileSystemMonitor::addWatch(const std::string& path) {
     const char *filename = path.c_str();
+    const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE;
 
-    if (int watch_desc = inotify_add_watch(m_inotifyFd, filename, IN_MODIFY); watch_desc == -1) {
+    int watch_desc = inotify_add_watch(m_inotifyFd, filename, mask);
+    if (watch_desc == -1) {
         perror("inotify_add_watch");
         exit(EXIT_FAILURE);
     }
 
-    size_t bufsiz = sizeof(struct inotify_event) + PATH_MAX + 1;
-    struct inotify_event* event = (inotify_event*)malloc(bufsiz);
-
-    /* wait for an event to occur */
-    read(m_inotifyFd, event, bufsiz);
-
-    /* process event struct here */
+    std::lock_guard lock(m_queue_mutex);
+    m_watch_descriptors[watch_desc] = path;
 }
 
 std::optional<FileSystemMonitor::FSEvent> FileSystemMonitor::getNextEvent() {
-    return std::nullopt;
+    readEvents();
+
+    std::lock_guard lock(m_queue_mutex);
+    if (m_event_queue.empty()) {
+        return std::nullopt;
+    }
+    FSEvent event = m_event_queue.front();
+    m_event_queue.pop();
+    return event;
 }
 
 bool FileSystemMonitor::empty() {
+    readEvents();
+
+    std::lock_guard lock(m_queue_mutex);
     return m_event_queue.empty();
-}
\ No newline at end of file
+}
+
+static const char* actionName(uint32_t mask) {
+    if (mask & IN_CLOSE_WRITE) return "CLOSE_WRITE";
+    if (mask & IN_MOVED_TO) return "MOVED_TO";
+    if (mask & IN_CREATE) return "CREATE";
+    if (mask & IN_DELETE) return "DELETE";
+    return "MODIFY";
+}
+
+void FileSystemMonitor::readEvents() {
+    alignas(struct inotify_event) char buffer[sizeof(struct inotify_event) + PATH_MAX + 1];
+    std::vector<std::string> received;
+
+    while (true) {
+        ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; // EAGAIN: nothing pending
+        }
+
+        std::lock_guard lock(m_queue_mutex);
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            // The kernel queue hit max_queued_events; everything after was dropped
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            auto watch = m_watch_descriptors.find(event->wd);
+            if (watch == m_watch_descriptors.end()) {
+                continue;
+            }
+
+            FSEvent fsEvent;
+            fsEvent.path = event->len > 0 ? watch->second + "/" + event->name : watch->second;
+            fsEvent.action = actionName(event->mask);
+            fsEvent.timestamp = std::chrono::system_clock::now();
+            fsEvent.mask = static_cast<int>(event->mask);
+
+            SYNC_PROBE(event_received, fsEvent.path.c_str(), event->mask);
+
+            received.push_back(fsEvent.path);
+            m_event_queue.push(std::move(fsEvent));
+        }
+    }
+
+    // Callbacks run without the queue lock so they may call back into the monitor
+    if (m_callback) {
+        for (const auto& path : received) {
+            m_callback(path);
+        }
+    }
+}
@@ -5,21 +5,27 @@
 #ifndef FILE_VERIFICATION_HPP
 #define FILE_VERIFICATION_HPP
 
+#include <algorithm>
 #include <string>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <vector>
 #include <functional>
-#include <openssl/md5.h>
-#include <openssl/sha.h>
+#include <memory>
+#include <openssl/evp.h>
 #include <thread>
 #include <future>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <atomic>
 #include <iomanip>
 #include <sstream>
+#include <sys/stat.h>
+
+#include "cuckoo_filter.hpp"
 
 namespace fs = std::filesystem;
 
@@ -35,7 +41,14 @@ public:
         FULL_COMPARE     // Byte-by-byte comparison for absolute certainty
     };
 
-#endif // FILE_VERIFICATION_HPP
+    // Method named by the VERIFY_METHOD config key; FAST_HASH if unrecognised
+    static VerifyMethod methodFromString(const std::string& name) {
+        if (name == "SIZE_ONLY") return VerifyMethod::SIZE_ONLY;
+        if (name == "TIMESTAMP") return VerifyMethod::TIMESTAMP;
+        if (name == "SECURE_HASH") return VerifyMethod::SECURE_HASH;
+        if (name == "FULL_COMPARE") return VerifyMethod::FULL_COMPARE;
+        return VerifyMethod::FAST_HASH;
+    }
 
     // Result of verification
     struct VerifyResult {
@@ -46,12 +59,23 @@ public:
         std::chrono::milliseconds duration;
     };
 
+    // Default read size for hashing and comparison
+    static constexpr size_t kDefaultReadSize = 64 * 1024;
+
+    // Called with the length of each chunk read from the destination
+    using Throttle = std::function<void(uint64_t bytes)>;
+
     FileVerification() = default;
 
-    // Verify a single file pair
+    // Read size used by verifyFile(); set from the source device's I/O profile
+    void setReadSize(size_t bytes) { m_readSize = std::max<size_t>(bytes, 4096); }
+    size_t getReadSize() const { return m_readSize; }
+
+    // Verify a single file pair; @p throttle paces the destination reads
     VerifyResult verifyFile(const std::string& sourcePath,
                           const std::string& destPath,
-                          VerifyMethod method = VerifyMethod::FAST_HASH) {
+                          VerifyMethod method = VerifyMethod::FAST_HASH,
+                          const Throttle& throttle = {}) {
         auto startTime = std::chrono::high_resolution_clock::now();
         VerifyResult result;
         result.matches = false;
@@ -103,8 +127,8 @@ public:
         // For hash and full comparison methods, we need to read the files
         switch (method) {
             case VerifyMethod::FAST_HASH:
-                result.sourceHash = calculateMD5(sourcePath);
-                result.destHash = calculateMD5(destPath);
+                result.sourceHash = calculateMD5(sourcePath, m_readSize);
+                result.destHash = calculateDigest(destPath, EVP_md5(), m_readSize, throttle);
                 result.matches = (result.sourceHash == result.destHash);
                 if (!result.matches) {
                     result.errorMessage = "MD5 checksums don't match";
@@ -112,33 +136,48 @@ public:
                 break;
 
             case VerifyMethod::SECURE_HASH:
-                result.sourceHash = calculateSHA256(sourcePath);
-                result.destHash = calculateSHA256(destPath);
+                result.sourceHash = calculateSHA256(sourcePath, m_readSize);
+                result.destHash = calculateDigest(destPath, EVP_sha256(), m_readSize, throttle);
                 result.matches = (result.sourceHash == result.destHash);
                 if (!result.matches) {
                     result.errorMessage = "SHA-256 checksums don't match";
                 }
                 break;
 
-            case VerifyMethod::FULL_COMPARE:
-                bool equalContent = compareFileContent(sourcePath, destPath);
+            case VerifyMethod::FULL_COMPARE: {
+                bool equalContent = compareFileContent(sourcePath, destPath, m_readSize, throttle);
                 result.matches = equalContent;
                 if (!equalContent) {
                     result.errorMessage = "File contents don't match";
                 }
                 break;
+            }
+
+            case VerifyMethod::SIZE_ONLY:
+            case VerifyMethod::TIMESTAMP:
+                break; // handled above
         }
 
         return finishResult(result, startTime);
     }
 
-    // Verify a directory pair recursively
+    // Verify a directory pair recursively.  Each source file is compared
+    // with the copy below the root @p rootFor gives for its relative path
+    // (@p destDir if unset, or for an empty answer).  With @p inSync, a file
+    // whose root, relative path, size and mtime are in the filter is taken to
+    // be at the destination without a stat there, and with SIZE_ONLY or
+    // TIMESTAMP to match it outright; only misses and the hash methods touch
+    // the destination.  The filter is then rebuilt from the files found in
+    // sync, which drops files removed or rewritten since.  Extra files are
+    // those under @p destDir with no source file at the same relative path.
     std::vector<std::pair<std::string, VerifyResult>> verifyDirectory(
         const std::string& sourceDir,
         const std::string& destDir,
         VerifyMethod method = VerifyMethod::FAST_HASH,
         bool parallel = true,
-        int maxThreads = 4) {
+        int maxThreads = 4,
+        CuckooFilter* inSync = nullptr,
+        const std::function<std::string(const std::string&)>& rootFor = {}) {
 
         std::vector<std::pair<std::string, VerifyResult>> results;
         std::mutex resultsMutex;
@@ -159,18 +198,43 @@ public:
             return results;
         }
 
-        // Collect all files to verify
+        // Collect all files to verify, with their filter keys.  The walk's
+        // file type comes from the directory entry; the source is stat'ed
+        // once for its key, and a miss costs one stat of the destination.
         std::vector<std::pair<std::string, std::string>> filePairs;
+        std::vector<uint64_t> pairKeys;
+        std::vector<uint64_t> inSyncKeys;
+        std::unordered_set<std::string> sourceFiles;
+        const bool metadataOnly = method == VerifyMethod::SIZE_ONLY || method == VerifyMethod::TIMESTAMP;
         for (const auto& entry : fs::recursive_directory_iterator(sourceDir)) {
             if (entry.is_regular_file()) {
                 std::string relPath = entry.path().string().substr(sourceDir.length());
                 if (relPath[0] == '/' || relPath[0] == '\\') {
                     relPath = relPath.substr(1);
                 }
+                sourceFiles.insert(relPath);
 
-                std::string destPath = fs::path(destDir) / relPath;
-                if (fs::exists(destPath) && fs::is_regular_file(destPath)) {
+                std::string root = rootFor ? rootFor(relPath) : std::string();
+                if (root.empty()) {
+                    root = destDir;
+                }
+                std::string destPath = fs::path(root) / relPath;
+                uint64_t key = 0;
+                struct stat st;
+                if (inSync && ::stat(entry.path().c_str(), &st) == 0) {
+                    key = CuckooFilter::key(root, relPath, static_cast<uint64_t>(st.st_size),
+                                            static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+                }
+                bool known = key != 0 && inSync->contains(key);
+                std::error_code ec;
+                if (known && metadataOnly) {
+                    VerifyResult result{};
+                    result.matches = true;
+                    results.emplace_back(relPath, result);
+                    inSyncKeys.push_back(key);
+                } else if (known || fs::is_regular_file(destPath, ec)) {
                     filePairs.emplace_back(entry.path().string(), destPath);
+                    pairKeys.push_back(key);
                 } else {
                     // Missing file in destination
                     VerifyResult result;
@@ -183,7 +247,8 @@ public:
             }
         }
 
-        // Check for extra files in destination
+        // Check for extra files in destination: a listing only, looked up
+        // in the source files just walked
         for (const auto& entry : fs::recursive_directory_iterator(destDir)) {
             if (entry.is_regular_file()) {
                 std::string relPath = entry.path().string().substr(destDir.length());
@@ -191,8 +256,7 @@ public:
                     relPath = relPath.substr(1);
                 }
 
-                std::string sourcePath = fs::path(sourceDir) / relPath;
-                if (!fs::exists(sourcePath) || !fs::is_regular_file(sourcePath)) {
+                if (!sourceFiles.count(relPath)) {
                     // Extra file in destination
                     VerifyResult result;
                     result.matches = false;
@@ -212,7 +276,8 @@ public:
 
             // Divide work among threads
             for (int i = 0; i < numThreads; ++i) {
-                futures.push_back(std::async(std::launch::async, [this, &filePairs, &results, &resultsMutex, method, i, numThreads]() {
+                futures.push_back(std::async(std::launch::async, [this, &filePairs, &pairKeys, &inSyncKeys, &results,
+                                                                  &resultsMutex, method, i, numThreads]() {
                     for (size_t j = i; j < filePairs.size(); j += numThreads) {
                         const auto& pair = filePairs[j];
 
@@ -224,6 +289,9 @@ public:
                         VerifyResult result = verifyFile(pair.first, pair.second, method);
 
                         std::lock_guard<std::mutex> lock(resultsMutex);
+                        if (result.matches && pairKeys[j] != 0) {
+                            inSyncKeys.push_back(pairKeys[j]);
+                        }
                         results.emplace_back(relPath, result);
                     }
                 }));
@@ -235,78 +303,78 @@ public:
             }
         } else {
             // Sequential verification
-            for (const auto& pair : filePairs) {
+            for (size_t j = 0; j < filePairs.size(); ++j) {
+                const auto& pair = filePairs[j];
                 std::string relPath = pair.first;
                 if (relPath.find(fs::path(pair.first).root_path().string()) == 0) {
                     relPath = relPath.substr(fs::path(pair.first).root_path().string().length());
                 }
 
                 VerifyResult result = verifyFile(pair.first, pair.second, method);
+                if (result.matches && pairKeys[j] != 0) {
+                    inSyncKeys.push_back(pairKeys[j]);
+                }
                 results.emplace_back(relPath, result);
             }
         }
 
+        if (inSync) {
+            inSync->rebuild(inSyncKeys);
+        }
         return results;
     }
 
-    // Calculate a hash for a file
-    static std::string calculateMD5(const std::string& filePath) {
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file) {
-            return "";
-        }
-
-        MD5_CTX md5Context;
-        MD5_Init(&md5Context);
-
-        char buffer[8192];
-        while (file.good()) {
-            file.read(buffer, sizeof(buffer));
-            MD5_Update(&md5Context, buffer, file.gcount());
-        }
-
-        unsigned char result[MD5_DIGEST_LENGTH];
-        MD5_Final(result, &md5Context);
-
-        std::stringstream ss;
-        ss << std::hex << std::setfill('0');
-        for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
-            ss << std::setw(2) << static_cast<int>(result[i]);
-        }
-
-        return ss.str();
+    // Calculate MD5 hash for a file
+    static std::string calculateMD5(const std::string& filePath, size_t readSize = kDefaultReadSize) {
+        return calculateDigest(filePath, EVP_md5(), readSize);
     }
 
     // Calculate SHA-256 hash for a file
-    static std::string calculateSHA256(const std::string& filePath) {
+    static std::string calculateSHA256(const std::string& filePath, size_t readSize = kDefaultReadSize) {
+        return calculateDigest(filePath, EVP_sha256(), readSize);
+    }
+
+    // Hex digest of a file; empty if it cannot be read
+    static std::string calculateDigest(const std::string& filePath, const EVP_MD* algorithm,
+                                       size_t readSize = kDefaultReadSize, const Throttle& throttle = {}) {
         std::ifstream file(filePath, std::ios::binary);
         if (!file) {
             return "";
         }
 
-        SHA256_CTX sha256Context;
-        SHA256_Init(&sha256Context);
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+        if (!context || EVP_DigestInit_ex(context.get(), algorithm, nullptr) != 1) {
+            return "";
+        }
 
-        char buffer[8192];
+        std::vector<char> buffer(readSize);
         while (file.good()) {
-            file.read(buffer, sizeof(buffer));
-            SHA256_Update(&sha256Context, buffer, file.gcount());
+            file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            EVP_DigestUpdate(context.get(), buffer.data(), static_cast<size_t>(file.gcount()));
+            if (throttle) {
+                throttle(static_cast<uint64_t>(file.gcount()));
+            }
+        }
+        if (file.bad()) {
+            return "";
         }
 
-        unsigned char result[SHA256_DIGEST_LENGTH];
-        SHA256_Final(result, &sha256Context);
+        unsigned char result[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(context.get(), result, &length);
 
         std::stringstream ss;
         ss << std::hex << std::setfill('0');
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        for (unsigned int i = 0; i < length; i++) {
             ss << std::setw(2) << static_cast<int>(result[i]);
         }
 
         return ss.str();
     }
 
-    // Compare two files byte by byte
-    static bool compareFileContent(const std::string& file1Path, const std::string& file2Path) {
+    // Compare two files byte by byte; @p throttle paces the reads of the second
+    static bool compareFileContent(const std::string& file1Path, const std::string& file2Path,
+                                   size_t readSize = kDefaultReadSize, const Throttle& throttle = {}) {
         std::ifstream file1(file1Path, std::ios::binary);
         std::ifstream file2(file2Path, std::ios::binary);
 
@@ -314,26 +382,28 @@ public:
             return false;
         }
 
-        const size_t BUFFER_SIZE = 8192;
-        char buffer1[BUFFER_SIZE];
-        char buffer2[BUFFER_SIZE];
+        std::vector<char> buffer1(readSize);
+        std::vector<char> buffer2(readSize);
 
         while (file1.good() && file2.good()) {
-            file1.read(buffer1, BUFFER_SIZE);
-            file2.read(buffer2, BUFFER_SIZE);
+            file1.read(buffer1.data(), static_cast<std::streamsize>(readSize));
+            file2.read(buffer2.data(), static_cast<std::streamsize>(readSize));
 
             size_t bytesRead1 = file1.gcount();
             size_t bytesRead2 = file2.gcount();
+            if (throttle) {
+                throttle(bytesRead2);
+            }
 
             if (bytesRead1 != bytesRead2) {
                 return false;
             }
 
-            if (memcmp(buffer1, buffer2, bytesRead1) != 0) {
+            if (memcmp(buffer1.data(), buffer2.data(), bytesRead1) != 0) {
                 return false;
             }
 
-            if (bytesRead1 < BUFFER_SIZE) {
+            if (bytesRead1 < readSize) {
                 break;
             }
         }
@@ -356,24 +426,19 @@ private:
         uintmax_t fileSize;
     };
 
+    std::atomic<size_t> m_readSize{kDefaultReadSize};
     std::unordered_map<std::string, CacheEntry> m_hashCache;
     std::mutex m_cacheMutex;
 
     // Cache a hash result
     void cacheHash(const std::string& filePath, const std::string& hash) {
-        std::lock_guard<std::mutex> lock(m_cacheMutex);
-
-        CacheEntry entry;
-        entry.hash = hash;
-        entry.timestamp = std::chrono::system_clock::now();
-
+        uintmax_t fileSize;
         try {
-            entry.fileSize = fs::file_size(filePath);
+            fileSize = fs::file_size(filePath);
         } catch (...) {
-            entry.fileSize = 0;
+            fileSize = 0;
         }
-
-        m_hashCache[filePath] = entry;
+        cacheHash(filePath, hash, fileSize);
     }
 
     // Check if a cached hash is still valid
@@ -407,6 +472,19 @@ private:
     }
 
 public:
+    // Cache a hash whose file size is already known (e.g. from a manifest);
+    // no stat() of the file
+    void cacheHash(const std::string& filePath, const std::string& hash, uintmax_t fileSize) {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+        CacheEntry entry;
+        entry.hash = hash;
+        entry.timestamp = std::chrono::system_clock::now();
+        entry.fileSize = fileSize;
+
+        m_hashCache[filePath] = entry;
+    }
+
     // Create a cache summary
     std::string getCacheSummary() {
         std::lock_guard<std::mutex> lock(m_cacheMutex);
@@ -430,4 +508,6 @@ public:
         std::lock_guard<std::mutex> lock(m_cacheMutex);
         m_hashCache.clear();
     }
-};
\ No newline at end of file
+};
+
+#endif // FILE_VERIFICATION_HPP
@@ -0,0 +1,157 @@
+//
+// TinyLFU access-frequency estimate: a count-min sketch of 4-bit counters
+// behind a Bloom-filter doorkeeper, aged by periodic halving.
+//
+
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Approximate access counts for an unbounded key space in fixed memory
+// (about 3 bytes per expected item).  The first access of a key only sets
+// its doorkeeper bits, so the many keys a scan touches once never reach the
+// counters.  Later accesses increment the key's counters conservatively (only
+// the rows at the current minimum).  After 10 accesses per counter width all
+// counters are halved and the doorkeeper is cleared, so old popularity fades.
+// Not synchronised; callers hold their own lock.
+class FrequencySketch {
+public:
+    static constexpr uint32_t kMaxCount = 15;
+
+    explicit FrequencySketch(size_t expectedItems = 1 << 20)
+        : m_width(roundUpPowerOfTwo(std::max<size_t>(expectedItems, 64))),
+          m_counters(kDepth * m_width / kCountersPerWord, 0),
+          m_doorkeeper(m_width * kDoorkeeperBitsPerItem / 64, 0),
+          m_sampleSize(10 * m_width) {}
+
+    static uint64_t hash(std::string_view key) {
+        // FNV-1a; mix() spreads it over the rows
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : key) {
+            h = (h ^ c) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    // Record one access of the key with hash @p keyHash
+    void increment(uint64_t keyHash) {
+        if (++m_additions >= m_sampleSize) {
+            age();
+        }
+        if (!doorkeeperAdd(keyHash)) {
+            return;
+        }
+
+        std::array<size_t, kDepth> slots;
+        uint32_t minimum = kMaxCount;
+        for (size_t row = 0; row < kDepth; ++row) {
+            slots[row] = slot(keyHash, row);
+            minimum = std::min(minimum, counter(slots[row]));
+        }
+        if (minimum == kMaxCount) {
+            return;
+        }
+        for (size_t slotIndex : slots) {
+            if (counter(slotIndex) == minimum) {
+                m_counters[slotIndex / kCountersPerWord] += uint64_t{1} << shift(slotIndex);
+            }
+        }
+    }
+
+    // Estimated accesses since the last ageing, at most kMaxCount + 1
+    uint32_t frequency(uint64_t keyHash) const {
+        uint32_t minimum = kMaxCount;
+        for (size_t row = 0; row < kDepth; ++row) {
+            minimum = std::min(minimum, counter(slot(keyHash, row)));
+        }
+        return minimum + (doorkeeperContains(keyHash) ? 1 : 0);
+    }
+
+    // Halve every counter and clear the doorkeeper
+    void age() {
+        for (auto& word : m_counters) {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        std::fill(m_doorkeeper.begin(), m_doorkeeper.end(), 0);
+        m_additions = 0;
+        m_ageings++;
+    }
+
+    size_t memoryBytes() const {
+        return (m_counters.size() + m_doorkeeper.size()) * sizeof(uint64_t);
+    }
+
+    uint64_t ageings() const { return m_ageings; }
+
+private:
+    static constexpr size_t kDepth = 4;
+    static constexpr size_t kCountersPerWord = 16; // 4 bits each
+    static constexpr size_t kDoorkeeperBitsPerItem = 8;
+    static constexpr size_t kDoorkeeperHashes = 3;
+
+    const size_t m_width; // counters per row, a power of two
+    std::vector<uint64_t> m_counters;
+    std::vector<uint64_t> m_doorkeeper;
+    const uint64_t m_sampleSize;
+    uint64_t m_additions = 0;
+    uint64_t m_ageings = 0;
+
+    static size_t roundUpPowerOfTwo(size_t n) {
+        size_t power = 1;
+        while (power < n) {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    // SplitMix64 finaliser with a per-use seed
+    static uint64_t mix(uint64_t keyHash, uint64_t seed) {
+        uint64_t z = keyHash + 0x9e3779b97f4a7c15ULL * (seed + 1);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    size_t slot(uint64_t keyHash, size_t row) const {
+        return row * m_width + (mix(keyHash, row) & (m_width - 1));
+    }
+
+    static unsigned shift(size_t slotIndex) {
+        return static_cast<unsigned>(slotIndex % kCountersPerWord) * 4;
+    }
+
+    uint32_t counter(size_t slotIndex) const {
+        return static_cast<uint32_t>((m_counters[slotIndex / kCountersPerWord] >> shift(slotIndex)) & 0xf);
+    }
+
+    // Set the key's bits; true if they were all set already
+    bool doorkeeperAdd(uint64_t keyHash) {
+        bool present = true;
+        const uint64_t bits = m_doorkeeper.size() * 64;
+        for (size_t i = 0; i < kDoorkeeperHashes; ++i) {
+            uint64_t bit = mix(keyHash, kDepth + i) & (bits - 1);
+            uint64_t mask = uint64_t{1} << (bit % 64);
+            present &= (m_doorkeeper[bit / 64] & mask) != 0;
+            m_doorkeeper[bit / 64] |= mask;
+        }
+        return present;
+    }
+
+    bool doorkeeperContains(uint64_t keyHash) const {
+        const uint64_t bits = m_doorkeeper.size() * 64;
+        for (size_t i = 0; i < kDoorkeeperHashes; ++i) {
+            uint64_t bit = mix(keyHash, kDepth + i) & (bits - 1);
+            if ((m_doorkeeper[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // FREQUENCY_SKETCH_HPP
@@ -0,0 +1,202 @@
+//
+// Seqlock-protected live statistics segment shared with external readers.
+//
+
+#ifndef LIVE_STATS_HPP
+#define LIVE_STATS_HPP
+
+#include "sys/memory_mapped_file.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Default location of the segment; /dev/shm is tmpfs, so nothing reaches a disk
+inline constexpr const char* kDefaultLiveStatsPath = "/dev/shm/file_sync.stats";
+
+// Log2 histogram of task latencies: bucket i counts tasks that took
+// [2^i, 2^(i+1)) microseconds, the last bucket collects everything slower
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 32;
+
+    void record(std::chrono::nanoseconds latency) {
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        size_t bucket = us == 0 ? 0 : std::min<size_t>(std::bit_width(us) - 1, kBuckets - 1);
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::array<uint64_t, kBuckets> snapshot() const {
+        std::array<uint64_t, kBuckets> counts{};
+        for (size_t i = 0; i < kBuckets; ++i) {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> m_buckets{};
+};
+
+// Plain-old-data view of the daemon published once per tick.  Fixed-size
+// arrays only, so the layout is identical in every process that maps it.
+struct LiveStatsSnapshot {
+    static constexpr size_t kPriorities = 5;
+    static constexpr size_t kMaxDevices = 8;
+
+    enum DeviceState : uint32_t {
+        DEVICE_UNKNOWN = 0,
+        DEVICE_ONLINE = 1,
+        DEVICE_MISSING = 2,
+        DEVICE_DEGRADED = 3
+    };
+
+    struct Device {
+        char path[128];
+        uint32_t state;
+        uint32_t reserved;
+        uint64_t capacityBytes;
+        uint64_t freeBytes;
+    };
+
+    int64_t publishedAtNs;          // CLOCK_REALTIME of the last publish
+    int32_t pid;
+    uint32_t workers;
+
+    uint64_t pending;
+    uint64_t pendingByPriority[kPriorities];
+    uint64_t oldestAgeMs[kPriorities];
+    uint64_t bytesPending;
+    double drainTasksPerSecond;
+    double drainBytesPerSecond;
+    int64_t etaSeconds;             // -1 while nothing drains
+
+    uint64_t inFlight;
+    uint64_t oldestInFlightMs;
+
+    uint64_t tasksCompleted;
+    uint64_t tasksFailed;
+    uint64_t tasksRetried;
+
+    uint32_t deviceCount;
+    uint32_t reserved;
+    Device devices[kMaxDevices];
+
+    uint64_t latencyBuckets[LatencyHistogram::kBuckets];
+};
+
+static_assert(std::is_trivially_copyable_v<LiveStatsSnapshot>);
+
+// Header and payload as laid out in the mapped file
+struct LiveStatsSegment {
+    static constexpr uint64_t kMagic = 0x5354415453594E43ULL; // "CNYSTATS"
+    static constexpr uint32_t kVersion = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t size;
+    // Odd while the writer is mid-update
+    std::atomic<uint64_t> sequence;
+    LiveStatsSnapshot data;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the seqlock counter must be usable across processes");
+
+// Single writer.  publish() never blocks and never waits for readers, so an
+// attached dashboard costs the daemon nothing beyond the copy itself.
+class LiveStatsPublisher {
+public:
+    explicit LiveStatsPublisher(std::string path = kDefaultLiveStatsPath)
+        : m_path(std::move(path)), m_file(m_path, true) {
+        m_file.resize(sizeof(LiveStatsSegment));
+
+        auto* segment = this->segment();
+        std::memset(static_cast<void*>(segment), 0, sizeof(LiveStatsSegment));
+        segment->magic = LiveStatsSegment::kMagic;
+        segment->version = LiveStatsSegment::kVersion;
+        segment->size = sizeof(LiveStatsSegment);
+        segment->sequence.store(0, std::memory_order_release);
+    }
+
+    ~LiveStatsPublisher() {
+        // Readers that still have it mapped keep the last snapshot
+        ::unlink(m_path.c_str());
+    }
+
+    LiveStatsPublisher(const LiveStatsPublisher&) = delete;
+    LiveStatsPublisher& operator=(const LiveStatsPublisher&) = delete;
+
+    void publish(const LiveStatsSnapshot& snapshot) {
+        auto* segment = this->segment();
+        uint64_t seq = segment->sequence.load(std::memory_order_relaxed);
+
+        segment->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(static_cast<void*>(&segment->data), &snapshot, sizeof(snapshot));
+        segment->sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    const std::string& path() const { return m_path; }
+
+private:
+    std::string m_path;
+    sys::MemoryMappedFile m_file;
+
+    LiveStatsSegment* segment() { return static_cast<LiveStatsSegment*>(m_file.data()); }
+};
+
+// Maps the segment read-only; readers never write to shared memory
+class LiveStatsReader {
+public:
+    explicit LiveStatsReader(const std::string& path = kDefaultLiveStatsPath)
+        : m_file(path, false) {
+        if (m_file.size() < sizeof(LiveStatsSegment)) {
+            throw std::runtime_error("Live stats segment too small: " + path);
+        }
+        const auto* segment = this->segment();
+        if (segment->magic != LiveStatsSegment::kMagic ||
+            segment->version != LiveStatsSegment::kVersion ||
+            segment->size != sizeof(LiveStatsSegment)) {
+            throw std::runtime_error("Incompatible live stats segment: " + path);
+        }
+    }
+
+    // Consistent snapshot, or nullopt if the writer kept updating or has not
+    // published yet
+    std::optional<LiveStatsSnapshot> read(int maxAttempts = 100) const {
+        const auto* segment = this->segment();
+        for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+            uint64_t before = segment->sequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                return std::nullopt;
+            }
+            if (before & 1) {
+                continue;
+            }
+
+            LiveStatsSnapshot snapshot;
+            std::memcpy(&snapshot, static_cast<const void*>(&segment->data), sizeof(snapshot));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (segment->sequence.load(std::memory_order_relaxed) == before) {
+                return snapshot;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    sys::MemoryMappedFile m_file;
+
+    const LiveStatsSegment* segment() const { return static_cast<const LiveStatsSegment*>(m_file.data()); }
+};
+
+#endif // LIVE_STATS_HPP
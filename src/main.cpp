@@ -11,6 +11,8 @@
 #include <vector>
 #include <chrono>
 #include <csignal>
+#include <filesystem>
+#include <string>
 
 
 #include "configuration.hpp"
@@ -26,9 +28,13 @@ void eventLoop(ThreadPool& pool, FileSystemMonitor& monitor, MetricsCollector& m
         while (!monitor.empty())   {
             // Process all pending events
             auto event = monitor.getNextEvent();
-            pool.enqueue([&] () {
+            if (!event) {
+                break;
+            }
+            // The path is copied: the task runs after this iteration's event is gone
+            pool.enqueue([&sync_manager, path = event->path] () {
                 // Decides whether to copy/move/delete based on timestamps, checksums, or filesystem metadata.
-                sync_manager.syncFile(event.value().path);
+                sync_manager.syncFile(path);
             });
         }
         // Periodic consistency check (every 5 mins)
@@ -46,19 +52,33 @@ void eventLoop(ThreadPool& pool, FileSystemMonitor& monitor, MetricsCollector& m
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Same file photo-sync.sh reads; fall back to defaults when it is absent
+    std::string config_path = "/etc/photo-sync.conf";
+    if (argc > 2 && std::string(argv[1]) == "-c") {
+        config_path = argv[2];
+    }
+    Configuration config;
+    if (std::filesystem::exists(config_path)) {
+        try {
+            config = Configuration::loadFromFile(config_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
 
     ThreadPool pool;
      pool.start(std::thread::hardware_concurrency()); // Create a ThreadPool with the number of threads equal to the number of hardware threads
 
     FileSystemMonitor monitor;                  // Set up inotify/fanotify
-    monitor.addWatch("/path/to/watch"); // Set up inotify/fanotify
+    monitor.addWatch(config.source_dir.empty() ? "/path/to/watch" : config.source_dir); // Set up inotify/fanotify
 
     auto metrics = std::make_unique<MetricsCollector>();                          // Initialize metrics collector
-    Configuration config;
+    MetricsCollector& collector = *metrics;     // owned by sync_manager from here on
     SyncManager sync_manager{std::make_shared<Configuration>(config), std::move(metrics)};                        // Create a SyncManager
 
-    std::thread eventThread(eventLoop, std::ref(pool), std::ref(monitor), std::ref(*metrics), std::ref(sync_manager)); // Start the event loop in a separate thread
+    std::thread eventThread(eventLoop, std::ref(pool), std::ref(monitor), std::ref(collector), std::ref(sync_manager)); // Start the event loop in a separate thread
 
     // Graceful shutdown handling
     std::signal(SIGINT, [](int) {running = false;}); // Handle SIGINT (Ctrl+C) to stop the event loop
@@ -11,10 +11,28 @@ auto MetricsCollector::recordMetric(const std::string &name, const std::string &
     m_metrics.push_back({name, value, std::chrono::system_clock::now()});
 }
 
+auto MetricsCollector::setGauge(const std::string &name, double value) -> void {
+    std::lock_guard lock(m_metrics_mutex);
+    m_gauges[name] = value;
+}
+
+auto MetricsCollector::getGauge(const std::string &name) -> std::optional<double> {
+    std::lock_guard lock(m_metrics_mutex);
+    auto it = m_gauges.find(name);
+    if (it == m_gauges.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
 auto MetricsCollector::collect() -> void {
     std::lock_guard lock(m_metrics_mutex);
     for (const auto &metric : m_metrics) {
         std::cout << metric.name << ": " << metric.value << std::endl;
     }
     m_metrics.clear();
+
+    for (const auto &[name, value] : m_gauges) {
+        std::cout << name << ": " << value << std::endl;
+    }
 }
\ No newline at end of file
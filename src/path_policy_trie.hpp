@@ -0,0 +1,269 @@
+//
+// Per-subtree sync policies compiled into a path-component trie.
+//
+
+#ifndef PATH_POLICY_TRIE_HPP
+#define PATH_POLICY_TRIE_HPP
+
+#include "file_verification.hpp"
+#include "priority_sync_queue.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Effective policy for a file
+struct PathPolicy {
+    SyncPriority priority = SyncPriority::NORMAL;
+    FileVerification::VerifyMethod verifyMethod = FileVerification::VerifyMethod::FAST_HASH;
+    std::vector<std::string> destinations; // destination roots; empty = the default DEST_DIR
+    size_t quorum = 0;                     // destinations that must be durable for a sync to succeed; 0 = all
+    bool versioning = false;               // keep the previous copy under VERSIONS_DIR
+    bool compression = false;              // request transparent compression on the destination
+};
+
+// One rule: a subtree (relative to the source root) and the settings it
+// overrides.  Unset fields are inherited from the nearest enclosing rule.
+struct PathRule {
+    std::string path;
+    std::optional<SyncPriority> priority;
+    std::optional<FileVerification::VerifyMethod> verifyMethod;
+    std::optional<std::vector<std::string>> destinations;
+    std::optional<size_t> quorum;
+    std::optional<bool> versioning;
+    std::optional<bool> compression;
+};
+
+// Immutable trie keyed by path component.  Inheritance is resolved when the
+// trie is built, so lookup() walks at most depth nodes, compares string_views
+// against sorted child names and returns a reference to a precomputed policy.
+class PathPolicyTrie {
+public:
+    PathPolicyTrie(std::string sourceRoot, PathPolicy defaults, std::vector<PathRule> rules = {})
+        : m_sourceRoot(std::move(sourceRoot)) {
+        while (m_sourceRoot.size() > 1 && m_sourceRoot.back() == '/') {
+            m_sourceRoot.pop_back();
+        }
+        m_root.policy = std::move(defaults);
+
+        // Parents first, so every rule inherits from an already-resolved ancestor
+        std::stable_sort(rules.begin(), rules.end(), [](const PathRule& a, const PathRule& b) {
+            return depthOf(a.path) < depthOf(b.path);
+        });
+        for (const auto& rule : rules) {
+            insert(rule);
+        }
+    }
+
+    // Policy for @p path, absolute under the source root or relative to it.
+    // Paths outside the root get the defaults.
+    const PathPolicy& lookup(std::string_view path) const {
+        if (!path.empty() && path.front() == '/') {
+            if (!isUnderRoot(path)) {
+                return *m_root.policy;
+            }
+            path.remove_prefix(m_sourceRoot == "/" ? 1 : m_sourceRoot.size());
+        }
+
+        const Node* node = &m_root;
+        const PathPolicy* policy = &*m_root.policy;
+        forEachComponent(path, [&](std::string_view component) {
+            if (node == nullptr) {
+                return;
+            }
+            node = node->child(component);
+            if (node != nullptr && node->policy) {
+                policy = &*node->policy;
+            }
+        });
+        return *policy;
+    }
+
+    const PathPolicy& defaults() const { return *m_root.policy; }
+    const std::string& sourceRoot() const { return m_sourceRoot; }
+
+    // Parse a rules file: one rule per line, "<subtree> key=value ...".
+    // Keys: priority, verify, dest (comma separated), versioning, compression.
+    static std::vector<PathRule> parseRules(const std::string& text, const std::string& origin = "<rules>") {
+        std::vector<PathRule> rules;
+        std::istringstream in(text);
+        std::string line;
+        int lineNumber = 0;
+
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            if (auto hash = line.find('#'); hash != std::string::npos) {
+                line.erase(hash);
+            }
+            std::istringstream words(line);
+            PathRule rule;
+            if (!(words >> rule.path)) {
+                continue;
+            }
+
+            try {
+                std::string setting;
+                while (words >> setting) {
+                    auto eq = setting.find('=');
+                    if (eq == std::string::npos) {
+                        throw std::runtime_error("expected key=value, got '" + setting + "'");
+                    }
+                    applySetting(rule, setting.substr(0, eq), setting.substr(eq + 1));
+                }
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error(origin + ":" + std::to_string(lineNumber) + ": " + e.what());
+            }
+            rules.push_back(std::move(rule));
+        }
+        return rules;
+    }
+
+    static std::vector<PathRule> loadRules(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("Cannot open policy file: " + path);
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        return parseRules(text.str(), path);
+    }
+
+private:
+    struct Node {
+        // Sorted by name for binary search
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+        std::optional<PathPolicy> policy; // set where a rule ends
+
+        const Node* child(std::string_view name) const {
+            auto it = std::lower_bound(children.begin(), children.end(), name,
+                [](const auto& entry, std::string_view key) { return std::string_view(entry.first) < key; });
+            return it != children.end() && it->first == name ? it->second.get() : nullptr;
+        }
+
+        Node& childOrInsert(std::string_view name) {
+            auto it = std::lower_bound(children.begin(), children.end(), name,
+                [](const auto& entry, std::string_view key) { return std::string_view(entry.first) < key; });
+            if (it == children.end() || it->first != name) {
+                it = children.emplace(it, std::string(name), std::make_unique<Node>());
+            }
+            return *it->second;
+        }
+    };
+
+    std::string m_sourceRoot;
+    Node m_root;
+
+    void insert(const PathRule& rule) {
+        Node* node = &m_root;
+        const PathPolicy* inherited = &*m_root.policy;
+        forEachComponent(relativeToRoot(rule.path), [&](std::string_view component) {
+            node = &node->childOrInsert(component);
+            if (node->policy) {
+                inherited = &*node->policy;
+            }
+        });
+
+        PathPolicy policy = *inherited;
+        if (rule.priority) policy.priority = *rule.priority;
+        if (rule.verifyMethod) policy.verifyMethod = *rule.verifyMethod;
+        if (rule.destinations) policy.destinations = *rule.destinations;
+        if (rule.quorum) policy.quorum = *rule.quorum;
+        if (rule.versioning) policy.versioning = *rule.versioning;
+        if (rule.compression) policy.compression = *rule.compression;
+        node->policy = std::move(policy);
+    }
+
+    bool isUnderRoot(std::string_view path) const {
+        if (m_sourceRoot == "/") {
+            return true;
+        }
+        return path.substr(0, m_sourceRoot.size()) == m_sourceRoot &&
+               (path.size() == m_sourceRoot.size() || path[m_sourceRoot.size()] == '/');
+    }
+
+    // Rule paths may be written absolute (under the root) or relative to it
+    std::string_view relativeToRoot(std::string_view path) const {
+        if (!path.empty() && path.front() == '/' && isUnderRoot(path) && m_sourceRoot != "/") {
+            path.remove_prefix(m_sourceRoot.size());
+        }
+        return path;
+    }
+
+    template <typename Visitor>
+    static void forEachComponent(std::string_view path, Visitor&& visit) {
+        while (!path.empty()) {
+            auto slash = path.find('/');
+            std::string_view component = path.substr(0, slash);
+            if (!component.empty() && component != ".") {
+                visit(component);
+            }
+            if (slash == std::string_view::npos) {
+                break;
+            }
+            path.remove_prefix(slash + 1);
+        }
+    }
+
+    static size_t depthOf(std::string_view path) {
+        size_t depth = 0;
+        forEachComponent(path, [&](std::string_view) { ++depth; });
+        return depth;
+    }
+
+    static bool parseSwitch(const std::string& key, const std::string& value) {
+        if (value == "on" || value == "true" || value == "1") return true;
+        if (value == "off" || value == "false" || value == "0") return false;
+        throw std::runtime_error(key + " must be on or off, got '" + value + "'");
+    }
+
+    static void applySetting(PathRule& rule, const std::string& key, const std::string& value) {
+        if (key == "priority") {
+            for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+                if (value == toString(static_cast<SyncPriority>(i))) {
+                    rule.priority = static_cast<SyncPriority>(i);
+                    return;
+                }
+            }
+            throw std::runtime_error("unknown priority '" + value + "'");
+        } else if (key == "verify") {
+            auto method = FileVerification::methodFromString(value);
+            if (method == FileVerification::VerifyMethod::FAST_HASH && value != "FAST_HASH") {
+                throw std::runtime_error("unknown verify method '" + value + "'");
+            }
+            rule.verifyMethod = method;
+        } else if (key == "dest") {
+            std::vector<std::string> destinations;
+            std::istringstream list(value);
+            std::string destination;
+            while (std::getline(list, destination, ',')) {
+                if (!destination.empty()) {
+                    destinations.push_back(destination);
+                }
+            }
+            rule.destinations = std::move(destinations);
+        } else if (key == "quorum") {
+            size_t quorum = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), quorum);
+            if (ec != std::errc() || end != value.data() + value.size() || quorum == 0) {
+                throw std::runtime_error("quorum must be a positive number, got '" + value + "'");
+            }
+            rule.quorum = quorum;
+        } else if (key == "versioning") {
+            rule.versioning = parseSwitch(key, value);
+        } else if (key == "compression") {
+            rule.compression = parseSwitch(key, value);
+        } else {
+            throw std::runtime_error("unknown policy key '" + key + "'");
+        }
+    }
+};
+
+#endif // PATH_POLICY_TRIE_HPP
@@ -39,6 +39,27 @@ load_config() {
         RSYNC_EXCLUDE="$RSYNC_EXCLUDE --exclude='$pattern'"
     done
 
+    # BANDWIDTH_LIMIT is bytes/s with an optional K/M/G/T suffix; rsync takes KiB/s
+    RSYNC_BWLIMIT=""
+    if [ -n "$BANDWIDTH_LIMIT" ] && [ "$BANDWIDTH_LIMIT" != "0" ]; then
+        if ! [[ "$BANDWIDTH_LIMIT" =~ ^([0-9]+)([KkMmGgTt]?)$ ]]; then
+            echo "Error: BANDWIDTH_LIMIT must be a number with an optional K, M, G or T suffix"
+            exit 1
+        fi
+        local limit=${BASH_REMATCH[1]}
+        case "${BASH_REMATCH[2]}" in
+            [Kk]) limit=$((limit << 10)) ;;
+            [Mm]) limit=$((limit << 20)) ;;
+            [Gg]) limit=$((limit << 30)) ;;
+            [Tt]) limit=$((limit << 40)) ;;
+        esac
+        limit=$((limit >> 10))
+        if [ "$limit" -lt 1 ]; then
+            limit=1
+        fi
+        RSYNC_BWLIMIT="--bwlimit=$limit"
+    fi
+
     # Validate numeric values
     if ! [[ "$HEALTH_CHECK_INTERVAL" =~ ^[0-9]+$ ]]; then
         echo "Error: HEALTH_CHECK_INTERVAL must be a number"
@@ -247,7 +268,7 @@ sync_changes() {
         log_message "Starting sync operation (attempt $((retry_count + 1)))"
         
         # Build rsync command using configuration
-        eval rsync "$RSYNC_OPTS" "$RSYNC_EXCLUDE" \
+        eval rsync "$RSYNC_OPTS" "$RSYNC_EXCLUDE" "$RSYNC_BWLIMIT" \
             --backup \
             --backup-dir="$VERSIONS_DIR/$(date +%Y-%m-%d_%H-%M-%S)" \
             "$SOURCE_DIR/" "$DEST_DIR/" >> "$LOG_FILE" 2>&1 &
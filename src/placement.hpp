@@ -0,0 +1,120 @@
+//
+// Placement of files across the array members by weighted rendezvous hashing.
+//
+
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Maps a file's relative path to one member with no directory to consult:
+// every member scores the path with its own hash, -weight / ln(u) for a
+// uniform u in (0, 1), and the highest score wins.  A member wins with
+// probability weight / total weight.  Adding a member moves only the files it
+// now wins, its share of the total, and removing one moves only its own
+// files.  Jump hashing is cheaper per lookup but cannot weight members or
+// remove one from the middle; with a handful of members the per-member loop
+// costs nothing next to the copy.
+class Placement {
+public:
+    struct Member {
+        std::string root;
+        double weight = 1.0; // usually the member's capacity in bytes
+    };
+
+    // Throws std::invalid_argument without members or with a weight that is
+    // not positive
+    explicit Placement(std::vector<Member> members) : m_members(std::move(members)) {
+        if (m_members.empty()) {
+            throw std::invalid_argument("placement needs at least one member");
+        }
+        for (const auto& member : m_members) {
+            if (!(member.weight > 0.0) || !std::isfinite(member.weight)) {
+                throw std::invalid_argument("placement weight of " + member.root + " must be positive");
+            }
+            // Seeded by the root, so a member keeps its files wherever it is listed
+            m_seeds.push_back(hash(member.root));
+        }
+    }
+
+    // Index of the member holding @p key, a path relative to SOURCE_DIR
+    size_t memberIndex(std::string_view key) const {
+        if (m_members.size() == 1) {
+            return 0;
+        }
+        uint64_t keyHash = hash(key);
+        size_t best = 0;
+        double bestScore = -std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < m_members.size(); ++i) {
+            double score = this->score(keyHash, i);
+            if (score > bestScore) {
+                bestScore = score;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Every member's index, best score for @p key first: memberIndex() and
+    // then the members that would take over from it in turn.  Spreading a
+    // file's pieces over the first few keeps them apart and just as stable.
+    std::vector<size_t> rank(std::string_view key) const {
+        uint64_t keyHash = hash(key);
+        std::vector<std::pair<double, size_t>> scored;
+        for (size_t i = 0; i < m_members.size(); ++i) {
+            scored.emplace_back(score(keyHash, i), i);
+        }
+        std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        std::vector<size_t> order;
+        for (const auto& [score, index] : scored) {
+            order.push_back(index);
+        }
+        return order;
+    }
+
+    const std::string& rootFor(std::string_view key) const { return m_members[memberIndex(key)].root; }
+
+    const std::vector<Member>& members() const { return m_members; }
+    size_t size() const { return m_members.size(); }
+
+    // 64-bit FNV-1a
+    static uint64_t hash(std::string_view key) {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+private:
+    std::vector<Member> m_members;
+    std::vector<uint64_t> m_seeds;
+
+    double score(uint64_t keyHash, size_t member) const {
+        // Top 53 bits as a double strictly inside (0, 1)
+        double u = (static_cast<double>(mix(keyHash ^ m_seeds[member]) >> 11) + 0.5) * 0x1p-53;
+        return -m_members[member].weight / std::log(u);
+    }
+
+    // SplitMix64 finalizer: FNV's low-entropy high bits are not uniform enough
+    // on their own for the score
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+};
+
+#endif // PLACEMENT_HPP
@@ -19,6 +19,14 @@ Advanced Queue Features
 #include <optional>
 #include <chrono>
 #include <atomic>
+#include <algorithm>
+#include <array>
+#include <set>
+#include <cstdint>
+#include <vector>
+
+#include "profiled_mutex.hpp"
+#include "sys/probes.hpp"
 
 // Forward declaration
 class SyncTask;
@@ -32,6 +40,19 @@ enum class SyncPriority {
     BACKGROUND = 4 // Periodic checks, cleanup, etc.
 };
 
+constexpr size_t kSyncPriorityLevels = 5;
+
+inline const char* toString(SyncPriority priority) {
+    switch (priority) {
+        case SyncPriority::CRITICAL: return "CRITICAL";
+        case SyncPriority::HIGH: return "HIGH";
+        case SyncPriority::NORMAL: return "NORMAL";
+        case SyncPriority::LOW: return "LOW";
+        case SyncPriority::BACKGROUND: return "BACKGROUND";
+    }
+    return "UNKNOWN";
+}
+
 // A task representing a file sync operation
 class SyncTask {
 public:
@@ -43,8 +64,10 @@ public:
           m_priority(priority),
           m_timestamp(std::chrono::system_clock::now()),
           m_retryCount(0),
+          m_size(0),
           m_status("pending"),
-          m_taskId(generateTaskId()) {}
+          m_sequence(nextSequence()),
+          m_taskId(generateTaskId(m_sequence)) {}
 
     // Getters
     const std::string& getPath() const { return m_path; }
@@ -52,16 +75,24 @@ public:
     SyncPriority getPriority() const { return m_priority; }
     auto getTimestamp() const { return m_timestamp; }
     int getRetryCount() const { return m_retryCount; }
+    uintmax_t getSize() const { return m_size; }
     const std::string& getStatus() const { return m_status; }
     const std::string& getTaskId() const { return m_taskId; }
+    const std::vector<std::string>& getDestinations() const { return m_destinations; }
 
     // Setters
     void incrementRetry() { m_retryCount++; }
     void setStatus(const std::string& status) { m_status = status; }
+    void setSize(uintmax_t size) { m_size = size; }
+    void setDestinations(std::vector<std::string> roots) { m_destinations = std::move(roots); }
 
-    // Task comparison for priority queue - lower priority value means higher priority
+    // Task comparison for priority queue - lower priority value means higher
+    // priority; tasks of equal priority leave in creation order
     bool operator<(const SyncTask& other) const {
-        return m_priority > other.m_priority; // Reversed for priority_queue
+        if (m_priority != other.m_priority) {
+            return m_priority > other.m_priority; // Reversed for priority_queue
+        }
+        return m_sequence > other.m_sequence;
     }
 
 private:
@@ -70,13 +101,19 @@ private:
     SyncPriority m_priority; // Task priority
     std::chrono::system_clock::time_point m_timestamp; // Task creation time
     int m_retryCount;        // Number of retry attempts
+    uintmax_t m_size;        // Bytes to transfer, if known (backlog accounting)
     std::string m_status;    // Current status (pending, in_progress, completed, failed)
+    uint64_t m_sequence;     // Creation order
     std::string m_taskId;    // Unique task identifier
+    std::vector<std::string> m_destinations; // Destination roots to write, if only some of the policy's
 
-    // Generate a unique task ID
-    static std::string generateTaskId() {
+    static uint64_t nextSequence() {
         static std::atomic<uint64_t> counter{0};
-        uint64_t id = ++counter;
+        return ++counter;
+    }
+
+    // Generate a unique task ID
+    static std::string generateTaskId(uint64_t id) {
         auto now = std::chrono::system_clock::now();
         auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
         uint64_t timestamp = now_ms.time_since_epoch().count();
@@ -88,12 +125,26 @@ private:
 // A thread-safe priority queue for sync tasks
 class PrioritySyncQueue {
 public:
+    // Backlog gauges, maintained incrementally on enqueue/dequeue
+    struct BacklogStats {
+        size_t pending = 0;
+        std::array<size_t, kSyncPriorityLevels> pendingByPriority{};
+        // Age of the oldest pending task per priority (zero when none pending)
+        std::array<std::chrono::milliseconds, kSyncPriorityLevels> oldestAge{};
+        uintmax_t bytesPending = 0;
+        double drainTasksPerSecond = 0.0;  // smoothed dequeue rate
+        double drainBytesPerSecond = 0.0;
+        // Estimated time to empty at the current drain rate; nullopt while nothing drains
+        std::optional<std::chrono::seconds> eta;
+    };
+
     PrioritySyncQueue(size_t maxSize = 10000)
-        : m_maxSize(maxSize), m_shutdown(false) {}
+        : m_maxSize(maxSize), m_shutdown(false),
+          m_rateWindowStart(std::chrono::steady_clock::now()) {}
 
     // Add a task to the queue with timeout and back-pressure
     bool enqueue(SyncTask task, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        ProfiledMutex::UniqueLock lock(m_mutex);
 
         // Wait until there's room in the queue or timeout
         bool hasRoom = m_notFull.wait_for(lock, timeout, [this] {
@@ -104,6 +155,12 @@ public:
             return false; // Queue is full or shutting down
         }
 
+        SYNC_PROBE(queue_enqueue, task.getPath().c_str(), static_cast<int>(task.getPriority()),
+                   m_tasks.size(), task.getTimestamp().time_since_epoch().count());
+
+        m_pendingSince[static_cast<size_t>(task.getPriority())].insert(task.getTimestamp());
+        m_bytesPending += task.getSize();
+
         m_tasks.push(std::move(task));
         m_notEmpty.notify_one();
         return true;
@@ -111,7 +168,7 @@ public:
 
     // Get the next task from the queue
     std::optional<SyncTask> dequeue(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        ProfiledMutex::UniqueLock lock(m_mutex);
 
         // Wait for a task or timeout
         bool hasTask = m_notEmpty.wait_for(lock, timeout, [this] {
@@ -124,37 +181,120 @@ public:
 
         SyncTask task = std::move(m_tasks.top());
         m_tasks.pop();
+
+        auto& pendingSince = m_pendingSince[static_cast<size_t>(task.getPriority())];
+        pendingSince.erase(pendingSince.find(task.getTimestamp()));
+        m_bytesPending -= task.getSize();
+        updateDrainRate(std::chrono::steady_clock::now());
+        m_windowTasks++;
+        m_windowBytes += task.getSize();
+
+        SYNC_PROBE(queue_dequeue, task.getPath().c_str(), static_cast<int>(task.getPriority()),
+                   m_tasks.size(), task.getTimestamp().time_since_epoch().count());
+
         m_notFull.notify_one();
         return task;
     }
 
     // Check if the queue is empty
     bool empty() const {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
         return m_tasks.empty();
     }
 
     // Get the current size of the queue
     size_t size() const {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
         return m_tasks.size();
     }
 
+    // Snapshot of the backlog gauges; O(priority levels), never scans the queue
+    BacklogStats getBacklogStats() const {
+        std::lock_guard lock(m_mutex);
+        updateDrainRate(std::chrono::steady_clock::now());
+
+        BacklogStats stats;
+        stats.pending = m_tasks.size();
+        stats.bytesPending = m_bytesPending;
+        stats.drainTasksPerSecond = m_drainTasksPerSecond;
+        stats.drainBytesPerSecond = m_drainBytesPerSecond;
+
+        auto now = std::chrono::system_clock::now();
+        for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+            stats.pendingByPriority[i] = m_pendingSince[i].size();
+            if (!m_pendingSince[i].empty()) {
+                stats.oldestAge[i] = std::max(std::chrono::milliseconds(0),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(now - *m_pendingSince[i].begin()));
+            }
+        }
+
+        if (stats.pending == 0) {
+            stats.eta = std::chrono::seconds(0);
+        } else if (m_bytesPending > 0 && m_drainBytesPerSecond > 0.0) {
+            stats.eta = std::chrono::seconds(static_cast<int64_t>(m_bytesPending / m_drainBytesPerSecond));
+        } else if (m_drainTasksPerSecond > 0.0) {
+            stats.eta = std::chrono::seconds(static_cast<int64_t>(stats.pending / m_drainTasksPerSecond));
+        }
+
+        return stats;
+    }
+
+    // Change the capacity; producers blocked on a full queue are woken if it grew
+    void setMaxSize(size_t maxSize) {
+        std::lock_guard lock(m_mutex);
+        m_maxSize = maxSize;
+        m_notFull.notify_all();
+    }
+
     // Prepare for shutdown
     void shutdown() {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
         m_shutdown = true;
         m_notEmpty.notify_all();
         m_notFull.notify_all();
     }
 
 private:
-    mutable std::mutex m_mutex;
-    std::condition_variable m_notEmpty;
-    std::condition_variable m_notFull;
+    mutable ProfiledMutex m_mutex{"sync_queue"};
+    ProfiledMutex::ConditionVariable m_notEmpty;
+    ProfiledMutex::ConditionVariable m_notFull;
     std::priority_queue<SyncTask> m_tasks;
     size_t m_maxSize;
     bool m_shutdown;
+
+    // Creation times of pending tasks per priority; begin() is the oldest
+    std::array<std::multiset<std::chrono::system_clock::time_point>, kSyncPriorityLevels> m_pendingSince;
+    uintmax_t m_bytesPending = 0;
+
+    // Drain rate: dequeues are counted in fixed windows and folded into an EWMA
+    static constexpr std::chrono::seconds kRateWindow{1};
+    static constexpr double kRateSmoothing = 0.2;
+    mutable std::chrono::steady_clock::time_point m_rateWindowStart;
+    mutable uint64_t m_windowTasks = 0;
+    mutable uintmax_t m_windowBytes = 0;
+    mutable double m_drainTasksPerSecond = 0.0;
+    mutable double m_drainBytesPerSecond = 0.0;
+
+    // Close every rate window that ended before now (caller holds m_mutex)
+    void updateDrainRate(std::chrono::steady_clock::time_point now) const {
+        // After a long idle stretch the EWMA has decayed to ~0 anyway
+        constexpr int kMaxWindows = 64;
+        for (int i = 0; i < kMaxWindows && now - m_rateWindowStart >= kRateWindow; ++i) {
+            double seconds = std::chrono::duration<double>(kRateWindow).count();
+            m_drainTasksPerSecond = kRateSmoothing * (m_windowTasks / seconds) +
+                                    (1.0 - kRateSmoothing) * m_drainTasksPerSecond;
+            m_drainBytesPerSecond = kRateSmoothing * (m_windowBytes / seconds) +
+                                    (1.0 - kRateSmoothing) * m_drainBytesPerSecond;
+            m_windowTasks = 0;
+            m_windowBytes = 0;
+            m_rateWindowStart += kRateWindow;
+        }
+        if (now - m_rateWindowStart >= kRateWindow) {
+            m_drainTasksPerSecond = 0.0;
+            m_drainBytesPerSecond = 0.0;
+            m_rateWindowStart = now;
+        }
+    }
 };
 
 #endif // PRIORITY_SYNC_QUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,257 @@
+//
+// Lock contention profiling for the daemon's internal mutexes.
+//
+
+#include "profiled_mutex.hpp"
+#include "metrics_collector.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+size_t bucketFor(uint64_t ns) {
+    if (ns == 0) {
+        return 0;
+    }
+    return std::min<size_t>(std::bit_width(ns) - 1, LockStats::kBuckets - 1);
+}
+
+// Resolve a return address to "function+0xoff" (needs -rdynamic for symbols in the executable)
+std::string describeSite(const void* address) {
+    std::stringstream ss;
+    Dl_info info{};
+    if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        ss << (status == 0 && demangled ? demangled : info.dli_sname);
+        std::free(demangled);
+        ss << "+0x" << std::hex
+           << (static_cast<const char*>(address) - static_cast<const char*>(info.dli_saddr));
+    } else {
+        ss << address;
+    }
+    return ss.str();
+}
+
+#ifdef FILE_SYNC_LOCK_PROFILING
+
+// Whether a return address lies in the locking machinery itself: std::
+// (lock_guard, unique_lock, condition_variable_any), libstdc++ internals or
+// ProfiledMutex.  Without optimisation those are real frames between the
+// caller and lock(); classifications are cached per address.
+bool isLockingFrame(const void* address) {
+    static std::mutex cacheMutex;
+    static std::unordered_map<const void*, bool> cache;
+    {
+        std::lock_guard lock(cacheMutex);
+        auto it = cache.find(address);
+        if (it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    bool locking = false;
+    Dl_info info{};
+    if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string_view name = status == 0 && demangled ? demangled : info.dli_sname;
+        // Only the qualified name matters, not the parameter list
+        name = name.substr(0, name.find('('));
+        locking = name.find("std::") != std::string_view::npos ||
+                  name.find("__gnu_cxx::") != std::string_view::npos ||
+                  name.find("ProfiledMutex::") != std::string_view::npos;
+        std::free(demangled);
+    }
+
+    std::lock_guard lock(cacheMutex);
+    cache.emplace(address, locking);
+    return locking;
+}
+
+// First return address above lock() that is not locking machinery; lock()'s
+// own return address if the whole stack is
+const void* contendingSite() {
+    constexpr int kMaxFrames = 12;
+    void* frames[kMaxFrames];
+    // Frame 0 is this function, frame 1 ProfiledMutex::lock()
+    int depth = backtrace(frames, kMaxFrames);
+    for (int i = 2; i < depth; ++i) {
+        if (!isLockingFrame(frames[i])) {
+            return frames[i];
+        }
+    }
+    return depth > 2 ? frames[2] : nullptr;
+}
+
+#endif
+
+std::vector<std::pair<const void*, LockStats::Site>> topSitesOf(LockStats& stats, size_t count) {
+    std::vector<std::pair<const void*, LockStats::Site>> sites;
+    {
+        std::lock_guard lock(stats.siteMutex);
+        sites.assign(stats.sites.begin(), stats.sites.end());
+    }
+    std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+        return a.second.waitNs > b.second.waitNs;
+    });
+    if (sites.size() > count) {
+        sites.resize(count);
+    }
+    return sites;
+}
+
+} // namespace
+
+void LockStats::recordWait(uint64_t ns, const void* site) {
+    contended.fetch_add(1, std::memory_order_relaxed);
+    totalWaitNs.fetch_add(ns, std::memory_order_relaxed);
+    waitHistogram[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard lock(siteMutex);
+    auto& entry = sites[site];
+    entry.contended++;
+    entry.waitNs += ns;
+}
+
+void LockStats::recordHold(uint64_t ns) {
+    holdHistogram[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LockStats::percentile(const std::array<std::atomic<uint64_t>, kBuckets>& histogram, double p) {
+    uint64_t total = 0;
+    for (const auto& bucket : histogram) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    auto target = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += histogram[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            return uint64_t{1} << (i + 1);
+        }
+    }
+    return uint64_t{1} << kBuckets;
+}
+
+#ifdef FILE_SYNC_LOCK_PROFILING
+
+ProfiledMutex::ProfiledMutex(const char* name)
+    : m_stats(&LockProfiler::instance().statsFor(name)) {}
+
+// Kept out of line so the stack walk in contendingSite() starts from here
+__attribute__((noinline)) void ProfiledMutex::lock() {
+    m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+    if (!m_mutex.try_lock()) {
+        auto start = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        auto waited = std::chrono::steady_clock::now() - start;
+        m_stats->recordWait(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                            contendingSite());
+    } else {
+        m_stats->waitHistogram[0].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_acquired = std::chrono::steady_clock::now();
+}
+
+bool ProfiledMutex::try_lock() {
+    if (!m_mutex.try_lock()) {
+        return false;
+    }
+    m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    m_acquired = std::chrono::steady_clock::now();
+    return true;
+}
+
+void ProfiledMutex::unlock() {
+    auto held = std::chrono::steady_clock::now() - m_acquired;
+    m_mutex.unlock();
+    m_stats->recordHold(std::chrono::duration_cast<std::chrono::nanoseconds>(held).count());
+}
+
+#endif
+
+LockProfiler& LockProfiler::instance() {
+    static LockProfiler profiler;
+    return profiler;
+}
+
+LockStats& LockProfiler::statsFor(const std::string& name) {
+    std::lock_guard lock(m_mutex);
+    auto& stats = m_locks[name];
+    if (!stats) {
+        stats = std::make_unique<LockStats>();
+        stats->name = name;
+    }
+    return *stats;
+}
+
+std::string LockProfiler::getSummary(size_t topSites) {
+    std::stringstream ss;
+    if (!enabled()) {
+        ss << "Lock profiling disabled (build with -DFILE_SYNC_LOCK_PROFILING=ON)" << std::endl;
+        return ss.str();
+    }
+
+    std::lock_guard lock(m_mutex);
+    for (auto& [name, stats] : m_locks) {
+        ss << name << ": acquisitions=" << stats->acquisitions.load()
+           << " contended=" << stats->contended.load()
+           << " wait_total_ns=" << stats->totalWaitNs.load()
+           << " wait_p50_ns=" << LockStats::percentile(stats->waitHistogram, 0.50)
+           << " wait_p99_ns=" << LockStats::percentile(stats->waitHistogram, 0.99)
+           << " hold_p50_ns=" << LockStats::percentile(stats->holdHistogram, 0.50)
+           << " hold_p99_ns=" << LockStats::percentile(stats->holdHistogram, 0.99) << std::endl;
+
+        for (const auto& [site, siteStats] : topSitesOf(*stats, topSites)) {
+            ss << "    " << describeSite(site) << " contended=" << siteStats.contended
+               << " wait_ns=" << siteStats.waitNs << std::endl;
+        }
+    }
+    return ss.str();
+}
+
+void LockProfiler::recordMetrics(MetricsCollector& metrics, size_t topSites) {
+    if (!enabled()) {
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+    for (auto& [name, stats] : m_locks) {
+        const std::string label = "{lock=\"" + name + "\"}";
+        metrics.setGauge("lock_acquisitions" + label, static_cast<double>(stats->acquisitions.load()));
+        metrics.setGauge("lock_contended" + label, static_cast<double>(stats->contended.load()));
+        metrics.setGauge("lock_wait_total_ns" + label, static_cast<double>(stats->totalWaitNs.load()));
+        metrics.setGauge("lock_wait_p50_ns" + label,
+                         static_cast<double>(LockStats::percentile(stats->waitHistogram, 0.50)));
+        metrics.setGauge("lock_wait_p99_ns" + label,
+                         static_cast<double>(LockStats::percentile(stats->waitHistogram, 0.99)));
+        metrics.setGauge("lock_hold_p50_ns" + label,
+                         static_cast<double>(LockStats::percentile(stats->holdHistogram, 0.50)));
+        metrics.setGauge("lock_hold_p99_ns" + label,
+                         static_cast<double>(LockStats::percentile(stats->holdHistogram, 0.99)));
+
+        for (const auto& [site, siteStats] : topSitesOf(*stats, topSites)) {
+            metrics.recordMetric("lock_contention_site",
+                                 name + " " + describeSite(site) +
+                                 " contended=" + std::to_string(siteStats.contended) +
+                                 " wait_ns=" + std::to_string(siteStats.waitNs));
+        }
+    }
+}
@@ -0,0 +1,257 @@
+//
+// Token-bucket throughput limiters for copy and verify traffic.
+//
+
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One bucket of a rate in units per second, holding at most one second of
+// burst.  It starts empty, and may go into debt: a request larger than what
+// is held is taken anyway and the deficit is what the caller sleeps off.
+// Not synchronised; callers hold their own lock.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // rate == 0 means unlimited
+    explicit TokenBucket(uint64_t rate = 0, Clock::time_point now = Clock::now()) : m_lastRefill(now) {
+        setRate(rate, now);
+    }
+
+    void setRate(uint64_t rate, Clock::time_point now) {
+        refill(now);
+        m_rate = rate;
+        m_tokens = std::min(m_tokens, static_cast<double>(m_rate));
+    }
+
+    uint64_t rate() const { return m_rate; }
+    bool unlimited() const { return m_rate == 0; }
+
+    // True if @p amount (or a full bucket, for more than a second's worth)
+    // can be taken at @p now without going into debt
+    bool covers(uint64_t amount, Clock::time_point now) {
+        if (unlimited()) {
+            return true;
+        }
+        refill(now);
+        return m_tokens >= std::min(static_cast<double>(amount), static_cast<double>(m_rate));
+    }
+
+    // Take @p amount at @p now; returns how long the deficit takes to refill
+    std::chrono::nanoseconds take(uint64_t amount, Clock::time_point now) {
+        if (unlimited()) {
+            return std::chrono::nanoseconds::zero();
+        }
+        refill(now);
+        m_tokens -= static_cast<double>(amount);
+        return m_tokens >= 0.0 ? std::chrono::nanoseconds::zero() : timeFor(-m_tokens);
+    }
+
+    // How long until covers(@p amount) holds, with nothing else taken
+    std::chrono::nanoseconds waitFor(uint64_t amount, Clock::time_point now) {
+        if (covers(amount, now)) {
+            return std::chrono::nanoseconds::zero();
+        }
+        return timeFor(std::min(static_cast<double>(amount), static_cast<double>(m_rate)) - m_tokens);
+    }
+
+private:
+    uint64_t m_rate = 0;
+    double m_tokens = 0.0;
+    Clock::time_point m_lastRefill;
+
+    void refill(Clock::time_point now) {
+        double elapsed = std::max(0.0, std::chrono::duration<double>(now - m_lastRefill).count());
+        m_lastRefill = std::max(m_lastRefill, now);
+        m_tokens = std::min(m_tokens + elapsed * static_cast<double>(m_rate), static_cast<double>(m_rate));
+    }
+
+    std::chrono::nanoseconds timeFor(double tokens) const {
+        return std::chrono::nanoseconds(static_cast<int64_t>(tokens / static_cast<double>(m_rate) * 1e9));
+    }
+};
+
+// Byte-rate limiter whose rate can be changed at any time (config reload).
+// Callers take what they need up front and sleep off any deficit, so a
+// request larger than the burst still goes through, just later.
+class RateLimiter {
+public:
+    // bytesPerSecond == 0 means unlimited
+    explicit RateLimiter(uint64_t bytesPerSecond = 0) { setRate(bytesPerSecond); }
+
+    void setRate(uint64_t bytesPerSecond) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bucket.setRate(bytesPerSecond, TokenBucket::Clock::now());
+    }
+
+    uint64_t getRate() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bucket.rate();
+    }
+
+    // Block until @p bytes may be transferred
+    void acquire(uint64_t bytes) {
+        auto delay = reserve(bytes);
+        if (delay > std::chrono::nanoseconds::zero()) {
+            std::this_thread::sleep_for(delay);
+        }
+    }
+
+    // Take @p bytes of budget and return how long the caller has to wait
+    std::chrono::nanoseconds reserve(uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bucket.take(bytes, TokenBucket::Clock::now());
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    TokenBucket m_bucket;
+};
+
+// Bytes and I/O operations per second; 0 leaves that side unlimited
+struct IoRate {
+    uint64_t bytesPerSecond = 0;
+    uint64_t opsPerSecond = 0;
+
+    bool operator==(const IoRate&) const = default;
+};
+
+// Hierarchical limits for copy and verify I/O.  There is a pair of buckets
+// (bytes and operations) for all traffic, one per class (the manager uses
+// SyncPriority) and one per device.  An I/O needs the budget of every level
+// it passes, so the tightest level sets the pace.
+//
+// Ordinary classes take what they need and sleep off the deficit, as
+// RateLimiter callers do.  A headroom-only class never puts the shared
+// levels (global and device) into debt: it takes budget only while their
+// buckets hold enough, and otherwise waits and looks again.  It therefore
+// gets only what the other classes leave unused.  Every rate can be changed
+// at any time.
+class IoThrottle {
+public:
+    using Clock = TokenBucket::Clock;
+
+    // Outcome of reserve(): if granted, the caller sleeps for @c wait and
+    // goes ahead; otherwise nothing was taken and it asks again after @c wait
+    struct Grant {
+        bool granted = true;
+        std::chrono::nanoseconds wait{0};
+    };
+
+    explicit IoThrottle(size_t classes = 1) : m_classes(std::max<size_t>(classes, 1)) {}
+
+    void setGlobal(IoRate rate) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_global.set(rate, Clock::now());
+    }
+
+    IoRate getGlobal() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_global.get();
+    }
+
+    // Limits of class @p cls; classes past the last given at construction
+    // share the last one
+    void setClass(size_t cls, IoRate rate, bool headroomOnly = false) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Class& entry = m_classes[std::min(cls, m_classes.size() - 1)];
+        entry.buckets.set(rate, Clock::now());
+        entry.headroomOnly = headroomOnly;
+    }
+
+    // Replace the per-device limits; devices kept keep their budget
+    void setDevices(const std::unordered_map<std::string, IoRate>& devices) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = Clock::now();
+        for (auto it = m_devices.begin(); it != m_devices.end();) {
+            it = devices.count(it->first) ? std::next(it) : m_devices.erase(it);
+        }
+        for (const auto& [device, rate] : devices) {
+            m_devices[device].set(rate, now);
+        }
+    }
+
+    // Block until @p bytes in @p ops operations on @p device (empty or
+    // unknown: no device limit) may go ahead for class @p cls
+    void acquire(const std::string& device, size_t cls, uint64_t bytes, uint64_t ops = 1) {
+        for (;;) {
+            Grant grant = reserve(device, cls, bytes, ops);
+            if (grant.wait > std::chrono::nanoseconds::zero()) {
+                std::this_thread::sleep_for(grant.wait);
+            }
+            if (grant.granted) {
+                return;
+            }
+        }
+    }
+
+    Grant reserve(const std::string& device, size_t cls, uint64_t bytes, uint64_t ops = 1,
+                  Clock::time_point now = Clock::now()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Class& entry = m_classes[std::min(cls, m_classes.size() - 1)];
+        auto found = m_devices.find(device);
+        Buckets* deviceBuckets = found == m_devices.end() ? nullptr : &found->second;
+
+        Grant grant;
+        if (entry.headroomOnly) {
+            std::chrono::nanoseconds wait = m_global.waitFor(bytes, ops, now);
+            if (deviceBuckets) {
+                wait = std::max(wait, deviceBuckets->waitFor(bytes, ops, now));
+            }
+            if (wait > std::chrono::nanoseconds::zero()) {
+                // Look again once the budget could be there; a busier class
+                // may take it first
+                grant.granted = false;
+                grant.wait = std::clamp<std::chrono::nanoseconds>(wait, kMinRetry, kMaxRetry);
+                return grant;
+            }
+        }
+        grant.wait = std::max(entry.buckets.take(bytes, ops, now), m_global.take(bytes, ops, now));
+        if (deviceBuckets) {
+            grant.wait = std::max(grant.wait, deviceBuckets->take(bytes, ops, now));
+        }
+        return grant;
+    }
+
+private:
+    static constexpr std::chrono::nanoseconds kMinRetry = std::chrono::milliseconds(1);
+    static constexpr std::chrono::nanoseconds kMaxRetry = std::chrono::milliseconds(100);
+
+    struct Buckets {
+        TokenBucket bytes;
+        TokenBucket ops;
+
+        void set(IoRate rate, Clock::time_point now) {
+            bytes.setRate(rate.bytesPerSecond, now);
+            ops.setRate(rate.opsPerSecond, now);
+        }
+        IoRate get() const { return {bytes.rate(), ops.rate()}; }
+        std::chrono::nanoseconds take(uint64_t byteCount, uint64_t opCount, Clock::time_point now) {
+            return std::max(bytes.take(byteCount, now), ops.take(opCount, now));
+        }
+        std::chrono::nanoseconds waitFor(uint64_t byteCount, uint64_t opCount, Clock::time_point now) {
+            return std::max(bytes.waitFor(byteCount, now), ops.waitFor(opCount, now));
+        }
+    };
+
+    struct Class {
+        Buckets buckets;
+        bool headroomOnly = false;
+    };
+
+    mutable std::mutex m_mutex;
+    Buckets m_global;
+    std::vector<Class> m_classes;
+    std::unordered_map<std::string, Buckets> m_devices;
+};
+
+#endif // RATE_LIMITER_HPP
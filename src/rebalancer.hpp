@@ -0,0 +1,240 @@
+//
+// Migration plan and progress for moving files between array members.
+//
+
+#ifndef REBALANCER_HPP
+#define REBALANCER_HPP
+
+#include "erasure_store.hpp"
+#include "file_index.hpp"
+#include "placement.hpp"
+#include "profiled_mutex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The plan is the delta between the index and the current placement: only
+// files the placement now puts on another member move.  It is handed out a
+// window at a time in array order, and the index records each finished move,
+// so a restart plans only what is left.  A resilver is planned and run the
+// same way: the files a replaced member held, from where they survive.
+class Rebalancer {
+public:
+    struct Move {
+        std::string relative;
+        std::string from; // member holding the file now
+        std::string to;   // member the placement names
+        uint64_t size = 0;
+        std::optional<uint64_t> offset; // physical offset on the old member
+        std::optional<size_t> shard;    // erasure shard to rebuild on @c to
+    };
+
+    struct Progress {
+        size_t plannedFiles = 0;
+        size_t movedFiles = 0;
+        size_t failedFiles = 0;
+        size_t inFlight = 0;
+        uint64_t plannedBytes = 0;
+        uint64_t movedBytes = 0;
+        std::optional<std::chrono::seconds> eta; // once some bytes have moved
+    };
+
+    using OffsetFn = std::function<std::optional<uint64_t>(const std::string& path)>;
+
+    // @p label names the work in getSummary()
+    explicit Rebalancer(std::string label = "Rebalance") : m_label(std::move(label)) {}
+
+    // Files the index has on another member than the placement names, ordered
+    // for the old members' heads: by member, then physical offset of the old
+    // copy (when @p offsetOf finds one), then path
+    static std::vector<Move> planMoves(const FileIndex& index, const Placement& placement,
+                                       const OffsetFn& offsetOf = {}) {
+        std::vector<Move> moves;
+        index.forEach([&](const std::string& relative, const FileIndex::Entry& entry) {
+            if (entry.erasure) {
+                // Shards stay where they are; any k of them still give the file
+                return;
+            }
+            const std::string& target = placement.rootFor(relative);
+            if (entry.root != target) {
+                moves.push_back({relative, entry.root, target, entry.size, std::nullopt, std::nullopt});
+            }
+        });
+        if (offsetOf) {
+            for (auto& move : moves) {
+                move.offset = offsetOf(move.from + move.relative);
+            }
+        }
+        sortForHeads(moves);
+        return moves;
+    }
+
+    // Files the index places on @p member, to be written to it again after
+    // it was replaced.  A whole copy is read from the cache tier at
+    // @p cacheRoot.  An erasure-coded file with a shard on @p member, as the
+    // index recorded at encoding, gets that shard rebuilt, read from another
+    // shard's member.  Files encoded before the index recorded shard roots
+    // are taken to have shard i on the i-th of the first @p shardCount
+    // ranked members, which holds only while the members are unchanged; the
+    // manager rebuilds whichever shards it finds missing either way.
+    // Ordered as planMoves() orders moves, for the heads of the devices read.
+    static std::vector<Move> planResilver(const FileIndex& index, const Placement& placement,
+                                          const std::string& member, const std::string& cacheRoot,
+                                          size_t shardCount, const OffsetFn& offsetOf = {}) {
+        std::vector<Move> moves;
+        std::vector<std::string> reads; // path each move reads first
+        index.forEach([&](const std::string& relative, const FileIndex::Entry& entry) {
+            if (!entry.erasure) {
+                if (entry.root == member) {
+                    moves.push_back({relative, cacheRoot, member, entry.size, std::nullopt, std::nullopt});
+                    reads.push_back(cacheRoot + relative);
+                }
+                return;
+            }
+            std::vector<std::string> roots = entry.shardRoots;
+            if (roots.empty()) {
+                auto order = placement.rank(relative);
+                for (size_t i = 0; i < std::min(shardCount, order.size()); ++i) {
+                    roots.push_back(placement.members()[order[i]].root);
+                }
+            }
+            auto held = std::find(roots.begin(), roots.end(), member);
+            if (roots.size() < 2 || held == roots.end()) {
+                return;
+            }
+            auto shard = static_cast<size_t>(held - roots.begin());
+            size_t read = shard == 0 ? 1 : 0;
+            moves.push_back({relative, roots[read], member, entry.size, std::nullopt, shard});
+            reads.push_back(ErasureStore::shardPath(roots[read], relative, read));
+        });
+        if (offsetOf) {
+            for (size_t i = 0; i < moves.size(); ++i) {
+                moves[i].offset = offsetOf(reads[i]);
+            }
+        }
+        sortForHeads(moves);
+        return moves;
+    }
+
+    void start(std::vector<Move> moves, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        std::lock_guard lock(m_mutex);
+        m_plan = std::move(moves);
+        m_next = 0;
+        m_inFlight.clear();
+        m_progress = Progress{};
+        m_progress.plannedFiles = m_plan.size();
+        for (const auto& move : m_plan) {
+            m_progress.plannedBytes += move.size;
+        }
+        m_started = now;
+    }
+
+    // The next moves in plan order, keeping at most @p window in flight
+    std::vector<Move> next(size_t window) {
+        std::lock_guard lock(m_mutex);
+        std::vector<Move> moves;
+        while (m_next < m_plan.size() && m_inFlight.size() < window) {
+            const Move& move = m_plan[m_next++];
+            m_inFlight.emplace(move.relative, move);
+            moves.push_back(move);
+        }
+        return moves;
+    }
+
+    void finished(const std::string& relative, bool success) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_inFlight.find(relative);
+        if (it == m_inFlight.end()) {
+            return;
+        }
+        if (success) {
+            m_progress.movedFiles++;
+            m_progress.movedBytes += it->second.size;
+        } else {
+            m_progress.failedFiles++;
+        }
+        m_inFlight.erase(it);
+    }
+
+    bool isMoving(const std::string& relative) const {
+        std::lock_guard lock(m_mutex);
+        return m_inFlight.count(relative) > 0;
+    }
+
+    // The move of @p relative handed out by next() and not yet finished
+    std::optional<Move> inFlight(const std::string& relative) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_inFlight.find(relative);
+        if (it == m_inFlight.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    // True once every planned move has finished, or when nothing was planned
+    bool done() const {
+        std::lock_guard lock(m_mutex);
+        return m_next == m_plan.size() && m_inFlight.empty();
+    }
+
+    Progress getProgress(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const {
+        std::lock_guard lock(m_mutex);
+        Progress progress = m_progress;
+        progress.inFlight = m_inFlight.size();
+        double elapsed = std::chrono::duration<double>(now - m_started).count();
+        if (progress.movedBytes > 0 && elapsed > 0.0) {
+            double rate = static_cast<double>(progress.movedBytes) / elapsed;
+            uint64_t remaining = progress.plannedBytes - std::min(progress.plannedBytes, progress.movedBytes);
+            progress.eta = std::chrono::seconds(static_cast<int64_t>(static_cast<double>(remaining) / rate));
+        }
+        return progress;
+    }
+
+    std::string getSummary() const {
+        Progress progress = getProgress();
+        std::stringstream ss;
+        ss << m_label << ": " << progress.movedFiles << "/" << progress.plannedFiles << " files, "
+           << progress.movedBytes << "/" << progress.plannedBytes << " bytes moved, " << progress.failedFiles
+           << " failed, " << progress.inFlight << " in flight";
+        if (progress.eta) {
+            ss << ", ETA " << progress.eta->count() << "s";
+        }
+        ss << std::endl;
+        return ss.str();
+    }
+
+private:
+    std::string m_label;
+    mutable ProfiledMutex m_mutex{"rebalancer"};
+    std::vector<Move> m_plan;
+    size_t m_next = 0;
+    std::unordered_map<std::string, Move> m_inFlight; // by relative path
+    Progress m_progress;
+    std::chrono::steady_clock::time_point m_started;
+
+    // By device read, then physical offset there (unknown last), then path
+    static void sortForHeads(std::vector<Move>& moves) {
+        std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) {
+            if (a.from != b.from) {
+                return a.from < b.from;
+            }
+            if (a.offset.has_value() != b.offset.has_value()) {
+                return a.offset.has_value();
+            }
+            if (a.offset && *a.offset != *b.offset) {
+                return *a.offset < *b.offset;
+            }
+            return a.relative < b.relative;
+        });
+    }
+};
+
+#endif // REBALANCER_HPP
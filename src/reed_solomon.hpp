@@ -0,0 +1,314 @@
+//
+// Systematic Reed-Solomon erasure code over GF(2^8).
+//
+
+#ifndef REED_SOLOMON_HPP
+#define REED_SOLOMON_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REED_SOLOMON_X86 1
+#endif
+
+// k data shards and m parity shards; any k of the k + m rebuild the rest.
+// The encoding matrix is the identity over a Cauchy matrix, so every k x k
+// submatrix is invertible and the data shards are stored as they are.
+//
+// All the work is multiply-accumulate of a region by a constant.  As in
+// ISA-L, the x86 kernels split each byte into nibbles and look up both
+// products with one pshufb each: a 16-entry table per nibble replaces the
+// 64 KiB product table the scalar loop walks.  The kernel is picked once
+// from the running CPU (AVX2, SSSE3, else scalar).
+class ReedSolomon {
+public:
+    // Throws std::invalid_argument unless 1 <= k, 1 <= m and k + m <= 256
+    ReedSolomon(size_t dataShards, size_t parityShards) : m_k(dataShards), m_m(parityShards) {
+        if (m_k == 0 || m_m == 0 || m_k + m_m > 256) {
+            throw std::invalid_argument("Reed-Solomon needs 1 <= k, 1 <= m and k + m <= 256, got " +
+                                        std::to_string(m_k) + "+" + std::to_string(m_m));
+        }
+        // Parity row i, column j: 1 / (x_i + y_j) with x_i = k + i and y_j = j,
+        // all distinct, so no denominator is zero
+        m_parity.resize(m_m * m_k);
+        for (size_t i = 0; i < m_m; ++i) {
+            for (size_t j = 0; j < m_k; ++j) {
+                m_parity[i * m_k + j] = inverse(static_cast<uint8_t>((m_k + i) ^ j));
+            }
+        }
+    }
+
+    size_t dataShards() const { return m_k; }
+    size_t parityShards() const { return m_m; }
+    size_t totalShards() const { return m_k + m_m; }
+
+    // Compute the m parity shards of the k @p data shards, each @p length bytes
+    void encode(const std::vector<const uint8_t*>& data, const std::vector<uint8_t*>& parity, size_t length) const {
+        if (data.size() != m_k || parity.size() != m_m) {
+            throw std::invalid_argument("Reed-Solomon encode needs k data and m parity shards");
+        }
+        for (size_t i = 0; i < m_m; ++i) {
+            std::memset(parity[i], 0, length);
+            for (size_t j = 0; j < m_k; ++j) {
+                mulAdd(m_parity[i * m_k + j], data[j], parity[i], length);
+            }
+        }
+    }
+
+    // Rebuild the shards @p present marks missing, in place; with
+    // @p dataOnly, missing parity shards are left alone.  @p shards holds all
+    // k + m buffers of @p length bytes.  The work is split by byte range over
+    // up to @p threads threads.  Throws std::runtime_error if fewer than k
+    // shards are present.
+    void reconstruct(const std::vector<uint8_t*>& shards, const std::vector<bool>& present, size_t length,
+                     size_t threads = 1, bool dataOnly = false) const {
+        if (shards.size() != totalShards() || present.size() != totalShards()) {
+            throw std::invalid_argument("Reed-Solomon reconstruct needs k + m shards");
+        }
+        std::vector<size_t> rows;
+        for (size_t i = 0; i < totalShards() && rows.size() < m_k; ++i) {
+            if (present[i]) {
+                rows.push_back(i);
+            }
+        }
+        if (rows.size() < m_k) {
+            throw std::runtime_error("Reed-Solomon: " + std::to_string(rows.size()) + " of " +
+                                     std::to_string(totalShards()) + " shards left, need " + std::to_string(m_k));
+        }
+
+        // Data shard j = sum over r of decode[j][r] * shards[rows[r]]
+        std::vector<uint8_t> decode = invert(rows);
+        std::vector<size_t> missingData, missingParity;
+        for (size_t i = 0; i < totalShards(); ++i) {
+            if (!present[i] && (i < m_k || !dataOnly)) {
+                (i < m_k ? missingData : missingParity).push_back(i);
+            }
+        }
+        if (missingData.empty() && missingParity.empty()) {
+            return;
+        }
+
+        auto rebuild = [&](size_t begin, size_t end) {
+            size_t n = end - begin;
+            for (size_t j : missingData) {
+                std::memset(shards[j] + begin, 0, n);
+                for (size_t r = 0; r < m_k; ++r) {
+                    mulAdd(decode[j * m_k + r], shards[rows[r]] + begin, shards[j] + begin, n);
+                }
+            }
+            // The data is whole now; parity is encoded again from it
+            for (size_t p : missingParity) {
+                size_t i = p - m_k;
+                std::memset(shards[p] + begin, 0, n);
+                for (size_t j = 0; j < m_k; ++j) {
+                    mulAdd(m_parity[i * m_k + j], shards[j] + begin, shards[p] + begin, n);
+                }
+            }
+        };
+
+        // Ranges of whole cache lines, at least 64 KiB each
+        size_t workers = std::max<size_t>(1, std::min(threads, length / (64 * 1024)));
+        if (workers == 1) {
+            rebuild(0, length);
+            return;
+        }
+        size_t step = (length / workers + 63) & ~size_t{63};
+        std::vector<std::thread> pool;
+        for (size_t begin = step; begin < length; begin += step) {
+            pool.emplace_back(rebuild, begin, std::min(length, begin + step));
+        }
+        rebuild(0, std::min(length, step));
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+
+    // out[i] ^= c * in[i] for @p n bytes, with the fastest kernel this CPU has
+    static void mulAdd(uint8_t c, const uint8_t* in, uint8_t* out, size_t n) {
+        static const Kernel kernel = selectKernel();
+        if (c == 0) {
+            return;
+        }
+        kernel.mulAdd(c, in, out, n);
+    }
+
+    // Name of the kernel mulAdd() uses: "avx2", "ssse3" or "scalar"
+    static const char* kernelName() {
+        return selectKernel().name;
+    }
+
+    static void mulAddScalar(uint8_t c, const uint8_t* in, uint8_t* out, size_t n) {
+        const uint8_t* row = tables().product[c].data();
+        for (size_t i = 0; i < n; ++i) {
+            out[i] ^= row[in[i]];
+        }
+    }
+
+#ifdef REED_SOLOMON_X86
+    __attribute__((target("ssse3"))) static void mulAddSsse3(uint8_t c, const uint8_t* in, uint8_t* out, size_t n) {
+        alignas(16) uint8_t low[16], high[16];
+        nibbleTables(c, low, high);
+        const __m128i lowTable = _mm_load_si128(reinterpret_cast<const __m128i*>(low));
+        const __m128i highTable = _mm_load_si128(reinterpret_cast<const __m128i*>(high));
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i product = _mm_xor_si128(_mm_shuffle_epi8(lowTable, _mm_and_si128(x, mask)),
+                                            _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+            __m128i* dest = reinterpret_cast<__m128i*>(out + i);
+            _mm_storeu_si128(dest, _mm_xor_si128(_mm_loadu_si128(dest), product));
+        }
+        mulAddScalar(c, in + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static void mulAddAvx2(uint8_t c, const uint8_t* in, uint8_t* out, size_t n) {
+        alignas(16) uint8_t low[16], high[16];
+        nibbleTables(c, low, high);
+        const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(low)));
+        const __m256i highTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(high)));
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i product =
+                _mm256_xor_si256(_mm256_shuffle_epi8(lowTable, _mm256_and_si256(x, mask)),
+                                 _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+            __m256i* dest = reinterpret_cast<__m256i*>(out + i);
+            _mm256_storeu_si256(dest, _mm256_xor_si256(_mm256_loadu_si256(dest), product));
+        }
+        mulAddScalar(c, in + i, out + i, n - i);
+    }
+#endif
+
+    // GF(2^8) product with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+    static uint8_t multiply(uint8_t a, uint8_t b) {
+        return tables().product[a][b];
+    }
+
+    static uint8_t inverse(uint8_t a) {
+        if (a == 0) {
+            throw std::domain_error("GF(2^8): zero has no inverse");
+        }
+        const Tables& t = tables();
+        return t.exp[255 - t.log[a]];
+    }
+
+private:
+    struct Tables {
+        std::array<uint8_t, 256> exp{};
+        std::array<uint8_t, 256> log{};
+        std::array<std::array<uint8_t, 256>, 256> product{};
+    };
+
+    struct Kernel {
+        void (*mulAdd)(uint8_t, const uint8_t*, uint8_t*, size_t);
+        const char* name;
+    };
+
+    size_t m_k;
+    size_t m_m;
+    std::vector<uint8_t> m_parity; // m x k, row-major
+
+    static const Tables& tables() {
+        static const Tables t = [] {
+            Tables t;
+            unsigned x = 1;
+            for (unsigned i = 0; i < 255; ++i) {
+                t.exp[i] = static_cast<uint8_t>(x);
+                t.log[x] = static_cast<uint8_t>(i);
+                x <<= 1;
+                if (x & 0x100) {
+                    x ^= 0x11d;
+                }
+            }
+            t.exp[255] = t.exp[0];
+            for (unsigned a = 1; a < 256; ++a) {
+                for (unsigned b = 1; b < 256; ++b) {
+                    t.product[a][b] = t.exp[(t.log[a] + t.log[b]) % 255];
+                }
+            }
+            return t;
+        }();
+        return t;
+    }
+
+    static Kernel selectKernel() {
+#ifdef REED_SOLOMON_X86
+        if (__builtin_cpu_supports("avx2")) {
+            return {&mulAddAvx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            return {&mulAddSsse3, "ssse3"};
+        }
+#endif
+        return {&mulAddScalar, "scalar"};
+    }
+
+    // c times every low nibble, and c times every high nibble
+    static void nibbleTables(uint8_t c, uint8_t* low, uint8_t* high) {
+        const auto& row = tables().product[c];
+        for (unsigned i = 0; i < 16; ++i) {
+            low[i] = row[i];
+            high[i] = row[i << 4];
+        }
+    }
+
+    // Inverse of the k x k matrix made of encoding rows @p rows, by
+    // Gauss-Jordan elimination
+    std::vector<uint8_t> invert(const std::vector<size_t>& rows) const {
+        const size_t k = m_k;
+        std::vector<uint8_t> a(k * k, 0), inv(k * k, 0);
+        for (size_t r = 0; r < k; ++r) {
+            if (rows[r] < k) {
+                a[r * k + rows[r]] = 1;
+            } else {
+                std::memcpy(&a[r * k], &m_parity[(rows[r] - k) * k], k);
+            }
+            inv[r * k + r] = 1;
+        }
+        for (size_t col = 0; col < k; ++col) {
+            size_t pivot = col;
+            while (pivot < k && a[pivot * k + col] == 0) {
+                pivot++;
+            }
+            if (pivot == k) {
+                throw std::runtime_error("Reed-Solomon: singular decode matrix");
+            }
+            if (pivot != col) {
+                for (size_t j = 0; j < k; ++j) {
+                    std::swap(a[pivot * k + j], a[col * k + j]);
+                    std::swap(inv[pivot * k + j], inv[col * k + j]);
+                }
+            }
+            uint8_t scale = inverse(a[col * k + col]);
+            for (size_t j = 0; j < k; ++j) {
+                a[col * k + j] = multiply(a[col * k + j], scale);
+                inv[col * k + j] = multiply(inv[col * k + j], scale);
+            }
+            for (size_t r = 0; r < k; ++r) {
+                uint8_t factor = a[r * k + col];
+                if (r == col || factor == 0) {
+                    continue;
+                }
+                for (size_t j = 0; j < k; ++j) {
+                    a[r * k + j] ^= multiply(factor, a[col * k + j]);
+                    inv[r * k + j] ^= multiply(factor, inv[col * k + j]);
+                }
+            }
+        }
+        return inv;
+    }
+};
+
+#endif // REED_SOLOMON_HPP
@@ -5,22 +5,46 @@
 #ifndef ROBUST_SYNC_MANAGER_HPP
 #define ROBUST_SYNC_MANAGER_HPP
 
+#include "access_monitor.hpp"
 #include "file_verification.hpp"
 #include "transaction_log.hpp"
 #include "priority_sync_queue.hpp"
 #include "configuration.hpp"
+#include "configuration_watcher.hpp"
+#include "copy_engine.hpp"
+#include "cuckoo_filter.hpp"
+#include "device_profiler.hpp"
+#include "dirty_set.hpp"
+#include "erasure_store.hpp"
+#include "placement.hpp"
+#include "rebalancer.hpp"
 #include "metrics_collector.hpp"
+#include "path_policy_trie.hpp"
 #include "file_system_monitor.hpp"
+#include "live_stats.hpp"
+#include "profiled_mutex.hpp"
+#include "rate_limiter.hpp"
+#include "stage_profiler.hpp"
+#include "task_accounting.hpp"
+#include "tiering_engine.hpp"
+#include "sys/probes.hpp"
 
 #include <filesystem>
 #include <string>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include <unordered_set>
 #include <functional>
 #include <future>
 #include <memory>
 #include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -28,22 +52,74 @@ namespace fs = std::filesystem;
 // and priority-based queuing
 class RobustSyncManager {
 public:
+    // Called once per task when it finishes: synced to every destination, or
+    // failed with no retries left
+    using CompletionCallback = std::function<void(const SyncTask& task, bool synced)>;
+
     RobustSyncManager(
         std::shared_ptr<Configuration> config,
         std::unique_ptr<MetricsCollector> metrics,
-        const std::string& logDir = "/var/log/file_sync")
+        const std::string& logDir = "")
         : m_config(config),
           m_metrics(std::move(metrics)),
-          m_transactionLog(logDir),
+          m_transactionLog(logDir.empty() ? config->transaction_log_dir : logDir),
+          m_syncQueue(config->queue_capacity),
+          m_sourceRoot(config->source_dir),
+          m_destRoot(config->dest_dir),
+          m_placement(buildPlacement(*config)),
+          m_index((logDir.empty() ? config->transaction_log_dir : logDir) + "/file_index.json"),
+          m_destFilterPath((logDir.empty() ? config->transaction_log_dir : logDir) + "/dest_filter.bin"),
+          m_accounting(m_sourceRoot),
+          m_rebalanceThrottle(config->rebalance_bandwidth_bytes),
+          m_deviceProfiler("/sys", config->device_calibration),
+          m_tiering(std::chrono::seconds(config->tier_half_life_seconds), config->tier_promote_accesses,
+                    config->tier_sketch_items),
           m_running(false) {
 
         // Initialize the transaction log
         if (!m_transactionLog.open()) {
             throw std::runtime_error("Failed to open transaction log");
         }
+        if (!m_index.open()) {
+            throw std::runtime_error("Failed to open file index");
+        }
+        // Missing or torn: start empty, the next consistency check refills it
+        m_destFilter.load(m_destFilterPath);
+
+        // Replay the log so the in-flight backlog left by a crash is known
+        // before the first task is accepted
+        auto replayStart = std::chrono::steady_clock::now();
+        m_startupRecovery = m_transactionLog.recover();
+        m_startupRecoverySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+        m_metrics->setGauge("recovery_replay_seconds", m_startupRecoverySeconds);
+        m_metrics->setGauge("recovery_replay_records", static_cast<double>(m_startupRecovery.records));
+        if (m_startupRecovery.tornBytes > 0) {
+            m_metrics->recordMetric("recovery_torn_tail",
+                                    std::to_string(m_startupRecovery.tornBytes) + " bytes truncated");
+        }
+        // Nothing is moving yet, so every promotion in flight was interrupted
+        for (const auto& tx : m_transactionLog.getPendingTransactions()) {
+            if (isPromotion(tx)) {
+                recoverPromotion(tx);
+            }
+        }
+
+        // Profile the source and destination devices once; copies, hashing
+        // and per-device concurrency follow the profiles
+        m_sourceProfile = m_deviceProfiler.profileFor(m_sourceRoot);
+        for (const auto& member : m_placement.members()) {
+            m_deviceProfiler.profileFor(member.root);
+        }
+        applyIoLimits(*m_config);
 
         // Set up file verification
         m_fileVerifier = std::make_unique<FileVerification>();
+        m_fileVerifier->setReadSize(m_sourceProfile.bufferSize);
+
+        // Per-subtree policies; a broken policy file is a startup error
+        m_policies = buildPolicies(*m_config);
+
+        StageProfiler::instance().setEnabled(m_config->self_profiling);
     }
 
     ~RobustSyncManager() {
@@ -58,11 +134,10 @@ public:
         }
 
         m_running = true;
+        auto config = currentConfig();
 
         // Start worker threads
-        for (int i = 0; i < m_config->num_threads; ++i) {
-            m_workers.emplace_back(&RobustSyncManager::workerThread, this);
-        }
+        resizeWorkers(static_cast<size_t>(config->num_threads));
 
         // Start recovery thread
         m_recoveryThread = std::thread(&RobustSyncManager::recoveryWorker, this);
@@ -70,11 +145,45 @@ public:
         // Start consistency check thread
         m_consistencyThread = std::thread(&RobustSyncManager::consistencyWorker, this);
 
+        // Start tier placement thread (idle unless TIERING is set)
+        m_tieringThread = std::thread(&RobustSyncManager::tieringWorker, this);
+
+        // Start write-back flusher (idle unless WRITE_BACK is set)
+        m_flushThread = std::thread(&RobustSyncManager::flushWorker, this);
+
+        // Start moving files whose array member changed since the index was written
+        m_rebalanceThread = std::thread(&RobustSyncManager::rebalanceWorker, this);
+
+        // Publish live stats for external readers (file_sync-top)
+        if (!config->live_stats_path.empty()) {
+            try {
+                m_liveStats = std::make_unique<LiveStatsPublisher>(config->live_stats_path);
+                m_statsThread = std::thread(&RobustSyncManager::statsWorker, this);
+            } catch (const std::exception& e) {
+                m_metrics->recordMetric("live_stats_error", e.what());
+            }
+        }
+
+        // Reload the config file when it changes
+        if (!config->config_file.empty()) {
+            try {
+                m_configWatcher = std::make_unique<ConfigurationWatcher>(
+                    config->config_file,
+                    [this](std::shared_ptr<Configuration> updated) { reloadConfiguration(std::move(updated)); },
+                    [this](const std::string& error) { m_metrics->recordMetric("config_reload_error", error); });
+            } catch (const std::exception& e) {
+                m_metrics->recordMetric("config_watch_error", e.what());
+            }
+        }
+
         m_metrics->recordMetric("sync_manager", "started");
     }
 
     // Stop the sync manager
     void stop() {
+        // Stop reloads first; a reload takes m_mutex to resize the worker pool
+        m_configWatcher.reset();
+
         std::lock_guard<std::mutex> lock(m_mutex);
         if (!m_running) {
             return;
@@ -82,13 +191,20 @@ public:
 
         m_running = false;
         m_syncQueue.shutdown();
+        wakeIdleWorkers();
 
         // Wait for worker threads to finish
         for (auto& worker : m_workers) {
-            if (worker.joinable()) {
-                worker.join();
+            if (worker.thread.joinable()) {
+                worker.thread.join();
             }
         }
+        for (auto& retired : m_retiredWorkers) {
+            if (retired.joinable()) {
+                retired.join();
+            }
+        }
+        m_retiredWorkers.clear();
 
         // Wait for recovery thread
         if (m_recoveryThread.joinable()) {
@@ -100,6 +216,35 @@ public:
             m_consistencyThread.join();
         }
 
+        // Wait for tier placement thread
+        if (m_tieringThread.joinable()) {
+            m_tieringThread.join();
+        }
+        m_accessMonitor.reset();
+
+        // Wait for the flusher; unflushed files stay PENDING in the log
+        if (m_flushThread.joinable()) {
+            m_flushThread.join();
+        }
+
+        // Wait for the rebalancer; the index keeps unmoved files on their old member
+        if (m_rebalanceThread.joinable()) {
+            m_rebalanceThread.join();
+        }
+        if (m_resilverThread.joinable()) {
+            m_resilverThread.join();
+        }
+
+        // Wait for stats publisher
+        if (m_statsThread.joinable()) {
+            m_statsThread.join();
+        }
+        m_liveStats.reset();
+
+        if (!m_destFilter.save(m_destFilterPath)) {
+            m_metrics->recordMetric("dest_filter_save_failed", m_destFilterPath);
+        }
+
         m_workers.clear();
 
         // Close transaction log
@@ -108,13 +253,99 @@ public:
         m_metrics->recordMetric("sync_manager", "stopped");
     }
 
-    // Schedule a file for synchronization
-    bool syncFile(const std::string& path, SyncPriority priority = SyncPriority::NORMAL) {
+    // Apply a new configuration without restarting.  Concurrency, queue
+    // capacity, bandwidth limit, excludes, verification and retry settings
+    // take effect immediately; root directories and file locations keep their
+    // current values until the next restart.
+    void reloadConfiguration(std::shared_ptr<Configuration> updated) {
+        auto previous = currentConfig();
+        for (const auto& key : updated->restartRequiredChanges(*previous)) {
+            m_metrics->recordMetric("config_restart_required", key);
+        }
+        updated->source_dir = previous->source_dir;
+        updated->dest_dir = previous->dest_dir;
+        updated->array_members = previous->array_members;
+        updated->versions_dir = previous->versions_dir;
+        updated->log_file = previous->log_file;
+        updated->pid_file = previous->pid_file;
+        updated->transaction_log_dir = previous->transaction_log_dir;
+        updated->live_stats_path = previous->live_stats_path;
+        updated->tier_half_life_seconds = previous->tier_half_life_seconds;
+        updated->tier_sketch_items = previous->tier_sketch_items;
+
+        std::shared_ptr<const PathPolicyTrie> policies;
+        try {
+            policies = buildPolicies(*updated);
+        } catch (const std::exception& e) {
+            m_metrics->recordMetric("policy_reload_error", e.what());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_configMutex);
+            m_config = updated;
+            if (policies) {
+                m_policies = std::move(policies);
+            }
+        }
+
+        m_syncQueue.setMaxSize(updated->queue_capacity);
+        applyIoLimits(*updated);
+        m_rebalanceThrottle.setRate(updated->rebalance_bandwidth_bytes);
+        m_tiering.setPromoteAccesses(updated->tier_promote_accesses);
+        StageProfiler::instance().setEnabled(updated->self_profiling);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_running) {
+                resizeWorkers(static_cast<size_t>(updated->num_threads));
+            }
+        }
+
+        m_metrics->recordMetric("config_reloaded", updated->config_file);
+    }
+
+    // Set the task completion callback; call before start()
+    void setCompletionCallback(CompletionCallback callback) {
+        m_onComplete = std::move(callback);
+    }
+
+    // Configuration currently in effect
+    std::shared_ptr<Configuration> currentConfig() const {
+        std::lock_guard<std::mutex> lock(m_configMutex);
+        return m_config;
+    }
+
+    // Path policies currently in effect
+    std::shared_ptr<const PathPolicyTrie> currentPolicies() const {
+        std::lock_guard<std::mutex> lock(m_configMutex);
+        return m_policies;
+    }
+
+    // Number of worker threads currently serving the queue
+    size_t getWorkerCount() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_workers.size();
+    }
+
+    // Schedule a file for synchronization; without an explicit priority the
+    // file's path policy decides
+    bool syncFile(const std::string& path, std::optional<SyncPriority> priority = std::nullopt) {
         if (!m_running) {
             return false;
         }
 
-        SyncTask task(path, "SYNC", priority);
+        if (currentConfig()->isExcluded(path)) {
+            m_metrics->recordMetric("file_excluded", path);
+            return true;
+        }
+
+        SyncPriority effective = priority.value_or(currentPolicies()->lookup(path).priority);
+        if (writesBack(effective)) {
+            markDirty(path, effective);
+            return true;
+        }
+
+        SyncTask task = makeTask(path, "SYNC", effective);
         bool queued = m_syncQueue.enqueue(task);
 
         if (queued) {
@@ -127,15 +358,26 @@ public:
     }
 
     // Schedule a batch of files
-    bool batchSync(const std::vector<std::string>& paths, SyncPriority priority = SyncPriority::NORMAL) {
+    bool batchSync(const std::vector<std::string>& paths, std::optional<SyncPriority> priority = std::nullopt) {
         if (!m_running) {
             return false;
         }
 
         bool allQueued = true;
+        auto config = currentConfig();
+        auto policies = currentPolicies();
 
         for (const auto& path : paths) {
-            SyncTask task(path, "SYNC", priority);
+            if (config->isExcluded(path)) {
+                m_metrics->recordMetric("file_excluded", path);
+                continue;
+            }
+            SyncPriority effective = priority.value_or(policies->lookup(path).priority);
+            if (config->write_back && effective != SyncPriority::CRITICAL) {
+                markDirty(path, effective);
+                continue;
+            }
+            SyncTask task = makeTask(path, "SYNC", effective);
             if (!m_syncQueue.enqueue(task)) {
                 allQueued = false;
                 m_metrics->recordMetric("file_queue_failed", path);
@@ -147,184 +389,1460 @@ public:
         return allQueued;
     }
 
+    // Report an access to a file under the source root (TIERING only); opens
+    // by other processes are reported automatically when fanotify is
+    // available.  A file on the array that becomes hot enough, and is used
+    // more than the cache file it would displace, is promoted back to the
+    // cache.  Without room below the high watermark, the coldest cache files
+    // are demoted to make it, queued at the promotion's priority ahead of it.
+    void recordAccess(const std::string& path) {
+        auto config = currentConfig();
+        if (!m_running || !config->tiering || !m_tiering.recordAccess(path)) {
+            return;
+        }
+        auto [used, capacity] = cacheTierUsage(*config);
+        uint64_t size = m_tiering.sizeOf(path);
+        uint64_t limit = capacity / 100 * static_cast<uint64_t>(config->tier_high_watermark);
+        if (capacity > 0 && used + size > limit) {
+            uint64_t needed = used + size - limit;
+            uint64_t inFlight = m_tiering.getStats().demotingBytes;
+            if (needed > inFlight && !displace(needed - inFlight, *config)) {
+                m_metrics->recordMetric("tier_promote_deferred", path);
+                return;
+            }
+        }
+        promoteFile(path);
+    }
+
+    // Queue a file on the array for promotion to the cache regardless of its
+    // heat; false if it is not array-only or is already moving
+    bool promoteFile(const std::string& path) {
+        if (!m_running || !m_tiering.beginPromotion(path)) {
+            return false;
+        }
+        SyncTask task = makeTask(path, "PROMOTE", SyncPriority::NORMAL);
+        task.setSize(m_tiering.sizeOf(path));
+        if (!m_syncQueue.enqueue(task)) {
+            m_tiering.finishMove(path, TieringEngine::Tier::ARRAY);
+            m_metrics->recordMetric("file_queue_failed", path);
+            return false;
+        }
+        m_metrics->recordMetric("tier_promote_queued", path);
+        return true;
+    }
+
+    // Flush every dirty file now instead of waiting for WRITE_BACK_MAX_AGE
+    void flushDirty() {
+        m_flushRequested = true;
+        wakeIdleWorkers();
+    }
+
     // Trigger a consistency check
     void performConsistencyCheck() {
         m_consistencyCheckRequested = true;
+        wakeIdleWorkers();
     }
 
     // Get current queue statistics
     std::string getQueueStats() {
-        std::stringstream ss;
-        ss << "Queue size: " << m_syncQueue.size() << std::endl;
+        auto backlog = m_syncQueue.getBacklogStats();
 
-        // Additional stats could be added here
+        std::stringstream ss;
+        ss << "Queue size: " << backlog.pending << std::endl;
+        for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+            if (backlog.pendingByPriority[i] > 0) {
+                ss << "  " << toString(static_cast<SyncPriority>(i)) << ": "
+                   << backlog.pendingByPriority[i] << " pending, oldest "
+                   << std::chrono::duration_cast<std::chrono::seconds>(backlog.oldestAge[i]).count()
+                   << "s" << std::endl;
+            }
+        }
+        ss << "Bytes pending: " << backlog.bytesPending << std::endl;
+        ss << "Drain rate: " << backlog.drainTasksPerSecond << " tasks/s, "
+           << backlog.drainBytesPerSecond << " bytes/s" << std::endl;
+        ss << "ETA: " << (backlog.eta ? std::to_string(backlog.eta->count()) + "s" : "unknown") << std::endl;
+
+        auto recovery = m_transactionLog.getInFlightStats();
+        ss << "In-flight transactions: " << recovery.count << std::endl;
+
+        auto dirty = m_dirty.getStats();
+        if (dirty.files > 0) {
+            ss << "Dirty (write-back): " << dirty.files << " files, " << dirty.bytes << " bytes, oldest "
+               << std::chrono::duration_cast<std::chrono::seconds>(dirty.oldestAge).count() << "s" << std::endl;
+        }
 
         return ss.str();
     }
 
+    // Fill a live stats snapshot from the queue, transaction log and devices
+    LiveStatsSnapshot collectLiveStats() {
+        LiveStatsSnapshot snapshot{};
+        snapshot.publishedAtNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        snapshot.pid = static_cast<int32_t>(getpid());
+        snapshot.workers = static_cast<uint32_t>(currentConfig()->num_threads);
+
+        auto backlog = m_syncQueue.getBacklogStats();
+        snapshot.pending = backlog.pending;
+        for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+            snapshot.pendingByPriority[i] = backlog.pendingByPriority[i];
+            snapshot.oldestAgeMs[i] = static_cast<uint64_t>(backlog.oldestAge[i].count());
+        }
+        snapshot.bytesPending = backlog.bytesPending;
+        snapshot.drainTasksPerSecond = backlog.drainTasksPerSecond;
+        snapshot.drainBytesPerSecond = backlog.drainBytesPerSecond;
+        snapshot.etaSeconds = backlog.eta ? backlog.eta->count() : -1;
+
+        auto recovery = m_transactionLog.getInFlightStats();
+        snapshot.inFlight = recovery.count;
+        if (recovery.oldest) {
+            snapshot.oldestInFlightMs = static_cast<uint64_t>(std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now() - *recovery.oldest).count()));
+        }
+
+        snapshot.tasksCompleted = m_tasksCompleted.load(std::memory_order_relaxed);
+        snapshot.tasksFailed = m_tasksFailed.load(std::memory_order_relaxed);
+        snapshot.tasksRetried = m_tasksRetried.load(std::memory_order_relaxed);
+
+        for (const auto& member : m_placement.members()) {
+            if (snapshot.deviceCount == LiveStatsSnapshot::kMaxDevices) {
+                break;
+            }
+            auto& device = snapshot.devices[snapshot.deviceCount++];
+            std::strncpy(device.path, member.root.c_str(), sizeof(device.path) - 1);
+            std::error_code ec;
+            auto space = fs::space(member.root, ec);
+            if (ec) {
+                device.state = LiveStatsSnapshot::DEVICE_MISSING;
+            } else {
+                device.state = LiveStatsSnapshot::DEVICE_ONLINE;
+                device.capacityBytes = space.capacity;
+                device.freeBytes = space.available;
+            }
+        }
+
+        auto latency = m_taskLatency.snapshot();
+        std::copy(latency.begin(), latency.end(), snapshot.latencyBuckets);
+        return snapshot;
+    }
+
+    // Export queue and recovery backlog gauges (oldest age per priority, bytes
+    // pending, drain rate, ETA) to the metrics collector
+    void recordBacklogMetrics() {
+        auto backlog = m_syncQueue.getBacklogStats();
+        for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+            const std::string label = std::string("{priority=\"") + toString(static_cast<SyncPriority>(i)) + "\"}";
+            m_metrics->setGauge("sync_queue_pending" + label, static_cast<double>(backlog.pendingByPriority[i]));
+            m_metrics->setGauge("sync_queue_oldest_age_seconds" + label,
+                                std::chrono::duration<double>(backlog.oldestAge[i]).count());
+        }
+        m_metrics->setGauge("sync_queue_bytes_pending", static_cast<double>(backlog.bytesPending));
+        m_metrics->setGauge("sync_queue_drain_tasks_per_second", backlog.drainTasksPerSecond);
+        m_metrics->setGauge("sync_queue_drain_bytes_per_second", backlog.drainBytesPerSecond);
+        // -1 while nothing is draining and the backlog is non-empty
+        m_metrics->setGauge("sync_queue_eta_seconds",
+                            backlog.eta ? static_cast<double>(backlog.eta->count()) : -1.0);
+
+        auto recovery = m_transactionLog.getInFlightStats();
+        m_metrics->setGauge("recovery_in_flight", static_cast<double>(recovery.count));
+        m_metrics->setGauge("recovery_oldest_age_seconds", recovery.oldest
+            ? std::chrono::duration<double>(std::chrono::system_clock::now() - *recovery.oldest).count()
+            : 0.0);
+    }
+
     // Get transaction log statistics
     std::string getTransactionStats() {
         std::stringstream ss;
 
         auto pendingTransactions = m_transactionLog.getPendingTransactions();
         ss << "Pending transactions: " << pendingTransactions.size() << std::endl;
-
-        // Additional stats could be added here
+        ss << "Startup replay: " << m_startupRecovery.records << " records, "
+           << m_startupRecovery.inFlight << " in flight, "
+           << static_cast<int64_t>(m_startupRecoverySeconds * 1000) << " ms" << std::endl;
 
         return ss.str();
     }
 
+    // What the log replay at construction found
+    TransactionLog::RecoveryStats getStartupRecovery() const {
+        return m_startupRecovery;
+    }
+
+    // Get resource usage per top-level source directory, heaviest first
+    std::string getAccountingStats() {
+        return m_accounting.getSummary();
+    }
+
+    // Get per-stage hardware counters (self-profiling mode only)
+    std::string getProfileStats() {
+        return StageProfiler::instance().getSummary();
+    }
+
+    // Get the I/O profile of every device touched so far
+    std::string getDeviceStats() {
+        return m_deviceProfiler.getSummary();
+    }
+
+    // Get files and bytes per tier and moves in progress
+    std::string getTieringStats() {
+        return m_tiering.getSummary();
+    }
+
+    std::string getRebalanceStats() {
+        return m_rebalancer.getSummary();
+    }
+
+    // Write back everything the index places on the array member at @p root,
+    // after its disk was replaced: whole copies from the cache tier and lost
+    // shards rebuilt from the surviving members.  Runs in the background
+    // like a rebalance.  False if @p root is not a member, the manager is
+    // not running or a resilver is already running.
+    bool resilverMember(const std::string& root) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto& members = m_placement.members();
+        if (!m_running || std::none_of(members.begin(), members.end(),
+                                       [&](const Placement::Member& member) { return member.root == root; })) {
+            return false;
+        }
+        if (m_resilverThread.joinable()) {
+            if (!m_resilver.done()) {
+                return false;
+            }
+            m_resilverThread.join();
+        }
+        auto config = currentConfig();
+        size_t shardCount = config->erasure_data_shards + config->erasure_parity_shards;
+        m_resilver.start(
+            Rebalancer::planResilver(m_index, m_placement, root, m_sourceRoot, shardCount, &DirtySet::physicalOffset));
+        m_metrics->recordMetric("resilver_started", root + " " + m_resilver.getSummary());
+        m_resilverThread = std::thread(&RobustSyncManager::resilverWorker, this);
+        return true;
+    }
+
+    std::string getResilverStats() {
+        return m_resilver.getSummary();
+    }
+
+    // Array path holding @p sourcePath's data.  While a rebalance moves it,
+    // the index names the old member until the new copy is verified, and the
+    // placement's member is used once the old copy is gone.
+    std::string locateOnArray(const std::string& sourcePath) {
+        std::string placed = determineDestinationPaths(sourcePath, currentPolicies()->lookup(sourcePath)).front().second;
+        std::string relative = relativePath(sourcePath);
+        if (auto entry = m_index.find(relative)) {
+            std::string indexed = entry->root + relative;
+            std::error_code ec;
+            if (indexed != placed && fs::exists(indexed, ec)) {
+                return indexed;
+            }
+        }
+        return placed;
+    }
+
+    // Get lock contention statistics (FILE_SYNC_LOCK_PROFILING builds only)
+    std::string getLockStats() {
+        return LockProfiler::instance().getSummary();
+    }
+
 private:
+    // A worker exits once its retire flag is set (pool shrunk by a reload)
+    struct Worker {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> retire;
+    };
+
+    mutable std::mutex m_configMutex;
     std::shared_ptr<Configuration> m_config;
+    std::shared_ptr<const PathPolicyTrie> m_policies;
     std::unique_ptr<MetricsCollector> m_metrics;
     std::unique_ptr<FileVerification> m_fileVerifier;
     TransactionLog m_transactionLog;
+    TransactionLog::RecoveryStats m_startupRecovery;
+    double m_startupRecoverySeconds = 0.0;
     PrioritySyncQueue m_syncQueue;
-
-    std::vector<std::thread> m_workers;
+    // Source and destination roots, fixed for the lifetime of the manager
+    const std::string m_sourceRoot;
+    const std::string m_destRoot;
+    const Placement m_placement; // DEST_DIR and ARRAY_MEMBERS
+    FileIndex m_index;           // member holding each placed file
+    // Destination files verified in sync, persisted beside the index
+    const std::string m_destFilterPath;
+    CuckooFilter m_destFilter;
+    Rebalancer m_rebalancer;
+    Rebalancer m_resilver{"Resilver"};
+    static constexpr size_t kRebalanceWindow = 64; // migrations queued at once
+    TaskAccounting m_accounting;
+    IoThrottle m_ioThrottle{kSyncPriorityLevels}; // copy and verify I/O by device and priority
+    RateLimiter m_rebalanceThrottle; // migrations and resilvers, on top of m_ioThrottle
+    DeviceProfiler m_deviceProfiler;
+    IoProfile m_sourceProfile;
+    DeviceGate m_deviceGate; // per-device copy/verify concurrency
+    TieringEngine m_tiering;
+    std::unique_ptr<AccessMonitor> m_accessMonitor; // owned by the tiering thread until stop()
+    DirtySet m_dirty;
+    std::atomic<bool> m_flushRequested{false};
+    std::unique_ptr<ConfigurationWatcher> m_configWatcher;
+
+    std::unique_ptr<LiveStatsPublisher> m_liveStats;
+    LatencyHistogram m_taskLatency;
+    std::atomic<uint64_t> m_tasksCompleted{0};
+    std::atomic<uint64_t> m_tasksFailed{0};
+    std::atomic<uint64_t> m_tasksRetried{0};
+
+    std::vector<Worker> m_workers;
+    std::vector<std::thread> m_retiredWorkers;
     std::thread m_recoveryThread;
     std::thread m_consistencyThread;
+    std::thread m_tieringThread;
+    std::thread m_flushThread;
+    std::thread m_rebalanceThread;
+    std::thread m_resilverThread;
+    std::thread m_statsThread;
 
     std::mutex m_mutex;
     std::atomic<bool> m_running;
     std::atomic<bool> m_consistencyCheckRequested{false};
+    CompletionCallback m_onComplete;
 
-    // Worker thread function to process tasks from the queue
-    void workerThread() {
-        while (m_running) {
-            auto taskOpt = m_syncQueue.dequeue(std::chrono::milliseconds(100));
+    // Background workers sleep on this so stop() does not wait out their intervals
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleSignal;
 
-            if (taskOpt) {
-                SyncTask task = *taskOpt;
-                processTask(task);
-            }
-        }
+    // Sleep for @p timeout, waking early when the manager stops or @p wake() holds
+    template <typename Rep, typename Period, typename Wake>
+    void idleFor(std::chrono::duration<Rep, Period> timeout, Wake wake) {
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleSignal.wait_for(lock, timeout, [&] { return !m_running || wake(); });
     }
 
-    // Process a single sync task
-    void processTask(const SyncTask& task) {
-        const std::string& sourcePath = task.getPath();
+    void wakeIdleWorkers() {
+        { std::lock_guard<std::mutex> lock(m_idleMutex); }
+        m_idleSignal.notify_all();
+    }
 
-        // Determine destination path (this would be based on your configuration)
-        std::string destPath = determineDestinationPath(sourcePath);
+    // Build a task, recording its size for the bytes-pending gauge
+    SyncTask makeTask(const std::string& path, const std::string& operation, SyncPriority priority) {
+        SyncTask task(path, operation, priority);
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        task.setSize(ec ? 0 : size);
+        return task;
+    }
 
-        // Log the transaction
-        std::string txId = m_transactionLog.logTransaction(
-            TransactionLog::OperationType::COPY,
-            sourcePath,
-            destPath
-        );
+    // DEST_DIR plus ARRAY_MEMBERS, weighted by capacity.  A lone member needs
+    // no weight, so its filesystem need not exist yet.
+    static Placement buildPlacement(const Configuration& config) {
+        std::vector<Configuration::ArrayMember> members{{config.dest_dir, 0}};
+        for (const auto& member : config.array_members) {
+            if (fs::path(member.root).lexically_normal() == fs::path(config.dest_dir).lexically_normal()) {
+                members.front().capacity = member.capacity;
+            } else {
+                members.push_back(member);
+            }
+        }
 
-        if (txId.empty()) {
-            m_metrics->recordMetric("tx_log_failed", sourcePath);
-            return;
+        std::vector<Placement::Member> weighted;
+        for (const auto& member : members) {
+            double weight = static_cast<double>(member.capacity);
+            if (member.capacity == 0 && members.size() > 1) {
+                std::error_code ec;
+                auto space = fs::space(member.root, ec);
+                if (ec || space.capacity == 0) {
+                    throw std::runtime_error("Cannot size array member " + member.root + "; give it as " +
+                                             member.root + ":SIZE in ARRAY_MEMBERS");
+                }
+                weight = static_cast<double>(space.capacity);
+            }
+            weighted.push_back({member.root, members.size() > 1 ? weight : 1.0});
         }
+        return Placement(std::move(weighted));
+    }
 
-        m_metrics->recordMetric("tx_started", txId);
+    // Compile the policy trie: config-wide defaults plus POLICY_FILE rules
+    std::shared_ptr<const PathPolicyTrie> buildPolicies(const Configuration& config) const {
+        PathPolicy defaults;
+        defaults.verifyMethod = FileVerification::methodFromString(config.verify_method);
+        defaults.versioning = !config.versions_dir.empty();
 
-        // Update transaction status to in-progress
-        m_transactionLog.updateTransactionStatus(
-            txId,
-            TransactionLog::TransactionStatus::IN_PROGRESS
-        );
+        std::vector<PathRule> rules;
+        if (!config.policy_file.empty()) {
+            rules = PathPolicyTrie::loadRules(config.policy_file);
+        }
+        return std::make_shared<const PathPolicyTrie>(m_sourceRoot, std::move(defaults), std::move(rules));
+    }
 
-        // Perform the actual sync operation
-        bool success = performSyncOperation(sourcePath, destPath);
+    // Grow or shrink the worker pool (caller holds m_mutex).  Retired workers
+    // finish their current task and are joined on stop().
+    void resizeWorkers(size_t count) {
+        while (m_workers.size() < count) {
+            auto retire = std::make_shared<std::atomic<bool>>(false);
+            m_workers.push_back({std::thread(&RobustSyncManager::workerThread, this, retire), retire});
+        }
+        while (m_workers.size() > count) {
+            m_workers.back().retire->store(true);
+            m_retiredWorkers.push_back(std::move(m_workers.back().thread));
+            m_workers.pop_back();
+        }
+    }
 
-        // Verify the sync was successful
-        bool verified = false;
-        std::string errorMsg;
+    // Worker thread function to process tasks from the queue
+    void workerThread(std::shared_ptr<std::atomic<bool>> retire) {
+        while (m_running && !*retire) {
+            auto taskOpt = m_syncQueue.dequeue(std::chrono::milliseconds(100));
 
-        if (success) {
-            auto result = m_fileVerifier->verifyFile(sourcePath, destPath);
-            verified = result.matches;
-            errorMsg = result.errorMessage;
+            if (taskOpt) {
+                SyncTask task = *taskOpt;
+                processTask(task);
+            }
+        }
+    }
 
-            m_metrics->recordMetric("sync_verification",
-                                    verified ? "success" : "failed: " + errorMsg);
+    // Process a single sync task: copy to every destination its policy names
+    void processTask(const SyncTask& task) {
+        const std::string& sourcePath = task.getPath();
+        auto config = currentConfig();
+        auto policies = currentPolicies();
+        const PathPolicy& policy = policies->lookup(sourcePath);
+        auto resourcesBefore = ResourceSample::capture();
+
+        bool allSynced = true;
+        std::vector<std::string> missed; // destination roots left out of a quorum reached
+        if (task.getOperation() == "DEMOTE") {
+            allSynced = demoteFile(task, policy, *config);
+        } else if (task.getOperation() == "PROMOTE") {
+            allSynced = promoteFromArray(task, policy, *config);
+        } else if (task.getOperation() == "MIGRATE") {
+            allSynced = migrateFile(task, policy, *config);
+        } else if (task.getOperation() == "ENCODE") {
+            allSynced = encodeFile(task, *config);
+        } else if (task.getOperation() == "RESILVER") {
+            allSynced = resilverFile(task, policy, *config);
+        } else if (task.getOperation() == "FLUSH" && !fs::exists(sourcePath)) {
+            // Deleted before it reached the array
+            if (auto txId = m_dirty.flushed(sourcePath, true)) {
+                m_transactionLog.updateTransactionStatus(*txId, TransactionLog::TransactionStatus::ROLLED_BACK,
+                                                         "source removed before flush");
+            }
+            return;
+        } else if (isTierPlaceholder(sourcePath)) {
+            // A stub, or a promotion's own copy: the array already has the data
+            m_metrics->recordMetric("tier_sync_skipped", sourcePath);
         } else {
-            errorMsg = "Sync operation failed";
+            auto destinations = determineDestinationPaths(sourcePath, policy);
+            if (!task.getDestinations().empty()) {
+                // A retry of the replicas a quorum went without
+                const auto& only = task.getDestinations();
+                std::erase_if(destinations, [&](const auto& destination) {
+                    return std::find(only.begin(), only.end(), destination.first) == only.end();
+                });
+            }
+            if (destinations.size() > 1) {
+                allSynced = replicateToDestinations(task, destinations, policy, *config, missed);
+                destinations.clear();
+            }
+            for (const auto& [destRoot, destPath] : destinations) {
+                if (!syncToDestination(task, destRoot, destPath, policy, *config)) {
+                    allSynced = false;
+                } else if (policy.destinations.empty()) {
+                    recordPlacement(sourcePath, destRoot, task.getSize());
+                }
+            }
+            if (allSynced && config->tiering) {
+                m_tiering.track(sourcePath, task.getSize(), TieringEngine::Tier::CACHE);
+            }
         }
 
-        // Update transaction status based on result
-        if (success && verified) {
-            m_transactionLog.updateTransactionStatus(
-                txId,
-                TransactionLog::TransactionStatus::COMPLETED
-            );
-            m_metrics->recordMetric("tx_completed", txId);
-        } else {
-            m_transactionLog.updateTransactionStatus(
-                txId,
-                TransactionLog::TransactionStatus::FAILED,
-                errorMsg
-            );
-            m_metrics->recordMetric("tx_failed", txId + ": " + errorMsg);
+        // Charge the copy and verification (not the retry back-off) to the task
+        TaskCost cost = ResourceSample::capture() - resourcesBefore;
+        m_accounting.record(sourcePath, cost);
+        m_taskLatency.record(cost.wallTime);
+        m_metrics->recordMetric("task_cost", task.getTaskId() + " " + sourcePath + " " + cost.toString());
 
-            // Handle retry logic if needed
-            if (task.getRetryCount() < 3) {
+        if (allSynced) {
+            if (task.getOperation() == "FLUSH") {
+                if (auto txId = m_dirty.flushed(sourcePath, true)) {
+                    m_transactionLog.updateTransactionStatus(*txId, TransactionLog::TransactionStatus::COMPLETED);
+                }
+            } else if (task.getOperation() == "MIGRATE") {
+                m_rebalancer.finished(relativePath(sourcePath), true);
+            } else if (task.getOperation() == "RESILVER") {
+                m_resilver.finished(relativePath(sourcePath), true);
+            }
+            m_tasksCompleted.fetch_add(1, std::memory_order_relaxed);
+            if (m_onComplete) {
+                m_onComplete(task, true);
+            }
+            if (!missed.empty() && task.getRetryCount() < config->max_retries) {
+                // Write the replicas that missed the quorum again, and only those
                 SyncTask retryTask = task;
-                const_cast<SyncTask&>(retryTask).incrementRetry();
-                const_cast<SyncTask&>(retryTask).setStatus("retry");
-
-                // Requeue with a delay
-                std::this_thread::sleep_for(std::chrono::seconds(5));
+                retryTask.setDestinations(missed);
+                retryTask.incrementRetry();
+                retryTask.setStatus("retry");
+                idleFor(std::chrono::seconds(config->retry_delay_seconds), [] { return false; });
                 m_syncQueue.enqueue(retryTask);
-                m_metrics->recordMetric("tx_retry", txId);
+                m_metrics->recordMetric("replica_retry", task.getTaskId());
+            }
+            return;
+        }
+        m_tasksFailed.fetch_add(1, std::memory_order_relaxed);
+
+        // Handle retry logic if needed
+        if (task.getRetryCount() < config->max_retries) {
+            SyncTask retryTask = task;
+            retryTask.incrementRetry();
+            retryTask.setStatus("retry");
+
+            // Requeue with a delay
+            idleFor(std::chrono::seconds(config->retry_delay_seconds), [] { return false; });
+            m_syncQueue.enqueue(retryTask);
+            m_metrics->recordMetric("tx_retry", task.getTaskId());
+            m_tasksRetried.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // Out of retries: the file stays where it was
+            if (task.getOperation() == "DEMOTE") {
+                m_tiering.finishMove(sourcePath, TieringEngine::Tier::CACHE);
+            } else if (task.getOperation() == "PROMOTE" || task.getOperation() == "ENCODE") {
+                m_tiering.finishMove(sourcePath, TieringEngine::Tier::ARRAY);
+            } else if (task.getOperation() == "FLUSH") {
+                m_dirty.flushed(sourcePath, false);
+            } else if (task.getOperation() == "MIGRATE") {
+                m_rebalancer.finished(relativePath(sourcePath), false);
+            } else if (task.getOperation() == "RESILVER") {
+                m_resilver.finished(relativePath(sourcePath), false);
+            }
+            if (m_onComplete) {
+                m_onComplete(task, false);
             }
         }
     }
 
-    // Determine the destination path for a source file
-    std::string determineDestinationPath(const std::string& sourcePath) {
-        // This would be based on your specific synchronization rules
-        // For now, this is a dummy implementation
+    // Write-back applies to everything but CRITICAL files
+    bool writesBack(SyncPriority priority) {
+        return currentConfig()->write_back && priority != SyncPriority::CRITICAL;
+    }
 
-        // Example: Replace source directory with destination directory
-        std::string sourceRoot = "/path/to/source";
-        std::string destRoot = "/path/to/destination";
+    // Acknowledge a change once it is on the cache tier: record it dirty,
+    // with a PENDING transaction if it was clean, for the flusher
+    void markDirty(const std::string& path, SyncPriority priority) {
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        bool wasClean = m_dirty.markDirty(path, ec ? 0 : size, priority, [&] {
+            std::string destPath = determineDestinationPaths(path, currentPolicies()->lookup(path)).front().second;
+            std::string txId = m_transactionLog.logTransaction(TransactionLog::OperationType::COPY, path, destPath);
+            if (txId.empty()) {
+                m_metrics->recordMetric("tx_log_failed", path);
+            }
+            return txId;
+        });
+        m_metrics->recordMetric(wasClean ? "file_dirty" : "file_redirtied", path);
+    }
 
-        if (sourcePath.find(sourceRoot) == 0) {
-            return destRoot + sourcePath.substr(sourceRoot.length());
+    // Note that a sync put @p sourcePath on @p root; a copy left on another
+    // member by an earlier placement is stale and goes
+    void recordPlacement(const std::string& sourcePath, const std::string& root, uint64_t size) {
+        std::string relative = relativePath(sourcePath);
+        auto indexed = m_index.find(relative);
+        if (auto previous = m_index.put(relative, root, size)) {
+            std::error_code ec;
+            fs::remove(*previous + relative, ec);
+            m_metrics->recordMetric("rebalance_superseded", *previous + relative);
         }
+        if (indexed && indexed->erasure) {
+            ErasureStore::remove(arrayRoots(), relative);
+            m_metrics->recordMetric("erasure_superseded", relative);
+        }
+    }
 
-        return "/path/to/destination/" + fs::path(sourcePath).filename().string();
+    std::vector<std::string> arrayRoots() const {
+        std::vector<std::string> roots;
+        for (const auto& member : m_placement.members()) {
+            roots.push_back(member.root);
+        }
+        return roots;
     }
 
-    // Perform the actual synchronization operation
-    bool performSyncOperation(const std::string& sourcePath, const std::string& destPath) {
-        try {
-            // Make sure destination directory exists
-            fs::path destDir = fs::path(destPath).parent_path();
-            if (!fs::exists(destDir)) {
-                fs::create_directories(destDir);
-            }
+    // ENCODE: rewrite a cold array copy as k + m shards on the first members
+    // of its placement ranking and check them against it, then point the
+    // index at the shards and drop the copy.  Until then the index names the
+    // whole copy, so a crash leaves at worst some orphaned shards that the
+    // next encode overwrites.
+    bool encodeFile(const SyncTask& task, const Configuration& config) {
+        const std::string& sourcePath = task.getPath();
+        std::string relative = relativePath(sourcePath);
+        auto entry = m_index.find(relative);
+        if (!entry || entry->erasure || config.erasure_data_shards == 0 ||
+            config.erasure_data_shards + config.erasure_parity_shards > m_placement.size()) {
+            // Already encoded, re-synced whole, or erasure coding turned off since
+            m_tiering.finishMove(sourcePath, TieringEngine::Tier::ARRAY);
+            return true;
+        }
+        std::string wholePath = entry->root + relative;
+        auto version = TieringEngine::versionOf(wholePath);
+        if (!version) {
+            m_tiering.finishMove(sourcePath, TieringEngine::Tier::ARRAY);
+            m_metrics->recordMetric("erasure_missing", wholePath);
+            return true;
+        }
 
-            // Copy the file with overwrite
-            fs::copy(sourcePath, destPath, fs::copy_options::overwrite_existing);
+        ReedSolomon rs(config.erasure_data_shards, config.erasure_parity_shards);
+        std::vector<std::string> shardRoots, shardPaths;
+        auto order = m_placement.rank(relative);
+        for (size_t i = 0; i < rs.totalShards(); ++i) {
+            shardRoots.push_back(m_placement.members()[order[i]].root);
+            shardPaths.push_back(ErasureStore::shardPath(shardRoots.back(), relative, i));
+        }
 
-            // Preserve timestamps
-            auto sourceTime = fs::last_write_time(sourcePath);
-            fs::last_write_time(destPath, sourceTime);
+        std::string txId = m_transactionLog.logTransaction(TransactionLog::OperationType::ENCODE, sourcePath, wholePath);
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", sourcePath);
+            return false;
+        }
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+        // Each member is charged for the shard written to it
+        for (const auto& shardPath : shardPaths) {
+            chargeIo(task, m_deviceProfiler.profileFor(shardPath), version->size / rs.dataShards());
+        }
 
-            return true;
+        bool success = false;
+        std::string errorMsg = "shards do not match the array copy";
+        try {
+            {
+                StageProfiler::Scope stage("copy");
+                ErasureStore::encode(rs, wholePath, shardPaths);
+            }
+            StageProfiler::Scope stage("verify");
+            auto shards = ErasureStore::locate(arrayRoots(), relative);
+            success = shards && ErasureStore::verify(*shards, wholePath);
         } catch (const std::exception& e) {
-            m_metrics->recordMetric("sync_error", std::string(e.what()) + ": " + sourcePath);
+            errorMsg = e.what();
+        }
+        if (!success) {
+            ErasureStore::remove(arrayRoots(), relative);
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, errorMsg);
+            m_metrics->recordMetric("erasure_encode_failed", errorMsg + ": " + wholePath);
             return false;
         }
-    }
-
-    // Worker to handle recovery of failed transactions
-    void recoveryWorker() {
-        while (m_running) {
-            // Run recovery every minute
-            std::this_thread::sleep_for(std::chrono::minutes(1));
 
-            if (!m_running) break;
-
-            try {
-                // Get all pending and in-progress transactions
-                auto pendingTransactions = m_transactionLog.getPendingTransactions();
+        auto current = m_index.find(relative);
+        if (TieringEngine::versionOf(wholePath) != version || !current || current->erasure ||
+            current->root != entry->root) {
+            // Synced again while it was encoded; the new copy stands
+            ErasureStore::remove(arrayRoots(), relative);
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::ROLLED_BACK,
+                                                     "rewritten during encoding");
+            m_tiering.finishMove(sourcePath, TieringEngine::Tier::ARRAY);
+            return true;
+        }
+        // The shards stay where they are when members change; resilver finds them here
+        m_index.putErasure(relative, version->size, shardRoots);
+        std::error_code ec;
+        fs::remove(wholePath, ec);
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::COMPLETED);
+        m_tiering.finishMove(sourcePath, TieringEngine::Tier::ARRAY);
+        m_metrics->recordMetric("erasure_encoded", wholePath + " " + std::to_string(rs.dataShards()) + "+" +
+                                                       std::to_string(rs.parityShards()));
+        return true;
+    }
+
+    // MIGRATE: copy a file to the member the placement now names, verify it,
+    // then point the index at it and drop the old copy.  Until then the index
+    // names the old member, so locateOnArray() always finds a whole copy.
+    bool migrateFile(const SyncTask& task, const PathPolicy& policy, const Configuration& config) {
+        const std::string& sourcePath = task.getPath();
+        std::string relative = relativePath(sourcePath);
+        auto entry = m_index.find(relative);
+        const std::string& target = m_placement.rootFor(relative);
+        if (!entry || entry->root == target) {
+            // Re-synced to its new member in the meantime
+            return true;
+        }
+        std::string from = entry->root + relative;
+        std::string to = target + relative;
+
+        m_rebalanceThrottle.acquire(entry->size);
+        std::error_code ec;
+        if (fs::exists(sourcePath, ec) && !isTierPlaceholder(sourcePath)) {
+            // The cache tier has the data: read it there rather than seek the old member
+            if (!syncToDestination(task, target, to, policy, config)) {
+                return false;
+            }
+        } else if (fs::exists(from, ec)) {
+            if (!copyBetweenMembers(task, from, to, policy, config)) {
+                return false;
+            }
+        } else {
+            m_index.remove(relative);
+            m_metrics->recordMetric("rebalance_missing", from);
+            return true;
+        }
+
+        auto size = fs::file_size(to, ec);
+        recordPlacement(sourcePath, target, ec ? entry->size : size);
+        m_metrics->recordMetric("rebalance_moved", from + " -> " + to);
+        return true;
+    }
+
+    // RESILVER: write a file the index places on a replaced member back to
+    // it.  A whole copy is synced from the cache tier as usual.  For an
+    // erasure-coded file the shard headers on the members say which indices
+    // are missing and the file's k + m; each missing index the index puts on
+    // this member (every missing one, for files encoded before shard roots
+    // were recorded) is rebuilt from the others into a temporary file renamed
+    // over it, so a crash leaves nothing a reader would take for a shard.
+    bool resilverFile(const SyncTask& task, const PathPolicy& policy, const Configuration& config) {
+        const std::string& sourcePath = task.getPath();
+        std::string relative = relativePath(sourcePath);
+        auto move = m_resilver.inFlight(relative);
+        auto entry = m_index.find(relative);
+        if (!move || !entry) {
+            return true;
+        }
+        std::error_code ec;
+        if (!move->shard) {
+            if (entry->erasure || entry->root != move->to) {
+                // Moved, encoded or re-synced since it was planned
+                return true;
+            }
+            std::string destPath = move->to + relative;
+            if (fs::exists(sourcePath, ec) && !TieringEngine::stubTarget(sourcePath)) {
+                m_rebalanceThrottle.acquire(entry->size);
+                if (!syncToDestination(task, move->to, destPath, policy, config)) {
+                    return false;
+                }
+                m_metrics->recordMetric("resilver_copied", destPath);
+                return true;
+            }
+            if (!fs::exists(destPath, ec)) {
+                // Only a stub on the cache tier: no copy survives
+                m_resilver.finished(relative, false);
+                m_metrics->recordMetric("resilver_lost", destPath);
+            }
+            return true;
+        }
+
+        if (!entry->erasure) {
+            return true;
+        }
+        auto shards = ErasureStore::locate(arrayRoots(), relative);
+        if (!shards) {
+            m_resilver.finished(relative, false);
+            m_metrics->recordMetric("resilver_lost", ErasureStore::shardPath(move->to, relative, *move->shard));
+            return true;
+        }
+        bool recorded = entry->shardRoots.size() == shards->paths.size();
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < shards->paths.size(); ++i) {
+            if (shards->paths[i].empty() && (!recorded || entry->shardRoots[i] == move->to)) {
+                missing.push_back(i);
+            }
+        }
+        if (missing.empty()) {
+            // Rebuilt already, or this member's shard survived
+            return true;
+        }
+
+        // k shards are read for each one written; the budget is taken
+        // before the device slot, so waiting for it holds no slot
+        m_rebalanceThrottle.acquire(entry->size);
+        IoProfile destProfile = m_deviceProfiler.profileFor(move->to);
+        chargeIo(task, destProfile, entry->size / shards->header.dataShards * missing.size());
+        auto deviceSlot = m_deviceGate.acquire(destProfile);
+        for (size_t index : missing) {
+            std::string shardPath = ErasureStore::shardPath(move->to, relative, index);
+            try {
+                StageProfiler::Scope stage("copy");
+                size_t degraded = ErasureStore::rebuild(*shards, index, shardPath,
+                                                        std::max(1u, std::thread::hardware_concurrency() / 4));
+                if (degraded > 0) {
+                    m_metrics->recordMetric("erasure_degraded_read",
+                                            std::to_string(degraded) + " more shards rebuilt around: " + shardPath);
+                }
+            } catch (const std::system_error& e) {
+                // The new member failed a write; retried
+                m_metrics->recordMetric("resilver_failed", std::string(e.what()) + ": " + shardPath);
+                return false;
+            } catch (const std::runtime_error& e) {
+                // Fewer than k shards left
+                m_resilver.finished(relative, false);
+                m_metrics->recordMetric("resilver_lost", std::string(e.what()) + ": " + shardPath);
+                return true;
+            }
+            shards->paths[index] = shardPath;
+            m_metrics->recordMetric("resilver_rebuilt", shardPath);
+        }
+        return true;
+    }
+
+    // Copy an array copy to another member and verify it against the original
+    bool copyBetweenMembers(const SyncTask& task, const std::string& from, const std::string& to,
+                            const PathPolicy& policy, const Configuration& config) {
+        // Logged against the source path, which recovery knows how to sync
+        std::string txId = m_transactionLog.logTransaction(TransactionLog::OperationType::MOVE, task.getPath(), to);
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", task.getPath());
+            return false;
+        }
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+
+        IoProfile destProfile = m_deviceProfiler.profileFor(to);
+        CopyOptions copyOptions = copyOptionsFor(m_deviceProfiler.profileFor(from), destProfile);
+        if (auto forced = copyStrategyFromString(config.copy_engine)) {
+            copyOptions.strategy = *forced;
+        }
+        if (config.copy_buffer_size > 0) {
+            copyOptions.bufferSize = config.copy_buffer_size;
+        }
+        auto deviceSlot = m_deviceGate.acquire(destProfile);
+        copyOptions.throttle = ioPacer(task, {ioDevice(destProfile)}, {&deviceSlot});
+
+        bool success;
+        {
+            StageProfiler::Scope stage("copy");
+            success = performSyncOperation(from, to, copyOptions);
+        }
+        std::string errorMsg = "copy between array members failed";
+        if (success) {
+            StageProfiler::Scope stage("verify");
+            auto result = m_fileVerifier->verifyFile(from, to, policy.verifyMethod, copyOptions.throttle);
+            success = result.matches;
+            errorMsg = result.errorMessage;
+        }
+        if (!success) {
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, errorMsg);
+            m_metrics->recordMetric("tx_failed", txId + ": " + errorMsg);
+            return false;
+        }
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::COMPLETED);
+        return true;
+    }
+
+    // True for cache-tier files whose content is already on the array: stubs,
+    // and promoted copies nobody has written to since
+    bool isTierPlaceholder(const std::string& path) {
+        if (TieringEngine::stubTarget(path)) {
+            return true;
+        }
+        auto version = TieringEngine::versionOf(path);
+        return version && m_tiering.isPromotedCopy(path, *version);
+    }
+
+    // DEMOTE: make sure every destination holds the current data, then replace
+    // the cache copy with a stub or remove it
+    bool demoteFile(const SyncTask& task, const PathPolicy& policy, const Configuration& config) {
+        const std::string& cachePath = task.getPath();
+        if (TieringEngine::stubTarget(cachePath)) {
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::ARRAY);
+            return true;
+        }
+        auto version = TieringEngine::versionOf(cachePath);
+        if (!version) {
+            // Deleted since it was planned
+            m_tiering.forget(cachePath);
+            return true;
+        }
+
+        // The array copies must match before the cache copy goes; a copy is
+        // only made when verification fails.  An unchanged promoted copy of
+        // an erasure-coded file is still held by its shards.
+        auto destinations = determineDestinationPaths(cachePath, policy);
+        auto indexed = m_index.find(relativePath(cachePath));
+        bool encoded = indexed && indexed->erasure && m_tiering.isPromotedCopy(cachePath, *version);
+        if (!encoded) {
+            for (const auto& [destRoot, destPath] : destinations) {
+                std::error_code ec;
+                bool current = false;
+                if (fs::exists(destPath, ec)) {
+                    StageProfiler::Scope stage("verify");
+                    current = m_fileVerifier->verifyFile(cachePath, destPath, policy.verifyMethod).matches;
+                }
+                if (!current && !syncToDestination(task, destRoot, destPath, policy, config)) {
+                    return false;
+                }
+            }
+            if (policy.destinations.empty()) {
+                recordPlacement(cachePath, destinations.front().first, version->size);
+            }
+        }
+        const std::string& arrayPath = destinations.front().second;
+
+        std::string txId = m_transactionLog.logTransaction(TransactionLog::OperationType::MOVE, cachePath, arrayPath);
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", cachePath);
+            return false;
+        }
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+
+        bool replaced = false;
+        try {
+            bool remove = config.tier_demote_mode == "remove";
+            if (!remove) {
+                try {
+                    replaced = TieringEngine::makeStub(cachePath, arrayPath, *version);
+                } catch (const std::system_error& e) {
+                    if (e.code() != std::errc::not_supported && e.code() != std::errc::operation_not_supported) {
+                        throw;
+                    }
+                    // No user xattrs on the cache filesystem: leave the file array-only
+                    m_metrics->recordMetric("tier_stub_unsupported", cachePath);
+                    remove = true;
+                }
+            }
+            if (remove) {
+                replaced = TieringEngine::versionOf(cachePath) == version && fs::remove(cachePath);
+            }
+        } catch (const std::exception& e) {
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, e.what());
+            m_metrics->recordMetric("tier_demote_failed", std::string(e.what()) + ": " + cachePath);
+            return false;
+        }
+
+        if (!replaced) {
+            // Written while the array copy was checked; it is hot after all
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED,
+                                                     "modified during demotion");
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::CACHE);
+            m_metrics->recordMetric("tier_demote_abandoned", cachePath);
+            return true;
+        }
+
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::COMPLETED);
+        m_tiering.finishMove(cachePath, TieringEngine::Tier::ARRAY);
+        m_metrics->recordMetric("tier_demoted", cachePath);
+        return true;
+    }
+
+    // PROMOTE: copy the array copy next to the stub, verify it and rename it
+    // over the stub so readers never see a partial file.  An erasure-coded
+    // file is decoded instead, from whichever k shards are readable.
+    bool promoteFromArray(const SyncTask& task, const PathPolicy& policy, const Configuration& config) {
+        const std::string& cachePath = task.getPath();
+        // The stub names the array copy it was made from; a rebalance or an
+        // encode may have moved it since
+        std::error_code ec;
+        std::optional<ErasureStore::Shards> shards;
+        std::string arrayPath = TieringEngine::stubTarget(cachePath).value_or("");
+        auto indexed = m_index.find(relativePath(cachePath));
+        if (indexed && indexed->erasure) {
+            shards = ErasureStore::locate(arrayRoots(), relativePath(cachePath));
+            if (!shards) {
+                m_metrics->recordMetric("tier_promote_failed", "no shards: " + cachePath);
+                return false;
+            }
+            auto first = std::find_if(shards->paths.begin(), shards->paths.end(),
+                                      [](const std::string& path) { return !path.empty(); });
+            arrayPath = *first;
+        } else if (arrayPath.empty() || !fs::exists(arrayPath, ec)) {
+            arrayPath = locateOnArray(cachePath);
+        }
+
+        if (fs::exists(cachePath, ec) && !TieringEngine::stubTarget(cachePath)) {
+            // Rewritten on the cache in the meantime; that copy wins
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::CACHE);
+            return true;
+        }
+
+        // Logged against the cache path and its temporary file, which
+        // recovery discards rather than syncing the array copy anywhere
+        std::string tmp = promotionTemp(cachePath);
+        std::string txId = m_transactionLog.logTransaction(TransactionLog::OperationType::COPY, cachePath, tmp);
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", cachePath);
+            return false;
+        }
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+
+        CopyOptions copyOptions = copyOptionsFor(m_deviceProfiler.profileFor(arrayPath), m_sourceProfile);
+        if (auto forced = copyStrategyFromString(config.copy_engine)) {
+            copyOptions.strategy = *forced;
+        }
+        if (config.copy_buffer_size > 0) {
+            copyOptions.bufferSize = config.copy_buffer_size;
+        }
+        copyOptions.throttle = ioPacer(task, {ioDevice(m_sourceProfile)});
+
+        bool success;
+        std::string errorMsg = "copy from array failed";
+        if (shards) {
+            // The decode checks each shard's header and length; there is no
+            // whole copy left to verify against
+            StageProfiler::Scope stage("copy");
+            try {
+                chargeIo(task, m_sourceProfile, task.getSize());
+                if (size_t missing = ErasureStore::restore(*shards, tmp)) {
+                    m_metrics->recordMetric("erasure_degraded_read",
+                                            std::to_string(missing) + " shards rebuilt: " + cachePath);
+                }
+                success = true;
+            } catch (const std::exception& e) {
+                success = false;
+                errorMsg = e.what();
+            }
+        } else {
+            {
+                StageProfiler::Scope stage("copy");
+                success = performSyncOperation(arrayPath, tmp, copyOptions);
+            }
+            if (success) {
+                StageProfiler::Scope stage("verify");
+                auto result = m_fileVerifier->verifyFile(arrayPath, tmp, policy.verifyMethod, copyOptions.throttle);
+                success = result.matches;
+                errorMsg = result.errorMessage;
+            }
+        }
+        if (success && fs::exists(cachePath, ec) && !TieringEngine::stubTarget(cachePath)) {
+            fs::remove(tmp, ec);
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::ROLLED_BACK,
+                                                     "rewritten on the cache during promotion");
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::CACHE);
+            return true;
+        }
+        if (success) {
+            fs::rename(tmp, cachePath, ec);
+            success = !ec;
+            errorMsg = ec.message();
+        }
+        if (!success) {
+            fs::remove(tmp, ec);
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, errorMsg);
+            m_metrics->recordMetric("tier_promote_failed", errorMsg + ": " + cachePath);
+            return false;
+        }
+
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::COMPLETED);
+        m_tiering.finishMove(cachePath, TieringEngine::Tier::CACHE, TieringEngine::versionOf(cachePath));
+        m_metrics->recordMetric("tier_promoted", cachePath);
+        return true;
+    }
+
+    // Copy and verify one source/destination pair under its own transaction
+    bool syncToDestination(const SyncTask& task, const std::string& destRoot, const std::string& destPath,
+                           const PathPolicy& policy, const Configuration& config) {
+        const std::string& sourcePath = task.getPath();
+
+        // Log the transaction
+        std::string txId;
+        {
+            StageProfiler::Scope stage("wal");
+            txId = m_transactionLog.logTransaction(
+                TransactionLog::OperationType::COPY,
+                sourcePath,
+                destPath
+            );
+        }
+
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", sourcePath);
+            return false;
+        }
+
+        m_metrics->recordMetric("tx_started", txId);
+
+        // Update transaction status to in-progress
+        {
+            StageProfiler::Scope stage("wal");
+            m_transactionLog.updateTransactionStatus(
+                txId,
+                TransactionLog::TransactionStatus::IN_PROGRESS
+            );
+        }
+
+        // Perform the actual sync operation, within the destination device's concurrency
+        IoProfile destProfile = m_deviceProfiler.profileFor(destRoot);
+        CopyOptions copyOptions = copyOptionsFor(m_sourceProfile, destProfile);
+        if (auto forced = copyStrategyFromString(config.copy_engine)) {
+            copyOptions.strategy = *forced;
+        }
+        if (config.copy_buffer_size > 0) {
+            copyOptions.bufferSize = config.copy_buffer_size;
+        }
+        auto deviceSlot = m_deviceGate.acquire(destProfile);
+        copyOptions.throttle = ioPacer(task, {ioDevice(destProfile)}, {&deviceSlot});
+
+        // Taken before the copy: a write during it changes the mtime, so
+        // the filter never vouches for a version that was not verified
+        auto version = TieringEngine::versionOf(sourcePath);
+        bool success;
+        {
+            StageProfiler::Scope stage("copy");
+            if (policy.versioning) {
+                preserveVersion(destRoot, destPath, config.versions_dir);
+            }
+            if (policy.compression) {
+                requestCompression(destPath);
+            }
+            success = performSyncOperation(sourcePath, destPath, copyOptions);
+        }
+
+        // Verify the sync was successful
+        bool verified = false;
+        std::string errorMsg;
+
+        if (success) {
+            FileVerification::VerifyResult result;
+            {
+                StageProfiler::Scope stage("verify");
+                result = m_fileVerifier->verifyFile(sourcePath, destPath, policy.verifyMethod, copyOptions.throttle);
+            }
+            SYNC_PROBE(verify_result, sourcePath.c_str(), static_cast<int>(result.matches),
+                       result.duration.count());
+            verified = result.matches;
+            errorMsg = result.errorMessage;
+
+            m_metrics->recordMetric("sync_verification",
+                                    verified ? "success" : "failed: " + errorMsg);
+        } else {
+            errorMsg = "Sync operation failed";
+        }
+
+        // Update transaction status based on result
+        if (success && verified) {
+            m_transactionLog.updateTransactionStatus(
+                txId,
+                TransactionLog::TransactionStatus::COMPLETED
+            );
+            m_metrics->recordMetric("tx_completed", txId);
+            if (version) {
+                m_destFilter.insert(CuckooFilter::key(destRoot, relativePath(sourcePath), version->size,
+                                                      version->mtimeNs));
+            }
+            return true;
+        }
+
+        m_transactionLog.updateTransactionStatus(
+            txId,
+            TransactionLog::TransactionStatus::FAILED,
+            errorMsg
+        );
+        m_metrics->recordMetric("tx_failed", txId + ": " + errorMsg);
+        return false;
+    }
+
+    // Path below SOURCE_DIR with a leading '/'; the file name for paths outside it
+    std::string relativePath(const std::string& sourcePath) const {
+        if (sourcePath.find(m_sourceRoot) == 0) {
+            return sourcePath.substr(m_sourceRoot.length());
+        }
+        return "/" + fs::path(sourcePath).filename().string();
+    }
+
+    // Several destinations: read the source once and write every destination
+    // at the same time (CopyEngine::fanOutCopy) under one REPLICATE
+    // transaction.  Each replica is verified as soon as it is synced, and the
+    // transaction is COMPLETED in the log when policy.quorum of them are,
+    // without waiting for the rest.  Returns whether the quorum was reached;
+    // if it was but some replica failed, that destination's root is added to
+    // @p missed.
+    bool replicateToDestinations(const SyncTask& task,
+                                 const std::vector<std::pair<std::string, std::string>>& destinations,
+                                 const PathPolicy& policy, const Configuration& config,
+                                 std::vector<std::string>& missed) {
+        const std::string& sourcePath = task.getPath();
+        std::vector<std::string> paths;
+        for (const auto& destination : destinations) {
+            paths.push_back(destination.second);
+        }
+        auto quorum = static_cast<uint32_t>(policy.quorum == 0 ? paths.size() : std::min(policy.quorum, paths.size()));
+
+        std::string txId;
+        {
+            StageProfiler::Scope stage("wal");
+            txId = m_transactionLog.logReplication(sourcePath, paths, quorum);
+        }
+        if (txId.empty()) {
+            m_metrics->recordMetric("tx_log_failed", sourcePath);
+            return false;
+        }
+        m_metrics->recordMetric("tx_started", txId);
+        m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+
+        // A slot on every destination device, taken in device order so two
+        // fan-outs never wait on each other's devices
+        std::vector<IoProfile> profiles;
+        for (const auto& destination : destinations) {
+            profiles.push_back(m_deviceProfiler.profileFor(destination.first));
+        }
+        CopyOptions copyOptions = copyOptionsFor(m_sourceProfile, profiles.front());
+        if (config.copy_buffer_size > 0) {
+            copyOptions.bufferSize = config.copy_buffer_size;
+        }
+        // Every chunk read is written once per destination
+        std::vector<std::string> destDevices;
+        for (const auto& profile : profiles) {
+            destDevices.push_back(ioDevice(profile));
+        }
+        std::sort(profiles.begin(), profiles.end(),
+                  [](const IoProfile& a, const IoProfile& b) { return a.deviceId < b.deviceId; });
+        profiles.erase(std::unique(profiles.begin(), profiles.end(),
+                                   [](const IoProfile& a, const IoProfile& b) { return a.deviceId == b.deviceId; }),
+                       profiles.end());
+        std::vector<DeviceGate::Slot> deviceSlots;
+        for (const auto& profile : profiles) {
+            deviceSlots.push_back(m_deviceGate.acquire(profile));
+        }
+        std::vector<DeviceGate::Slot*> slots;
+        for (auto& slot : deviceSlots) {
+            slots.push_back(&slot);
+        }
+        auto pacer = ioPacer(task, destDevices, slots);
+
+        std::error_code ec;
+        for (const auto& [destRoot, destPath] : destinations) {
+            if (policy.versioning) {
+                preserveVersion(destRoot, destPath, config.versions_dir);
+            }
+            if (policy.compression) {
+                requestCompression(destPath);
+            }
+            fs::create_directories(fs::path(destPath).parent_path(), ec);
+        }
+
+        // Taken before the copy, as in syncToDestination()
+        auto version = TieringEngine::versionOf(sourcePath);
+        std::vector<char> durable(paths.size(), 0);
+        std::vector<std::string> verifyErrors(paths.size());
+        FanOutResult copied;
+        try {
+            StageProfiler::Scope stage("copy");
+            SYNC_PROBE(copy_start, sourcePath.c_str(), paths.front().c_str());
+            copied = CopyEngine::fanOutCopy(sourcePath, paths, copyOptions.bufferSize, [&](size_t index) {
+                auto result = m_fileVerifier->verifyFile(sourcePath, paths[index], policy.verifyMethod,
+                                                         ioPacer(task, {destDevices[index]}, slots));
+                if (!result.matches) {
+                    verifyErrors[index] = "verification failed: " + result.errorMessage;
+                    return;
+                }
+                durable[index] = 1;
+                if (m_transactionLog.recordDurableReplica(txId, paths[index])) {
+                    m_metrics->recordMetric("tx_quorum", txId);
+                }
+            }, pacer);
+            SYNC_PROBE(copy_end, sourcePath.c_str(), paths.front().c_str(), 1);
+        } catch (const std::exception& e) {
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, e.what());
+            m_metrics->recordMetric("tx_failed", txId + ": " + e.what());
+            return false;
+        }
+
+        size_t durableCount = 0;
+        std::string failures;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (durable[i]) {
+                durableCount++;
+                if (version) {
+                    m_destFilter.insert(CuckooFilter::key(destinations[i].first, relativePath(sourcePath),
+                                                          version->size, version->mtimeNs));
+                }
+            } else {
+                missed.push_back(destinations[i].first);
+                failures += (failures.empty() ? "" : "; ") + paths[i] + ": " +
+                            (copied.errors[i].empty() ? verifyErrors[i] : copied.errors[i]);
+            }
+        }
+        m_metrics->recordMetric("replication", txId + " " + std::to_string(durableCount) + "/" +
+                                                   std::to_string(paths.size()) + " replicas durable");
+        if (durableCount < quorum) {
+            missed.clear();
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::FAILED, failures);
+            m_metrics->recordMetric("tx_failed", txId + ": " + failures);
+            return false;
+        }
+        if (!failures.empty()) {
+            m_transactionLog.updateTransactionStatus(txId, TransactionLog::TransactionStatus::COMPLETED,
+                                                     "quorum reached; failed " + failures);
+            m_metrics->recordMetric("replica_degraded", sourcePath + ": " + failures);
+        }
+        m_metrics->recordMetric("tx_completed", txId);
+        return true;
+    }
+
+    // Destination (root, path) pairs for a source file: the policy's
+    // destinations, or the array member the path hashes to when it names none
+    std::vector<std::pair<std::string, std::string>> determineDestinationPaths(
+        const std::string& sourcePath, const PathPolicy& policy) {
+        std::string relative = relativePath(sourcePath);
+
+        std::vector<std::pair<std::string, std::string>> destinations;
+        if (policy.destinations.empty()) {
+            const std::string& root = m_placement.rootFor(relative);
+            destinations.emplace_back(root, root + relative);
+        }
+        for (const auto& root : policy.destinations) {
+            destinations.emplace_back(root, root + relative);
+        }
+        return destinations;
+    }
+
+    // Move the current destination copy to VERSIONS_DIR/<timestamp>/<relative
+    // path>, the layout photo-sync.sh's rsync --backup-dir produces
+    void preserveVersion(const std::string& destRoot, const std::string& destPath, const std::string& versionsDir) {
+        std::error_code ec;
+        if (versionsDir.empty() || !fs::exists(destPath, ec)) {
+            return;
+        }
+
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm local{};
+        localtime_r(&now, &local);
+        std::stringstream stamp;
+        stamp << std::put_time(&local, "%Y-%m-%d_%H-%M-%S");
+
+        fs::path versionPath = fs::path(versionsDir) / stamp.str() /
+                               fs::path(destPath).lexically_relative(destRoot);
+        fs::create_directories(versionPath.parent_path(), ec);
+        fs::rename(destPath, versionPath, ec);
+        if (ec) {
+            // Different filesystem: keep a copy; the sync overwrites the original
+            ec.clear();
+            fs::copy_file(destPath, versionPath, fs::copy_options::overwrite_existing, ec);
+        }
+        if (ec) {
+            m_metrics->recordMetric("version_error", ec.message() + ": " + destPath);
+        } else {
+            m_metrics->recordMetric("version_saved", versionPath.string());
+        }
+    }
+
+    // Mark the destination file for transparent compression (FS_COMPR_FL,
+    // honoured by btrfs and similar); other filesystems store it as is
+    void requestCompression(const std::string& destPath) {
+        std::error_code ec;
+        fs::create_directories(fs::path(destPath).parent_path(), ec);
+        int fd = ::open(destPath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            return;
+        }
+        int flags = 0;
+        if (ioctl(fd, FS_IOC_GETFLAGS, &flags) == 0) {
+            flags |= FS_COMPR_FL;
+            if (ioctl(fd, FS_IOC_SETFLAGS, &flags) != 0) {
+                m_metrics->recordMetric("compression_unsupported", destPath);
+            }
+        }
+        ::close(fd);
+    }
+
+    // m_ioThrottle's name for the device of @p profile, as DeviceGate keys it
+    static std::string ioDevice(const IoProfile& profile) { return std::to_string(profile.deviceId); }
+
+    // BANDWIDTH_LIMIT and IOPS_LIMIT cap all copy and verify I/O, CLASS_LIMITS
+    // each priority and DEVICE_LIMITS each destination device (the last entry
+    // wins when two directories share one).  BACKGROUND work - demotion,
+    // encoding, migration, resilver - only gets what the other classes leave
+    // of the global and device budgets.
+    void applyIoLimits(const Configuration& config) {
+        m_ioThrottle.setGlobal({config.bandwidth_limit_bytes, config.iops_limit});
+        for (size_t i = 0; i < kSyncPriorityLevels; ++i) {
+            auto priority = static_cast<SyncPriority>(i);
+            IoRate rate;
+            for (const auto& limit : config.class_limits) {
+                if (limit.target == toString(priority)) {
+                    rate = {limit.bytes_per_second, limit.ops_per_second};
+                }
+            }
+            m_ioThrottle.setClass(i, rate, priority == SyncPriority::BACKGROUND);
+        }
+        std::unordered_map<std::string, IoRate> devices;
+        for (const auto& limit : config.device_limits) {
+            devices[ioDevice(m_deviceProfiler.profileFor(limit.target))] = {limit.bytes_per_second,
+                                                                            limit.ops_per_second};
+        }
+        m_ioThrottle.setDevices(devices);
+    }
+
+    // Throttle for the chunks @p task copies or verifies: each is one
+    // operation on every device in @p devices.  While a headroom-only class
+    // waits for budget the other classes left, it gives up @p slots (in the
+    // caller's device order), so it never holds foreground work at the gate.
+    std::function<void(uint64_t)> ioPacer(const SyncTask& task, std::vector<std::string> devices,
+                                          std::vector<DeviceGate::Slot*> slots = {}) {
+        size_t priority = static_cast<size_t>(task.getPriority());
+        return [this, priority, devices = std::move(devices), slots = std::move(slots)](uint64_t bytes) {
+            for (const auto& device : devices) {
+                bool paused = false;
+                for (;;) {
+                    IoThrottle::Grant grant = m_ioThrottle.reserve(device, priority, bytes);
+                    if (!grant.granted && !paused) {
+                        for (auto* slot : slots) {
+                            slot->pause();
+                        }
+                        paused = true;
+                    }
+                    if (grant.wait > std::chrono::nanoseconds::zero()) {
+                        std::this_thread::sleep_for(grant.wait);
+                    }
+                    if (grant.granted) {
+                        break;
+                    }
+                }
+                if (paused) {
+                    for (auto* slot : slots) {
+                        slot->resume();
+                    }
+                }
+            }
+        };
+    }
+
+    // Charge @p bytes written to @p profile's device up front, one operation
+    // per stripe unit, for the erasure paths that do their own I/O
+    void chargeIo(const SyncTask& task, const IoProfile& profile, uint64_t bytes) {
+        m_ioThrottle.acquire(ioDevice(profile), static_cast<size_t>(task.getPriority()), bytes,
+                             1 + bytes / ErasureStore::kStripeUnit);
+    }
+
+    // Perform the actual synchronization operation
+    bool performSyncOperation(const std::string& sourcePath, const std::string& destPath,
+                              const CopyOptions& options) {
+        SYNC_PROBE(copy_start, sourcePath.c_str(), destPath.c_str());
+        try {
+            // Make sure destination directory exists
+            fs::path destDir = fs::path(destPath).parent_path();
+            if (!fs::exists(destDir)) {
+                fs::create_directories(destDir);
+            }
+
+            // Copy with overwrite, preserving mode and timestamps
+            CopyEngine::copyFile(sourcePath, destPath, options);
+
+            SYNC_PROBE(copy_end, sourcePath.c_str(), destPath.c_str(), 1);
+            return true;
+        } catch (const std::exception& e) {
+            SYNC_PROBE(copy_end, sourcePath.c_str(), destPath.c_str(), 0);
+            m_metrics->recordMetric("sync_error", std::string(e.what()) + ": " + sourcePath);
+            return false;
+        }
+    }
+
+    // Worker publishing the live stats segment once a second
+    void statsWorker() {
+        while (m_running) {
+            m_liveStats->publish(collectLiveStats());
+
+            for (int i = 0; i < 10 && m_running; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+    // Worker to handle recovery of failed transactions
+    void recoveryWorker() {
+        while (m_running) {
+            // Run recovery every minute
+            idleFor(std::chrono::minutes(1), [] { return false; });
+
+            if (!m_running) break;
+
+            LockProfiler::instance().recordMetrics(*m_metrics);
+            m_accounting.recordMetrics(*m_metrics);
+            StageProfiler::instance().recordMetrics(*m_metrics);
+            m_deviceProfiler.recordMetrics(*m_metrics);
+            m_tiering.recordMetrics(*m_metrics);
+            recordBacklogMetrics();
+
+            try {
+                // Get all pending and in-progress transactions
+                auto pendingTransactions = m_transactionLog.getPendingTransactions();
 
                 if (!pendingTransactions.empty()) {
                     m_metrics->recordMetric("recovery_started",
@@ -348,8 +1866,22 @@ private:
         }
     }
 
+    // The file a promotion of @p cachePath copies into before the rename
+    static std::string promotionTemp(const std::string& cachePath) {
+        fs::path target(cachePath);
+        return (target.parent_path() / ("." + target.filename().string() + ".promote")).string();
+    }
+
+    static bool isPromotion(const TransactionLog::TransactionRecord& tx) {
+        return tx.operation == TransactionLog::OperationType::COPY && tx.destPath == promotionTemp(tx.sourcePath);
+    }
+
     // Recover a failed transaction
     void recoverTransaction(const TransactionLog::TransactionRecord& tx) {
+        if (isPromotion(tx)) {
+            recoverPromotion(tx);
+            return;
+        }
         m_metrics->recordMetric("tx_recovery_attempt", tx.id);
 
         // Check if source still exists
@@ -364,26 +1896,323 @@ private:
         }
 
         // Create a sync task for the file
-        SyncTask task(tx.sourcePath, "RECOVERY", SyncPriority::HIGH);
+        SyncTask task = makeTask(tx.sourcePath, "RECOVERY", SyncPriority::HIGH);
 
-        // Queue it for processing
+        // Queue it for processing; the task logs its own transaction, so this
+        // one is closed rather than found again on the next pass
         if (m_syncQueue.enqueue(task)) {
+            m_transactionLog.updateTransactionStatus(tx.id, TransactionLog::TransactionStatus::ROLLED_BACK,
+                                                     "requeued as task " + task.getTaskId());
             m_metrics->recordMetric("tx_recovery_queued", tx.id);
         } else {
             m_metrics->recordMetric("tx_recovery_queue_failed", tx.id);
         }
     }
 
+    // An interrupted promotion: the stub still names the array copy, so the
+    // partial copy is discarded and the file stays on the array.  If the
+    // rename was done, the promotion is closed as it would have been.
+    // Promotions still running are left alone.
+    void recoverPromotion(const TransactionLog::TransactionRecord& tx) {
+        const std::string& cachePath = tx.sourcePath;
+        if (m_tiering.isMoving(cachePath)) {
+            return;
+        }
+        m_metrics->recordMetric("tx_recovery_attempt", tx.id);
+        std::error_code ec;
+        fs::remove(tx.destPath, ec);
+        if (fs::exists(cachePath, ec) && !TieringEngine::stubTarget(cachePath)) {
+            m_transactionLog.updateTransactionStatus(tx.id, TransactionLog::TransactionStatus::COMPLETED,
+                                                     "promoted before the interruption");
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::CACHE, TieringEngine::versionOf(cachePath));
+        } else {
+            m_transactionLog.updateTransactionStatus(tx.id, TransactionLog::TransactionStatus::ROLLED_BACK,
+                                                     "interrupted promotion discarded");
+            m_tiering.finishMove(cachePath, TieringEngine::Tier::ARRAY);
+        }
+        m_metrics->recordMetric("tier_promote_recovered", cachePath);
+    }
+
+    // Worker keeping the cache tier below its high watermark
+    void tieringWorker() {
+        bool scanned = false;
+        bool accessMonitorTried = false;
+        while (m_running) {
+            auto config = currentConfig();
+            if (config->tiering) {
+                if (!accessMonitorTried) {
+                    accessMonitorTried = true;
+                    try {
+                        m_accessMonitor = std::make_unique<AccessMonitor>(
+                            m_sourceRoot, [this](const std::string& path) { recordAccess(path); });
+                    } catch (const std::exception& e) {
+                        // Without CAP_SYS_ADMIN only recordAccess() callers feed promotion
+                        m_metrics->recordMetric("tier_access_monitor_unavailable", e.what());
+                    }
+                }
+                try {
+                    if (!scanned) {
+                        scanCacheTier(*config);
+                        scanned = true;
+                    }
+                    scheduleDemotions(*config);
+                    if (config->erasure_data_shards > 0) {
+                        scheduleEncodes(*config);
+                    }
+                } catch (const std::exception& e) {
+                    m_metrics->recordMetric("tier_error", e.what());
+                }
+                if (m_accessMonitor) {
+                    m_metrics->setGauge("tier_access_events", static_cast<double>(m_accessMonitor->eventCount()));
+                    m_metrics->setGauge("tier_access_overflows", static_cast<double>(m_accessMonitor->overflowCount()));
+                }
+            }
+            idleFor(std::chrono::seconds(config->tier_scan_interval_seconds), [] { return false; });
+        }
+    }
+
+    // Register every file under the source root, stubs as array-resident;
+    // the last access or write time seeds each file's heat
+    void scanCacheTier(const Configuration& config) {
+        std::error_code ec;
+        size_t files = 0;
+        for (auto it = fs::recursive_directory_iterator(m_sourceRoot, fs::directory_options::skip_permission_denied, ec);
+             it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (ec) {
+                break;
+            }
+            struct stat st;
+            const std::string path = it->path().string();
+            if (::lstat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode) || config.isExcluded(path)) {
+                continue;
+            }
+            auto lastUse = std::max(st.st_atim.tv_sec, st.st_mtim.tv_sec);
+            m_tiering.track(path, static_cast<uint64_t>(st.st_size),
+                            TieringEngine::stubTarget(path) ? TieringEngine::Tier::ARRAY : TieringEngine::Tier::CACHE,
+                            std::chrono::system_clock::from_time_t(lastUse));
+            files++;
+        }
+        m_metrics->recordMetric("tier_scan_complete", std::to_string(files) + " files");
+    }
+
+    // Bytes used on the cache tier and its capacity; {0, 0} if unknown
+    std::pair<uint64_t, uint64_t> cacheTierUsage(const Configuration& config) {
+        if (config.tier_cache_capacity > 0) {
+            return {m_tiering.getStats().cacheBytes, config.tier_cache_capacity};
+        }
+        std::error_code ec;
+        auto space = fs::space(m_sourceRoot, ec);
+        if (ec || space.capacity == 0) {
+            return {0, 0};
+        }
+        return {space.capacity - space.available, space.capacity};
+    }
+
+    // Above the high watermark, queue the coldest files for demotion until
+    // the low watermark would be reached, at most one batch per pass.
+    // Demotions run at BACKGROUND priority behind every other task.
+    void scheduleDemotions(const Configuration& config) {
+        auto [used, capacity] = cacheTierUsage(config);
+        if (capacity == 0) {
+            return;
+        }
+        m_metrics->setGauge("tier_cache_used_ratio", static_cast<double>(used) / static_cast<double>(capacity));
+        if (used * 100 < capacity * static_cast<uint64_t>(config.tier_high_watermark)) {
+            return;
+        }
+
+        uint64_t target = capacity / 100 * static_cast<uint64_t>(config.tier_low_watermark);
+        uint64_t inFlight = m_tiering.getStats().demotingBytes;
+        if (used <= target + inFlight) {
+            return;
+        }
+
+        size_t queued = 0;
+        for (const auto& demotion : m_tiering.planDemotions(used - target - inFlight, config.tier_demote_batch)) {
+            SyncTask task(demotion.path, "DEMOTE", SyncPriority::BACKGROUND);
+            task.setSize(demotion.size);
+            if (m_syncQueue.enqueue(task)) {
+                queued++;
+            } else {
+                m_tiering.finishMove(demotion.path, TieringEngine::Tier::CACHE);
+            }
+        }
+        m_metrics->recordMetric("tier_demotions_queued", std::to_string(queued));
+    }
+
+    // Queue the coldest cache files totalling @p bytes for demotion at
+    // NORMAL priority, so a promotion queued next runs behind them; false if
+    // none could be queued
+    bool displace(uint64_t bytes, const Configuration& config) {
+        size_t queued = 0;
+        for (const auto& victim : m_tiering.planDemotions(bytes, config.tier_demote_batch)) {
+            SyncTask task(victim.path, "DEMOTE", SyncPriority::NORMAL);
+            task.setSize(victim.size);
+            if (m_syncQueue.enqueue(task)) {
+                queued++;
+            } else {
+                m_tiering.finishMove(victim.path, TieringEngine::Tier::CACHE);
+            }
+        }
+        if (queued > 0) {
+            m_metrics->recordMetric("tier_displaced", std::to_string(queued));
+        }
+        return queued > 0;
+    }
+
+    // Queue array files nobody has opened for ERASURE_COLD_AGE for encoding,
+    // at most one demotion batch per pass.  Only files the members place whole
+    // qualify: policy destinations keep their copies.
+    void scheduleEncodes(const Configuration& config) {
+        auto coldBefore = std::chrono::system_clock::now() - std::chrono::seconds(config.erasure_cold_age_seconds);
+        auto plan = m_tiering.planEncodes(coldBefore, config.tier_demote_batch, [this](const std::string& path) {
+            auto entry = m_index.find(relativePath(path));
+            return !entry || entry->erasure;
+        });
+        for (const auto& encode : plan) {
+            SyncTask task(encode.path, "ENCODE", SyncPriority::BACKGROUND);
+            task.setSize(encode.size);
+            if (!m_syncQueue.enqueue(task)) {
+                m_tiering.finishMove(encode.path, TieringEngine::Tier::ARRAY);
+            }
+        }
+        if (!plan.empty()) {
+            m_metrics->recordMetric("erasure_encodes_queued", std::to_string(plan.size()));
+        }
+    }
+
+    // Worker moving files whose member changed since they were indexed.  The
+    // plan comes from the index alone; moves are queued as BACKGROUND tasks a
+    // window at a time, in the plan's array order.
+    void rebalanceWorker() {
+        auto moves = Rebalancer::planMoves(m_index, m_placement, &DirtySet::physicalOffset);
+        if (moves.empty()) {
+            return;
+        }
+        m_rebalancer.start(std::move(moves));
+        m_metrics->recordMetric("rebalance_started", m_rebalancer.getSummary());
+
+        while (m_running && !m_rebalancer.done()) {
+            for (const auto& move : m_rebalancer.next(kRebalanceWindow)) {
+                SyncTask task(m_sourceRoot + move.relative, "MIGRATE", SyncPriority::BACKGROUND);
+                task.setSize(move.size);
+                if (!m_syncQueue.enqueue(task)) {
+                    m_rebalancer.finished(move.relative, false);
+                }
+            }
+
+            auto progress = m_rebalancer.getProgress();
+            m_metrics->setGauge("rebalance_planned_bytes", static_cast<double>(progress.plannedBytes));
+            m_metrics->setGauge("rebalance_moved_bytes", static_cast<double>(progress.movedBytes));
+            m_metrics->setGauge("rebalance_failed_files", static_cast<double>(progress.failedFiles));
+            if (progress.eta) {
+                m_metrics->setGauge("rebalance_eta_seconds", static_cast<double>(progress.eta->count()));
+            }
+            idleFor(std::chrono::seconds(1), [] { return false; });
+        }
+        if (m_rebalancer.done()) {
+            m_metrics->recordMetric("rebalance_complete", m_rebalancer.getSummary());
+        }
+    }
+
+    // Worker queueing the plan resilverMember() started, as BACKGROUND tasks a
+    // window at a time in the plan's order; the worker pool copies them in
+    // parallel
+    void resilverWorker() {
+        while (m_running && !m_resilver.done()) {
+            for (const auto& move : m_resilver.next(kRebalanceWindow)) {
+                SyncTask task(m_sourceRoot + move.relative, "RESILVER", SyncPriority::BACKGROUND);
+                task.setSize(move.size);
+                if (!m_syncQueue.enqueue(task)) {
+                    m_resilver.finished(move.relative, false);
+                }
+            }
+
+            auto progress = m_resilver.getProgress();
+            m_metrics->setGauge("resilver_planned_bytes", static_cast<double>(progress.plannedBytes));
+            m_metrics->setGauge("resilver_copied_bytes", static_cast<double>(progress.movedBytes));
+            m_metrics->setGauge("resilver_failed_files", static_cast<double>(progress.failedFiles));
+            if (progress.eta) {
+                m_metrics->setGauge("resilver_eta_seconds", static_cast<double>(progress.eta->count()));
+            }
+            idleFor(std::chrono::seconds(1), [] { return false; });
+        }
+        if (m_resilver.done()) {
+            m_metrics->recordMetric("resilver_complete", m_resilver.getSummary());
+        }
+    }
+
+    // Worker flushing dirty files once the oldest reaches WRITE_BACK_MAX_AGE
+    // or WRITE_BACK_BATCH bytes are waiting
+    void flushWorker() {
+        while (m_running) {
+            idleFor(std::chrono::seconds(1), [this] { return m_flushRequested.load(); });
+            if (!m_running) break;
+
+            auto config = currentConfig();
+            bool requested = m_flushRequested.exchange(false);
+            try {
+                if (requested || m_dirty.flushDue(std::chrono::seconds(config->write_back_max_age_seconds),
+                                                  config->write_back_batch_bytes)) {
+                    flushDirtyBatch();
+                }
+            } catch (const std::exception& e) {
+                m_metrics->recordMetric("writeback_error", e.what());
+            }
+
+            auto dirty = m_dirty.getStats();
+            m_metrics->setGauge("writeback_dirty_files", static_cast<double>(dirty.files));
+            m_metrics->setGauge("writeback_dirty_bytes", static_cast<double>(dirty.bytes));
+            m_metrics->setGauge("writeback_oldest_age_seconds",
+                                std::chrono::duration<double>(dirty.oldestAge).count());
+        }
+    }
+
+    // Queue every dirty file as one batch ordered for the array.  Within a
+    // priority the queue is FIFO, and the destination device gate keeps array
+    // writes to one or two streams, so the array sees them in this order.
+    void flushDirtyBatch() {
+        auto batch = m_dirty.takeBatch();
+        if (batch.empty()) {
+            return;
+        }
+
+        auto policies = currentPolicies();
+        for (auto& file : batch) {
+            auto destinations = determineDestinationPaths(file.path, policies->lookup(file.path));
+            file.destRoot = destinations.front().first;
+            file.destPath = destinations.front().second;
+            file.destOffset = DirtySet::physicalOffset(file.destPath);
+        }
+        DirtySet::orderForArray(batch);
+
+        uint64_t bytes = 0;
+        auto oldest = std::chrono::steady_clock::now();
+        for (const auto& file : batch) {
+            SyncTask task(file.path, "FLUSH", file.priority);
+            task.setSize(file.size);
+            bool queued = false;
+            while (m_running && !(queued = m_syncQueue.enqueue(task))) {
+                // Queue full: wait for the workers rather than split the batch
+            }
+            if (!queued) {
+                m_dirty.flushed(file.path, false);
+                continue;
+            }
+            bytes += file.size;
+            oldest = std::min(oldest, file.since);
+        }
+        m_metrics->recordMetric("writeback_flush",
+                                std::to_string(batch.size()) + " files, " + std::to_string(bytes) + " bytes, oldest " +
+                                std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - oldest).count()) + " ms");
+    }
+
     // Worker to perform periodic consistency checks
     void consistencyWorker() {
         while (m_running) {
             // Run consistency check every 6 hours or when requested
-            for (int i = 0; i < 360 && m_running; ++i) { // 6 hours = 360 minutes
-                std::this_thread::sleep_for(std::chrono::minutes(1));
-                if (m_consistencyCheckRequested) {
-                    break;
-                }
-            }
+            idleFor(std::chrono::hours(6), [this] { return m_consistencyCheckRequested.load(); });
 
             if (!m_running) break;
 
@@ -401,34 +2230,58 @@ private:
     void performFullConsistencyCheck() {
         m_metrics->recordMetric("consistency_check", "started");
 
-        // Source and destination directories (from config in real implementation)
-        std::string sourceDir = "/path/to/source";
-        std::string destDir = "/path/to/destination";
+        auto config = currentConfig();
+        const std::string& sourceDir = m_sourceRoot;
+        const std::string& destDir = m_destRoot;
 
-        // Verify directories recursively
+        // Verify directories recursively, as many files at once as the source
+        // device handles well, each against the member it is placed on
+        auto placedRoot = [this](const std::string& relative) { return m_placement.rootFor("/" + relative); };
         auto results = m_fileVerifier->verifyDirectory(
             sourceDir,
             destDir,
-            FileVerification::VerifyMethod::FAST_HASH,
+            FileVerification::methodFromString(config->verify_method),
             true,
-            m_config->num_threads
+            static_cast<int>(m_sourceProfile.concurrency),
+            &m_destFilter,
+            placedRoot
         );
+        m_metrics->setGauge("dest_filter_files", static_cast<double>(m_destFilter.size()));
+        if (!m_destFilter.save(m_destFilterPath)) {
+            m_metrics->recordMetric("dest_filter_save_failed", m_destFilterPath);
+        }
 
         int totalFiles = 0;
         int mismatches = 0;
 
         // Process results and queue mismatched files for sync
         for (const auto& result : results) {
+            // Create full path
+            std::string fullPath = (fs::path(sourceDir) / result.first).string();
+            if (config->isExcluded(fullPath)) {
+                continue;
+            }
+
             totalFiles++;
 
             if (!result.second.matches) {
+                if (TieringEngine::stubTarget(fullPath)) {
+                    // Demoted: the array holds the data
+                    continue;
+                }
+                if (m_placement.size() > 1) {
+                    // On another array member, or not moved there yet
+                    std::string arrayPath = locateOnArray(fullPath);
+                    if (arrayPath != placedRoot(result.first) + "/" + result.first &&
+                        m_fileVerifier->verifyFile(fullPath, arrayPath,
+                            FileVerification::methodFromString(config->verify_method)).matches) {
+                        continue;
+                    }
+                }
                 mismatches++;
 
-                // Create full path
-                std::string fullPath = (fs::path(sourceDir) / result.first).string();
-
                 // Queue for sync
-                SyncTask task(fullPath, "CONSISTENCY", SyncPriority::LOW);
+                SyncTask task = makeTask(fullPath, "CONSISTENCY", SyncPriority::LOW);
                 m_syncQueue.enqueue(task);
 
                 m_metrics->recordMetric("consistency_mismatch", result.first);
@@ -0,0 +1,186 @@
+//
+// Optional self-profiling: hardware counter deltas attributed to pipeline stages.
+//
+
+#ifndef STAGE_PROFILER_HPP
+#define STAGE_PROFILER_HPP
+
+#include "metrics_collector.hpp"
+#include "profiled_mutex.hpp"
+#include "sys/perf_event_counters.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Attributes per-thread perf counter deltas (cycles, instructions, cache
+// misses, context switches) to named pipeline stages such as "copy" or
+// "verify".  Disabled by default; when enabled but perf_event_open is refused
+// (perf_event_paranoid, seccomp, no PMU) it reports why once and turns every
+// stage scope into a no-op.
+class StageProfiler {
+public:
+    struct StageTotals {
+        uint64_t calls = 0;
+        sys::PerfEventCounters::Reading counters{};
+    };
+
+    // RAII scope charging the counters consumed in between to a stage
+    class Scope {
+    public:
+        explicit Scope(const char* stage, StageProfiler& profiler = StageProfiler::instance())
+            : m_profiler(profiler), m_stage(stage), m_counters(profiler.threadCounters()) {
+            if (m_counters) {
+                m_start = m_counters->read();
+            }
+        }
+
+        ~Scope() {
+            if (m_counters) {
+                auto end = m_counters->read();
+                for (size_t i = 0; i < end.size(); ++i) {
+                    end[i] -= m_start[i];
+                }
+                m_profiler.record(m_stage, end);
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StageProfiler& m_profiler;
+        const char* m_stage;
+        sys::PerfEventCounters* m_counters;
+        sys::PerfEventCounters::Reading m_start{};
+    };
+
+    static StageProfiler& instance() {
+        static StageProfiler profiler;
+        return profiler;
+    }
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // False once perf_event_open has been refused on any thread
+    bool isAvailable() const { return m_available; }
+
+    std::string getUnavailableReason() const {
+        std::lock_guard lock(m_mutex);
+        return m_unavailableReason;
+    }
+
+    std::map<std::string, StageTotals> getTotals() const {
+        std::lock_guard lock(m_mutex);
+        return m_stages;
+    }
+
+    std::string getSummary() const {
+        std::stringstream ss;
+        if (!m_enabled) {
+            ss << "Self-profiling disabled" << std::endl;
+            return ss.str();
+        }
+        if (!m_available) {
+            ss << "Self-profiling unavailable: " << getUnavailableReason() << std::endl;
+            return ss.str();
+        }
+
+        for (const auto& [stage, totals] : getTotals()) {
+            ss << stage << ": calls=" << totals.calls;
+            for (int i = 0; i < sys::PerfEventCounters::COUNTER_COUNT; ++i) {
+                ss << " " << sys::PerfEventCounters::name(static_cast<sys::PerfEventCounters::Counter>(i))
+                   << "=" << totals.counters[i];
+            }
+            ss << " ipc=" << ipc(totals) << std::endl;
+        }
+        return ss.str();
+    }
+
+    // Export per-stage counters as gauges
+    void recordMetrics(MetricsCollector& metrics) const {
+        if (!m_enabled) {
+            return;
+        }
+        metrics.setGauge("self_profiling_available", m_available ? 1.0 : 0.0);
+
+        for (const auto& [stage, totals] : getTotals()) {
+            const std::string label = "{stage=\"" + stage + "\"}";
+            metrics.setGauge("stage_calls" + label, static_cast<double>(totals.calls));
+            for (int i = 0; i < sys::PerfEventCounters::COUNTER_COUNT; ++i) {
+                auto counter = static_cast<sys::PerfEventCounters::Counter>(i);
+                metrics.setGauge(std::string("stage_") + sys::PerfEventCounters::name(counter) + label,
+                                 static_cast<double>(totals.counters[i]));
+            }
+            metrics.setGauge("stage_ipc" + label, ipc(totals));
+        }
+    }
+
+    void reset() {
+        std::lock_guard lock(m_mutex);
+        m_stages.clear();
+    }
+
+private:
+    std::atomic<bool> m_enabled{false};
+    std::atomic<bool> m_available{true};
+    mutable ProfiledMutex m_mutex{"stage_profiler"};
+    std::string m_unavailableReason;
+    std::map<std::string, StageTotals> m_stages;
+
+    // The calling thread's counters, opened on first use; nullptr when
+    // profiling is off or perf events are not permitted
+    sys::PerfEventCounters* threadCounters() {
+        if (!m_enabled || !m_available) {
+            return nullptr;
+        }
+
+        thread_local std::unique_ptr<sys::PerfEventCounters> counters;
+        thread_local std::string failure;
+        if (!counters && failure.empty()) {
+            try {
+                counters = std::make_unique<sys::PerfEventCounters>();
+            } catch (const std::system_error& e) {
+                failure = e.what();
+            }
+        }
+        if (!counters) {
+            markUnavailable(failure);
+        }
+        return counters.get();
+    }
+
+    void markUnavailable(const std::string& error) {
+        std::lock_guard lock(m_mutex);
+        m_available = false;
+
+        m_unavailableReason = error;
+        std::ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+        int level;
+        if (paranoid >> level) {
+            m_unavailableReason += " (perf_event_paranoid=" + std::to_string(level) + ")";
+        }
+    }
+
+    void record(const char* stage, const sys::PerfEventCounters::Reading& delta) {
+        std::lock_guard lock(m_mutex);
+        auto& totals = m_stages[stage];
+        totals.calls++;
+        for (size_t i = 0; i < delta.size(); ++i) {
+            totals.counters[i] += delta[i];
+        }
+    }
+
+    static double ipc(const StageTotals& totals) {
+        auto cycles = totals.counters[sys::PerfEventCounters::CYCLES];
+        return cycles == 0 ? 0.0
+            : static_cast<double>(totals.counters[sys::PerfEventCounters::INSTRUCTIONS]) / cycles;
+    }
+};
+
+#endif // STAGE_PROFILER_HPP
@@ -0,0 +1,256 @@
+//
+// Per-task resource accounting for sync tasks, aggregated by top-level directory.
+//
+
+#ifndef TASK_ACCOUNTING_HPP
+#define TASK_ACCOUNTING_HPP
+
+#include "metrics_collector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Resources consumed by one task (or the sum over many)
+struct TaskCost {
+    uint64_t bytesRead = 0;        // bytes returned by read-like syscalls (rchar)
+    uint64_t bytesWritten = 0;     // bytes passed to write-like syscalls (wchar)
+    uint64_t storageRead = 0;      // bytes fetched from storage (read_bytes)
+    uint64_t storageWritten = 0;   // bytes sent to storage (write_bytes)
+    uint64_t readSyscalls = 0;
+    uint64_t writeSyscalls = 0;
+    uint64_t majorFaults = 0;
+    std::chrono::nanoseconds wallTime{0};
+    std::chrono::nanoseconds cpuTime{0};
+
+    TaskCost& operator+=(const TaskCost& other) {
+        bytesRead += other.bytesRead;
+        bytesWritten += other.bytesWritten;
+        storageRead += other.storageRead;
+        storageWritten += other.storageWritten;
+        readSyscalls += other.readSyscalls;
+        writeSyscalls += other.writeSyscalls;
+        majorFaults += other.majorFaults;
+        wallTime += other.wallTime;
+        cpuTime += other.cpuTime;
+        return *this;
+    }
+
+    std::string toString() const {
+        std::stringstream ss;
+        ss << "read=" << bytesRead << " written=" << bytesWritten
+           << " storage_read=" << storageRead << " storage_written=" << storageWritten
+           << " syscr=" << readSyscalls << " syscw=" << writeSyscalls
+           << " majflt=" << majorFaults
+           << " wall_us=" << std::chrono::duration_cast<std::chrono::microseconds>(wallTime).count()
+           << " cpu_us=" << std::chrono::duration_cast<std::chrono::microseconds>(cpuTime).count();
+        return ss.str();
+    }
+};
+
+// Snapshot of the calling thread's resource counters.  The difference of two
+// samples taken on the same thread is the cost of the work in between.  The
+// I/O counters come from one pread() of /proc/thread-self/io, whose own
+// syscall and bytes land in the next sample's totals; operator- takes the
+// earlier sample's read back out, so sampling adds nothing to the cost.
+class ResourceSample {
+public:
+    static ResourceSample capture() {
+        ResourceSample sample;
+        sample.m_wall = std::chrono::steady_clock::now();
+
+        timespec cpu{};
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0) {
+            sample.m_cpu = std::chrono::seconds(cpu.tv_sec) + std::chrono::nanoseconds(cpu.tv_nsec);
+        }
+
+        rusage usage{};
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            sample.m_majorFaults = static_cast<uint64_t>(usage.ru_majflt);
+        }
+
+        // Per-thread I/O accounting; absent when the kernel lacks TASK_IO_ACCOUNTING
+        int fd = ioDescriptor();
+        char text[512];
+        ssize_t length = fd == -1 ? -1 : ::pread(fd, text, sizeof(text) - 1, 0);
+        if (length > 0) {
+            text[length] = '\0';
+            sample.m_sampleRead = static_cast<uint64_t>(length);
+            for (char* line = text; line != nullptr && *line != '\0';) {
+                char* colon = std::strchr(line, ':');
+                if (colon == nullptr) {
+                    break;
+                }
+                std::string_view name(line, static_cast<size_t>(colon - line));
+                uint64_t value = std::strtoull(colon + 1, &line, 10);
+                if (name == "rchar") sample.m_io.bytesRead = value;
+                else if (name == "wchar") sample.m_io.bytesWritten = value;
+                else if (name == "syscr") sample.m_io.readSyscalls = value;
+                else if (name == "syscw") sample.m_io.writeSyscalls = value;
+                else if (name == "read_bytes") sample.m_io.storageRead = value;
+                else if (name == "write_bytes") sample.m_io.storageWritten = value;
+                line = std::strchr(line, '\n');
+                if (line != nullptr) {
+                    line++;
+                }
+            }
+        }
+
+        return sample;
+    }
+
+    // Cost accumulated since an earlier sample from the same thread
+    TaskCost operator-(const ResourceSample& earlier) const {
+        // The earlier sample's own pread() is counted here, this one's is not yet
+        auto without = [](uint64_t later, uint64_t before, uint64_t own) {
+            return later - before - std::min(own, later - before);
+        };
+        TaskCost cost;
+        cost.bytesRead = without(m_io.bytesRead, earlier.m_io.bytesRead, earlier.m_sampleRead);
+        cost.bytesWritten = m_io.bytesWritten - earlier.m_io.bytesWritten;
+        cost.storageRead = m_io.storageRead - earlier.m_io.storageRead;
+        cost.storageWritten = m_io.storageWritten - earlier.m_io.storageWritten;
+        cost.readSyscalls = without(m_io.readSyscalls, earlier.m_io.readSyscalls, earlier.m_sampleRead > 0 ? 1 : 0);
+        cost.writeSyscalls = m_io.writeSyscalls - earlier.m_io.writeSyscalls;
+        cost.majorFaults = m_majorFaults - earlier.m_majorFaults;
+        cost.wallTime = m_wall - earlier.m_wall;
+        cost.cpuTime = m_cpu - earlier.m_cpu;
+        return cost;
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_wall;
+    std::chrono::nanoseconds m_cpu{0};
+    uint64_t m_majorFaults = 0;
+    TaskCost m_io;
+    uint64_t m_sampleRead = 0; // bytes the pread() of this sample returned
+
+    // /proc/thread-self/io of the calling thread, opened on its first sample
+    // and closed when it exits; -1 if unavailable
+    static int ioDescriptor() {
+        struct Descriptor {
+            int fd = ::open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+            ~Descriptor() {
+                if (fd != -1) {
+                    ::close(fd);
+                }
+            }
+        };
+        thread_local Descriptor descriptor;
+        return descriptor.fd;
+    }
+};
+
+// Aggregates task costs by the top-level directory under the source root
+class TaskAccounting {
+public:
+    struct DirectoryTotals {
+        uint64_t tasks = 0;
+        TaskCost cost;
+    };
+
+    explicit TaskAccounting(std::string sourceRoot)
+        : m_sourceRoot(std::move(sourceRoot)) {}
+
+    void setSourceRoot(const std::string& sourceRoot) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sourceRoot = sourceRoot;
+    }
+
+    // Charge a finished task to its top-level directory
+    void record(const std::string& path, const TaskCost& cost) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& totals = m_directories[directoryFor(path)];
+        totals.tasks++;
+        totals.cost += cost;
+    }
+
+    // Top-level directory a path is accounted to: "." for files directly in
+    // the root and "(other)" for paths outside it
+    std::string topLevelDirectory(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return directoryFor(path);
+    }
+
+    std::map<std::string, DirectoryTotals> getTotals() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_directories;
+    }
+
+    // Directories ordered by storage I/O, heaviest first
+    std::string getSummary(size_t limit = 10) const {
+        auto totals = getTotals();
+        std::vector<std::pair<std::string, DirectoryTotals>> ordered(totals.begin(), totals.end());
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+            return ioOf(a.second.cost) > ioOf(b.second.cost);
+        });
+
+        std::stringstream ss;
+        for (size_t i = 0; i < ordered.size() && i < limit; ++i) {
+            ss << ordered[i].first << ": tasks=" << ordered[i].second.tasks << " "
+               << ordered[i].second.cost.toString() << std::endl;
+        }
+        return ss.str();
+    }
+
+    // Export the per-directory totals as gauges
+    void recordMetrics(MetricsCollector& metrics) const {
+        for (const auto& [dir, totals] : getTotals()) {
+            const std::string label = "{dir=\"" + dir + "\"}";
+            metrics.setGauge("task_count" + label, static_cast<double>(totals.tasks));
+            metrics.setGauge("task_bytes_read" + label, static_cast<double>(totals.cost.bytesRead));
+            metrics.setGauge("task_bytes_written" + label, static_cast<double>(totals.cost.bytesWritten));
+            metrics.setGauge("task_storage_read_bytes" + label, static_cast<double>(totals.cost.storageRead));
+            metrics.setGauge("task_storage_written_bytes" + label,
+                             static_cast<double>(totals.cost.storageWritten));
+            metrics.setGauge("task_syscalls" + label,
+                             static_cast<double>(totals.cost.readSyscalls + totals.cost.writeSyscalls));
+            metrics.setGauge("task_major_faults" + label, static_cast<double>(totals.cost.majorFaults));
+            metrics.setGauge("task_wall_seconds" + label,
+                             std::chrono::duration<double>(totals.cost.wallTime).count());
+            metrics.setGauge("task_cpu_seconds" + label,
+                             std::chrono::duration<double>(totals.cost.cpuTime).count());
+        }
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::string m_sourceRoot;
+    std::map<std::string, DirectoryTotals> m_directories;
+
+    // Caller holds m_mutex
+    std::string directoryFor(const std::string& path) const {
+        fs::path relative = fs::path(path).lexically_relative(m_sourceRoot);
+        if (relative.empty() || *relative.begin() == "..") {
+            return "(other)";
+        }
+        auto first = relative.begin();
+        if (std::next(first) == relative.end()) {
+            return ".";
+        }
+        return first->string();
+    }
+
+    static uint64_t ioOf(const TaskCost& cost) {
+        return cost.storageRead + cost.storageWritten + cost.bytesRead + cost.bytesWritten;
+    }
+};
+
+#endif // TASK_ACCOUNTING_HPP
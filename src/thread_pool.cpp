@@ -7,9 +7,22 @@
 
 ThreadPool::ThreadPool() : m_stop(false) {};
 
+ThreadPool::~ThreadPool() {
+    {
+        ProfiledMutex::UniqueLock lock(m_queue_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
 
 void ThreadPool::enqueue(std::function<void()> task) {
-    std::unique_lock lock(m_queue_mutex);
+    ProfiledMutex::UniqueLock lock(m_queue_mutex);
     m_tasks.push(task);
     m_condition.notify_one();
 }
@@ -20,7 +33,7 @@ void ThreadPool::start(size_t num_threads) {
             while (true) {
                 std::function<void()> task;
                 {
-                    std::unique_lock lock(m_queue_mutex);
+                    ProfiledMutex::UniqueLock lock(m_queue_mutex);
                     m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
                     if (m_stop && m_tasks.empty()) {
                         return;
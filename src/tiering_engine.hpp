@@ -0,0 +1,476 @@
+//
+// Placement of files between the cache tier (SOURCE_DIR, SSD) and the array
+// tier (DEST_DIR, HDD): access heat, demotion planning and stub files.
+//
+
+#ifndef TIERING_ENGINE_HPP
+#define TIERING_ENGINE_HPP
+
+#include "frequency_sketch.hpp"
+#include "metrics_collector.hpp"
+#include "profiled_mutex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Tracks every file the cache tier holds or has demoted, with an access heat
+// that combines recency and frequency: each access adds one hit and hits
+// decay with a fixed half-life.  Because every file decays at the same rate,
+// the order by heat never changes between accesses, so the demotion
+// candidates are kept in a set ordered by a time-independent key
+// (log2(hits) + last access / half-life) and the coldest file is always at
+// the front.
+//
+// Promotion is guarded by a TinyLFU admission test.  Every access, including
+// accesses to files the engine does not track, feeds a fixed-size frequency
+// sketch.  A hot file on the array is promoted only if its estimated
+// frequency beats that of the file it would displace, which is the coldest
+// file on the cache.  A search or backup that reads the whole archive once
+// therefore cannot flush the cache tier.
+class TieringEngine {
+public:
+    enum class Tier {
+        CACHE, // data on the cache tier (and usually mirrored on the array)
+        ARRAY  // data on the array only; the cache holds a stub or nothing
+    };
+
+    // Size and modification time, enough to tell whether a file changed
+    struct FileVersion {
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+
+        bool operator==(const FileVersion& other) const = default;
+    };
+
+    struct Demotion {
+        std::string path;
+        uint64_t size = 0;
+    };
+
+    struct Stats {
+        size_t cacheFiles = 0;
+        uint64_t cacheBytes = 0;
+        size_t arrayFiles = 0;
+        uint64_t arrayBytes = 0;
+        size_t demotingFiles = 0;
+        uint64_t demotingBytes = 0;
+        size_t promotingFiles = 0;
+        size_t encodingFiles = 0;
+        uint64_t admitted = 0; // promotions that passed the admission test
+        uint64_t rejected = 0; // hot enough, but no more frequent than the victim
+        size_t sketchBytes = 0;
+    };
+
+    // Extended attribute marking a stub; its value is the array copy's path
+    static constexpr const char* kStubAttribute = "user.cache_array_sync.stub";
+
+    // @p sketchItems sizes the frequency sketch (about 3 bytes each); use
+    // the number of files expected under the source root
+    explicit TieringEngine(std::chrono::seconds halfLife = std::chrono::hours(24), double promoteAccesses = 2.0,
+                           size_t sketchItems = 1 << 20)
+        : m_halfLifeSeconds(static_cast<double>(std::max<int64_t>(1, halfLife.count()))),
+          m_promoteAccesses(promoteAccesses),
+          m_sketch(sketchItems) {
+        m_stats.sketchBytes = m_sketch.memoryBytes();
+    }
+
+    // Decayed hits a file on the array needs before an access promotes it
+    void setPromoteAccesses(double accesses) {
+        std::lock_guard lock(m_mutex);
+        m_promoteAccesses = accesses;
+    }
+
+    // Start tracking @p path, or update it; counts as an access at @p when
+    void track(const std::string& path, uint64_t size, Tier tier,
+               std::chrono::system_clock::time_point when = std::chrono::system_clock::now()) {
+        std::lock_guard lock(m_mutex);
+        auto [it, inserted] = m_entries.try_emplace(path);
+        Entry& entry = it->second;
+        if (!inserted) {
+            if (entry.moving) {
+                // A move in progress settles the tier; only the heat changes
+                touch(it, seconds(when));
+                return;
+            }
+            unlink(it);
+        }
+        entry.size = size;
+        entry.tier = tier;
+        entry.promoted.reset();
+        if (inserted) {
+            entry.hits = 1.0;
+            entry.last = seconds(when);
+        } else {
+            entry.hits = decayedHits(entry, seconds(when)) + 1.0;
+            entry.last = std::max(entry.last, seconds(when));
+        }
+        link(it);
+    }
+
+    // Stop tracking @p path (deleted from the source)
+    void forget(const std::string& path) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            return;
+        }
+        unlink(it);
+        m_entries.erase(it);
+    }
+
+    // Record an access.  True when the file lives on the array, is not being
+    // moved, is hot enough to promote and is accessed more often than the
+    // cache file it would displace.
+    bool recordAccess(const std::string& path,
+                      std::chrono::system_clock::time_point when = std::chrono::system_clock::now()) {
+        std::lock_guard lock(m_mutex);
+        uint64_t keyHash = FrequencySketch::hash(path);
+        m_sketch.increment(keyHash);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            return false;
+        }
+        touch(it, seconds(when));
+        const Entry& entry = it->second;
+        if (entry.tier != Tier::ARRAY || entry.moving || entry.hits < m_promoteAccesses) {
+            return false;
+        }
+        if (!m_coldest.empty() &&
+            m_sketch.frequency(keyHash) <= m_sketch.frequency(FrequencySketch::hash(*m_coldest.begin()->second))) {
+            m_stats.rejected++;
+            return false;
+        }
+        m_stats.admitted++;
+        return true;
+    }
+
+    // Estimated recent accesses of @p path from the frequency sketch
+    uint32_t estimatedFrequency(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        return m_sketch.frequency(FrequencySketch::hash(path));
+    }
+
+    // Coldest cache-resident files totalling at least @p bytes (at most
+    // @p maxFiles of them); they are marked as moving until finishMove()
+    std::vector<Demotion> planDemotions(uint64_t bytes, size_t maxFiles) {
+        std::lock_guard lock(m_mutex);
+        std::vector<Demotion> plan;
+        uint64_t planned = 0;
+        while (planned < bytes && plan.size() < maxFiles && !m_coldest.empty()) {
+            auto it = m_entries.find(*m_coldest.begin()->second);
+            unlink(it);
+            it->second.moving = true;
+            link(it);
+            plan.push_back({it->first, it->second.size});
+            planned += it->second.size;
+        }
+        return plan;
+    }
+
+    // Array-resident files not accessed since @p lastAccessBefore, oldest
+    // access first, at most @p maxFiles of them and none @p skip rejects
+    // (already encoded).  They are marked as moving until finishMove(), so
+    // neither a promotion nor the next pass picks them up meanwhile.  This
+    // walks every tracked file; it runs once per scan interval.
+    std::vector<Demotion> planEncodes(std::chrono::system_clock::time_point lastAccessBefore, size_t maxFiles,
+                                      const std::function<bool(const std::string& path)>& skip = {}) {
+        std::lock_guard lock(m_mutex);
+        const double cutoff = seconds(lastAccessBefore);
+        std::vector<std::pair<double, EntryMap::iterator>> cold;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            const Entry& entry = it->second;
+            if (entry.tier == Tier::ARRAY && !entry.moving && entry.last < cutoff && (!skip || !skip(it->first))) {
+                cold.emplace_back(entry.last, it);
+            }
+        }
+        size_t count = std::min(maxFiles, cold.size());
+        std::partial_sort(cold.begin(), cold.begin() + static_cast<std::ptrdiff_t>(count), cold.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::vector<Demotion> plan;
+        for (size_t i = 0; i < count; ++i) {
+            auto it = cold[i].second;
+            unlink(it);
+            it->second.moving = true;
+            it->second.encoding = true;
+            link(it);
+            plan.push_back({it->first, it->second.size});
+        }
+        return plan;
+    }
+
+    // Mark an array-resident file as moving to the cache; false if it is
+    // unknown, already on the cache or already moving
+    bool beginPromotion(const std::string& path) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end() || it->second.tier != Tier::ARRAY || it->second.moving) {
+            return false;
+        }
+        unlink(it);
+        it->second.moving = true;
+        link(it);
+        return true;
+    }
+
+    // A move ended with the data on @p tier.  @p promoted is the version the
+    // promotion wrote, so the sync it triggers can be recognised and skipped.
+    void finishMove(const std::string& path, Tier tier, std::optional<FileVersion> promoted = std::nullopt) {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            return;
+        }
+        unlink(it);
+        it->second.moving = false;
+        it->second.encoding = false;
+        it->second.tier = tier;
+        it->second.promoted = promoted;
+        link(it);
+    }
+
+    // True if @p path still holds exactly what a promotion copied from the array
+    bool isPromotedCopy(const std::string& path, const FileVersion& version) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        return it != m_entries.end() && it->second.promoted && *it->second.promoted == version;
+    }
+
+    // True while a demotion, promotion or encode of @p path is under way
+    bool isMoving(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        return it != m_entries.end() && it->second.moving;
+    }
+
+    std::optional<Tier> tierOf(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            return std::nullopt;
+        }
+        return it->second.tier;
+    }
+
+    uint64_t sizeOf(const std::string& path) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        return it == m_entries.end() ? 0 : it->second.size;
+    }
+
+    // Decayed hit count of @p path at @p when (0 if untracked)
+    double heat(const std::string& path,
+                std::chrono::system_clock::time_point when = std::chrono::system_clock::now()) const {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        return it == m_entries.end() ? 0.0 : decayedHits(it->second, seconds(when));
+    }
+
+    Stats getStats() const {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+    std::string getSummary() const {
+        Stats stats = getStats();
+        std::stringstream ss;
+        ss << "Cache tier: " << stats.cacheFiles << " files, " << stats.cacheBytes << " bytes" << std::endl;
+        ss << "Array only: " << stats.arrayFiles << " files, " << stats.arrayBytes << " bytes" << std::endl;
+        ss << "Demoting: " << stats.demotingFiles << " files, " << stats.demotingBytes << " bytes; promoting: "
+           << stats.promotingFiles << " files; encoding: " << stats.encodingFiles << " files" << std::endl;
+        ss << "Admission: " << stats.admitted << " admitted, " << stats.rejected << " rejected (sketch "
+           << stats.sketchBytes << " bytes)" << std::endl;
+        return ss.str();
+    }
+
+    void recordMetrics(MetricsCollector& metrics) const {
+        Stats stats = getStats();
+        metrics.setGauge("tier_files{tier=\"cache\"}", static_cast<double>(stats.cacheFiles));
+        metrics.setGauge("tier_bytes{tier=\"cache\"}", static_cast<double>(stats.cacheBytes));
+        metrics.setGauge("tier_files{tier=\"array\"}", static_cast<double>(stats.arrayFiles));
+        metrics.setGauge("tier_bytes{tier=\"array\"}", static_cast<double>(stats.arrayBytes));
+        metrics.setGauge("tier_demoting_bytes", static_cast<double>(stats.demotingBytes));
+        metrics.setGauge("tier_promoting_files", static_cast<double>(stats.promotingFiles));
+        metrics.setGauge("tier_encoding_files", static_cast<double>(stats.encodingFiles));
+        metrics.setGauge("tier_admissions_total{result=\"admitted\"}", static_cast<double>(stats.admitted));
+        metrics.setGauge("tier_admissions_total{result=\"rejected\"}", static_cast<double>(stats.rejected));
+        metrics.setGauge("tier_sketch_bytes", static_cast<double>(stats.sketchBytes));
+    }
+
+    static std::optional<FileVersion> versionOf(const std::string& path) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == -1) {
+            return std::nullopt;
+        }
+        return versionOf(st);
+    }
+
+    // Array path recorded in @p path's stub attribute; nullopt for regular files
+    static std::optional<std::string> stubTarget(const std::string& path) {
+        char buffer[4096];
+        ssize_t length = ::getxattr(path.c_str(), kStubAttribute, buffer, sizeof(buffer));
+        if (length < 0) {
+            return std::nullopt;
+        }
+        return std::string(buffer, static_cast<size_t>(length));
+    }
+
+    // Atomically replace @p cachePath with a stub: a sparse file of the same
+    // size, mode and times that holds no data and names @p arrayPath in its
+    // stub attribute.  Returns false, leaving the file alone, if it no longer
+    // matches @p expected (written since its array copy was verified).
+    // Throws std::system_error; ENOTSUP means the filesystem has no user xattrs.
+    static bool makeStub(const std::string& cachePath, const std::string& arrayPath, const FileVersion& expected) {
+        struct stat st;
+        if (::stat(cachePath.c_str(), &st) == -1) {
+            throw std::system_error(errno, std::system_category(), "stat " + cachePath);
+        }
+        if (versionOf(st) != expected) {
+            return false;
+        }
+
+        fs::path target(cachePath);
+        std::string tmp = (target.parent_path() / ("." + target.filename().string() + ".stub")).string();
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+        if (fd == -1) {
+            throw std::system_error(errno, std::system_category(), "create " + tmp);
+        }
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        if (::ftruncate(fd, st.st_size) == -1 ||
+            ::fsetxattr(fd, kStubAttribute, arrayPath.data(), arrayPath.size(), 0) == -1 ||
+            ::futimens(fd, times) == -1) {
+            int error = errno;
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw std::system_error(error, std::system_category(), "stub " + cachePath);
+        }
+        ::close(fd);
+
+        // Last check before the data goes; a write after this point is lost
+        auto current = versionOf(cachePath);
+        if (!current || *current != expected) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        if (::rename(tmp.c_str(), cachePath.c_str()) == -1) {
+            int error = errno;
+            ::unlink(tmp.c_str());
+            throw std::system_error(error, std::system_category(), "rename " + tmp);
+        }
+        return true;
+    }
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        Tier tier = Tier::CACHE;
+        bool moving = false;
+        bool encoding = false; // moving into erasure-coded shards rather than to the cache
+        double hits = 0.0; // as of `last`
+        double last = 0.0; // seconds since the epoch
+        std::optional<FileVersion> promoted;
+    };
+    using EntryMap = std::unordered_map<std::string, Entry>;
+
+    mutable ProfiledMutex m_mutex{"tiering"};
+    const double m_halfLifeSeconds;
+    double m_promoteAccesses;
+    FrequencySketch m_sketch;
+    EntryMap m_entries;
+    // Cache-resident files not being moved, coldest first; the pointers are
+    // the map's keys, which stay put while the entry exists
+    std::set<std::pair<double, const std::string*>> m_coldest;
+    Stats m_stats;
+
+    static double seconds(std::chrono::system_clock::time_point when) {
+        return std::chrono::duration<double>(when.time_since_epoch()).count();
+    }
+
+    static FileVersion versionOf(const struct stat& st) {
+        return {static_cast<uint64_t>(st.st_size),
+                static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+    }
+
+    double decayedHits(const Entry& entry, double now) const {
+        return entry.hits * std::exp2(-std::max(0.0, now - entry.last) / m_halfLifeSeconds);
+    }
+
+    double key(const Entry& entry) const {
+        return std::log2(entry.hits) + entry.last / m_halfLifeSeconds;
+    }
+
+    void touch(EntryMap::iterator it, double now) {
+        Entry& entry = it->second;
+        bool ranked = !entry.moving && entry.tier == Tier::CACHE;
+        if (ranked) {
+            m_coldest.erase({key(entry), &it->first});
+        }
+        entry.hits = decayedHits(entry, now) + 1.0;
+        entry.last = std::max(entry.last, now);
+        if (ranked) {
+            m_coldest.emplace(key(entry), &it->first);
+        }
+    }
+
+    // Add or remove an entry's contribution to the ranking and the totals
+    void link(EntryMap::iterator it) {
+        const Entry& entry = it->second;
+        if (entry.tier == Tier::CACHE) {
+            m_stats.cacheFiles++;
+            m_stats.cacheBytes += entry.size;
+            if (entry.moving) {
+                m_stats.demotingFiles++;
+                m_stats.demotingBytes += entry.size;
+            } else {
+                m_coldest.emplace(key(entry), &it->first);
+            }
+        } else {
+            m_stats.arrayFiles++;
+            m_stats.arrayBytes += entry.size;
+            if (entry.moving) {
+                (entry.encoding ? m_stats.encodingFiles : m_stats.promotingFiles)++;
+            }
+        }
+    }
+
+    void unlink(EntryMap::iterator it) {
+        const Entry& entry = it->second;
+        if (entry.tier == Tier::CACHE) {
+            m_stats.cacheFiles--;
+            m_stats.cacheBytes -= entry.size;
+            if (entry.moving) {
+                m_stats.demotingFiles--;
+                m_stats.demotingBytes -= entry.size;
+            } else {
+                m_coldest.erase({key(entry), &it->first});
+            }
+        } else {
+            m_stats.arrayFiles--;
+            m_stats.arrayBytes -= entry.size;
+            if (entry.moving) {
+                (entry.encoding ? m_stats.encodingFiles : m_stats.promotingFiles)--;
+            }
+        }
+    }
+};
+
+#endif // TIERING_ENGINE_HPP
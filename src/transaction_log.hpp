@@ -5,15 +5,23 @@
 #ifndef TRANSACTION_LOG_HPP
 #define TRANSACTION_LOG_HPP
 
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <mutex>
 #include <filesystem>
 #include <chrono>
+#include <memory>
 #include <json/json.h>  // Uses jsoncpp library
 #include <atomic>
 #include <optional>
+#include <set>
+#include <unordered_map>
+
+#include "profiled_mutex.hpp"
+#include "sys/probes.hpp"
 
 namespace fs = std::filesystem;
 
@@ -25,7 +33,9 @@ public:
         COPY,
         MOVE,
         DELETE,
-        METADATA_UPDATE
+        METADATA_UPDATE,
+        REPLICATE, // one source to several destinations, complete at a quorum
+        ENCODE     // an array copy into erasure-coded shards
     };
 
     // Status of a transaction
@@ -47,6 +57,11 @@ public:
         std::chrono::system_clock::time_point timestamp;
         std::string errorMessage;
         std::optional<std::string> checksum;
+        // REPLICATE: every destination, those written, synced and verified
+        // so far, and how many of them complete the transaction
+        std::vector<std::string> replicas{};
+        std::vector<std::string> durableReplicas{};
+        uint32_t quorum = 0;
 
         // Convert to JSON for storage
         Json::Value toJson() const {
@@ -62,6 +77,16 @@ public:
             if (checksum) {
                 json["checksum"] = *checksum;
             }
+            if (!replicas.empty()) {
+                for (const auto& replica : replicas) {
+                    json["replicas"].append(replica);
+                }
+                json["durableReplicas"] = Json::Value(Json::arrayValue);
+                for (const auto& replica : durableReplicas) {
+                    json["durableReplicas"].append(replica);
+                }
+                json["quorum"] = quorum;
+            }
             return json;
         }
 
@@ -79,6 +104,13 @@ public:
             if (json.isMember("checksum")) {
                 record.checksum = json["checksum"].asString();
             }
+            for (const auto& replica : json["replicas"]) {
+                record.replicas.push_back(replica.asString());
+            }
+            for (const auto& replica : json["durableReplicas"]) {
+                record.durableReplicas.push_back(replica.asString());
+            }
+            record.quorum = json["quorum"].asUInt();
             return record;
         }
     };
@@ -102,21 +134,13 @@ public:
 
     // Open the transaction log
     bool open() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_isOpen) return true;
-
-        m_logStream.open(m_currentLogPath, std::ios::app);
-        if (!m_logStream) {
-            return false;
-        }
-
-        m_isOpen = true;
-        return true;
+        std::lock_guard lock(m_mutex);
+        return openLocked();
     }
 
     // Close the transaction log
     void close() {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
         if (!m_isOpen) return;
 
         m_logStream.close();
@@ -128,8 +152,8 @@ public:
                            const std::string& sourcePath,
                            const std::string& destPath = "",
                            const std::optional<std::string>& checksum = std::nullopt) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (!m_isOpen && !open()) {
+        std::lock_guard lock(m_mutex);
+        if (!m_isOpen && !openLocked()) {
             return "";
         }
 
@@ -149,12 +173,52 @@ public:
         return id;
     }
 
+    // Log a REPLICATE of @p sourcePath to @p replicas that completes once
+    // @p quorum of them are durable
+    std::string logReplication(const std::string& sourcePath, const std::vector<std::string>& replicas,
+                               uint32_t quorum) {
+        std::lock_guard lock(m_mutex);
+        if (!m_isOpen && !openLocked()) {
+            return "";
+        }
+
+        TransactionRecord record{generateTransactionId(), OperationType::REPLICATE, sourcePath,
+                                 replicas.empty() ? "" : replicas.front(), TransactionStatus::PENDING,
+                                 std::chrono::system_clock::now(), "", std::nullopt};
+        record.replicas = replicas;
+        record.quorum = quorum;
+        writeRecord(record);
+        return record.id;
+    }
+
+    // Note that @p replica of a REPLICATE is durable; the transaction is
+    // COMPLETED when this reaches its quorum.  Returns true if it did.
+    bool recordDurableReplica(const std::string& id, const std::string& replica) {
+        std::lock_guard lock(m_mutex);
+        if (!m_isOpen && !openLocked()) {
+            return false;
+        }
+        auto record = findTransaction(id);
+        if (!record) {
+            return false;
+        }
+
+        record->durableReplicas.push_back(replica);
+        bool reached = record->durableReplicas.size() == record->quorum;
+        if (reached) {
+            record->status = TransactionStatus::COMPLETED;
+        }
+        record->timestamp = std::chrono::system_clock::now();
+        writeRecord(*record);
+        return reached;
+    }
+
     // Update transaction status
     bool updateTransactionStatus(const std::string& id,
                               TransactionStatus status,
                               const std::string& errorMessage = "") {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (!m_isOpen && !open()) {
+        std::lock_guard lock(m_mutex);
+        if (!m_isOpen && !openLocked()) {
             return false;
         }
 
@@ -174,7 +238,7 @@ public:
 
     // Get transactions with a specific status
     std::vector<TransactionRecord> getTransactionsByStatus(TransactionStatus status) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
 
         std::vector<TransactionRecord> result;
         loadAllTransactions();
@@ -188,23 +252,85 @@ public:
         return result;
     }
 
-    // Load all in-progress transactions for recovery
+    // Load all in-progress transactions for recovery.  Once the log has been
+    // replayed the in-flight index is authoritative, so this costs
+    // O(in-flight) instead of re-parsing the whole log.
     std::vector<TransactionRecord> getPendingTransactions() {
-        std::vector<TransactionRecord> pending;
-
-        // Combine transactions in IN_PROGRESS and PENDING states
-        auto inProgress = getTransactionsByStatus(TransactionStatus::IN_PROGRESS);
-        auto pendingOnes = getTransactionsByStatus(TransactionStatus::PENDING);
+        std::lock_guard lock(m_mutex);
+        if (!m_replayed) {
+            loadAllTransactions();
+        }
 
-        pending.insert(pending.end(), inProgress.begin(), inProgress.end());
+        // IN_PROGRESS first, then PENDING
+        std::vector<TransactionRecord> pending;
+        std::vector<TransactionRecord> pendingOnes;
+        for (const auto& entry : m_inFlight) {
+            auto it = m_transactionCache.find(entry.first);
+            if (it == m_transactionCache.end()) {
+                continue;
+            }
+            if (it->second.status == TransactionStatus::IN_PROGRESS) {
+                pending.push_back(it->second);
+            } else {
+                pendingOnes.push_back(it->second);
+            }
+        }
         pending.insert(pending.end(), pendingOnes.begin(), pendingOnes.end());
 
         return pending;
     }
 
+    // What a startup replay found
+    struct RecoveryStats {
+        size_t records = 0;      // log lines replayed
+        size_t transactions = 0; // distinct transaction ids
+        size_t inFlight = 0;     // left PENDING or IN_PROGRESS
+        uint64_t tornBytes = 0;  // partial final record cut off
+    };
+
+    // Replay the log after a restart.  A crash can leave a partial last
+    // record; it is truncated so the next append starts on a fresh line.
+    RecoveryStats recover() {
+        std::lock_guard lock(m_mutex);
+        bool wasOpen = m_isOpen;
+        if (m_isOpen) {
+            m_logStream.close();
+            m_isOpen = false;
+        }
+
+        RecoveryStats stats;
+        stats.tornBytes = truncateTornTail();
+        stats.records = loadAllTransactions();
+        stats.transactions = m_transactionCache.size();
+        stats.inFlight = m_inFlight.size();
+
+        if (wasOpen) {
+            openLocked();
+        }
+        return stats;
+    }
+
+    // Transactions still PENDING or IN_PROGRESS, maintained on every write
+    struct InFlightStats {
+        size_t count = 0;
+        std::optional<std::chrono::system_clock::time_point> oldest;
+    };
+
+    // O(1) view of the recovery backlog; unlike getPendingTransactions() it
+    // never re-reads the log file
+    InFlightStats getInFlightStats() {
+        std::lock_guard lock(m_mutex);
+        InFlightStats stats;
+        stats.count = m_inFlight.size();
+        if (!m_inFlightByAge.empty()) {
+            stats.oldest = m_inFlightByAge.begin()->first;
+        }
+        return stats;
+    }
+
     // Rotate log files when they get too large
     bool rotateLogIfNeeded(size_t maxSize = 10 * 1024 * 1024) {  // Default 10MB
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard lock(m_mutex);
 
         if (!fs::exists(m_currentLogPath)) {
             return true;  // No need to rotate if file doesn't exist
@@ -247,20 +373,55 @@ public:
 
         // Clear cache and re-open log
         m_transactionCache.clear();
-        return open();
+        m_inFlight.clear();
+        m_inFlightByAge.clear();
+        return openLocked();
     }
 
 private:
     std::string m_logDir;
     std::string m_currentLogPath;
     std::ofstream m_logStream;
-    std::mutex m_mutex;
+    ProfiledMutex m_mutex{"transaction_log"};
     std::atomic<uint64_t> m_nextId;
     bool m_isOpen;
+    bool m_replayed = false; // cache and in-flight index reflect the whole log
 
     // In-memory cache of transactions
     std::unordered_map<std::string, TransactionRecord> m_transactionCache;
 
+    // In-flight transactions: id -> time first seen in flight, plus an age index
+    std::unordered_map<std::string, std::chrono::system_clock::time_point> m_inFlight;
+    std::set<std::pair<std::chrono::system_clock::time_point, std::string>> m_inFlightByAge;
+
+    // Keep the in-flight index in step with a record being written or replayed
+    void trackInFlight(const TransactionRecord& record) {
+        bool inFlight = record.status == TransactionStatus::PENDING ||
+                        record.status == TransactionStatus::IN_PROGRESS;
+        auto it = m_inFlight.find(record.id);
+
+        if (inFlight && it == m_inFlight.end()) {
+            m_inFlight.emplace(record.id, record.timestamp);
+            m_inFlightByAge.emplace(record.timestamp, record.id);
+        } else if (!inFlight && it != m_inFlight.end()) {
+            m_inFlightByAge.erase({it->second, it->first});
+            m_inFlight.erase(it);
+        }
+    }
+
+    // Open the log stream; callers hold m_mutex
+    bool openLocked() {
+        if (m_isOpen) return true;
+
+        m_logStream.open(m_currentLogPath, std::ios::app);
+        if (!m_logStream) {
+            return false;
+        }
+
+        m_isOpen = true;
+        return true;
+    }
+
     // Initialize the log system
     void initializeLog() {
         // Find the most recent log file or create a new one
@@ -312,8 +473,11 @@ private:
         m_logStream << jsonStr;
         m_logStream.flush();
 
+        SYNC_PROBE(wal_commit, record.id.c_str(), static_cast<int>(record.status));
+
         // Update the cache
         m_transactionCache[record.id] = record;
+        trackInFlight(record);
     }
 
     // Find a transaction by ID
@@ -336,10 +500,48 @@ private:
         return std::nullopt;
     }
 
-    // Load all transactions from the current log file
-    void loadAllTransactions() {
+    // Cut the log back to its last complete line; returns the bytes removed
+    uint64_t truncateTornTail() {
+        std::error_code ec;
+        uint64_t size = fs::file_size(m_currentLogPath, ec);
+        if (ec || size == 0) {
+            return 0;
+        }
+
+        std::ifstream inFile(m_currentLogPath, std::ios::binary);
+        char chunk[4096];
+        uint64_t end = size;
+        while (end > 0) {
+            uint64_t begin = end > sizeof(chunk) ? end - sizeof(chunk) : 0;
+            inFile.seekg(static_cast<std::streamoff>(begin));
+            inFile.read(chunk, static_cast<std::streamsize>(end - begin));
+            if (!inFile) {
+                return 0;
+            }
+            for (uint64_t i = end - begin; i > 0; --i) {
+                if (chunk[i - 1] == '\n') {
+                    uint64_t keep = begin + i;
+                    if (keep < size) {
+                        inFile.close();
+                        fs::resize_file(m_currentLogPath, keep);
+                    }
+                    return size - keep;
+                }
+            }
+            end = begin;
+        }
+
+        // Not a single complete record
+        inFile.close();
+        fs::resize_file(m_currentLogPath, 0);
+        return size;
+    }
+
+    // Load all transactions from the current log file; returns the records read
+    size_t loadAllTransactions() {
         if (!fs::exists(m_currentLogPath)) {
-            return;
+            m_replayed = true;
+            return 0;
         }
 
         // Close the log if it's open
@@ -353,27 +555,33 @@ private:
         std::ifstream inFile(m_currentLogPath);
         if (!inFile) {
             if (wasOpen) {
-                open();  // Reopen if it was open
+                openLocked();  // Reopen if it was open
             }
-            return;
+            return 0;
         }
 
         // Clear the cache
         m_transactionCache.clear();
+        m_inFlight.clear();
+        m_inFlightByAge.clear();
 
-        // Read line by line
+        // Read line by line with one reader; building a reader per line
+        // dominated replay time on large logs
         std::string line;
         Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
         Json::Value json;
         JSONCPP_STRING errs;
+        size_t records = 0;
 
         while (std::getline(inFile, line)) {
             if (line.empty()) continue;
 
-            std::istringstream iss(line);
-            if (Json::parseFromStream(builder, iss, &json, &errs)) {
+            if (reader->parse(line.data(), line.data() + line.size(), &json, &errs)) {
+                records++;
                 TransactionRecord record = TransactionRecord::fromJson(json);
                 m_transactionCache[record.id] = record;
+                trackInFlight(record);
 
                 // Update next ID if needed
                 if (record.id.find("tx-") == 0) {
@@ -389,11 +597,13 @@ private:
         }
 
         inFile.close();
+        m_replayed = true;
 
         // Reopen for appending if needed
         if (wasOpen) {
-            open();
+            openLocked();
         }
+        return records;
     }
 };
 
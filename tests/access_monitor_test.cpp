@@ -0,0 +1,65 @@
+//
+// Tests for the fanotify access monitor.
+//
+#include <gtest/gtest.h>
+#include "access_monitor.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Opens by another process are reported once each; the monitor's own
+// process and files outside the root are not
+TEST(AccessMonitorTest, ReportsOpensByOtherProcesses) {
+    fs::path root = fs::temp_directory_path() / "file_sync_access_monitor_test";
+    fs::remove_all(root);
+    fs::create_directories(root / "photos");
+    std::string photo = (fs::canonical(root) / "photos" / "IMG_0001.CR3").string();
+    std::string outside = (fs::temp_directory_path() / "file_sync_access_monitor_outside").string();
+    std::ofstream(photo) << std::string(1 << 20, 'x');
+    std::ofstream(outside) << "x";
+
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    std::unique_ptr<AccessMonitor> monitor;
+    try {
+        monitor = std::make_unique<AccessMonitor>((root / "photos").string(), [&](const std::string& path) {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.push_back(path);
+        });
+    } catch (const std::system_error& e) {
+        fs::remove_all(root);
+        GTEST_SKIP() << "fanotify unavailable: " << e.what();
+    }
+
+    std::ifstream(photo).get(); // our own pid: ignored
+    pid_t child = ::fork();
+    if (child == 0) {
+        // Read in small chunks; still one open
+        std::ifstream in(photo);
+        char buffer[4096];
+        while (in.read(buffer, sizeof(buffer))) {
+        }
+        std::ifstream(outside).get();
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (monitor->eventCount() < 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    monitor.reset();
+
+    EXPECT_EQ(seen, std::vector<std::string>{photo});
+    fs::remove_all(root);
+    fs::remove(outside);
+}
@@ -3,6 +3,9 @@
 //
 #include <gtest/gtest.h>
 #include "configuration.hpp"
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 class ConfigurationTest : public ::testing::Test {
 protected:
@@ -28,4 +31,139 @@ TEST_F(ConfigurationTest, UpdateValues) {
     EXPECT_EQ(config.num_threads, 4);
 }
 
-// Add more tests as you expand your Configuration class functionality
\ No newline at end of file
+// Shell-style assignments: quotes, comments, export and unknown keys
+TEST_F(ConfigurationTest, ParsesShellSyntax) {
+    auto config = Configuration::parse(
+        "# photo-sync settings\n"
+        "SOURCE_DIR=\"/photos/My Pictures\"\n"
+        "export DEST_DIR='/backup'\n"
+        "ARRAY_MEMBERS=\"/mnt/array2:4T /mnt/array3\"\n"
+        "NUM_THREADS=8   # workers\n"
+        "EXCLUDE_PATTERNS=\".DS_Store *.tmp cache/\"\n"
+        "ENABLE_HEALTH_CHECKS=false\n"
+        "BANDWIDTH_LIMIT=20M\n"
+        "IOPS_LIMIT=400\n"
+        "DEVICE_LIMITS=\"/mnt/array2:50M:200 /mnt/array3:0:100\"\n"
+        "CLASS_LIMITS=BACKGROUND:5M\n"
+        "COPY_BUFFER_SIZE=1M\n"
+        "TIER_CACHE_CAPACITY=2G\n"
+        "TIER_PROMOTE_ACCESSES=1.5\n"
+        "WRITE_BACK=true\n"
+        "WRITE_BACK_BATCH=512M\n"
+        "TIERING=true\n"
+        "ERASURE_CODING=2+1\n"
+        "RSYNC_OPTS=\"-av --delete\"\n");
+
+    EXPECT_EQ(config.source_dir, "/photos/My Pictures");
+    EXPECT_EQ(config.dest_dir, "/backup");
+    EXPECT_EQ(config.array_members, (std::vector<Configuration::ArrayMember>{{"/mnt/array2", 4ULL << 40},
+                                                                            {"/mnt/array3", 0}}));
+    EXPECT_EQ(config.num_threads, 8);
+    EXPECT_EQ(config.exclude_patterns, (std::vector<std::string>{".DS_Store", "*.tmp", "cache/"}));
+    EXPECT_FALSE(config.enable_health_checks);
+    EXPECT_EQ(config.bandwidth_limit_bytes, 20u * 1024 * 1024);
+    EXPECT_EQ(config.iops_limit, 400u);
+    EXPECT_EQ(config.device_limits, (std::vector<Configuration::IoLimit>{{"/mnt/array2", 50ULL << 20, 200},
+                                                                         {"/mnt/array3", 0, 100}}));
+    EXPECT_EQ(config.class_limits, (std::vector<Configuration::IoLimit>{{"BACKGROUND", 5ULL << 20, 0}}));
+    EXPECT_EQ(config.copy_buffer_size, 1024u * 1024);
+    EXPECT_EQ(config.tier_cache_capacity, 2ULL << 30);
+    EXPECT_DOUBLE_EQ(config.tier_promote_accesses, 1.5);
+    EXPECT_TRUE(config.write_back);
+    EXPECT_EQ(config.write_back_batch_bytes, 512ULL << 20);
+    EXPECT_EQ(config.erasure_data_shards, 2u);
+    EXPECT_EQ(config.erasure_parity_shards, 1u);
+    EXPECT_NO_THROW(config.validate());
+}
+
+// Syntax and type errors name the offending line
+TEST_F(ConfigurationTest, ReportsLineOfBadValue) {
+    try {
+        Configuration::parse("SOURCE_DIR=/a\nNUM_THREADS=many\n", "test.conf");
+        FAIL() << "expected a parse error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("test.conf:2"), std::string::npos) << e.what();
+    }
+
+    EXPECT_THROW(Configuration::parse("if [ -z x ]; then\n"), std::runtime_error);
+    EXPECT_THROW(Configuration::parse("SOURCE_DIR=\"/unterminated\n"), std::runtime_error);
+    EXPECT_THROW(Configuration::parse("ENABLE_HEALTH_CHECKS=maybe\n"), std::runtime_error);
+    EXPECT_THROW(Configuration::parse("ERASURE_CODING=4\n"), std::runtime_error);
+    EXPECT_THROW(Configuration::parse("DEVICE_LIMITS=/mnt/array2\n"), std::runtime_error);
+    EXPECT_THROW(Configuration::parse("CLASS_LIMITS=LOW:1M:fast\n"), std::runtime_error);
+}
+
+// Validation collects every invalid setting
+TEST_F(ConfigurationTest, ValidateRejectsBadSettings) {
+    Configuration config;
+    EXPECT_THROW(config.validate(), std::runtime_error); // no directories
+
+    config.source_dir = "/photos";
+    config.dest_dir = "/photos/";
+    EXPECT_THROW(config.validate(), std::runtime_error); // same directory
+
+    config.dest_dir = "/backup";
+    EXPECT_NO_THROW(config.validate());
+
+    config.num_threads = 0;
+    config.verify_method = "CRC32";
+    config.copy_buffer_size = 100;
+    config.tier_low_watermark = 95;
+    config.tier_demote_mode = "delete";
+    config.write_back_max_age_seconds = 600;
+    config.array_members = {{"/mnt/array2", 0}, {"/mnt/array2/", 0}};
+    config.erasure_data_shards = 2;
+    config.erasure_parity_shards = 1;
+    config.device_limits = {{"mnt/array2", 1 << 20, 0}};
+    config.class_limits = {{"IDLE", 1 << 20, 0}, {"LOW", 0, 10}, {"LOW", 0, 20}};
+    try {
+        config.validate();
+        FAIL() << "expected a validation error";
+    } catch (const std::runtime_error& e) {
+        std::string message = e.what();
+        EXPECT_NE(message.find("NUM_THREADS"), std::string::npos);
+        EXPECT_NE(message.find("VERIFY_METHOD"), std::string::npos);
+        EXPECT_NE(message.find("COPY_BUFFER_SIZE"), std::string::npos);
+        EXPECT_NE(message.find("TIER_LOW_WATERMARK"), std::string::npos);
+        EXPECT_NE(message.find("TIER_DEMOTE_MODE"), std::string::npos);
+        EXPECT_NE(message.find("WRITE_BACK_MAX_AGE"), std::string::npos);
+        EXPECT_NE(message.find("ARRAY_MEMBERS"), std::string::npos);
+        EXPECT_NE(message.find("ERASURE_CODING needs K + M array members"), std::string::npos);
+        EXPECT_NE(message.find("set TIERING=true"), std::string::npos);
+        EXPECT_NE(message.find("DEVICE_LIMITS entries must start with an absolute directory"), std::string::npos);
+        EXPECT_NE(message.find("CLASS_LIMITS priorities"), std::string::npos);
+        EXPECT_NE(message.find("CLASS_LIMITS lists LOW twice"), std::string::npos);
+    }
+}
+
+// Patterns without '/' match any component, others are anchored at SOURCE_DIR
+TEST_F(ConfigurationTest, ExcludePatterns) {
+    Configuration config;
+    config.source_dir = "/photos";
+    config.exclude_patterns = {".DS_Store", "*.tmp", "/cache/", "Albums/*/thumbs"};
+
+    EXPECT_TRUE(config.isExcluded("/photos/2024/.DS_Store"));
+    EXPECT_TRUE(config.isExcluded("/photos/2024/upload.tmp"));
+    EXPECT_TRUE(config.isExcluded("/photos/cache/a.jpg"));
+    EXPECT_TRUE(config.isExcluded("/photos/Albums/Trip/thumbs/a.jpg"));
+    EXPECT_FALSE(config.isExcluded("/photos/2024/cache/a.jpg"));
+    EXPECT_FALSE(config.isExcluded("/photos/Albums/Trip/a.jpg"));
+    EXPECT_FALSE(config.isExcluded("/photos/2024/img.jpg"));
+}
+
+// Directory and file locations are reported as needing a restart
+TEST_F(ConfigurationTest, RestartRequiredChanges) {
+    Configuration running;
+    Configuration updated;
+    updated.num_threads = 8;
+    updated.exclude_patterns = {"*.tmp"};
+    EXPECT_TRUE(updated.restartRequiredChanges(running).empty());
+
+    updated.dest_dir = "/elsewhere";
+    EXPECT_EQ(updated.restartRequiredChanges(running), std::vector<std::string>{"DEST_DIR"});
+
+    updated.dest_dir = running.dest_dir;
+    updated.tier_high_watermark = 80;
+    updated.tier_half_life_seconds = 3600;
+    EXPECT_EQ(updated.restartRequiredChanges(running), std::vector<std::string>{"TIER_HALF_LIFE"});
+}
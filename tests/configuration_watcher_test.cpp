@@ -0,0 +1,108 @@
+//
+// Tests for configuration hot reload.
+//
+#include <gtest/gtest.h>
+#include "configuration_watcher.hpp"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+class ConfigurationWatcherTest : public ::testing::Test {
+protected:
+    fs::path testDir;
+    fs::path configPath;
+
+    std::mutex mutex;
+    std::shared_ptr<Configuration> latest;
+    std::vector<std::string> errors;
+
+    void SetUp() override {
+        testDir = fs::temp_directory_path() / "file_sync_config_watch_test";
+        fs::create_directories(testDir);
+        configPath = testDir / "photo-sync.conf";
+        writeConfig(configPath, 2);
+    }
+
+    void TearDown() override {
+        fs::remove_all(testDir);
+    }
+
+    static void writeConfig(const fs::path& path, int threads) {
+        std::ofstream out(path);
+        out << "SOURCE_DIR=/photos\nDEST_DIR=/backup\nNUM_THREADS=" << threads << "\n";
+    }
+
+    std::unique_ptr<ConfigurationWatcher> makeWatcher() {
+        return std::make_unique<ConfigurationWatcher>(
+            configPath.string(),
+            [this](std::shared_ptr<Configuration> config) {
+                std::lock_guard lock(mutex);
+                latest = std::move(config);
+            },
+            [this](const std::string& error) {
+                std::lock_guard lock(mutex);
+                errors.push_back(error);
+            });
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate predicate) {
+        for (int i = 0; i < 100; ++i) {
+            {
+                std::lock_guard lock(mutex);
+                if (predicate()) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+};
+
+// Rewriting the file in place delivers the new configuration
+TEST_F(ConfigurationWatcherTest, ReloadsOnWrite) {
+    auto watcher = makeWatcher();
+    writeConfig(configPath, 6);
+
+    ASSERT_TRUE(waitFor([this] { return latest && latest->num_threads == 6; }));
+    EXPECT_EQ(latest->config_file, configPath.string());
+}
+
+// Editors that save to a temporary file and rename it over the original are seen too
+TEST_F(ConfigurationWatcherTest, ReloadsOnRename) {
+    auto watcher = makeWatcher();
+    fs::path temp = testDir / "photo-sync.conf.swp";
+    writeConfig(temp, 12);
+    fs::rename(temp, configPath);
+
+    ASSERT_TRUE(waitFor([this] { return latest && latest->num_threads == 12; }));
+}
+
+// An invalid file is reported and not delivered
+TEST_F(ConfigurationWatcherTest, KeepsPreviousOnInvalidFile) {
+    auto watcher = makeWatcher();
+    {
+        std::ofstream out(configPath);
+        out << "SOURCE_DIR=/photos\nDEST_DIR=/backup\nNUM_THREADS=0\n";
+    }
+
+    ASSERT_TRUE(waitFor([this] { return !errors.empty(); }));
+    EXPECT_EQ(latest, nullptr);
+    EXPECT_EQ(watcher->reloadCount(), 0u);
+    EXPECT_NE(errors.front().find("NUM_THREADS"), std::string::npos);
+}
+
+// Changes to other files in the directory are ignored
+TEST_F(ConfigurationWatcherTest, IgnoresOtherFiles) {
+    auto watcher = makeWatcher();
+    writeConfig(testDir / "other.conf", 9);
+    watcher->checkNow();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(watcher->reloadCount(), 0u);
+}
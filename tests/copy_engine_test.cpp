@@ -0,0 +1,153 @@
+//
+// Tests for the file copy strategies.
+//
+#include <gtest/gtest.h>
+#include "copy_engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+class CopyEngineTest : public ::testing::TestWithParam<CopyStrategy> {
+protected:
+    fs::path testDir;
+
+    void SetUp() override {
+        testDir = fs::temp_directory_path() / "file_sync_copy_engine_test";
+        fs::remove_all(testDir);
+        fs::create_directories(testDir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(testDir);
+    }
+
+    std::string writeFile(const std::string& name, size_t size) {
+        std::string data(size, '\0');
+        std::mt19937 rng(static_cast<unsigned>(size));
+        for (auto& c : data) {
+            c = static_cast<char>(rng());
+        }
+        std::ofstream(testDir / name, std::ios::binary) << data;
+        return data;
+    }
+
+    std::string readFile(const std::string& name) {
+        std::ifstream in(testDir / name, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+};
+
+// Sizes straddle the buffer and O_DIRECT alignment so partial tails are covered
+TEST_P(CopyEngineTest, CopiesContentAndTimes) {
+    for (size_t size : {size_t{0}, size_t{1}, size_t{4095}, size_t{65536}, size_t{300000}}) {
+        std::string data = writeFile("source.bin", size);
+        // Stale, longer destination content must not survive
+        writeFile("dest.bin", size + 5000);
+        fs::last_write_time(testDir / "source.bin", fs::file_time_type::clock::now() - std::chrono::hours(24));
+
+        CopyOptions options;
+        options.strategy = GetParam();
+        options.bufferSize = 65536;
+        uint64_t throttled = 0;
+        options.throttle = [&](uint64_t bytes) { throttled += bytes; };
+        CopyResult result = CopyEngine::copyFile((testDir / "source.bin").string(),
+                                                 (testDir / "dest.bin").string(), options);
+
+        EXPECT_EQ(result.bytes, size);
+        EXPECT_EQ(throttled, size); // every chunk passes the throttle
+        EXPECT_EQ(readFile("dest.bin"), data) << "size " << size;
+        EXPECT_EQ(fs::last_write_time(testDir / "dest.bin"), fs::last_write_time(testDir / "source.bin"));
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Strategies, CopyEngineTest,
+                         ::testing::Values(CopyStrategy::READ_WRITE, CopyStrategy::SENDFILE,
+                                           CopyStrategy::COPY_FILE_RANGE, CopyStrategy::DIRECT_IO),
+                         [](const auto& info) { return std::string(toString(info.param)); });
+
+TEST(CopyEngineErrorTest, MissingSourceThrows) {
+    EXPECT_THROW(CopyEngine::copyFile("/nonexistent/source", "/tmp/file_sync_copy_engine_unused"),
+                 std::system_error);
+}
+
+TEST(CopyEngineErrorTest, StrategyNames) {
+    EXPECT_EQ(copyStrategyFromString("sendfile"), CopyStrategy::SENDFILE);
+    EXPECT_EQ(copyStrategyFromString("direct"), CopyStrategy::DIRECT_IO);
+    EXPECT_FALSE(copyStrategyFromString("auto").has_value());
+}
+
+// Every destination gets the whole file from one read of the source
+TEST(CopyEngineFanOutTest, WritesEveryDestination) {
+    fs::path dir = fs::temp_directory_path() / "file_sync_copy_engine_fan_out_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    for (size_t size : {size_t{0}, size_t{4095}, size_t{300000}}) {
+        std::string data(size, '\0');
+        std::mt19937 rng(static_cast<unsigned>(size));
+        for (auto& c : data) {
+            c = static_cast<char>(rng());
+        }
+        std::ofstream(dir / "source.bin", std::ios::binary) << data;
+        fs::last_write_time(dir / "source.bin", fs::file_time_type::clock::now() - std::chrono::hours(24));
+        // Stale, longer content in one destination must not survive
+        std::ofstream(dir / "b.bin", std::ios::binary) << std::string(size + 5000, 'x');
+
+        std::vector<std::string> dests{(dir / "a.bin").string(), (dir / "b.bin").string(),
+                                       (dir / "c.bin").string()};
+        std::mutex mutex;
+        std::vector<size_t> durable;
+        FanOutResult result = CopyEngine::fanOutCopy((dir / "source.bin").string(), dests, 65536, [&](size_t i) {
+            std::lock_guard lock(mutex);
+            durable.push_back(i);
+        });
+
+        EXPECT_EQ(result.bytes, size);
+        std::sort(durable.begin(), durable.end());
+        EXPECT_EQ(durable, (std::vector<size_t>{0, 1, 2}));
+        for (size_t i = 0; i < dests.size(); ++i) {
+            EXPECT_TRUE(result.errors[i].empty()) << result.errors[i];
+            std::ifstream in(dests[i], std::ios::binary);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            EXPECT_EQ(ss.str(), data) << dests[i] << " size " << size;
+            EXPECT_EQ(fs::last_write_time(dests[i]), fs::last_write_time(dir / "source.bin"));
+        }
+    }
+    fs::remove_all(dir);
+}
+
+// A destination that cannot be written is reported and the others complete
+TEST(CopyEngineFanOutTest, FailedDestinationIsDropped) {
+    fs::path dir = fs::temp_directory_path() / "file_sync_copy_engine_fan_out_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string data(200000, 'p');
+    std::ofstream(dir / "source.bin", std::ios::binary) << data;
+
+    std::vector<std::string> dests{(dir / "a.bin").string(), (dir / "missing" / "b.bin").string()};
+    std::atomic<int> durable{0};
+    FanOutResult result = CopyEngine::fanOutCopy((dir / "source.bin").string(), dests, 4096,
+                                                 [&](size_t i) {
+                                                     EXPECT_EQ(i, 0u);
+                                                     durable++;
+                                                 });
+
+    EXPECT_EQ(result.bytes, data.size());
+    EXPECT_TRUE(result.errors[0].empty());
+    EXPECT_FALSE(result.errors[1].empty());
+    EXPECT_EQ(durable, 1);
+    EXPECT_EQ(fs::file_size(dests[0]), data.size());
+
+    EXPECT_THROW(CopyEngine::fanOutCopy((dir / "nonexistent").string(), dests), std::system_error);
+    fs::remove_all(dir);
+}
@@ -0,0 +1,193 @@
+//
+// Tests for the cuckoo filter of destination files in sync.
+//
+#include <gtest/gtest.h>
+#include "cuckoo_filter.hpp"
+#include "file_verification.hpp"
+
+#include <fstream>
+#include <sys/stat.h>
+
+namespace {
+
+uint64_t key(int i, uint64_t size = 100) {
+    return CuckooFilter::key("/dest", "/2024/IMG_" + std::to_string(i) + ".CR3", size, 1700000000000000000LL + i);
+}
+
+} // namespace
+
+// Every inserted key is found until erased; other keys rarely are
+TEST(CuckooFilterTest, InsertContainsErase) {
+    const int kKeys = 100000;
+    CuckooFilter filter(kKeys);
+    for (int i = 0; i < kKeys; ++i) {
+        ASSERT_TRUE(filter.insert(key(i)));
+    }
+    // Keys alike in fingerprint and buckets share a slot
+    size_t stored = filter.size();
+    EXPECT_GT(stored, static_cast<size_t>(kKeys) - 20);
+    for (int i = 0; i < kKeys; ++i) {
+        ASSERT_TRUE(filter.contains(key(i)));
+    }
+
+    // A rewritten file (new size or mtime) or another path misses
+    int falsePositives = 0;
+    for (int i = 0; i < kKeys; ++i) {
+        falsePositives += filter.contains(key(i, 101)) ? 1 : 0;
+        falsePositives += filter.contains(key(kKeys + i)) ? 1 : 0;
+    }
+    EXPECT_LT(falsePositives, 2 * kKeys / 1000);
+    // Slashes where root and relative path meet do not matter
+    EXPECT_EQ(CuckooFilter::key("/dest/", "a/b", 1, 2), CuckooFilter::key("/dest", "/a/b", 1, 2));
+    EXPECT_NE(CuckooFilter::key("/dest", "/a/b", 1, 2), CuckooFilter::key("/other", "/a/b", 1, 2));
+
+    // Inserting again does not take another slot
+    EXPECT_TRUE(filter.insert(key(0)));
+    EXPECT_EQ(filter.size(), stored);
+
+    size_t erased = 0;
+    for (int i = 0; i < kKeys; i += 2) {
+        erased += filter.erase(key(i)) ? 1 : 0;
+    }
+    EXPECT_EQ(filter.size(), stored - erased);
+    int lost = 0;
+    for (int i = 1; i < kKeys; i += 2) {
+        lost += filter.contains(key(i)) ? 0 : 1;
+    }
+    EXPECT_LT(lost, 20);
+}
+
+// Filled past its capacity, the filter refuses inserts but loses nothing
+TEST(CuckooFilterTest, FullFilterKeepsEntries) {
+    CuckooFilter filter(1000);
+    std::vector<int> inserted;
+    for (int i = 0; i < static_cast<int>(filter.capacity()) * 2; ++i) {
+        if (!filter.insert(key(i))) {
+            break;
+        }
+        inserted.push_back(i);
+    }
+    EXPECT_GT(inserted.size(), filter.capacity() * 9 / 10);
+    EXPECT_LE(inserted.size(), filter.capacity() + 1);
+    for (int i : inserted) {
+        ASSERT_TRUE(filter.contains(key(i)));
+    }
+
+    // A rebuild sizes the table for the keys it is given
+    std::vector<uint64_t> keys;
+    for (int i : inserted) {
+        keys.push_back(key(i));
+    }
+    filter.rebuild(keys);
+    EXPECT_GE(filter.capacity(), 2 * keys.size());
+    EXPECT_TRUE(filter.insert(key(-1)));
+    for (uint64_t k : keys) {
+        ASSERT_TRUE(filter.contains(k));
+    }
+}
+
+TEST(CuckooFilterTest, SaveAndLoad) {
+    std::string path = (std::filesystem::temp_directory_path() / "file_sync_cuckoo_filter_test.bin").string();
+    CuckooFilter filter;
+    for (int i = 0; i < 5000; ++i) {
+        filter.insert(key(i));
+    }
+    ASSERT_TRUE(filter.save(path));
+
+    CuckooFilter loaded(16);
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.size(), 5000u);
+    EXPECT_EQ(loaded.capacity(), filter.capacity());
+    for (int i = 0; i < 5000; ++i) {
+        ASSERT_TRUE(loaded.contains(key(i)));
+    }
+
+    // A torn file is refused and the filter kept
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 2);
+    EXPECT_FALSE(loaded.load(path));
+    EXPECT_TRUE(loaded.contains(key(0)));
+    std::filesystem::remove(path);
+    EXPECT_FALSE(loaded.load(path));
+}
+
+// verifyDirectory trusts filter hits without looking at the destination and
+// rebuilds the filter from the files it found in sync
+TEST(CuckooFilterTest, VerifyDirectoryUsesFilter) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "file_sync_cuckoo_verify_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "src");
+    fs::create_directories(dir / "dst");
+    for (const char* name : {"a", "b", "c"}) {
+        std::ofstream(dir / "src" / name) << name;
+        fs::copy_file(dir / "src" / name, dir / "dst" / name);
+        fs::last_write_time(dir / "dst" / name, fs::last_write_time(dir / "src" / name));
+    }
+    auto keyOf = [&](const char* name) {
+        struct stat st;
+        stat((dir / "src" / name).c_str(), &st);
+        return CuckooFilter::key((dir / "dst").string(), name, static_cast<uint64_t>(st.st_size),
+                                 static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    };
+
+    CuckooFilter filter;
+    FileVerification verifier;
+    auto results = verifier.verifyDirectory((dir / "src").string(), (dir / "dst").string(),
+                                            FileVerification::VerifyMethod::SIZE_ONLY, false, 1, &filter);
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(filter.size(), 3u);
+    EXPECT_TRUE(filter.contains(keyOf("a")));
+
+    // "a" is taken on the filter's word; "b" was rewritten and is checked
+    fs::remove(dir / "dst" / "a");
+    std::ofstream(dir / "src" / "b") << "bb";
+    results = verifier.verifyDirectory((dir / "src").string(), (dir / "dst").string(),
+                                       FileVerification::VerifyMethod::SIZE_ONLY, false, 1, &filter);
+    size_t matched = 0;
+    for (const auto& [relative, result] : results) {
+        matched += result.matches ? 1 : 0;
+    }
+    EXPECT_EQ(matched, 2u);
+    EXPECT_TRUE(filter.contains(keyOf("a")));
+    EXPECT_FALSE(filter.contains(keyOf("b")));
+
+    // A hash check still reads the destination, finds "a" gone and drops it
+    verifier.verifyDirectory((dir / "src").string(), (dir / "dst").string(),
+                             FileVerification::VerifyMethod::FAST_HASH, false, 1, &filter);
+    EXPECT_FALSE(filter.contains(keyOf("a")));
+    EXPECT_TRUE(filter.contains(keyOf("c")));
+    fs::remove_all(dir);
+}
+
+// Each file is looked up and checked under the root it is placed on;
+// extras are still the files under the destination with no source
+TEST(CuckooFilterTest, VerifyDirectoryUsesPlacedRoot) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "file_sync_cuckoo_placed_test";
+    fs::remove_all(dir);
+    for (const char* sub : {"src", "dst", "member"}) {
+        fs::create_directories(dir / sub);
+    }
+    std::ofstream(dir / "src" / "a") << "a";
+    std::ofstream(dir / "src" / "b") << "b";
+    fs::copy_file(dir / "src" / "a", dir / "member" / "a");
+    fs::copy_file(dir / "src" / "b", dir / "dst" / "b");
+    std::ofstream(dir / "dst" / "extra") << "x";
+    std::string member = (dir / "member").string() + "/";
+    auto rootFor = [&](const std::string& relative) { return relative == "a" ? member : std::string(); };
+
+    CuckooFilter filter;
+    FileVerification verifier;
+    auto results = verifier.verifyDirectory((dir / "src").string(), (dir / "dst").string(),
+                                            FileVerification::VerifyMethod::SIZE_ONLY, false, 1, &filter, rootFor);
+    ASSERT_EQ(results.size(), 3u);
+    for (const auto& [relative, result] : results) {
+        EXPECT_EQ(result.matches, relative != "extra") << relative;
+    }
+    struct stat st;
+    stat((dir / "src" / "a").c_str(), &st);
+    EXPECT_TRUE(filter.contains(CuckooFilter::key((dir / "member").string(), "/a", static_cast<uint64_t>(st.st_size),
+                                                  static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                                                      st.st_mtim.tv_nsec)));
+    fs::remove_all(dir);
+}
@@ -0,0 +1,170 @@
+//
+// Tests for sysfs device profiling and per-device admission.
+//
+#include <gtest/gtest.h>
+#include "device_profiler.hpp"
+
+#include <future>
+
+class DeviceProfilerTest : public ::testing::Test {
+protected:
+    fs::path sysfs;
+
+    void SetUp() override {
+        sysfs = fs::temp_directory_path() / "file_sync_device_profiler_test";
+        fs::remove_all(sysfs);
+
+        // An SMR disk with one partition and an NVMe namespace
+        addDisk("sda", "8:0", {{"rotational", "1"}, {"nr_requests", "64"}, {"optimal_io_size", "0"},
+                               {"logical_block_size", "512"}, {"max_sectors_kb", "1280"},
+                               {"zoned", "host-aware"}});
+        fs::create_directories(sysfs / "devices" / "sda" / "sda1");
+        std::ofstream(sysfs / "devices" / "sda" / "sda1" / "partition") << "1\n";
+        fs::create_directory_symlink(sysfs / "devices" / "sda" / "sda1", sysfs / "dev" / "block" / "8:1");
+
+        addDisk("nvme0n1", "259:0", {{"rotational", "0"}, {"nr_requests", "1023"},
+                                     {"optimal_io_size", "0"}, {"logical_block_size", "4096"},
+                                     {"max_sectors_kb", "512"}, {"zoned", "none"}});
+    }
+
+    void TearDown() override {
+        fs::remove_all(sysfs);
+    }
+
+    void addDisk(const std::string& name, const std::string& number,
+                 const std::vector<std::pair<std::string, std::string>>& queue) {
+        fs::path disk = sysfs / "devices" / name;
+        fs::create_directories(disk / "queue");
+        for (const auto& [file, value] : queue) {
+            std::ofstream(disk / "queue" / file) << value << "\n";
+        }
+        fs::create_directories(sysfs / "dev" / "block");
+        fs::create_directory_symlink(disk, sysfs / "dev" / "block" / number);
+    }
+};
+
+// A partition resolves to its disk's queue; rotational media get few, large streams
+TEST_F(DeviceProfilerTest, PartitionUsesDiskQueue) {
+    DeviceProfiler profiler(sysfs.string());
+    IoProfile profile = profiler.profileForDevice(8, 1);
+
+    EXPECT_EQ(profile.device, "sda");
+    EXPECT_TRUE(profile.rotational);
+    EXPECT_TRUE(profile.zoned);
+    EXPECT_EQ(profile.queueDepth, 64u);
+    EXPECT_EQ(profile.maxTransferBytes, 1280u * 1024);
+    EXPECT_EQ(profile.concurrency, 1u); // zoned: strictly one writer
+    EXPECT_GE(profile.bufferSize, 1024u * 1024);
+    EXPECT_EQ(profile.copyStrategy, CopyStrategy::READ_WRITE);
+}
+
+TEST_F(DeviceProfilerTest, FlashKeepsQueueBusy) {
+    DeviceProfiler profiler(sysfs.string());
+    IoProfile profile = profiler.profileForDevice(259, 0);
+
+    EXPECT_EQ(profile.device, "nvme0n1");
+    EXPECT_FALSE(profile.rotational);
+    EXPECT_FALSE(profile.zoned);
+    EXPECT_EQ(profile.logicalBlockSize, 4096u);
+    EXPECT_EQ(profile.concurrency, 16u);
+    EXPECT_EQ(profile.bufferSize, 256u * 1024);
+    EXPECT_EQ(profile.copyStrategy, CopyStrategy::COPY_FILE_RANGE);
+}
+
+// tmpfs, NFS and friends have no block queue
+TEST_F(DeviceProfilerTest, UnknownDeviceGetsDefaults) {
+    DeviceProfiler profiler(sysfs.string());
+    IoProfile profile = profiler.profileForDevice(0, 42);
+
+    EXPECT_FALSE(profile.isBlockDevice());
+    EXPECT_FALSE(profile.rotational);
+    EXPECT_GT(profile.concurrency, 1u);
+}
+
+// A rotational disk on either side switches the pair to large buffered copies
+TEST_F(DeviceProfilerTest, CopyOptionsFollowSlowerSide) {
+    DeviceProfiler profiler(sysfs.string());
+    IoProfile hdd = profiler.profileForDevice(8, 0);
+    IoProfile ssd = profiler.profileForDevice(259, 0);
+
+    EXPECT_EQ(copyOptionsFor(ssd, ssd).strategy, CopyStrategy::COPY_FILE_RANGE);
+    CopyOptions mixed = copyOptionsFor(ssd, hdd);
+    EXPECT_EQ(mixed.strategy, CopyStrategy::READ_WRITE);
+    EXPECT_EQ(mixed.bufferSize, hdd.bufferSize);
+    EXPECT_EQ(mixed.alignment, 4096u);
+}
+
+// Profiles are cached per device, and paths that do not exist yet use their nearest ancestor
+TEST_F(DeviceProfilerTest, ProfileForPathIsCached) {
+    DeviceProfiler profiler;
+    fs::path missing = sysfs / "not" / "created" / "yet.jpg";
+    IoProfile first = profiler.profileFor(missing.string());
+    IoProfile second = profiler.profileFor(sysfs.string());
+
+    struct stat st{};
+    ASSERT_EQ(::stat(sysfs.c_str(), &st), 0);
+    EXPECT_EQ(first.deviceId, st.st_dev);
+    EXPECT_EQ(second.deviceId, first.deviceId);
+    EXPECT_NE(profiler.getSummary().find("concurrency"), std::string::npos);
+}
+
+TEST_F(DeviceProfilerTest, GateLimitsConcurrencyPerDevice) {
+    IoProfile profile;
+    profile.deviceId = makedev(8, 0);
+    profile.concurrency = 1;
+
+    DeviceGate gate;
+    std::promise<void> admitted;
+    std::future<void> secondAdmitted = admitted.get_future();
+    std::thread second;
+    {
+        auto slot = gate.acquire(profile);
+        EXPECT_EQ(gate.active(profile.deviceId), 1u);
+
+        second = std::thread([&] {
+            auto slot = gate.acquire(profile);
+            admitted.set_value();
+        });
+        EXPECT_EQ(secondAdmitted.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+        // Another device is not held up
+        IoProfile other = profile;
+        other.deviceId = makedev(259, 0);
+        auto otherSlot = gate.acquire(other);
+        EXPECT_EQ(gate.active(other.deviceId), 1u);
+    }
+    EXPECT_EQ(secondAdmitted.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    second.join();
+    EXPECT_EQ(gate.active(profile.deviceId), 0u);
+}
+
+// A paused slot lets another operation on the device through and is taken
+// back only once that one is done and every pause was resumed
+TEST_F(DeviceProfilerTest, PausedSlotLetsOthersThrough) {
+    IoProfile profile;
+    profile.deviceId = makedev(8, 0);
+    profile.concurrency = 1;
+
+    DeviceGate gate;
+    auto slot = gate.acquire(profile);
+    slot.pause();
+    slot.pause();
+    EXPECT_EQ(gate.active(profile.deviceId), 0u);
+
+    std::promise<void> resumed;
+    std::future<void> slotResumed = resumed.get_future();
+    std::thread owner;
+    {
+        auto other = gate.acquire(profile);
+        slot.resume();
+        EXPECT_EQ(gate.active(profile.deviceId), 1u);
+        owner = std::thread([&] {
+            slot.resume();
+            resumed.set_value();
+        });
+        EXPECT_EQ(slotResumed.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+    }
+    EXPECT_EQ(slotResumed.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    owner.join();
+    EXPECT_EQ(gate.active(profile.deviceId), 1u);
+}
@@ -0,0 +1,140 @@
+//
+// Tests for write-back bookkeeping: dirty state, flush triggers and ordering.
+//
+#include <gtest/gtest.h>
+#include "dirty_set.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const auto kStart = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+
+std::function<std::string()> record(const std::string& txId, int* opened = nullptr) {
+    return [txId, opened] {
+        if (opened) {
+            (*opened)++;
+        }
+        return txId;
+    };
+}
+
+} // namespace
+
+// One record per dirty period; a clean flush returns it for closing
+TEST(DirtySetTest, MarkAndFlush) {
+    DirtySet dirty;
+    int opened = 0;
+    EXPECT_TRUE(dirty.markDirty("/photos/a.jpg", 100, SyncPriority::NORMAL, record("tx-a", &opened), kStart));
+    EXPECT_FALSE(dirty.markDirty("/photos/a.jpg", 150, SyncPriority::HIGH, record("tx-other", &opened), kStart));
+    EXPECT_EQ(opened, 1);
+
+    auto stats = dirty.getStats(kStart + std::chrono::seconds(2));
+    EXPECT_EQ(stats.files, 1u);
+    EXPECT_EQ(stats.bytes, 150u);
+    EXPECT_EQ(stats.oldestAge, std::chrono::seconds(2));
+
+    auto batch = dirty.takeBatch();
+    ASSERT_EQ(batch.size(), 1u);
+    EXPECT_EQ(batch[0].priority, SyncPriority::HIGH);
+    EXPECT_EQ(batch[0].transactionId, "tx-a");
+    EXPECT_TRUE(dirty.takeBatch().empty());
+
+    EXPECT_EQ(dirty.flushed("/photos/a.jpg", true), std::optional<std::string>("tx-a"));
+    EXPECT_FALSE(dirty.isDirty("/photos/a.jpg"));
+    EXPECT_EQ(dirty.getStats().bytes, 0u);
+}
+
+// A write during a flush keeps the file dirty, aged from that write
+TEST(DirtySetTest, RewriteDuringFlush) {
+    DirtySet dirty;
+    dirty.markDirty("/photos/a.jpg", 100, SyncPriority::NORMAL, record("tx-a"), kStart);
+    dirty.takeBatch();
+    dirty.markDirty("/photos/a.jpg", 100, SyncPriority::NORMAL, record("tx-b"), kStart + std::chrono::seconds(10));
+
+    EXPECT_FALSE(dirty.flushed("/photos/a.jpg", true));
+    EXPECT_TRUE(dirty.isDirty("/photos/a.jpg"));
+    EXPECT_EQ(dirty.getStats(kStart + std::chrono::seconds(15)).oldestAge, std::chrono::seconds(5));
+
+    auto batch = dirty.takeBatch();
+    ASSERT_EQ(batch.size(), 1u);
+    EXPECT_EQ(batch[0].transactionId, "tx-a");
+    EXPECT_EQ(dirty.flushed("/photos/a.jpg", true), std::optional<std::string>("tx-a"));
+
+    // A failed flush leaves the set; its record stays open for recovery
+    dirty.markDirty("/photos/b.jpg", 100, SyncPriority::NORMAL, record("tx-c"), kStart);
+    dirty.takeBatch();
+    EXPECT_FALSE(dirty.flushed("/photos/b.jpg", false));
+    EXPECT_FALSE(dirty.isDirty("/photos/b.jpg"));
+}
+
+// Flushes start at the max age or once enough bytes are waiting
+TEST(DirtySetTest, FlushDue) {
+    DirtySet dirty;
+    EXPECT_FALSE(dirty.flushDue(std::chrono::seconds(30), 1000, kStart));
+
+    dirty.markDirty("/photos/a.jpg", 400, SyncPriority::NORMAL, record("tx-a"), kStart);
+    dirty.markDirty("/photos/b.jpg", 400, SyncPriority::NORMAL, record("tx-b"), kStart + std::chrono::seconds(5));
+    EXPECT_FALSE(dirty.flushDue(std::chrono::seconds(30), 1000, kStart + std::chrono::seconds(29)));
+    EXPECT_TRUE(dirty.flushDue(std::chrono::seconds(30), 1000, kStart + std::chrono::seconds(30)));
+
+    dirty.markDirty("/photos/c.jpg", 400, SyncPriority::NORMAL, record("tx-c"), kStart + std::chrono::seconds(6));
+    EXPECT_TRUE(dirty.flushDue(std::chrono::seconds(30), 1000, kStart + std::chrono::seconds(6)));
+
+    // Files already being flushed do not count
+    dirty.takeBatch();
+    EXPECT_FALSE(dirty.flushDue(std::chrono::seconds(30), 1000, kStart + std::chrono::seconds(60)));
+}
+
+// Per destination: existing files by physical offset, then new files by path
+TEST(DirtySetTest, OrdersForArray) {
+    auto file = [](std::string root, std::string destPath, std::optional<uint64_t> offset) {
+        DirtySet::DirtyFile f;
+        f.path = "/src" + destPath;
+        f.destRoot = std::move(root);
+        f.destPath = std::move(destPath);
+        f.destOffset = offset;
+        return f;
+    };
+    std::vector<DirtySet::DirtyFile> batch{
+        file("/array2", "/array2/a", std::nullopt),
+        file("/array1", "/array1/z", std::nullopt),
+        file("/array1", "/array1/b", 9000),
+        file("/array1", "/array1/a", std::nullopt),
+        file("/array1", "/array1/c", 4000),
+    };
+
+    DirtySet::orderForArray(batch);
+    std::vector<std::string> order;
+    for (const auto& f : batch) {
+        order.push_back(f.destPath);
+    }
+    EXPECT_EQ(order, (std::vector<std::string>{"/array1/c", "/array1/b", "/array1/a", "/array1/z", "/array2/a"}));
+}
+
+TEST(DirtySetTest, PhysicalOffset) {
+    fs::path dir = fs::temp_directory_path() / "file_sync_dirty_set_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string path = (dir / "IMG_0001.CR3").string();
+
+    EXPECT_FALSE(DirtySet::physicalOffset(path));
+    std::ofstream(path, std::ios::binary).close();
+    EXPECT_FALSE(DirtySet::physicalOffset(path));
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << std::string(64 * 1024, 'x');
+    }
+    // Extents are mapped once written back; FIEMAP_FLAG_SYNC is not used, so
+    // a delayed-allocation filesystem may not have placed the file yet
+    auto offset = DirtySet::physicalOffset(path);
+    if (offset) {
+        EXPECT_EQ(*offset % 512, 0u);
+    }
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,158 @@
+//
+// Tests for erasure-coded shard files across array members.
+//
+#include <gtest/gtest.h>
+#include "erasure_store.hpp"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+class ErasureStoreTest : public ::testing::Test {
+protected:
+    fs::path testDir;
+    std::vector<std::string> roots;
+
+    void SetUp() override {
+        testDir = fs::temp_directory_path() / "file_sync_erasure_store_test";
+        fs::remove_all(testDir);
+        for (int i = 0; i < 6; ++i) {
+            roots.push_back((testDir / ("member" + std::to_string(i))).string());
+            fs::create_directories(roots.back());
+        }
+    }
+
+    void TearDown() override {
+        fs::remove_all(testDir);
+    }
+
+    std::string writeFile(size_t size) {
+        std::string data(size, '\0');
+        std::mt19937 rng(static_cast<unsigned>(size));
+        for (auto& c : data) {
+            c = static_cast<char>(rng());
+        }
+        std::ofstream(testDir / "original.bin", std::ios::binary) << data;
+        return data;
+    }
+
+    std::vector<std::string> shardPaths(const std::string& relative, size_t count) {
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < count; ++i) {
+            paths.push_back(ErasureStore::shardPath(roots[i], relative, i));
+        }
+        return paths;
+    }
+
+    static std::string readFile(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+};
+
+// Sizes around the stripe and batch boundaries round-trip exactly
+TEST_F(ErasureStoreTest, EncodeAndRestore) {
+    ReedSolomon rs(4, 2);
+    const size_t stripe = 4 * ErasureStore::kStripeUnit;
+    for (size_t size : {size_t{0}, size_t{1}, stripe - 1, stripe + 1, ErasureStore::kBatchStripes * stripe + 4097}) {
+        std::string data = writeFile(size);
+        fs::last_write_time(testDir / "original.bin", fs::file_time_type::clock::now() - std::chrono::hours(24));
+        EXPECT_EQ(ErasureStore::encode(rs, (testDir / "original.bin").string(), shardPaths("/2024/a.cr3", 6)), size);
+
+        auto shards = ErasureStore::locate(roots, "/2024/a.cr3");
+        ASSERT_TRUE(shards);
+        EXPECT_EQ(shards->present(), 6u);
+        EXPECT_TRUE(ErasureStore::verify(*shards, (testDir / "original.bin").string()));
+
+        EXPECT_EQ(ErasureStore::restore(*shards, (testDir / "restored.bin").string()), 0u);
+        EXPECT_EQ(readFile(testDir / "restored.bin"), data) << "size " << size;
+        EXPECT_EQ(fs::last_write_time(testDir / "restored.bin"), fs::last_write_time(testDir / "original.bin"));
+    }
+}
+
+// Losing any m members still gives the file back; losing more fails
+TEST_F(ErasureStoreTest, DegradedRead) {
+    ReedSolomon rs(4, 2);
+    std::string data = writeFile(3 * 1024 * 1024 + 123);
+    ErasureStore::encode(rs, (testDir / "original.bin").string(), shardPaths("/a.bin", 6));
+
+    fs::remove(ErasureStore::shardPath(roots[1], "/a.bin", 1));
+    // A truncated shard counts as missing
+    fs::resize_file(ErasureStore::shardPath(roots[4], "/a.bin", 4), 100000);
+
+    auto shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_EQ(shards->present(), 5u);
+    EXPECT_FALSE(ErasureStore::verify(*shards, (testDir / "original.bin").string()));
+    EXPECT_EQ(ErasureStore::restore(*shards, (testDir / "restored.bin").string(), 2), 2u);
+    EXPECT_EQ(readFile(testDir / "restored.bin"), data);
+
+    fs::remove(ErasureStore::shardPath(roots[0], "/a.bin", 0));
+    shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_THROW(ErasureStore::restore(*shards, (testDir / "restored.bin").string()), std::runtime_error);
+
+    EXPECT_EQ(ErasureStore::remove(roots, "/a.bin"), 4u);
+    EXPECT_FALSE(ErasureStore::locate(roots, "/a.bin"));
+}
+
+// A shard left from an older version of the file is not mixed in
+TEST_F(ErasureStoreTest, IgnoresStaleShards) {
+    ReedSolomon rs(2, 1);
+    writeFile(1000);
+    ErasureStore::encode(rs, (testDir / "original.bin").string(), shardPaths("/a.bin", 3));
+    fs::copy_file(ErasureStore::shardPath(roots[2], "/a.bin", 2), testDir / "old.rs2");
+
+    std::string data = writeFile(5000);
+    ErasureStore::encode(rs, (testDir / "original.bin").string(), shardPaths("/a.bin", 3));
+    fs::remove(ErasureStore::shardPath(roots[0], "/a.bin", 0));
+    fs::copy_file(testDir / "old.rs2", ErasureStore::shardPath(roots[2], "/a.bin", 2),
+                  fs::copy_options::overwrite_existing);
+
+    auto shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_EQ(shards->header.size, 5000u);
+    EXPECT_EQ(shards->present(), 1u);
+    EXPECT_THROW(ErasureStore::restore(*shards, (testDir / "restored.bin").string()), std::runtime_error);
+    EXPECT_FALSE(ErasureStore::locate(roots, "/missing.bin"));
+}
+
+// Lost data and parity shards are rebuilt byte for byte onto a new member
+TEST_F(ErasureStoreTest, RebuildsLostShards) {
+    ReedSolomon rs(4, 2);
+    writeFile(5 * 1024 * 1024 + 7);
+    auto paths = shardPaths("/a.bin", 6);
+    ErasureStore::encode(rs, (testDir / "original.bin").string(), paths);
+    std::string data1 = readFile(paths[1]);
+    std::string parity5 = readFile(paths[5]);
+
+    fs::remove(paths[1]);
+    fs::remove(paths[5]);
+    auto shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_EQ(ErasureStore::rebuild(*shards, 1, paths[1], 2), 1u);
+    EXPECT_EQ(readFile(paths[1]), data1);
+
+    shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_EQ(ErasureStore::rebuild(*shards, 5, paths[5], 2), 0u);
+    EXPECT_EQ(readFile(paths[5]), parity5);
+
+    shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_TRUE(ErasureStore::verify(*shards, (testDir / "original.bin").string()));
+
+    // Too few shards left: nothing is written
+    for (size_t i = 0; i < 3; ++i) {
+        fs::remove(paths[i]);
+    }
+    shards = ErasureStore::locate(roots, "/a.bin");
+    ASSERT_TRUE(shards);
+    EXPECT_THROW(ErasureStore::rebuild(*shards, 0, paths[0]), std::runtime_error);
+    EXPECT_FALSE(fs::exists(paths[0]));
+    EXPECT_FALSE(fs::exists(paths[0] + ".rebuild"));
+}
@@ -0,0 +1,125 @@
+//
+// Tests for the persistent file index.
+//
+#include <gtest/gtest.h>
+#include "file_index.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+class FileIndexTest : public ::testing::Test {
+protected:
+    fs::path m_dir;
+    std::string m_path;
+
+    void SetUp() override {
+        m_dir = fs::temp_directory_path() / "file_sync_file_index_test";
+        fs::remove_all(m_dir);
+        fs::create_directories(m_dir);
+        m_path = (m_dir / "file_index.json").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(m_dir);
+    }
+
+    size_t journalLines() const {
+        std::ifstream in(m_path);
+        size_t lines = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            lines++;
+        }
+        return lines;
+    }
+};
+
+// Entries survive a reopen; a move reports the member left behind
+TEST_F(FileIndexTest, PersistsAcrossReopen) {
+    {
+        FileIndex index(m_path);
+        ASSERT_TRUE(index.open());
+        EXPECT_FALSE(index.put("/2024/a.jpg", "/array1", 100));
+        EXPECT_FALSE(index.put("/2024/b.jpg", "/array1", 200));
+        EXPECT_FALSE(index.put("/2024/c.jpg", "/array2", 300));
+        EXPECT_EQ(index.put("/2024/a.jpg", "/array2", 100), std::optional<std::string>("/array1"));
+        EXPECT_FALSE(index.put("/2024/b.jpg", "/array1", 250));
+        index.remove("/2024/c.jpg");
+    }
+
+    FileIndex index(m_path);
+    ASSERT_TRUE(index.open());
+    EXPECT_EQ(index.size(), 2u);
+    auto a = index.find("/2024/a.jpg");
+    ASSERT_TRUE(a);
+    EXPECT_EQ(a->root, "/array2");
+    EXPECT_EQ(index.find("/2024/b.jpg")->size, 250u);
+    EXPECT_FALSE(index.find("/2024/c.jpg"));
+}
+
+// An erasure-coded file has no root, keeps its shards' members and reports
+// its whole copy's member once
+TEST_F(FileIndexTest, ErasureEntries) {
+    {
+        FileIndex index(m_path);
+        ASSERT_TRUE(index.open());
+        index.put("/2024/a.jpg", "/array1", 100);
+        EXPECT_EQ(index.putErasure("/2024/a.jpg", 100, {"/array3", "/array1", "/array2"}),
+                  std::optional<std::string>("/array1"));
+        // Rewritten whole: nothing stale to report, the caller drops the shards
+        index.putErasure("/2024/b.jpg", 200);
+        EXPECT_FALSE(index.put("/2024/b.jpg", "/array2", 200));
+    }
+
+    FileIndex index(m_path);
+    ASSERT_TRUE(index.open());
+    auto a = index.find("/2024/a.jpg");
+    ASSERT_TRUE(a);
+    EXPECT_TRUE(a->erasure);
+    EXPECT_EQ(a->root, "");
+    EXPECT_EQ(a->size, 100u);
+    EXPECT_EQ(a->shardRoots, (std::vector<std::string>{"/array3", "/array1", "/array2"}));
+    EXPECT_FALSE(index.find("/2024/b.jpg")->erasure);
+}
+
+// A line torn by a crash is skipped and does not swallow the next one
+TEST_F(FileIndexTest, IgnoresTornTail) {
+    {
+        FileIndex index(m_path);
+        ASSERT_TRUE(index.open());
+        index.put("/a.jpg", "/array1", 1);
+    }
+    std::ofstream(m_path, std::ios::app) << "{\"path\":\"/b.jpg\",\"ro";
+
+    {
+        FileIndex index(m_path);
+        ASSERT_TRUE(index.open());
+        EXPECT_EQ(index.size(), 1u);
+        index.put("/c.jpg", "/array1", 3);
+    }
+    FileIndex index(m_path);
+    ASSERT_TRUE(index.open());
+    EXPECT_TRUE(index.find("/a.jpg"));
+    EXPECT_FALSE(index.find("/b.jpg"));
+    EXPECT_TRUE(index.find("/c.jpg"));
+}
+
+// Superseded lines are compacted away
+TEST_F(FileIndexTest, Compacts) {
+    FileIndex index(m_path);
+    ASSERT_TRUE(index.open());
+    for (int round = 0; round < 400; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            index.put("/f" + std::to_string(i), round % 2 ? "/array1" : "/array2", static_cast<uint64_t>(round));
+        }
+    }
+    EXPECT_LT(journalLines(), 2 * 10 + 1024 + 1u);
+
+    FileIndex reopened(m_path);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(reopened.size(), 10u);
+    EXPECT_EQ(reopened.find("/f3")->root, "/array1");
+    EXPECT_EQ(reopened.find("/f3")->size, 399u);
+}
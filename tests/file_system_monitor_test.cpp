@@ -131,3 +131,26 @@ TEST_F(FileSystemMonitorIntegrationTest, DetectFileModification) {
 }
 
 // Mock tests would be helpful here to test without actual filesystem operations
+
+// Generating more events than max_queued_events without reading must be
+// reported as an overflow rather than silently lost
+TEST_F(FileSystemMonitorTest, CountsQueueOverflow) {
+    long maxQueued = 0;
+    std::ifstream("/proc/sys/fs/inotify/max_queued_events") >> maxQueued;
+    if (maxQueued <= 0 || maxQueued > 65536) {
+        GTEST_SKIP() << "max_queued_events is " << maxQueued;
+    }
+
+    FileSystemMonitor monitor;
+    monitor.addWatch(testDir.string());
+    EXPECT_EQ(monitor.overflowCount(), 0u);
+
+    // Each file yields at least IN_CREATE and IN_CLOSE_WRITE
+    for (long i = 0; i < maxQueued; ++i) {
+        createTestFile("storm" + std::to_string(i) + ".txt", "x");
+    }
+
+    while (monitor.getNextEvent()) {
+    }
+    EXPECT_GE(monitor.overflowCount(), 1u);
+}
@@ -0,0 +1,74 @@
+//
+// Tests for the TinyLFU frequency sketch.
+//
+#include <gtest/gtest.h>
+#include "frequency_sketch.hpp"
+
+#include <string>
+
+// The first access only reaches the doorkeeper; later ones the counters
+TEST(FrequencySketchTest, CountsAccesses) {
+    FrequencySketch sketch(1024);
+    uint64_t key = FrequencySketch::hash("/photos/2024/IMG_0001.CR3");
+
+    EXPECT_EQ(sketch.frequency(key), 0u);
+    sketch.increment(key);
+    EXPECT_EQ(sketch.frequency(key), 1u);
+    for (int i = 0; i < 4; ++i) {
+        sketch.increment(key);
+    }
+    EXPECT_EQ(sketch.frequency(key), 5u);
+
+    // Counters saturate at 15, plus one for the doorkeeper
+    for (int i = 0; i < 40; ++i) {
+        sketch.increment(key);
+    }
+    EXPECT_EQ(sketch.frequency(key), FrequencySketch::kMaxCount + 1);
+}
+
+// Ageing halves the counters and forgets one-off keys
+TEST(FrequencySketchTest, AgeingHalves) {
+    FrequencySketch sketch(1024);
+    uint64_t hot = FrequencySketch::hash("hot");
+    uint64_t once = FrequencySketch::hash("once");
+    for (int i = 0; i < 9; ++i) {
+        sketch.increment(hot);
+    }
+    sketch.increment(once);
+
+    sketch.age();
+    EXPECT_EQ(sketch.frequency(hot), 4u);
+    EXPECT_EQ(sketch.frequency(once), 0u);
+    EXPECT_EQ(sketch.ageings(), 1u);
+
+    // Ageing also happens on its own, every 10 accesses per counter
+    for (int i = 0; i < 10 * 1024; ++i) {
+        sketch.increment(FrequencySketch::hash("scan" + std::to_string(i)));
+    }
+    EXPECT_EQ(sketch.ageings(), 2u);
+}
+
+// A working set used repeatedly keeps its estimates through a scan of many
+// more keys, each seen once, in a sketch sized for the working set
+TEST(FrequencySketchTest, ScanResistant) {
+    FrequencySketch sketch(4096);
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 512; ++i) {
+            sketch.increment(FrequencySketch::hash("hot" + std::to_string(i)));
+        }
+    }
+    for (int i = 0; i < 20000; ++i) {
+        sketch.increment(FrequencySketch::hash("scan" + std::to_string(i)));
+    }
+
+    int scanBeatsHot = 0;
+    for (int i = 0; i < 512; ++i) {
+        uint32_t hot = sketch.frequency(FrequencySketch::hash("hot" + std::to_string(i)));
+        uint32_t scan = sketch.frequency(FrequencySketch::hash("scan" + std::to_string(i)));
+        if (scan >= hot) {
+            scanBeatsHot++;
+        }
+    }
+    EXPECT_LT(scanBeatsHot, 512 / 20);
+    EXPECT_LE(sketch.memoryBytes(), 4096u * 3);
+}
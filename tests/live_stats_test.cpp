@@ -0,0 +1,121 @@
+//
+// Tests for the shared-memory live stats segment.
+//
+#include <gtest/gtest.h>
+#include "live_stats.hpp"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+class LiveStatsTest : public ::testing::Test {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        path = (fs::temp_directory_path() / "file_sync_live_stats_test").string();
+        fs::remove(path);
+    }
+
+    void TearDown() override {
+        fs::remove(path);
+    }
+};
+
+// A published snapshot is read back unchanged
+TEST_F(LiveStatsTest, PublishAndRead) {
+    LiveStatsPublisher publisher(path);
+    LiveStatsReader reader(path);
+
+    EXPECT_FALSE(reader.read().has_value()); // nothing published yet
+
+    LiveStatsSnapshot snapshot{};
+    snapshot.pid = 42;
+    snapshot.pending = 7;
+    snapshot.pendingByPriority[2] = 7;
+    snapshot.etaSeconds = -1;
+    snapshot.deviceCount = 1;
+    std::strncpy(snapshot.devices[0].path, "/mnt/disk1", sizeof(snapshot.devices[0].path) - 1);
+    snapshot.devices[0].state = LiveStatsSnapshot::DEVICE_ONLINE;
+    snapshot.latencyBuckets[3] = 5;
+    publisher.publish(snapshot);
+
+    auto read = reader.read();
+    ASSERT_TRUE(read.has_value());
+    EXPECT_EQ(read->pid, 42);
+    EXPECT_EQ(read->pending, 7u);
+    EXPECT_EQ(read->pendingByPriority[2], 7u);
+    EXPECT_EQ(read->etaSeconds, -1);
+    EXPECT_STREQ(read->devices[0].path, "/mnt/disk1");
+    EXPECT_EQ(read->latencyBuckets[3], 5u);
+}
+
+// The segment is removed when the publisher goes away
+TEST_F(LiveStatsTest, PublisherRemovesSegment) {
+    {
+        LiveStatsPublisher publisher(path);
+        EXPECT_TRUE(fs::exists(path));
+    }
+    EXPECT_FALSE(fs::exists(path));
+}
+
+// Files that are not a stats segment are rejected
+TEST_F(LiveStatsTest, RejectsForeignFile) {
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << std::string(sizeof(LiveStatsSegment), 'x');
+    }
+    EXPECT_THROW(LiveStatsReader reader(path), std::runtime_error);
+}
+
+// Readers never observe a torn snapshot while the writer keeps publishing
+TEST_F(LiveStatsTest, ReadersSeeConsistentSnapshots) {
+    LiveStatsPublisher publisher(path);
+    LiveStatsReader reader(path);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&] {
+        LiveStatsSnapshot snapshot{};
+        for (uint64_t i = 1; i <= 20000; ++i) {
+            snapshot.pending = i;
+            snapshot.bytesPending = i;
+            snapshot.tasksCompleted = i;
+            std::fill(std::begin(snapshot.latencyBuckets), std::end(snapshot.latencyBuckets), i);
+            publisher.publish(snapshot);
+        }
+        done = true;
+    });
+
+    size_t reads = 0;
+    while (!done) {
+        if (auto snapshot = reader.read()) {
+            ASSERT_EQ(snapshot->bytesPending, snapshot->pending);
+            ASSERT_EQ(snapshot->tasksCompleted, snapshot->pending);
+            ASSERT_EQ(snapshot->latencyBuckets[LatencyHistogram::kBuckets - 1], snapshot->pending);
+            reads++;
+        }
+    }
+    writer.join();
+
+    auto last = reader.read();
+    ASSERT_TRUE(last.has_value());
+    EXPECT_EQ(last->pending, 20000u);
+}
+
+// Latencies land in log2 microsecond buckets
+TEST(LatencyHistogramTest, Buckets) {
+    LatencyHistogram histogram;
+    histogram.record(std::chrono::microseconds(0));
+    histogram.record(std::chrono::microseconds(1));
+    histogram.record(std::chrono::microseconds(3));
+    histogram.record(std::chrono::milliseconds(1));
+    histogram.record(std::chrono::hours(1000));
+
+    auto buckets = histogram.snapshot();
+    EXPECT_EQ(buckets[0], 2u);
+    EXPECT_EQ(buckets[1], 1u);
+    EXPECT_EQ(buckets[9], 1u);  // 1000us is in [512, 1024)
+    EXPECT_EQ(buckets[LatencyHistogram::kBuckets - 1], 1u);
+}
@@ -120,4 +120,22 @@ TEST_F(MetricsCollectorTest, ConcurrentRecording) {
 
     // We should have recorded numThreads * metricsPerThread metrics
     EXPECT_EQ(lineCount, numThreads * metricsPerThread);
+}
+
+// Test that gauges keep their latest value and survive collect()
+TEST_F(MetricsCollectorTest, GaugesPersistAcrossCollect) {
+    MetricsCollector collector;
+    collector.setGauge("queue_depth", 5);
+    collector.setGauge("queue_depth", 7);
+
+    capturedOutput.str("");
+    collector.collect();
+    EXPECT_TRUE(capturedOutput.str().find("queue_depth: 7") != std::string::npos);
+
+    capturedOutput.str("");
+    collector.collect();
+    EXPECT_TRUE(capturedOutput.str().find("queue_depth: 7") != std::string::npos);
+
+    EXPECT_EQ(collector.getGauge("queue_depth"), 7.0);
+    EXPECT_FALSE(collector.getGauge("missing").has_value());
 }
\ No newline at end of file
@@ -46,6 +46,15 @@ public:
 
         {
             std::lock_guard<std::mutex> lock(m_queue_mutex);
+            // Like the kernel: a full queue drops the event and reports one overflow
+            if (m_queueLimit > 0 && m_event_queue.size() >= m_queueLimit) {
+                if (!m_overflowed) {
+                    m_overflowed = true;
+                    m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            m_overflowed = false;
             m_event_queue.push(event);
         }
 
@@ -55,6 +64,17 @@ public:
         }
     }
 
+    // Bound the queue as max_queued_events does; 0 means unbounded
+    void setQueueLimit(size_t limit) {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        m_queueLimit = limit;
+    }
+
+    // Report an overflow without dropping anything
+    void simulateOverflow() {
+        m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
     // Override getNextEvent to pull from our mocked queue
     std::optional<FSEvent> getNextEvent() override {
         std::lock_guard<std::mutex> lock(m_queue_mutex);
@@ -76,6 +96,8 @@ public:
 private:
     std::map<std::string, int> m_watches;
     int m_nextWatchDescriptor = 1;
+    size_t m_queueLimit = 0;
+    bool m_overflowed = false;
 };
 
 #endif // MOCK_FILE_SYSTEM_MONITOR_HPP
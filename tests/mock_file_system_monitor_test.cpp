@@ -229,4 +229,30 @@ TEST_F(MockFileSystemMonitorTest, IntegrationWithSyncManager) {
         bool found = std::find(processedPaths.begin(), processedPaths.end(), expectedPath) != processedPaths.end();
         EXPECT_TRUE(found) << "Path not processed: " << expectedPath;
     }
-}
\ No newline at end of file
+}
+
+// A bounded queue drops events once full and reports a single overflow
+TEST_F(MockFileSystemMonitorTest, QueueLimitOverflow) {
+    MockFileSystemMonitor monitor;
+    monitor.setQueueLimit(4);
+
+    for (int i = 0; i < 10; ++i) {
+        monitor.simulateEvent("/test/overflow/file" + std::to_string(i), "CREATE");
+    }
+    EXPECT_EQ(monitor.overflowCount(), 1u);
+
+    int received = 0;
+    while (monitor.getNextEvent()) {
+        received++;
+    }
+    EXPECT_EQ(received, 4);
+
+    // Room again: events are queued, and the next overflow is counted separately
+    for (int i = 0; i < 5; ++i) {
+        monitor.simulateEvent("/test/overflow/again" + std::to_string(i), "CREATE");
+    }
+    EXPECT_EQ(monitor.overflowCount(), 2u);
+
+    monitor.simulateOverflow();
+    EXPECT_EQ(monitor.overflowCount(), 3u);
+}
@@ -0,0 +1,97 @@
+//
+// Tests for per-subtree path policies.
+//
+#include <gtest/gtest.h>
+#include "path_policy_trie.hpp"
+
+using VerifyMethod = FileVerification::VerifyMethod;
+
+class PathPolicyTrieTest : public ::testing::Test {
+protected:
+    static PathPolicyTrie makeTrie() {
+        PathPolicy defaults;
+        defaults.verifyMethod = VerifyMethod::FAST_HASH;
+        return PathPolicyTrie("/photos", defaults, PathPolicyTrie::parseRules(
+            "# subtree       settings\n"
+            "Critical        priority=CRITICAL verify=SECURE_HASH versioning=on\n"
+            "Critical/Drafts priority=LOW\n"
+            "/photos/Scratch priority=BACKGROUND verify=SIZE_ONLY\n"
+            "RAW             dest=/mnt/a,/mnt/b compression=on\n"));
+    }
+};
+
+// Files outside every rule get the defaults
+TEST_F(PathPolicyTrieTest, DefaultsApplyOutsideRules) {
+    auto trie = makeTrie();
+    const auto& policy = trie.lookup("/photos/2024/img.jpg");
+    EXPECT_EQ(policy.priority, SyncPriority::NORMAL);
+    EXPECT_EQ(policy.verifyMethod, VerifyMethod::FAST_HASH);
+    EXPECT_TRUE(policy.destinations.empty());
+    EXPECT_EQ(&trie.lookup("/elsewhere/Critical/a.jpg"), &trie.defaults());
+    EXPECT_EQ(&trie.lookup("/photosynth/Critical/a.jpg"), &trie.defaults());
+}
+
+// The deepest matching rule wins and inherits unset fields from its parents
+TEST_F(PathPolicyTrieTest, NestedRulesInherit) {
+    auto trie = makeTrie();
+
+    const auto& critical = trie.lookup("/photos/Critical/contract.pdf");
+    EXPECT_EQ(critical.priority, SyncPriority::CRITICAL);
+    EXPECT_EQ(critical.verifyMethod, VerifyMethod::SECURE_HASH);
+    EXPECT_TRUE(critical.versioning);
+
+    const auto& drafts = trie.lookup("/photos/Critical/Drafts/deep/a.jpg");
+    EXPECT_EQ(drafts.priority, SyncPriority::LOW);
+    EXPECT_EQ(drafts.verifyMethod, VerifyMethod::SECURE_HASH);
+    EXPECT_TRUE(drafts.versioning);
+
+    const auto& scratch = trie.lookup("Scratch/tmp.bin");
+    EXPECT_EQ(scratch.priority, SyncPriority::BACKGROUND);
+    EXPECT_EQ(scratch.verifyMethod, VerifyMethod::SIZE_ONLY);
+
+    const auto& raw = trie.lookup("/photos/RAW/a.cr3");
+    EXPECT_EQ(raw.destinations, (std::vector<std::string>{"/mnt/a", "/mnt/b"}));
+    EXPECT_TRUE(raw.compression);
+    EXPECT_EQ(raw.quorum, 0u);
+}
+
+// A quorum set on a subtree applies below it
+TEST_F(PathPolicyTrieTest, QuorumIsInherited) {
+    PathPolicyTrie trie("/photos", PathPolicy{}, PathPolicyTrie::parseRules(
+        "RAW      dest=/mnt/a,/mnt/b,/mnt/c quorum=2\n"
+        "RAW/2024 priority=HIGH\n"));
+    EXPECT_EQ(trie.lookup("/photos/RAW/2024/a.cr3").quorum, 2u);
+    EXPECT_EQ(trie.lookup("/photos/RAW/2024/a.cr3").destinations.size(), 3u);
+    EXPECT_EQ(trie.lookup("/photos/a.jpg").quorum, 0u);
+}
+
+// Component matching is exact: a sibling sharing a prefix is not covered
+TEST_F(PathPolicyTrieTest, MatchesWholeComponents) {
+    auto trie = makeTrie();
+    EXPECT_EQ(trie.lookup("/photos/CriticalMass/a.jpg").priority, SyncPriority::NORMAL);
+    EXPECT_EQ(trie.lookup("/photos//Critical/./a.jpg").priority, SyncPriority::CRITICAL);
+}
+
+// Rule order in the file does not matter
+TEST_F(PathPolicyTrieTest, ChildBeforeParentInFile) {
+    PathPolicyTrie trie("/photos", PathPolicy{}, PathPolicyTrie::parseRules(
+        "a/b verify=FULL_COMPARE\n"
+        "a   priority=HIGH\n"));
+    EXPECT_EQ(trie.lookup("/photos/a/b/c").priority, SyncPriority::HIGH);
+    EXPECT_EQ(trie.lookup("/photos/a/b/c").verifyMethod, VerifyMethod::FULL_COMPARE);
+}
+
+// Bad rules are rejected with their line number
+TEST_F(PathPolicyTrieTest, RejectsBadRules) {
+    try {
+        PathPolicyTrie::parseRules("a priority=HIGH\nb priority=URGENT\n", "rules");
+        FAIL() << "expected a parse error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("rules:2"), std::string::npos) << e.what();
+    }
+    EXPECT_THROW(PathPolicyTrie::parseRules("a verify=CRC32\n"), std::runtime_error);
+    EXPECT_THROW(PathPolicyTrie::parseRules("a color=blue\n"), std::runtime_error);
+    EXPECT_THROW(PathPolicyTrie::parseRules("a versioning\n"), std::runtime_error);
+    EXPECT_THROW(PathPolicyTrie::parseRules("a quorum=0\n"), std::runtime_error);
+    EXPECT_THROW(PathPolicyTrie::parseRules("a quorum=x\n"), std::runtime_error);
+}
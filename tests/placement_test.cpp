@@ -0,0 +1,89 @@
+//
+// Tests for weighted rendezvous placement across array members.
+//
+#include <gtest/gtest.h>
+#include "placement.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+
+const int kFiles = 20000;
+
+std::string key(int i) {
+    return "/2024/" + std::to_string(i % 365) + "/IMG_" + std::to_string(i) + ".CR3";
+}
+
+std::map<std::string, int> spread(const Placement& placement) {
+    std::map<std::string, int> counts;
+    for (int i = 0; i < kFiles; ++i) {
+        counts[placement.rootFor(key(i))]++;
+    }
+    return counts;
+}
+
+} // namespace
+
+// Members receive files in proportion to their weight
+TEST(PlacementTest, SpreadFollowsWeights) {
+    Placement placement({{"/array/a", 4.0}, {"/array/b", 4.0}, {"/array/c", 8.0}});
+    auto counts = spread(placement);
+
+    EXPECT_NEAR(counts["/array/a"], kFiles / 4, kFiles / 50);
+    EXPECT_NEAR(counts["/array/b"], kFiles / 4, kFiles / 50);
+    EXPECT_NEAR(counts["/array/c"], kFiles / 2, kFiles / 50);
+
+    // The same path always lands on the same member, whatever the list order
+    Placement reordered({{"/array/c", 8.0}, {"/array/a", 4.0}, {"/array/b", 4.0}});
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(placement.rootFor(key(i)), reordered.rootFor(key(i)));
+    }
+}
+
+// A new member takes its share from every other member and nothing else moves
+TEST(PlacementTest, AddingMemberMovesItsShare) {
+    Placement before({{"/array/a", 1.0}, {"/array/b", 1.0}, {"/array/c", 1.0}});
+    Placement after({{"/array/a", 1.0}, {"/array/b", 1.0}, {"/array/c", 1.0}, {"/array/d", 1.0}});
+
+    int moved = 0;
+    for (int i = 0; i < kFiles; ++i) {
+        const std::string& from = before.rootFor(key(i));
+        const std::string& to = after.rootFor(key(i));
+        if (from != to) {
+            EXPECT_EQ(to, "/array/d");
+            moved++;
+        }
+    }
+    EXPECT_NEAR(moved, kFiles / 4, kFiles / 50);
+
+    // Removing a member moves only its own files
+    Placement without({{"/array/a", 1.0}, {"/array/c", 1.0}});
+    for (int i = 0; i < kFiles; ++i) {
+        if (before.rootFor(key(i)) != "/array/b") {
+            EXPECT_EQ(without.rootFor(key(i)), before.rootFor(key(i)));
+        }
+    }
+}
+
+TEST(PlacementTest, RejectsBadMembers) {
+    EXPECT_THROW(Placement({}), std::invalid_argument);
+    EXPECT_THROW(Placement({{"/array/a", 0.0}}), std::invalid_argument);
+    EXPECT_THROW(Placement({{"/array/a", 1.0}, {"/array/b", -2.0}}), std::invalid_argument);
+
+    Placement single({{"/array/a", 1.0}});
+    EXPECT_EQ(single.rootFor("/anything"), "/array/a");
+}
+
+// The ranking starts with the placed member and names every member once
+TEST(PlacementTest, RankStartsWithPlacedMember) {
+    Placement placement({{"/array/a", 1.0}, {"/array/b", 2.0}, {"/array/c", 1.0}, {"/array/d", 1.0}});
+    for (int i = 0; i < 1000; ++i) {
+        auto order = placement.rank(key(i));
+        ASSERT_EQ(order.size(), 4u);
+        EXPECT_EQ(order[0], placement.memberIndex(key(i)));
+        std::vector<size_t> sorted(order);
+        std::sort(sorted.begin(), sorted.end());
+        EXPECT_EQ(sorted, (std::vector<size_t>{0, 1, 2, 3}));
+    }
+}
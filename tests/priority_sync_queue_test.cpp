@@ -0,0 +1,102 @@
+//
+// Tests for the priority sync queue and its backlog gauges.
+//
+#include <gtest/gtest.h>
+#include "priority_sync_queue.hpp"
+#include <chrono>
+#include <thread>
+
+class PrioritySyncQueueTest : public ::testing::Test {
+protected:
+    static SyncTask makeTask(const std::string& path, SyncPriority priority, uintmax_t size = 0) {
+        SyncTask task(path, "SYNC", priority);
+        task.setSize(size);
+        return task;
+    }
+};
+
+// Higher priority tasks are dequeued first
+TEST_F(PrioritySyncQueueTest, DequeuesByPriority) {
+    PrioritySyncQueue queue;
+    queue.enqueue(makeTask("/low", SyncPriority::LOW));
+    queue.enqueue(makeTask("/critical", SyncPriority::CRITICAL));
+    queue.enqueue(makeTask("/normal", SyncPriority::NORMAL));
+
+    EXPECT_EQ(queue.dequeue()->getPath(), "/critical");
+    EXPECT_EQ(queue.dequeue()->getPath(), "/normal");
+    EXPECT_EQ(queue.dequeue()->getPath(), "/low");
+    EXPECT_FALSE(queue.dequeue(std::chrono::milliseconds(10)).has_value());
+}
+
+// Tasks of one priority come out in the order they were created
+TEST_F(PrioritySyncQueueTest, FifoWithinPriority) {
+    PrioritySyncQueue queue;
+    for (int i = 0; i < 50; ++i) {
+        queue.enqueue(makeTask("/n" + std::to_string(i), SyncPriority::NORMAL));
+        queue.enqueue(makeTask("/h" + std::to_string(i), SyncPriority::HIGH));
+    }
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_EQ(queue.dequeue()->getPath(), "/h" + std::to_string(i));
+    }
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_EQ(queue.dequeue()->getPath(), "/n" + std::to_string(i));
+    }
+}
+
+// Pending counts and bytes follow enqueue/dequeue
+TEST_F(PrioritySyncQueueTest, BacklogCountsAndBytes) {
+    PrioritySyncQueue queue;
+    queue.enqueue(makeTask("/a", SyncPriority::NORMAL, 100));
+    queue.enqueue(makeTask("/b", SyncPriority::NORMAL, 200));
+    queue.enqueue(makeTask("/c", SyncPriority::BACKGROUND, 50));
+
+    auto stats = queue.getBacklogStats();
+    EXPECT_EQ(stats.pending, 3u);
+    EXPECT_EQ(stats.pendingByPriority[static_cast<size_t>(SyncPriority::NORMAL)], 2u);
+    EXPECT_EQ(stats.pendingByPriority[static_cast<size_t>(SyncPriority::BACKGROUND)], 1u);
+    EXPECT_EQ(stats.bytesPending, 350u);
+
+    queue.dequeue();
+    queue.dequeue();
+    stats = queue.getBacklogStats();
+    EXPECT_EQ(stats.pending, 1u);
+    EXPECT_EQ(stats.bytesPending, 50u);
+    EXPECT_EQ(stats.pendingByPriority[static_cast<size_t>(SyncPriority::NORMAL)], 0u);
+}
+
+// The oldest pending task's age is reported per priority
+TEST_F(PrioritySyncQueueTest, OldestAgePerPriority) {
+    PrioritySyncQueue queue;
+    queue.enqueue(makeTask("/old", SyncPriority::LOW));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.enqueue(makeTask("/new", SyncPriority::LOW));
+
+    auto stats = queue.getBacklogStats();
+    auto low = static_cast<size_t>(SyncPriority::LOW);
+    EXPECT_GE(stats.oldestAge[low], std::chrono::milliseconds(50));
+    EXPECT_EQ(stats.oldestAge[static_cast<size_t>(SyncPriority::HIGH)], std::chrono::milliseconds(0));
+}
+
+// Draining produces a rate and an ETA; an empty queue has an ETA of zero
+TEST_F(PrioritySyncQueueTest, DrainRateAndEta) {
+    PrioritySyncQueue queue;
+    EXPECT_EQ(queue.getBacklogStats().eta, std::chrono::seconds(0));
+
+    for (int i = 0; i < 20; ++i) {
+        queue.enqueue(makeTask("/f" + std::to_string(i), SyncPriority::NORMAL, 1000));
+    }
+    for (int i = 0; i < 10; ++i) {
+        queue.dequeue();
+    }
+
+    // No window has closed yet, so nothing is known about the rate
+    auto stats = queue.getBacklogStats();
+    EXPECT_FALSE(stats.eta.has_value());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    stats = queue.getBacklogStats();
+    EXPECT_GT(stats.drainTasksPerSecond, 0.0);
+    EXPECT_GT(stats.drainBytesPerSecond, 0.0);
+    ASSERT_TRUE(stats.eta.has_value());
+    EXPECT_GT(stats.eta->count(), 0);
+}
@@ -0,0 +1,112 @@
+//
+// Tests for the lock contention profiling wrapper.
+//
+#include <gtest/gtest.h>
+#include "profiled_mutex.hpp"
+#include "metrics_collector.hpp"
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ProfiledMutexTest : public ::testing::Test {
+protected:
+    // Redirect std::cout so MetricsCollector::collect() stays quiet
+    std::streambuf* originalBuffer;
+    std::stringstream capturedOutput;
+
+    void SetUp() override {
+        originalBuffer = std::cout.rdbuf();
+        std::cout.rdbuf(capturedOutput.rdbuf());
+    }
+
+    void TearDown() override {
+        std::cout.rdbuf(originalBuffer);
+    }
+};
+
+// The mutex must still provide mutual exclusion in either build mode
+TEST_F(ProfiledMutexTest, ProvidesMutualExclusion) {
+    ProfiledMutex mutex("test_exclusion");
+    int counter = 0;
+    const int numThreads = 4;
+    const int iterations = 10000;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < iterations; ++j) {
+                std::lock_guard lock(mutex);
+                counter++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(counter, numThreads * iterations);
+}
+
+// The condition variable alias must work with the lock alias
+TEST_F(ProfiledMutexTest, WorksWithConditionVariable) {
+    ProfiledMutex mutex("test_condition");
+    ProfiledMutex::ConditionVariable condition;
+    bool ready = false;
+
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard lock(mutex);
+        ready = true;
+        condition.notify_one();
+    });
+
+    ProfiledMutex::UniqueLock lock(mutex);
+    EXPECT_TRUE(condition.wait_for(lock, std::chrono::seconds(5), [&] { return ready; }));
+    lock.unlock();
+    producer.join();
+}
+
+// Contention is attributed to the named lock and exported as gauges
+TEST_F(ProfiledMutexTest, RecordsContention) {
+    if (!LockProfiler::enabled()) {
+        GTEST_SKIP() << "Built without FILE_SYNC_LOCK_PROFILING";
+    }
+
+    ProfiledMutex mutex("test_contention");
+    std::atomic<bool> holding{false};
+
+    std::thread holder([&]() {
+        std::lock_guard lock(mutex);
+        holding = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    while (!holding) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard lock(mutex);
+    }
+    holder.join();
+
+    auto& stats = LockProfiler::instance().statsFor("test_contention");
+    EXPECT_EQ(stats.acquisitions.load(), 2u);
+    EXPECT_EQ(stats.contended.load(), 1u);
+    EXPECT_GE(stats.totalWaitNs.load(), 1'000'000u);
+    EXPECT_GE(LockStats::percentile(stats.holdHistogram, 0.99), 10'000'000u);
+
+    MetricsCollector metrics;
+    LockProfiler::instance().recordMetrics(metrics);
+    auto contended = metrics.getGauge("lock_contended{lock=\"test_contention\"}");
+    ASSERT_TRUE(contended.has_value());
+    EXPECT_EQ(*contended, 1.0);
+
+    // The site is this test body, not the lock_guard constructor that called lock()
+    std::string summary = LockProfiler::instance().getSummary();
+    auto line = summary.find("test_contention:");
+    ASSERT_NE(line, std::string::npos);
+    std::string sites = summary.substr(line, summary.find('\n', summary.find('\n', line) + 1) - line);
+    EXPECT_NE(sites.find("ProfiledMutexTest_RecordsContention_Test::TestBody"), std::string::npos) << sites;
+}
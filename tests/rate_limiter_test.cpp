@@ -0,0 +1,96 @@
+//
+// Tests for the copy and verify throughput limiters.
+//
+#include <gtest/gtest.h>
+#include "rate_limiter.hpp"
+
+// A zero rate never delays
+TEST(RateLimiterTest, UnlimitedByDefault) {
+    RateLimiter limiter;
+    EXPECT_EQ(limiter.reserve(1ULL << 40), std::chrono::nanoseconds::zero());
+}
+
+// Deficits translate into proportional waits
+TEST(RateLimiterTest, DelaysProportionalToDeficit) {
+    RateLimiter limiter(1000); // 1000 bytes/s, starts with an empty bucket
+
+    auto first = limiter.reserve(500);
+    EXPECT_NEAR(std::chrono::duration<double>(first).count(), 0.5, 0.05);
+
+    auto second = limiter.reserve(500);
+    EXPECT_NEAR(std::chrono::duration<double>(second).count(), 1.0, 0.05);
+}
+
+// The rate can be changed while in use
+TEST(RateLimiterTest, RateChangesApply) {
+    RateLimiter limiter(1000);
+    limiter.setRate(0);
+    EXPECT_EQ(limiter.getRate(), 0u);
+    EXPECT_EQ(limiter.reserve(1 << 20), std::chrono::nanoseconds::zero());
+
+    limiter.setRate(1 << 20);
+    auto delay = limiter.reserve(1 << 20);
+    EXPECT_LE(std::chrono::duration<double>(delay).count(), 1.05);
+}
+
+// The tightest level an I/O passes sets its wait, in bytes or operations
+TEST(IoThrottleTest, TightestLevelSetsThePace) {
+    IoThrottle throttle(3);
+    throttle.setGlobal({1000, 0});
+    throttle.setClass(1, {500, 0});
+    throttle.setDevices({{"sda", {250, 0}}});
+    auto now = IoThrottle::Clock::now();
+
+    auto seconds = [](const IoThrottle::Grant& grant) { return std::chrono::duration<double>(grant.wait).count(); };
+    EXPECT_NEAR(seconds(throttle.reserve("", 0, 100, 1, now)), 0.1, 0.02);
+    EXPECT_NEAR(seconds(throttle.reserve("", 1, 100, 1, now)), 0.2, 0.02);
+    EXPECT_NEAR(seconds(throttle.reserve("sda", 2, 100, 1, now)), 0.4, 0.02);
+
+    throttle.setGlobal({0, 10});
+    EXPECT_NEAR(seconds(throttle.reserve("", 0, 1 << 20, 5, now)), 0.5, 0.02);
+}
+
+// A headroom-only class takes budget only while the shared buckets hold it,
+// and never puts them into debt
+TEST(IoThrottleTest, HeadroomOnlyClassWaitsForUnusedBudget) {
+    IoThrottle throttle(2);
+    throttle.setGlobal({1000, 0});
+    throttle.setClass(1, {}, true);
+    auto now = IoThrottle::Clock::now() + std::chrono::seconds(2); // bucket full
+
+    auto grant = throttle.reserve("", 1, 400, 1, now);
+    EXPECT_TRUE(grant.granted);
+    EXPECT_EQ(grant.wait, std::chrono::nanoseconds::zero());
+
+    // The ordinary class takes the rest and more
+    grant = throttle.reserve("", 0, 1000, 1, now);
+    EXPECT_TRUE(grant.granted);
+    EXPECT_NEAR(std::chrono::duration<double>(grant.wait).count(), 0.4, 0.02);
+
+    grant = throttle.reserve("", 1, 100, 1, now);
+    EXPECT_FALSE(grant.granted);
+    EXPECT_GE(grant.wait, std::chrono::milliseconds(1));
+
+    // Nothing was taken: once the debt is paid off the budget is there
+    grant = throttle.reserve("", 1, 100, 1, now + std::chrono::milliseconds(500));
+    EXPECT_TRUE(grant.granted);
+    EXPECT_EQ(grant.wait, std::chrono::nanoseconds::zero());
+}
+
+// Devices can be replaced at runtime; one no longer listed is unlimited
+TEST(IoThrottleTest, DeviceLimitsChangeAtRuntime) {
+    IoThrottle throttle;
+    throttle.setDevices({{"sda", {1000, 0}}});
+    auto now = IoThrottle::Clock::now();
+    EXPECT_GT(throttle.reserve("sda", 0, 500, 1, now).wait, std::chrono::milliseconds(400));
+    EXPECT_EQ(throttle.reserve("sdb", 0, 500, 1, now).wait, std::chrono::nanoseconds::zero());
+
+    throttle.setDevices({{"sdb", {1000, 0}}});
+    EXPECT_EQ(throttle.reserve("sda", 0, 500, 1, now).wait, std::chrono::nanoseconds::zero());
+    EXPECT_GT(throttle.reserve("sdb", 0, 500, 1, now).wait, std::chrono::milliseconds(400));
+    EXPECT_EQ(throttle.getGlobal(), IoRate{});
+
+    // Classes past the last share it
+    throttle.setClass(5, {1000, 0});
+    EXPECT_GT(throttle.reserve("", 0, 500, 1, now).wait, std::chrono::milliseconds(400));
+}
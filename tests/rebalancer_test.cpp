@@ -0,0 +1,176 @@
+//
+// Tests for rebalance planning and progress.
+//
+#include <gtest/gtest.h>
+#include "rebalancer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+class RebalancerTest : public ::testing::Test {
+protected:
+    fs::path m_dir;
+
+    void SetUp() override {
+        m_dir = fs::temp_directory_path() / "file_sync_rebalancer_test";
+        fs::remove_all(m_dir);
+        fs::create_directories(m_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(m_dir);
+    }
+};
+
+// Only files the new placement puts elsewhere move, and all of them go to
+// the new member
+TEST_F(RebalancerTest, PlansDeltaOnly) {
+    FileIndex index((m_dir / "file_index.json").string());
+    ASSERT_TRUE(index.open());
+    Placement before({{"/array1", 1.0}, {"/array2", 1.0}});
+    for (int i = 0; i < 3000; ++i) {
+        std::string relative = "/IMG_" + std::to_string(i) + ".CR3";
+        index.put(relative, before.rootFor(relative), 10);
+    }
+
+    Placement after({{"/array1", 1.0}, {"/array2", 1.0}, {"/array3", 1.0}});
+    auto moves = Rebalancer::planMoves(index, after);
+    EXPECT_NEAR(static_cast<double>(moves.size()), 1000.0, 100.0);
+    for (const auto& move : moves) {
+        EXPECT_EQ(move.to, "/array3");
+        EXPECT_EQ(move.from, before.rootFor(move.relative));
+    }
+    EXPECT_TRUE(Rebalancer::planMoves(index, before).empty());
+
+    // Erasure-coded files are not moved
+    for (int i = 0; i < 3000; ++i) {
+        index.putErasure("/IMG_" + std::to_string(i) + ".CR3", 10);
+    }
+    EXPECT_TRUE(Rebalancer::planMoves(index, after).empty());
+}
+
+// Moves are ordered by old member, then physical offset, then path
+TEST_F(RebalancerTest, OrdersByOldMemberAndOffset) {
+    FileIndex index((m_dir / "file_index.json").string());
+    ASSERT_TRUE(index.open());
+    index.put("/d", "/old2", 1);
+    index.put("/c", "/old1", 1);
+    index.put("/b", "/old1", 1);
+    index.put("/a", "/old1", 1);
+    Placement placement({{"/new", 1.0}});
+
+    auto moves = Rebalancer::planMoves(index, placement, [](const std::string& path) -> std::optional<uint64_t> {
+        if (path == "/old1/c") return 4096;
+        if (path == "/old1/b") return 8192;
+        return std::nullopt;
+    });
+    std::vector<std::string> order;
+    for (const auto& move : moves) {
+        order.push_back(move.from + move.relative);
+    }
+    EXPECT_EQ(order, (std::vector<std::string>{"/old1/c", "/old1/b", "/old1/a", "/old2/d"}));
+}
+
+// Moves are handed out a window at a time; progress and ETA follow them
+TEST_F(RebalancerTest, WindowAndProgress) {
+    std::vector<Rebalancer::Move> moves;
+    for (int i = 0; i < 5; ++i) {
+        moves.push_back({"/f" + std::to_string(i), "/old", "/new", 100, std::nullopt, std::nullopt});
+    }
+    auto start = std::chrono::steady_clock::now();
+    Rebalancer rebalancer;
+    rebalancer.start(moves, start);
+
+    auto first = rebalancer.next(2);
+    ASSERT_EQ(first.size(), 2u);
+    EXPECT_TRUE(rebalancer.next(2).empty());
+    EXPECT_TRUE(rebalancer.isMoving("/f0"));
+
+    rebalancer.finished("/f0", true);
+    rebalancer.finished("/f1", false);
+    auto progress = rebalancer.getProgress(start + std::chrono::seconds(10));
+    EXPECT_EQ(progress.movedFiles, 1u);
+    EXPECT_EQ(progress.failedFiles, 1u);
+    EXPECT_EQ(progress.movedBytes, 100u);
+    ASSERT_TRUE(progress.eta);
+    EXPECT_EQ(progress.eta->count(), 40);
+
+    EXPECT_EQ(rebalancer.next(2).size(), 2u);
+    EXPECT_FALSE(rebalancer.done());
+    rebalancer.finished("/f2", true);
+    rebalancer.finished("/f3", true);
+    ASSERT_EQ(rebalancer.next(2).size(), 1u);
+    rebalancer.finished("/f4", true);
+    EXPECT_TRUE(rebalancer.done());
+}
+
+// A resilver plans the replaced member's whole copies from the cache tier
+// and the shard each erasure-coded file kept there
+TEST_F(RebalancerTest, PlansResilverOfMember) {
+    FileIndex index((m_dir / "file_index.json").string());
+    ASSERT_TRUE(index.open());
+    // Encoded over three members; a fourth joined afterwards, so the
+    // ranking no longer says where the shards are
+    Placement before({{"/array1", 1.0}, {"/array2", 1.0}, {"/array3", 1.0}});
+    Placement placement({{"/array1", 1.0}, {"/array2", 1.0}, {"/array3", 1.0}, {"/array4", 1.0}});
+    size_t whole = 0;
+    std::unordered_map<std::string, std::vector<std::string>> shardRoots;
+    for (int i = 0; i < 2000; ++i) {
+        std::string relative = "/IMG_" + std::to_string(i) + ".CR3";
+        if (i % 2 == 0) {
+            index.put(relative, placement.rootFor(relative), 10);
+            whole += placement.rootFor(relative) == "/array2" ? 1 : 0;
+        } else {
+            auto& roots = shardRoots[relative];
+            for (size_t member : before.rank(relative)) {
+                roots.push_back(before.members()[member].root);
+            }
+            index.putErasure(relative, 10, roots);
+        }
+    }
+
+    auto moves = Rebalancer::planResilver(index, placement, "/array2", "/cache", 3);
+    size_t shards = 0;
+    for (const auto& move : moves) {
+        EXPECT_EQ(move.to, "/array2");
+        if (!move.shard) {
+            EXPECT_EQ(move.from, "/cache");
+            EXPECT_EQ(placement.rootFor(move.relative), "/array2");
+            continue;
+        }
+        shards++;
+        const auto& roots = shardRoots.at(move.relative);
+        ASSERT_LT(*move.shard, 3u);
+        EXPECT_EQ(roots[*move.shard], "/array2");
+        EXPECT_NE(move.from, "/array2");
+        EXPECT_NE(std::find(roots.begin(), roots.end(), move.from), roots.end());
+    }
+    EXPECT_EQ(moves.size() - shards, whole);
+    // Every encoded file had a shard on each of the three members
+    EXPECT_EQ(shards, 1000u);
+    // Grouped by the device read
+    EXPECT_TRUE(std::is_sorted(moves.begin(), moves.end(),
+                               [](const auto& a, const auto& b) { return a.from < b.from; }));
+
+    EXPECT_TRUE(Rebalancer::planResilver(index, placement, "/array5", "/cache", 3).empty());
+}
+
+// The move handed out for a file can be looked up until it finishes
+TEST_F(RebalancerTest, InFlightMove) {
+    Rebalancer resilver("Resilver");
+    resilver.start({{"/a", "/cache", "/array1", 10, std::nullopt, std::nullopt},
+                    {"/b", "/array2", "/array1", 20, std::nullopt, 1}});
+    EXPECT_FALSE(resilver.inFlight("/a"));
+    ASSERT_EQ(resilver.next(4).size(), 2u);
+    auto move = resilver.inFlight("/b");
+    ASSERT_TRUE(move);
+    EXPECT_EQ(move->shard, std::optional<size_t>(1));
+    resilver.finished("/b", true);
+    EXPECT_FALSE(resilver.inFlight("/b"));
+    EXPECT_EQ(resilver.getSummary().rfind("Resilver: 1/2 files, 20/30 bytes", 0), 0u);
+}
@@ -0,0 +1,105 @@
+//
+// Tests for the Reed-Solomon erasure code and its kernels.
+//
+#include <gtest/gtest.h>
+#include "reed_solomon.hpp"
+
+#include <random>
+
+namespace {
+
+std::vector<std::vector<uint8_t>> randomShards(size_t count, size_t length, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::vector<uint8_t>> shards(count, std::vector<uint8_t>(length));
+    for (auto& shard : shards) {
+        for (auto& byte : shard) {
+            byte = static_cast<uint8_t>(rng());
+        }
+    }
+    return shards;
+}
+
+} // namespace
+
+TEST(ReedSolomonTest, FieldArithmetic) {
+    EXPECT_EQ(ReedSolomon::multiply(0, 0x53), 0);
+    EXPECT_EQ(ReedSolomon::multiply(1, 0x53), 0x53);
+    EXPECT_EQ(ReedSolomon::multiply(2, 0x80), 0x1d); // reduced by x^8 + x^4 + x^3 + x^2 + 1
+    for (unsigned a = 1; a < 256; ++a) {
+        EXPECT_EQ(ReedSolomon::multiply(static_cast<uint8_t>(a), ReedSolomon::inverse(static_cast<uint8_t>(a))), 1);
+    }
+    EXPECT_THROW(ReedSolomon::inverse(0), std::domain_error);
+}
+
+// Every kernel this CPU runs gives the scalar result, tails included
+TEST(ReedSolomonTest, KernelsMatchScalar) {
+    auto in = randomShards(1, 1000, 1)[0];
+    for (uint8_t c : {uint8_t{1}, uint8_t{2}, uint8_t{0x8e}, uint8_t{0xff}}) {
+        for (size_t n : {size_t{0}, size_t{15}, size_t{33}, size_t{1000}}) {
+            std::vector<uint8_t> expected(n, 0x5a), actual(n, 0x5a);
+            ReedSolomon::mulAddScalar(c, in.data(), expected.data(), n);
+            ReedSolomon::mulAdd(c, in.data(), actual.data(), n);
+            EXPECT_EQ(actual, expected) << "c " << int(c) << " n " << n << " kernel " << ReedSolomon::kernelName();
+#ifdef REED_SOLOMON_X86
+            if (__builtin_cpu_supports("ssse3")) {
+                std::vector<uint8_t> ssse3(n, 0x5a);
+                ReedSolomon::mulAddSsse3(c, in.data(), ssse3.data(), n);
+                EXPECT_EQ(ssse3, expected);
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                std::vector<uint8_t> avx2(n, 0x5a);
+                ReedSolomon::mulAddAvx2(c, in.data(), avx2.data(), n);
+                EXPECT_EQ(avx2, expected);
+            }
+#endif
+        }
+    }
+}
+
+// Any m lost shards, data or parity, come back from the other k
+TEST(ReedSolomonTest, RebuildsAnyMissingShards) {
+    const size_t k = 4, m = 2, length = 300000;
+    ReedSolomon rs(k, m);
+    auto shards = randomShards(k + m, length, 7);
+    std::vector<const uint8_t*> data;
+    std::vector<uint8_t*> parity;
+    for (size_t i = 0; i < k; ++i) {
+        data.push_back(shards[i].data());
+    }
+    for (size_t i = k; i < k + m; ++i) {
+        parity.push_back(shards[i].data());
+    }
+    rs.encode(data, parity, length);
+
+    for (size_t a = 0; a < k + m; ++a) {
+        for (size_t b = a + 1; b < k + m; ++b) {
+            auto damaged = shards;
+            std::vector<bool> present(k + m, true);
+            for (size_t lost : {a, b}) {
+                std::fill(damaged[lost].begin(), damaged[lost].end(), 0);
+                present[lost] = false;
+            }
+            std::vector<uint8_t*> buffers;
+            for (auto& shard : damaged) {
+                buffers.push_back(shard.data());
+            }
+            rs.reconstruct(buffers, present, length, 3);
+            EXPECT_EQ(damaged, shards) << "lost " << a << " and " << b;
+        }
+    }
+
+    std::vector<bool> present(k + m, true);
+    present[0] = present[1] = present[2] = false;
+    std::vector<uint8_t*> buffers;
+    for (auto& shard : shards) {
+        buffers.push_back(shard.data());
+    }
+    EXPECT_THROW(rs.reconstruct(buffers, present, length), std::runtime_error);
+}
+
+TEST(ReedSolomonTest, RejectsBadLayouts) {
+    EXPECT_THROW(ReedSolomon(0, 2), std::invalid_argument);
+    EXPECT_THROW(ReedSolomon(4, 0), std::invalid_argument);
+    EXPECT_THROW(ReedSolomon(250, 7), std::invalid_argument);
+    EXPECT_NO_THROW(ReedSolomon(250, 6));
+}
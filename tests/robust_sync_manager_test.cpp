@@ -0,0 +1,391 @@
+//
+// Tests for RobustSyncManager's orchestration against temporary directories.
+//
+#include <gtest/gtest.h>
+#include "robust_sync_manager.hpp"
+
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/time.h>
+
+namespace fs = std::filesystem;
+
+class RobustSyncManagerTest : public ::testing::Test {
+protected:
+    fs::path testDir;
+    std::shared_ptr<Configuration> config;
+
+    // Tasks finished so far: operation, path and outcome
+    struct Completion {
+        std::string operation;
+        std::string path;
+        bool synced;
+    };
+    std::mutex completedMutex;
+    std::condition_variable completedChanged;
+    std::vector<Completion> completed;
+
+    std::streambuf* originalBuffer;
+    std::stringstream capturedOutput;
+
+    void SetUp() override {
+        // One directory per test, as each runs with its own manager and logs
+        std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        testDir = fs::temp_directory_path() / ("file_sync_robust_sync_manager_test_" + name);
+        fs::remove_all(testDir);
+        fs::create_directories(testDir / "src");
+        fs::create_directories(testDir / "dst");
+
+        config = std::make_shared<Configuration>();
+        config->source_dir = (testDir / "src").string();
+        config->dest_dir = (testDir / "dst").string();
+        config->transaction_log_dir = (testDir / "txlog").string();
+        config->live_stats_path.clear();
+        config->max_retries = 0;
+        config->retry_delay_seconds = 0;
+
+        originalBuffer = std::cout.rdbuf();
+        std::cout.rdbuf(capturedOutput.rdbuf());
+    }
+
+    void TearDown() override {
+        std::cout.rdbuf(originalBuffer);
+        fs::remove_all(testDir);
+    }
+
+    std::unique_ptr<RobustSyncManager> makeManager() {
+        auto manager = std::make_unique<RobustSyncManager>(config, std::make_unique<MetricsCollector>());
+        manager->setCompletionCallback([this](const SyncTask& task, bool synced) {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            completed.push_back({task.getOperation(), task.getPath(), synced});
+            completedChanged.notify_all();
+        });
+        return manager;
+    }
+
+    // The outcomes of the first @p count tasks of @p operation, waiting up
+    // to @p timeout for them; fewer if they do not finish in time
+    std::vector<Completion> waitFor(const std::string& operation, size_t count,
+                                    std::chrono::seconds timeout = std::chrono::seconds(20)) {
+        std::unique_lock<std::mutex> lock(completedMutex);
+        std::vector<Completion> matching;
+        completedChanged.wait_for(lock, timeout, [&] {
+            matching.clear();
+            for (const auto& completion : completed) {
+                if (completion.operation == operation) {
+                    matching.push_back(completion);
+                }
+            }
+            return matching.size() >= count;
+        });
+        return matching;
+    }
+
+    std::string writeSource(const std::string& relative, const std::string& data) {
+        fs::path path = testDir / "src" / relative;
+        fs::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << data;
+        return path.string();
+    }
+
+    void writePolicy(const std::string& rules) {
+        std::ofstream(testDir / "policy.conf") << rules;
+        config->policy_file = (testDir / "policy.conf").string();
+    }
+
+    static std::string readFile(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream data;
+        data << in.rdbuf();
+        return data.str();
+    }
+
+    static std::string contents(size_t size, char fill) {
+        std::string data(size, fill);
+        for (size_t i = 0; i < size; i += 4099) {
+            data[i] = static_cast<char>(i / 4099);
+        }
+        return data;
+    }
+
+    // Leave @p path unused for @p days, so tiering takes it as cold
+    static void age(const std::string& path, int days) {
+        time_t then = time(nullptr) - 86400 * days;
+        struct timeval times[2] = {{then, 0}, {then, 0}};
+        utimes(path.c_str(), times);
+    }
+
+    // Array members DEST_DIR, m2 and m3, with 2 + 1 erasure coding; filled by
+    // encodeColdFiles()
+    std::vector<std::string> roots;
+    std::vector<std::string> originals;
+
+    // Write @p count files left cold for 60 days and run a manager until the
+    // cache tier has demoted them and they are encoded
+    void encodeColdFiles(size_t count) {
+        roots = {(testDir / "dst").string()};
+        for (const char* member : {"m2", "m3"}) {
+            roots.push_back((testDir / member).string());
+            fs::create_directories(roots.back());
+            config->array_members.push_back({roots.back(), 0});
+        }
+        config->tiering = true;
+        config->tier_cache_capacity = 1000;
+        config->tier_scan_interval_seconds = 1;
+        config->erasure_data_shards = 2;
+        config->erasure_parity_shards = 1;
+
+        for (size_t i = 0; i < count; ++i) {
+            originals.push_back(contents(600000 + i, static_cast<char>('e' + i)));
+            age(writeSource("cold/f" + std::to_string(i), originals.back()), 60);
+        }
+
+        auto manager = makeManager();
+        manager->start();
+        auto encoded = waitFor("ENCODE", count);
+        manager->stop();
+        ASSERT_EQ(encoded.size(), count);
+        for (const auto& completion : encoded) {
+            EXPECT_TRUE(completion.synced) << completion.path;
+        }
+        std::lock_guard<std::mutex> lock(completedMutex);
+        completed.clear();
+    }
+};
+
+// With a quorum of two of three destinations, a file is synced even though
+// one destination cannot be written; the other two hold it
+TEST_F(RobustSyncManagerTest, ReplicationReachesQuorumWithOneDestinationUnwritable) {
+    for (const char* member : {"a", "b"}) {
+        fs::create_directories(testDir / member);
+    }
+    // A file where a directory should be: nothing can be created below it
+    std::ofstream(testDir / "blocked") << "not a directory";
+    writePolicy("RAW dest=" + (testDir / "a").string() + "," + (testDir / "b").string() + "," +
+                (testDir / "blocked").string() + " quorum=2\n");
+    std::string data = contents(300000, 'r');
+    std::string source = writeSource("RAW/img.cr3", data);
+
+    auto manager = makeManager();
+    manager->start();
+    ASSERT_TRUE(manager->syncFile(source));
+    auto done = waitFor("SYNC", 1);
+    manager->stop();
+
+    ASSERT_EQ(done.size(), 1u);
+    EXPECT_TRUE(done[0].synced);
+    EXPECT_EQ(readFile(testDir / "a" / "RAW" / "img.cr3"), data);
+    EXPECT_EQ(readFile(testDir / "b" / "RAW" / "img.cr3"), data);
+}
+
+// Below the quorum the task fails, even though some replicas were written
+TEST_F(RobustSyncManagerTest, ReplicationFailsBelowQuorum) {
+    fs::create_directories(testDir / "a");
+    std::ofstream(testDir / "blocked") << "not a directory";
+    writePolicy("RAW dest=" + (testDir / "a").string() + "," + (testDir / "blocked").string() + "\n");
+    std::string source = writeSource("RAW/img.cr3", contents(1000, 'q'));
+
+    auto manager = makeManager();
+    manager->start();
+    ASSERT_TRUE(manager->syncFile(source));
+    auto done = waitFor("SYNC", 1);
+    manager->stop();
+
+    ASSERT_EQ(done.size(), 1u);
+    EXPECT_FALSE(done[0].synced);
+    EXPECT_TRUE(fs::exists(testDir / "a" / "RAW" / "img.cr3"));
+}
+
+// A quorum reached without every replica is retried for the replicas that
+// missed it only: one removed meanwhile from a durable destination stays gone
+TEST_F(RobustSyncManagerTest, DegradedReplicationRetriesOnlyMissedReplicas) {
+    config->max_retries = 1;
+    config->retry_delay_seconds = 1;
+    for (const char* member : {"a", "b"}) {
+        fs::create_directories(testDir / member);
+    }
+    std::ofstream(testDir / "blocked") << "not a directory";
+    writePolicy("RAW dest=" + (testDir / "a").string() + "," + (testDir / "b").string() + "," +
+                (testDir / "blocked").string() + " quorum=2\n");
+    std::string source = writeSource("RAW/img.cr3", contents(1000, 'd'));
+
+    auto manager = makeManager();
+    manager->start();
+    ASSERT_TRUE(manager->syncFile(source));
+    ASSERT_EQ(waitFor("SYNC", 1).size(), 1u);
+    fs::remove(testDir / "a" / "RAW" / "img.cr3");
+    auto done = waitFor("SYNC", 2);
+    manager->stop();
+
+    ASSERT_EQ(done.size(), 2u);
+    EXPECT_TRUE(done[0].synced);
+    EXPECT_FALSE(done[1].synced);
+    EXPECT_FALSE(fs::exists(testDir / "a" / "RAW" / "img.cr3"));
+    EXPECT_TRUE(fs::exists(testDir / "b" / "RAW" / "img.cr3"));
+}
+
+// With write-back a change stays on the source until a flush, which then
+// writes every dirty file
+TEST_F(RobustSyncManagerTest, WriteBackFlushesDirtyBatch) {
+    config->write_back = true;
+    config->write_back_max_age_seconds = 3600;
+    std::vector<std::string> sources;
+    for (int i = 0; i < 3; ++i) {
+        sources.push_back(writeSource("dir/f" + std::to_string(i), contents(5000 + i, static_cast<char>('a' + i))));
+    }
+
+    auto manager = makeManager();
+    manager->start();
+    for (const auto& source : sources) {
+        ASSERT_TRUE(manager->syncFile(source));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_FALSE(fs::exists(testDir / "dst" / "dir" / "f0"));
+
+    manager->flushDirty();
+    auto done = waitFor("FLUSH", sources.size());
+    manager->stop();
+
+    ASSERT_EQ(done.size(), sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        EXPECT_TRUE(done[i].synced) << done[i].path;
+        EXPECT_EQ(readFile(testDir / "dst" / "dir" / ("f" + std::to_string(i))), readFile(sources[i]));
+    }
+}
+
+// Cold files are demoted to the array and then encoded as 2 + 1 shards over
+// three members, leaving no whole copy behind
+TEST_F(RobustSyncManagerTest, EncodesColdFiles) {
+    const size_t kFiles = 4;
+    encodeColdFiles(kFiles);
+    if (HasFatalFailure()) {
+        return;
+    }
+    for (size_t i = 0; i < kFiles; ++i) {
+        std::string relative = "/cold/f" + std::to_string(i);
+        auto shards = ErasureStore::locate(roots, relative);
+        ASSERT_TRUE(shards) << relative;
+        EXPECT_EQ(shards->present(), 3u) << relative;
+        EXPECT_FALSE(fs::exists(roots[0] + relative) || fs::exists(roots[1] + relative) ||
+                     fs::exists(roots[2] + relative)) << relative;
+
+        ErasureStore::restore(*shards, (testDir / "restored").string());
+        EXPECT_EQ(readFile(testDir / "restored"), originals[i]) << relative;
+    }
+}
+
+// When a fourth member joins and one member's disk is replaced, resilver
+// rebuilds exactly the shards that member held
+TEST_F(RobustSyncManagerTest, ResilverRebuildsLostShards) {
+    const size_t kFiles = 4;
+    encodeColdFiles(kFiles);
+    if (HasFatalFailure()) {
+        return;
+    }
+
+    // A fourth member changes every file's ranking, but not where its shards are
+    roots.push_back((testDir / "m4").string());
+    fs::create_directories(roots.back());
+    config->array_members.push_back({roots.back(), 0});
+    std::vector<std::vector<std::string>> before;
+    for (size_t i = 0; i < kFiles; ++i) {
+        before.push_back(ErasureStore::locate(roots, "/cold/f" + std::to_string(i))->paths);
+    }
+    fs::remove_all(roots[1] + "/.erasure");
+
+    {
+        auto manager = makeManager();
+        manager->start();
+        ASSERT_TRUE(manager->resilverMember(roots[1]));
+        auto resilvered = waitFor("RESILVER", kFiles);
+        manager->stop();
+        ASSERT_EQ(resilvered.size(), kFiles);
+    }
+    for (size_t i = 0; i < kFiles; ++i) {
+        std::string relative = "/cold/f" + std::to_string(i);
+        auto shards = ErasureStore::locate(roots, relative);
+        ASSERT_TRUE(shards) << relative;
+        EXPECT_EQ(shards->paths, before[i]) << relative;
+        EXPECT_FALSE(fs::exists(roots[3] + "/.erasure")) << relative;
+
+        ErasureStore::restore(*shards, (testDir / "restored").string());
+        EXPECT_EQ(readFile(testDir / "restored"), originals[i]) << relative;
+    }
+}
+
+// A promotion cut short by a crash is replayed at startup: its partial copy
+// is discarded and the file stays a stub on the array, with nothing synced
+// from the array copy
+TEST_F(RobustSyncManagerTest, ReplaysInterruptedPromotion) {
+    config->tiering = true;
+    std::string data = contents(20000, 'p');
+    std::string arrayPath = (testDir / "dst" / "photos" / "img.cr3").string();
+    fs::create_directories(testDir / "dst" / "photos");
+    std::ofstream(arrayPath, std::ios::binary) << data;
+    std::string cachePath = writeSource("photos/img.cr3", data);
+    ASSERT_TRUE(TieringEngine::makeStub(cachePath, arrayPath, *TieringEngine::versionOf(cachePath)));
+    std::string partial = (testDir / "src" / "photos" / ".img.cr3.promote").string();
+    std::ofstream(partial, std::ios::binary) << data.substr(0, 5000);
+    {
+        TransactionLog log(config->transaction_log_dir);
+        ASSERT_TRUE(log.open());
+        std::string txId = log.logTransaction(TransactionLog::OperationType::COPY, cachePath, partial);
+        ASSERT_FALSE(txId.empty());
+        log.updateTransactionStatus(txId, TransactionLog::TransactionStatus::IN_PROGRESS);
+    }
+
+    {
+        auto manager = makeManager();
+        manager->start();
+        manager->stop();
+    }
+    EXPECT_FALSE(fs::exists(partial));
+    EXPECT_EQ(TieringEngine::stubTarget(cachePath), std::optional<std::string>(arrayPath));
+    EXPECT_EQ(readFile(arrayPath), data);
+    EXPECT_FALSE(fs::exists(testDir / "dst" / "img.cr3"));
+
+    TransactionLog log(config->transaction_log_dir);
+    ASSERT_TRUE(log.open());
+    EXPECT_TRUE(log.getPendingTransactions().empty());
+}
+
+// A hot array file admitted over the coldest cache file, with no room below
+// the high watermark, displaces that file: it is demoted and the hot one
+// promoted
+TEST_F(RobustSyncManagerTest, AdmittedPromotionDisplacesColdestFile) {
+    config->tiering = true;
+    config->tier_cache_capacity = 15000; // high watermark at 13500 bytes
+    config->tier_scan_interval_seconds = 1;
+    std::string coldData = contents(10000, 'c');
+    std::string cold = writeSource("cold.jpg", coldData);
+    age(cold, 60);
+    std::string hotData = contents(10000, 'h');
+    std::string arrayPath = (testDir / "dst" / "hot.jpg").string();
+    std::ofstream(arrayPath, std::ios::binary) << hotData;
+    std::string hot = writeSource("hot.jpg", hotData);
+    ASSERT_TRUE(TieringEngine::makeStub(hot, arrayPath, *TieringEngine::versionOf(hot)));
+
+    auto manager = makeManager();
+    manager->start();
+    std::vector<Completion> promoted;
+    for (int i = 0; i < 100 && promoted.empty(); ++i) {
+        manager->recordAccess(hot);
+        promoted = waitFor("PROMOTE", 1, std::chrono::seconds(0));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    promoted = waitFor("PROMOTE", 1);
+    auto demoted = waitFor("DEMOTE", 1);
+    manager->stop();
+
+    ASSERT_EQ(demoted.size(), 1u);
+    EXPECT_EQ(demoted[0].path, cold);
+    EXPECT_TRUE(demoted[0].synced);
+    ASSERT_EQ(promoted.size(), 1u);
+    EXPECT_TRUE(promoted[0].synced);
+    EXPECT_TRUE(TieringEngine::stubTarget(cold));
+    EXPECT_EQ(readFile(testDir / "dst" / "cold.jpg"), coldData);
+    EXPECT_FALSE(TieringEngine::stubTarget(hot));
+    EXPECT_EQ(readFile(hot), hotData);
+}
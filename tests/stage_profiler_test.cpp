@@ -0,0 +1,79 @@
+//
+// Tests for perf_event self-profiling of pipeline stages.
+//
+#include <gtest/gtest.h>
+#include "stage_profiler.hpp"
+#include <vector>
+
+namespace {
+
+volatile uint64_t sink = 0;
+
+void burnCycles() {
+    std::vector<uint64_t> data(1 << 16);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = i * 2654435761u;
+    }
+    uint64_t sum = 0;
+    for (auto value : data) {
+        sum = sum + value;
+    }
+    sink = sum;
+}
+
+} // namespace
+
+// Disabled profiling records nothing and never touches perf_event_open
+TEST(StageProfilerTest, DisabledIsNoOp) {
+    StageProfiler profiler;
+    {
+        StageProfiler::Scope scope("copy", profiler);
+        burnCycles();
+    }
+
+    EXPECT_FALSE(profiler.isEnabled());
+    EXPECT_TRUE(profiler.getTotals().empty());
+    EXPECT_NE(profiler.getSummary().find("disabled"), std::string::npos);
+
+    MetricsCollector metrics;
+    profiler.recordMetrics(metrics);
+    EXPECT_FALSE(metrics.getGauge("self_profiling_available").has_value());
+}
+
+// Enabled profiling either attributes counters to stages or degrades with a reason
+TEST(StageProfilerTest, AttributesStagesOrDegrades) {
+    StageProfiler profiler;
+    profiler.setEnabled(true);
+
+    for (int i = 0; i < 3; ++i) {
+        StageProfiler::Scope scope("verify", profiler);
+        burnCycles();
+    }
+    {
+        StageProfiler::Scope scope("copy", profiler);
+    }
+
+    MetricsCollector metrics;
+    profiler.recordMetrics(metrics);
+    auto available = metrics.getGauge("self_profiling_available");
+    ASSERT_TRUE(available.has_value());
+
+    if (!profiler.isAvailable()) {
+        EXPECT_EQ(*available, 0.0);
+        EXPECT_TRUE(profiler.getTotals().empty());
+        EXPECT_FALSE(profiler.getUnavailableReason().empty());
+        EXPECT_NE(profiler.getSummary().find("unavailable"), std::string::npos);
+        GTEST_SKIP() << "perf_event_open refused: " << profiler.getUnavailableReason();
+    }
+
+    EXPECT_EQ(*available, 1.0);
+    auto totals = profiler.getTotals();
+    ASSERT_EQ(totals.count("verify"), 1u);
+    ASSERT_EQ(totals.count("copy"), 1u);
+    EXPECT_EQ(totals["verify"].calls, 3u);
+    EXPECT_EQ(totals["copy"].calls, 1u);
+    EXPECT_TRUE(metrics.getGauge("stage_calls{stage=\"verify\"}").has_value());
+
+    profiler.reset();
+    EXPECT_TRUE(profiler.getTotals().empty());
+}
@@ -0,0 +1,96 @@
+//
+// Tests for per-task resource accounting.
+//
+#include <gtest/gtest.h>
+#include "task_accounting.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+class TaskAccountingTest : public ::testing::Test {
+protected:
+    fs::path testDir;
+
+    void SetUp() override {
+        testDir = fs::temp_directory_path() / "file_sync_accounting_test";
+        fs::create_directories(testDir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(testDir);
+    }
+};
+
+// Paths are charged to the first directory below the source root
+TEST_F(TaskAccountingTest, TopLevelDirectory) {
+    TaskAccounting accounting("/photos");
+
+    EXPECT_EQ(accounting.topLevelDirectory("/photos/Albums/2024/img.cr3"), "Albums");
+    EXPECT_EQ(accounting.topLevelDirectory("/photos/Imports/a.jpg"), "Imports");
+    EXPECT_EQ(accounting.topLevelDirectory("/photos/loose.jpg"), ".");
+    EXPECT_EQ(accounting.topLevelDirectory("/elsewhere/file.jpg"), "(other)");
+}
+
+// Costs accumulate per directory
+TEST_F(TaskAccountingTest, AggregatesByDirectory) {
+    TaskAccounting accounting("/photos");
+
+    TaskCost cost;
+    cost.bytesRead = 100;
+    cost.bytesWritten = 50;
+    cost.majorFaults = 1;
+    cost.cpuTime = std::chrono::milliseconds(2);
+
+    accounting.record("/photos/Albums/a.jpg", cost);
+    accounting.record("/photos/Albums/b.jpg", cost);
+    accounting.record("/photos/Scratch/c.tmp", cost);
+
+    auto totals = accounting.getTotals();
+    ASSERT_EQ(totals.size(), 2u);
+    EXPECT_EQ(totals["Albums"].tasks, 2u);
+    EXPECT_EQ(totals["Albums"].cost.bytesRead, 200u);
+    EXPECT_EQ(totals["Albums"].cost.bytesWritten, 100u);
+    EXPECT_EQ(totals["Albums"].cost.majorFaults, 2u);
+    EXPECT_EQ(totals["Albums"].cost.cpuTime, std::chrono::milliseconds(4));
+    EXPECT_EQ(totals["Scratch"].tasks, 1u);
+
+    // Heaviest directory is listed first
+    EXPECT_EQ(accounting.getSummary().rfind("Albums", 0), 0u);
+}
+
+// A sample pair measures the work done on the calling thread in between
+TEST_F(TaskAccountingTest, SampleMeasuresThreadWork) {
+    auto before = ResourceSample::capture();
+
+    std::string data(1 << 20, 'x');
+    {
+        std::ofstream out(testDir / "payload.bin", std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    volatile uint64_t spin = 0;
+    for (int i = 0; i < 1000000; ++i) {
+        spin = spin + static_cast<uint64_t>(i);
+    }
+
+    TaskCost cost = ResourceSample::capture() - before;
+    EXPECT_GT(cost.wallTime.count(), 0);
+    EXPECT_GT(cost.cpuTime.count(), 0);
+    if (fs::exists("/proc/thread-self/io")) {
+        EXPECT_GE(cost.bytesWritten, data.size());
+        EXPECT_GE(cost.writeSyscalls, 1u);
+    }
+}
+
+// Sampling itself costs nothing: back-to-back samples see no reads
+TEST_F(TaskAccountingTest, SampleExcludesItsOwnRead) {
+    if (!fs::exists("/proc/thread-self/io")) {
+        GTEST_SKIP() << "No per-thread I/O accounting";
+    }
+    ResourceSample::capture(); // opens the descriptor
+    auto before = ResourceSample::capture();
+    TaskCost cost = ResourceSample::capture() - before;
+    EXPECT_EQ(cost.readSyscalls, 0u);
+    EXPECT_EQ(cost.bytesRead, 0u);
+}
@@ -0,0 +1,207 @@
+//
+// Tests for tier placement: heat ordering, demotion planning and stubs.
+//
+#include <gtest/gtest.h>
+#include "tiering_engine.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const auto kEpoch = std::chrono::system_clock::from_time_t(1700000000);
+
+std::chrono::system_clock::time_point at(std::chrono::seconds offset) {
+    return kEpoch + offset;
+}
+
+} // namespace
+
+// Hits halve every half-life
+TEST(TieringEngineTest, HeatDecays) {
+    TieringEngine engine(std::chrono::hours(1));
+    engine.track("/cache/a", 100, TieringEngine::Tier::CACHE, at(std::chrono::seconds(0)));
+    engine.recordAccess("/cache/a", at(std::chrono::seconds(0)));
+
+    EXPECT_DOUBLE_EQ(engine.heat("/cache/a", at(std::chrono::seconds(0))), 2.0);
+    EXPECT_DOUBLE_EQ(engine.heat("/cache/a", at(std::chrono::hours(1))), 1.0);
+    EXPECT_DOUBLE_EQ(engine.heat("/cache/a", at(std::chrono::hours(2))), 0.5);
+    EXPECT_DOUBLE_EQ(engine.heat("/cache/missing"), 0.0);
+}
+
+// Demotion takes the coldest files first: old and rarely used before recent
+// or frequently used
+TEST(TieringEngineTest, DemotesColdestFirst) {
+    TieringEngine engine(std::chrono::hours(1));
+    engine.track("/cache/old", 10, TieringEngine::Tier::CACHE, at(std::chrono::hours(0)));
+    engine.track("/cache/recent", 10, TieringEngine::Tier::CACHE, at(std::chrono::hours(3)));
+    engine.track("/cache/frequent", 10, TieringEngine::Tier::CACHE, at(std::chrono::hours(1)));
+    for (int i = 0; i < 7; ++i) {
+        engine.recordAccess("/cache/frequent", at(std::chrono::hours(1)));
+    }
+    // 8 hits two hours ago (heat 2) beat 1 hit now (heat 1)
+    engine.track("/cache/new", 10, TieringEngine::Tier::CACHE, at(std::chrono::hours(3)));
+
+    auto plan = engine.planDemotions(30, 10);
+    ASSERT_EQ(plan.size(), 3u);
+    EXPECT_EQ(plan[0].path, "/cache/old");
+    EXPECT_TRUE(plan[1].path == "/cache/recent" || plan[1].path == "/cache/new");
+    EXPECT_TRUE(plan[2].path == "/cache/recent" || plan[2].path == "/cache/new");
+    EXPECT_EQ(engine.getStats().demotingBytes, 30u);
+}
+
+// Planned files are not planned twice; a failed move puts them back
+TEST(TieringEngineTest, PlanRespectsBytesAndBatch) {
+    TieringEngine engine;
+    for (int i = 0; i < 10; ++i) {
+        engine.track("/cache/f" + std::to_string(i), 100, TieringEngine::Tier::CACHE, at(std::chrono::seconds(i)));
+    }
+
+    auto first = engine.planDemotions(250, 100);
+    ASSERT_EQ(first.size(), 3u);
+    EXPECT_EQ(first[0].path, "/cache/f0");
+
+    auto second = engine.planDemotions(1000, 2);
+    ASSERT_EQ(second.size(), 2u);
+    EXPECT_EQ(second[0].path, "/cache/f3");
+
+    engine.finishMove("/cache/f0", TieringEngine::Tier::ARRAY);
+    engine.finishMove("/cache/f3", TieringEngine::Tier::CACHE);
+    auto stats = engine.getStats();
+    EXPECT_EQ(stats.arrayFiles, 1u);
+    EXPECT_EQ(stats.cacheFiles, 9u);
+    EXPECT_EQ(stats.demotingFiles, 3u);
+    EXPECT_EQ(engine.planDemotions(100, 1)[0].path, "/cache/f3");
+}
+
+// Files on the array are promoted once their decayed hits reach the threshold
+TEST(TieringEngineTest, PromotesHotArrayFiles) {
+    TieringEngine engine(std::chrono::hours(1), 3.0);
+    engine.track("/cache/a", 100, TieringEngine::Tier::ARRAY, at(std::chrono::seconds(0)));
+    engine.track("/cache/b", 100, TieringEngine::Tier::CACHE, at(std::chrono::seconds(0)));
+
+    EXPECT_FALSE(engine.recordAccess("/cache/a", at(std::chrono::seconds(0))));
+    EXPECT_TRUE(engine.recordAccess("/cache/a", at(std::chrono::seconds(0))));
+    EXPECT_FALSE(engine.recordAccess("/cache/b", at(std::chrono::seconds(0))));
+    EXPECT_FALSE(engine.recordAccess("/cache/b", at(std::chrono::seconds(0))));
+    EXPECT_FALSE(engine.recordAccess("/cache/unknown"));
+
+    // Spread over hours the same accesses are not enough
+    engine.track("/cache/c", 100, TieringEngine::Tier::ARRAY, at(std::chrono::seconds(0)));
+    EXPECT_FALSE(engine.recordAccess("/cache/c", at(std::chrono::hours(2))));
+    EXPECT_FALSE(engine.recordAccess("/cache/c", at(std::chrono::hours(4))));
+
+    EXPECT_TRUE(engine.beginPromotion("/cache/a"));
+    EXPECT_FALSE(engine.beginPromotion("/cache/a"));
+    EXPECT_FALSE(engine.beginPromotion("/cache/b"));
+    EXPECT_FALSE(engine.recordAccess("/cache/a", at(std::chrono::seconds(0))));
+
+    TieringEngine::FileVersion version{100, 42};
+    engine.finishMove("/cache/a", TieringEngine::Tier::CACHE, version);
+    EXPECT_EQ(engine.tierOf("/cache/a"), TieringEngine::Tier::CACHE);
+    EXPECT_TRUE(engine.isPromotedCopy("/cache/a", version));
+    EXPECT_FALSE(engine.isPromotedCopy("/cache/a", {100, 43}));
+
+    // A sync of new content forgets the promotion
+    engine.track("/cache/a", 120, TieringEngine::Tier::CACHE);
+    EXPECT_FALSE(engine.isPromotedCopy("/cache/a", version));
+    EXPECT_EQ(engine.getStats().cacheBytes, 220u);
+}
+
+// Array files untouched since the cutoff are encoded, oldest first and once
+TEST(TieringEngineTest, PlansColdArrayEncodes) {
+    TieringEngine engine(std::chrono::hours(1));
+    engine.track("/cache/cold", 100, TieringEngine::Tier::ARRAY, at(std::chrono::hours(0)));
+    engine.track("/cache/colder", 200, TieringEngine::Tier::ARRAY, at(-std::chrono::hours(5)));
+    engine.track("/cache/done", 300, TieringEngine::Tier::ARRAY, at(-std::chrono::hours(9)));
+    engine.track("/cache/warm", 400, TieringEngine::Tier::ARRAY, at(std::chrono::hours(10)));
+    engine.track("/cache/cached", 500, TieringEngine::Tier::CACHE, at(-std::chrono::hours(9)));
+
+    auto skip = [](const std::string& path) { return path == "/cache/done"; };
+    auto plan = engine.planEncodes(at(std::chrono::hours(5)), 10, skip);
+    ASSERT_EQ(plan.size(), 2u);
+    EXPECT_EQ(plan[0].path, "/cache/colder");
+    EXPECT_EQ(plan[1].path, "/cache/cold");
+    EXPECT_EQ(engine.getStats().encodingFiles, 2u);
+    EXPECT_EQ(engine.getStats().promotingFiles, 0u);
+
+    // Being encoded: neither planned again nor promoted
+    EXPECT_TRUE(engine.planEncodes(at(std::chrono::hours(5)), 10, skip).empty());
+    EXPECT_FALSE(engine.beginPromotion("/cache/cold"));
+
+    engine.finishMove("/cache/cold", TieringEngine::Tier::ARRAY);
+    engine.finishMove("/cache/colder", TieringEngine::Tier::ARRAY);
+    EXPECT_EQ(engine.getStats().encodingFiles, 0u);
+    EXPECT_EQ(engine.planEncodes(at(std::chrono::hours(5)), 1).size(), 1u);
+}
+
+// A stub keeps size, mode and mtime, holds no blocks and names the array copy
+TEST(TieringEngineTest, StubReplacesFile) {
+    fs::path dir = fs::temp_directory_path() / "file_sync_tiering_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string path = (dir / "IMG_0001.CR3").string();
+    std::ofstream(path, std::ios::binary) << std::string(1 << 20, 'x');
+    fs::permissions(path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+
+    auto version = TieringEngine::versionOf(path);
+    ASSERT_TRUE(version);
+    EXPECT_FALSE(TieringEngine::stubTarget(path));
+
+    // Changed since verification: left alone
+    EXPECT_FALSE(TieringEngine::makeStub(path, "/array/IMG_0001.CR3", {version->size + 1, version->mtimeNs}));
+
+    try {
+        ASSERT_TRUE(TieringEngine::makeStub(path, "/array/IMG_0001.CR3", *version));
+    } catch (const std::system_error& e) {
+        fs::remove_all(dir);
+        GTEST_SKIP() << "no user xattrs on " << dir << ": " << e.what();
+    }
+
+    EXPECT_EQ(TieringEngine::stubTarget(path), std::optional<std::string>("/array/IMG_0001.CR3"));
+    EXPECT_EQ(TieringEngine::versionOf(path), version);
+    struct stat st;
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_blocks, 0);
+    EXPECT_EQ(st.st_mode & 0777, 0640u);
+    EXPECT_EQ(std::distance(fs::directory_iterator(dir), fs::directory_iterator()), 1);
+
+    fs::remove_all(dir);
+}
+
+// Files read once or twice by a scan are not promoted over the cache's
+// regularly used files; a file used more often than the coldest one is
+TEST(TieringEngineTest, AdmissionResistsScans) {
+    TieringEngine engine(std::chrono::hours(24), 2.0, 4096);
+    for (int i = 0; i < 100; ++i) {
+        std::string path = "/cache/hot" + std::to_string(i);
+        engine.track(path, 100, TieringEngine::Tier::CACHE, at(std::chrono::seconds(0)));
+        for (int access = 0; access < 3; ++access) {
+            engine.recordAccess(path, at(std::chrono::seconds(access)));
+        }
+    }
+    for (int i = 0; i < 1000; ++i) {
+        engine.track("/cache/archive" + std::to_string(i), 100, TieringEngine::Tier::ARRAY, at(std::chrono::seconds(0)));
+    }
+
+    // A search reading the whole archive twice
+    int promoted = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < 1000; ++i) {
+            promoted += engine.recordAccess("/cache/archive" + std::to_string(i), at(std::chrono::seconds(10)));
+        }
+    }
+    EXPECT_EQ(promoted, 0);
+    EXPECT_EQ(engine.getStats().rejected, 1000u);
+
+    // A file opened over and over outranks the least used cache file
+    bool admitted = false;
+    for (int access = 0; access < 5 && !admitted; ++access) {
+        admitted = engine.recordAccess("/cache/archive7", at(std::chrono::seconds(20)));
+    }
+    EXPECT_TRUE(admitted);
+    EXPECT_GT(engine.estimatedFrequency("/cache/archive7"), engine.estimatedFrequency("/cache/hot0"));
+}
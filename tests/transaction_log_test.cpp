@@ -0,0 +1,138 @@
+//
+// Tests for transaction log replay after a crash.
+//
+#include <gtest/gtest.h>
+#include "transaction_log.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+class TransactionLogTest : public ::testing::Test {
+protected:
+    fs::path testDir;
+
+    void SetUp() override {
+        testDir = fs::temp_directory_path() / "file_sync_transaction_log_test";
+        fs::remove_all(testDir);
+        fs::create_directories(testDir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(testDir);
+    }
+
+    fs::path logFile() {
+        for (const auto& entry : fs::directory_iterator(testDir)) {
+            if (entry.path().filename().string().find("sync_log_") == 0) {
+                return entry.path();
+            }
+        }
+        return {};
+    }
+};
+
+// A fresh instance rebuilds the in-flight set from the previous run's log
+TEST_F(TransactionLogTest, RecoverFindsInFlight) {
+    std::string pending, running;
+    {
+        TransactionLog log(testDir.string());
+        ASSERT_TRUE(log.open());
+        std::string done = log.logTransaction(TransactionLog::OperationType::COPY, "/src/a", "/dst/a");
+        log.updateTransactionStatus(done, TransactionLog::TransactionStatus::COMPLETED);
+        pending = log.logTransaction(TransactionLog::OperationType::COPY, "/src/b", "/dst/b");
+        running = log.logTransaction(TransactionLog::OperationType::COPY, "/src/c", "/dst/c");
+        log.updateTransactionStatus(running, TransactionLog::TransactionStatus::IN_PROGRESS);
+    }
+
+    TransactionLog log(testDir.string());
+    ASSERT_TRUE(log.open());
+    auto stats = log.recover();
+    EXPECT_EQ(stats.records, 5u);
+    EXPECT_EQ(stats.transactions, 3u);
+    EXPECT_EQ(stats.inFlight, 2u);
+    EXPECT_EQ(stats.tornBytes, 0u);
+    EXPECT_EQ(log.getInFlightStats().count, 2u);
+
+    // IN_PROGRESS is reported before PENDING
+    auto recovered = log.getPendingTransactions();
+    ASSERT_EQ(recovered.size(), 2u);
+    EXPECT_EQ(recovered[0].id, running);
+    EXPECT_EQ(recovered[1].id, pending);
+}
+
+// A partial record from an interrupted write is cut off, and appends after
+// recovery land on their own line
+TEST_F(TransactionLogTest, RecoverTruncatesTornTail) {
+    {
+        TransactionLog log(testDir.string());
+        ASSERT_TRUE(log.open());
+        log.logTransaction(TransactionLog::OperationType::COPY, "/src/a", "/dst/a");
+    }
+    const std::string torn = "{\"id\":\"tx-1-99\",\"operation\":0,\"sourcePa";
+    std::ofstream(logFile(), std::ios::app) << torn;
+
+    TransactionLog log(testDir.string());
+    ASSERT_TRUE(log.open());
+    auto stats = log.recover();
+    EXPECT_EQ(stats.tornBytes, torn.size());
+    EXPECT_EQ(stats.records, 1u);
+
+    std::string id = log.logTransaction(TransactionLog::OperationType::COPY, "/src/b", "/dst/b");
+    log.close();
+
+    TransactionLog reopened(testDir.string());
+    ASSERT_TRUE(reopened.open());
+    auto again = reopened.recover();
+    EXPECT_EQ(again.records, 2u);
+    EXPECT_EQ(again.tornBytes, 0u);
+    auto pending = reopened.getPendingTransactions();
+    EXPECT_TRUE(std::any_of(pending.begin(), pending.end(), [&](const auto& tx) { return tx.id == id; }));
+}
+
+// New ids continue after the highest one in the replayed log
+TEST_F(TransactionLogTest, RecoverContinuesIds) {
+    std::string last;
+    {
+        TransactionLog log(testDir.string());
+        ASSERT_TRUE(log.open());
+        for (int i = 0; i < 3; ++i) {
+            last = log.logTransaction(TransactionLog::OperationType::COPY, "/src/" + std::to_string(i));
+        }
+    }
+
+    TransactionLog log(testDir.string());
+    ASSERT_TRUE(log.open());
+    log.recover();
+    std::string next = log.logTransaction(TransactionLog::OperationType::COPY, "/src/next");
+    auto sequence = [](const std::string& id) { return std::stoull(id.substr(id.find_last_of('-') + 1)); };
+    EXPECT_EQ(sequence(next), sequence(last) + 1);
+}
+
+// A replication completes once its quorum of replicas is durable, and the
+// replica lists survive a restart
+TEST_F(TransactionLogTest, ReplicationQuorum) {
+    const std::vector<std::string> replicas{"/mnt/a/x", "/mnt/b/x", "/mnt/c/x"};
+    std::string id;
+    {
+        TransactionLog log(testDir.string());
+        ASSERT_TRUE(log.open());
+        id = log.logReplication("/src/x", replicas, 2);
+        EXPECT_FALSE(log.recordDurableReplica(id, "/mnt/b/x"));
+        EXPECT_TRUE(log.getTransactionsByStatus(TransactionLog::TransactionStatus::COMPLETED).empty());
+        EXPECT_TRUE(log.recordDurableReplica(id, "/mnt/a/x"));
+    }
+
+    TransactionLog log(testDir.string());
+    ASSERT_TRUE(log.open());
+    auto stats = log.recover();
+    EXPECT_EQ(stats.inFlight, 0u);
+    auto completed = log.getTransactionsByStatus(TransactionLog::TransactionStatus::COMPLETED);
+    ASSERT_EQ(completed.size(), 1u);
+    EXPECT_EQ(completed[0].id, id);
+    EXPECT_EQ(completed[0].operation, TransactionLog::OperationType::REPLICATE);
+    EXPECT_EQ(completed[0].replicas, replicas);
+    EXPECT_EQ(completed[0].durableReplicas, (std::vector<std::string>{"/mnt/b/x", "/mnt/a/x"}));
+    EXPECT_EQ(completed[0].quorum, 2u);
+}